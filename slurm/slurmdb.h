@@ -259,6 +259,15 @@ typedef struct {
 	List jobname_list;	/* list of char * */
 	uint32_t nodes_max;     /* number of nodes high range */
 	uint32_t nodes_min;     /* number of nodes low range */
+	char *page_cluster;	/* with page_size, cluster of the last job
+				 * of the previous page */
+	uint32_t page_jobid;	/* with page_size, job id of the last job of
+				 * the previous page */
+	uint32_t page_size;	/* if set give me about this many jobs, fewer
+				 * only if they are the last, after that of
+				 * page_cluster and page_jobid in order of
+				 * cluster and job id. Cleared by storage
+				 * which gives every job at once */
 	List partition_list;	/* list of char * */
 	List qos_list;  	/* list of char * */
 	List resv_list;		/* list of char * */
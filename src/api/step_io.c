@@ -42,6 +42,7 @@
 #include <string.h>
 #include <time.h>
 #include <signal.h>
+#include <sys/uio.h>
 
 #include "src/common/fd.h"
 #include "src/common/hostlist.h"
@@ -64,6 +65,11 @@
 
 #define MAX_RETRIES 3
 #define STDIO_MAX_FREE_BUF 1024
+/* Size of the buffer into which each slurmstepd's messages are read, must
+ * hold at least one message of MAX_MSG_LEN bytes plus its header */
+#define SERVER_READ_BUF_SIZE (32 * 1024)
+/* Most messages gathered into a single writev() to an output file */
+#define FILE_WRITE_MAX_IOV 64
 
 struct io_buf {
 	int ref_count;
@@ -121,9 +127,10 @@ struct server_io_info {
 	bool testing_connection;
 
 	/* incoming variables */
-	struct slurm_io_header header;
-	struct io_buf *in_msg;
-	int32_t in_remaining;
+	Buf in_buf;		/* messages read, unpacked up to its offset */
+	uint32_t in_tail;	/* end of the bytes read into in_buf */
+	bool in_stalled;	/* complete messages in in_buf wait for a
+				 * free outgoing buffer */
 	bool in_eof;
 	int remote_stdout_objs; /* active eio_obj_t's on the remote node */
 	int remote_stderr_objs; /* active eio_obj_t's on the remote node */
@@ -135,6 +142,11 @@ struct server_io_info {
 	bool out_eof;
 };
 
+static int _server_drain(struct server_io_info *s);
+static void _server_in_fini(struct server_io_info *s);
+static void _server_stall(struct server_io_info *s, bool stalled);
+static void _free_outgoing_msg(client_io_t *cio, struct io_buf *msg);
+
 /**********************************************************************
  * File write declarations
  **********************************************************************/
@@ -233,8 +245,9 @@ _create_server_eio_obj(int fd, client_io_t *cio, int nodeid,
 	info->cio = cio;
 	info->node_id = nodeid;
 	info->testing_connection = false;
-	info->in_msg = NULL;
-	info->in_remaining = 0;
+	info->in_buf = init_buf(SERVER_READ_BUF_SIZE);
+	info->in_tail = 0;
+	info->in_stalled = false;
 	info->in_eof = false;
 	info->remote_stdout_objs = stdout_objs;
 	info->remote_stderr_objs = stderr_objs;
@@ -265,6 +278,12 @@ _server_readable(eio_obj_t *obj)
 		return false;
 	}
 
+	if (s->in_stalled) {
+		/* unpacked by _free_outgoing_msg() as buffers are freed */
+		debug4("  false, messages still waiting");
+		return false;
+	}
+
 	if (s->remote_stdout_objs > 0 || s->remote_stderr_objs > 0 ||
 	    s->testing_connection) {
 		debug4("remote_stdout_objs = %d", s->remote_stdout_objs);
@@ -276,7 +295,7 @@ _server_readable(eio_obj_t *obj)
 		if (obj->fd != -1) {
 			close(obj->fd);
 			obj->fd = -1;
-			s->in_eof = true;
+			_server_in_fini(s);
 			s->out_eof = true;
 		}
 		debug3("  false, shutdown");
@@ -287,136 +306,226 @@ _server_readable(eio_obj_t *obj)
 	return false;
 }
 
+/*
+ * Get a buffer for a message unpacked from a slurmstepd, no more than
+ * STDIO_MAX_FREE_BUF are ever allocated.
+ * RET a buffer or NULL if none is free
+ */
+static struct io_buf *
+_server_get_buf(client_io_t *cio)
+{
+	if (!_outgoing_buf_free(cio))
+		return NULL;
+	return list_dequeue(cio->free_outgoing);
+}
+
+/*
+ * Unpack and route the complete messages in s->in_buf, leaving its offset at
+ * the start of the first incomplete one, or of the first one for which no
+ * outgoing buffer is free. One read may hold many messages, those left wait
+ * in in_buf until buffers are freed (see _free_outgoing_msg()).
+ * RET SLURM_ERROR if a message is malformed
+ */
 static int
-_server_read(eio_obj_t *obj, List objs)
+_server_unpack_msgs(struct server_io_info *s)
 {
-	struct server_io_info *s = (struct server_io_info *) obj->arg;
-	void *buf;
-	int n;
+	int hdr_size = io_hdr_packed_size();
+	struct file_write_info *info;
+	struct slurm_io_header header;
+	struct io_buf *msg;
+	eio_obj_t *obj;
+	uint32_t offset;
 
-	debug4("Entering _server_read");
-	if (s->in_msg == NULL) {
-		if (_outgoing_buf_free(s->cio)) {
-			s->in_msg = list_dequeue(s->cio->free_outgoing);
-		} else {
-			debug("List free_outgoing is empty!");
+	_server_stall(s, false);
+	while ((s->in_tail - (offset = get_buf_offset(s->in_buf))) >=
+	       hdr_size) {
+		if (io_hdr_unpack(&header, s->in_buf) != SLURM_SUCCESS)
+			return SLURM_ERROR;
+		if (header.length > MAX_MSG_LEN) {
+			error("Message length of %u exceeds maximum of %u",
+			      header.length, MAX_MSG_LEN);
 			return SLURM_ERROR;
 		}
-
-		n = io_hdr_read_fd(obj->fd, &s->header);
-		if (n <= 0) { /* got eof or error on socket read */
-			if (s->cio->sls)
-				step_launch_notify_io_failure(s->cio->sls,
-							      s->node_id);
-			debug3("got error or unexpected eof "
-			       "on _server_read header");
-			close(obj->fd);
-			obj->fd = -1;
-			s->in_eof = true;
-			s->out_eof = true;
-			list_enqueue(s->cio->free_outgoing, s->in_msg);
-			s->in_msg = NULL;
-			return SLURM_SUCCESS;
+		if ((s->in_tail - get_buf_offset(s->in_buf)) < header.length) {
+			/* body not yet read */
+			set_buf_offset(s->in_buf, offset);
+			break;
 		}
-		if (s->header.type == SLURM_IO_CONNECTION_TEST) {
+
+		if (header.type == SLURM_IO_CONNECTION_TEST) {
 			if (s->cio->sls)
 				step_launch_clear_questionable_state(
 					s->cio->sls, s->node_id);
-			list_enqueue(s->cio->free_outgoing, s->in_msg);
-			s->in_msg = NULL;
 			s->testing_connection = false;
-			return SLURM_SUCCESS;
-
-		} else if (s->header.length == 0) { /* eof message */
-			if (s->header.type == SLURM_IO_STDOUT) {
+			continue;
+		} else if (header.length == 0) { /* eof message */
+			if (header.type == SLURM_IO_STDOUT) {
 				s->remote_stdout_objs--;
-				debug3( "got eof-stdout msg on _server_read "
-					"header");
-			} else if (s->header.type == SLURM_IO_STDERR) {
+				debug3("got eof-stdout msg on _server_read "
+				       "header");
+			} else if (header.type == SLURM_IO_STDERR) {
 				s->remote_stderr_objs--;
-				debug3( "got eof-stderr msg on _server_read "
-					"header");
+				debug3("got eof-stderr msg on _server_read "
+				       "header");
 			} else
 				error("Unrecognized output message type");
-			list_enqueue(s->cio->free_outgoing, s->in_msg);
-			s->in_msg = NULL;
-			return SLURM_SUCCESS;
+			continue;
 		}
-		s->in_remaining = s->header.length;
-		s->in_msg->length = s->header.length;
-		s->in_msg->header = s->header;
-	}
 
-	/*
-	 * Read the body
-	 */
-	if (s->header.length != 0) {
-		buf = s->in_msg->data + (s->in_msg->length - s->in_remaining);
-	again:
-		if ((n = read(obj->fd, buf, s->in_remaining)) < 0) {
-			if (errno == EINTR)
-				goto again;
-			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
-				return SLURM_SUCCESS;
-			if (errno == ECONNRESET) {
-				/* The slurmstepd writes the message (header
-				 * plus data) in a single write(). We read the
-				 * header above OK, but the data can't be read.
-				 * I've confirmed the full write completes and
-				 * the file is closed at slurmstepd shutdown.
-				 * The reason for this error is unknown. -Moe */
-				debug("Stdout/err from task %u may be "
-				      "incomplete due to a network error",
-				      s->header.gtaskid);
-			} else {
-				debug3("_server_read error: %m");
-			}
-		}
-		if (n <= 0) { /* got eof or unhandled error */
-			if (s->cio->sls)
-				step_launch_notify_io_failure(
-					s->cio->sls, s->node_id);
-			debug3("got error or unexpected eof "
-			       "on _server_read body");
-			close(obj->fd);
-			obj->fd = -1;
-			s->in_eof = true;
-			s->out_eof = true;
-			list_enqueue(s->cio->free_outgoing, s->in_msg);
-			s->in_msg = NULL;
-			return SLURM_SUCCESS;
+		/*
+		 * Route the message to the proper output
+		 */
+		if (!(msg = _server_get_buf(s->cio))) {
+			set_buf_offset(s->in_buf, offset);
+			_server_stall(s, true);
+			break;
 		}
-
-		s->in_remaining -= n;
-		if (s->in_remaining > 0)
-			return SLURM_SUCCESS;
-	}
-	else {
-		debug3("***** passing on eof message");
-	}
-
-	/*
-	 * Route the message to the proper output
-	 */
-	{
-		eio_obj_t *obj;
-		struct file_write_info *info;
-
-		s->in_msg->ref_count = 1;
-		if (s->in_msg->header.type == SLURM_IO_STDOUT)
+		memcpy(msg->data,
+		       get_buf_data(s->in_buf) + get_buf_offset(s->in_buf),
+		       header.length);
+		set_buf_offset(s->in_buf,
+			       get_buf_offset(s->in_buf) + header.length);
+		msg->length = header.length;
+		msg->header = header;
+		msg->ref_count = 1;
+		if (header.type == SLURM_IO_STDOUT)
 			obj = s->cio->stdout_obj;
 		else
 			obj = s->cio->stderr_obj;
 		info = (struct file_write_info *) obj->arg;
 		if (info->eof)
 			/* this output is closed, discard message */
-			list_enqueue(s->cio->free_outgoing, s->in_msg);
+			list_enqueue(s->cio->free_outgoing, msg);
 		else
-			list_enqueue(info->msg_queue, s->in_msg);
+			list_enqueue(info->msg_queue, msg);
+	}
 
-		s->in_msg = NULL;
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Unpack what messages can be routed from s->in_buf and move the rest to
+ * its front.
+ * RET SLURM_ERROR if a message is malformed
+ */
+static int
+_server_drain(struct server_io_info *s)
+{
+	char *data = get_buf_data(s->in_buf);
+	uint32_t offset;
+
+	if (_server_unpack_msgs(s) != SLURM_SUCCESS)
+		return SLURM_ERROR;
+	offset = get_buf_offset(s->in_buf);
+	if (offset > 0) {
+		memmove(data, data + offset, s->in_tail - offset);
+		s->in_tail -= offset;
+		set_buf_offset(s->in_buf, 0);
+	}
+	return SLURM_SUCCESS;
+}
+
+/* Nothing more will be read from a slurmstepd, free its read buffer */
+static void
+_server_in_fini(struct server_io_info *s)
+{
+	s->in_eof = true;
+	_server_stall(s, false);
+	s->in_tail = 0;
+	if (s->in_buf) {
+		free_buf(s->in_buf);
+		s->in_buf = NULL;
+	}
+}
+
+/* Record whether messages read from a slurmstepd wait for a buffer */
+static void
+_server_stall(struct server_io_info *s, bool stalled)
+{
+	if (s->in_stalled == stalled)
+		return;
+	s->in_stalled = stalled;
+	if (stalled)
+		s->cio->ioservers_stalled++;
+	else
+		s->cio->ioservers_stalled--;
+}
+
+/*
+ * Return an outgoing buffer to the free list and unpack the messages which
+ * waited for one, taking the slurmstepds in turn. Nothing more may be read
+ * from their sockets to prompt this, and a stalled one is not polled.
+ */
+static void
+_free_outgoing_msg(client_io_t *cio, struct io_buf *msg)
+{
+	struct server_io_info *s;
+	int i, inx;
+
+	list_enqueue(cio->free_outgoing, msg);
+	for (i = 0; (i < cio->num_nodes) && cio->ioservers_stalled &&
+		    !list_is_empty(cio->free_outgoing); i++) {
+		inx = (cio->ioserver_next + i) % cio->num_nodes;
+		if (!cio->ioserver[inx])
+			continue;
+		s = (struct server_io_info *) cio->ioserver[inx]->arg;
+		if (s->in_stalled) {
+			(void) _server_drain(s);
+			cio->ioserver_next = (inx + 1) % cio->num_nodes;
+		}
+	}
+}
+
+/*
+ * Read as much as is available from a slurmstepd, which sends the output of
+ * its tasks in batches of messages, and unpack all of the complete messages
+ * read rather than reading each header and body separately.
+ */
+static int
+_server_read(eio_obj_t *obj, List objs)
+{
+	struct server_io_info *s = (struct server_io_info *) obj->arg;
+	char *data;
+	int n;
+
+	debug4("Entering _server_read");
+	if (s->in_stalled)	/* no room to read more */
+		return SLURM_SUCCESS;
+	data = get_buf_data(s->in_buf);
+again:
+	if ((n = read(obj->fd, data + s->in_tail,
+		      SERVER_READ_BUF_SIZE - s->in_tail)) < 0) {
+		if (errno == EINTR)
+			goto again;
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			return SLURM_SUCCESS;
+		if (errno == ECONNRESET) {
+			/* I've confirmed the slurmstepd's writes
+			 * complete and the file is closed at
+			 * slurmstepd shutdown. The reason for this
+			 * error is unknown. -Moe */
+			debug("Stdout/err from node %d may be "
+			      "incomplete due to a network error",
+			      s->node_id);
+		} else {
+			debug3("_server_read error: %m");
+		}
+	}
+	if (n > 0) {
+		s->in_tail += n;
+		if (_server_drain(s) == SLURM_SUCCESS)
+			return SLURM_SUCCESS;
+		error("Invalid message from node %d", s->node_id);
 	}
 
+	/* got eof, error on socket read or an invalid message */
+	if (s->cio->sls)
+		step_launch_notify_io_failure(s->cio->sls, s->node_id);
+	debug3("got error or unexpected eof on _server_read");
+	close(obj->fd);
+	obj->fd = -1;
+	_server_in_fini(s);
+	s->out_eof = true;
 	return SLURM_SUCCESS;
 }
 
@@ -554,6 +663,65 @@ static bool _file_writable(eio_obj_t *obj)
 	return false;
 }
 
+/*
+ * Write the message in progress and those queued behind it with a single
+ * writev(), used for output which is neither labelled nor filtered by task.
+ */
+static int _file_writev(eio_obj_t *obj, struct file_write_info *info)
+{
+	struct iovec iov[FILE_WRITE_MAX_IOV];
+	struct io_buf *msg;
+	ListIterator msgs;
+	int iovcnt = 1;
+	ssize_t n;
+
+	iov[0].iov_base = info->out_msg->data +
+		(info->out_msg->length - info->out_remaining);
+	iov[0].iov_len = info->out_remaining;
+	if (!list_is_empty(info->msg_queue)) {
+		msgs = list_iterator_create(info->msg_queue);
+		while ((iovcnt < FILE_WRITE_MAX_IOV) &&
+		       (msg = list_next(msgs))) {
+			iov[iovcnt].iov_base = msg->data;
+			iov[iovcnt].iov_len = msg->length;
+			iovcnt++;
+		}
+		list_iterator_destroy(msgs);
+	}
+
+again:
+	if ((n = writev(obj->fd, iov, iovcnt)) < 0) {
+		if (errno == EINTR)
+			goto again;
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			return SLURM_SUCCESS;
+		error("_file_write: %m");
+		_free_outgoing_msg(info->cio, info->out_msg);
+		info->out_msg = NULL;
+		info->eof = true;
+		return SLURM_ERROR;
+	}
+	debug3("  wrote %zd bytes from %d messages", n, iovcnt);
+
+	/*
+	 * Free the messages written in full.
+	 */
+	while (n >= info->out_remaining) {
+		n -= info->out_remaining;
+		info->out_msg->ref_count--;
+		if (info->out_msg->ref_count == 0)
+			_free_outgoing_msg(info->cio, info->out_msg);
+		info->out_msg = NULL;
+		if (n == 0)
+			return SLURM_SUCCESS;
+		info->out_msg = list_dequeue(info->msg_queue);
+		info->out_remaining = info->out_msg->length;
+	}
+	info->out_remaining -= n;
+
+	return SLURM_SUCCESS;
+}
+
 static int _file_write(eio_obj_t *obj, List objs)
 {
 	struct file_write_info *info = (struct file_write_info *) obj->arg;
@@ -577,7 +745,10 @@ static int _file_write(eio_obj_t *obj, List objs)
 	/*
 	 * Write message to file.
 	 */
-	if (info->taskid != (uint32_t)-1
+	if ((info->taskid == (uint32_t)-1) && !info->cio->label &&
+	    !info->eof) {
+		return _file_writev(obj, info);
+	} else if (info->taskid != (uint32_t)-1
 	    && info->out_msg->header.gtaskid != info->taskid) {
 		/* we are ignoring messages not from info->taskid */
 	} else if (!info->eof) {
@@ -588,7 +759,7 @@ static int _file_write(eio_obj_t *obj, List objs)
 					        info->out_msg->header.gtaskid,
 					        info->cio->label,
 					        info->cio->label_width)) < 0) {
-			list_enqueue(info->cio->free_outgoing, info->out_msg);
+			_free_outgoing_msg(info->cio, info->out_msg);
 			info->eof = true;
 			return SLURM_ERROR;
 		}
@@ -603,7 +774,7 @@ static int _file_write(eio_obj_t *obj, List objs)
 	 */
 	info->out_msg->ref_count--;
 	if (info->out_msg->ref_count == 0)
-		list_enqueue(info->cio->free_outgoing, info->out_msg);
+		_free_outgoing_msg(info->cio, info->out_msg);
 	info->out_msg = NULL;
 	debug2("Leaving  _file_write");
 
@@ -85,6 +85,10 @@ struct client_io {
 			         * including free_incoming buffers and
 			         * buffers in use.
 			         */
+	int ioservers_stalled;	/* Count of ioservers with messages read
+				 * which wait for a free_outgoing buffer */
+	int ioserver_next;	/* ioserver to unpack first when one is
+				 * freed, so all of them get a turn */
 
 	struct step_launch_state *sls; /* Used to notify the main thread of an
 				       I/O problem.  */
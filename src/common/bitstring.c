@@ -96,6 +96,222 @@ strong_alias(bit_copybits,	slurm_bit_copybits);
 strong_alias(bit_get_bit_num,	slurm_bit_get_bit_num);
 strong_alias(bit_get_pos_num,	slurm_bit_get_pos_num);
 
+#if !defined(USE_64BIT_BITSTR)
+/*
+ * Returns the hamming weight (i.e. the number of bits set) in a word.
+ * NOTE: This routine borrowed from Linux 2.4.9 <linux/bitops.h>.
+ */
+static uint32_t
+hweight(uint32_t w)
+{
+	uint32_t res;
+
+	res = (w   & 0x55555555) + ((w >> 1)    & 0x55555555);
+	res = (res & 0x33333333) + ((res >> 2)  & 0x33333333);
+	res = (res & 0x0F0F0F0F) + ((res >> 4)  & 0x0F0F0F0F);
+	res = (res & 0x00FF00FF) + ((res >> 8)  & 0x00FF00FF);
+	res = (res & 0x0000FFFF) + ((res >> 16) & 0x0000FFFF);
+
+	return res;
+}
+#else
+/*
+ * A 64 bit version crafted from 32-bit one borrowed above.
+ */
+static uint64_t
+hweight(uint64_t w)
+{
+	uint64_t res;
+
+	res = (w   & 0x5555555555555555) + ((w >> 1)    & 0x5555555555555555);
+	res = (res & 0x3333333333333333) + ((res >> 2)  & 0x3333333333333333);
+	res = (res & 0x0F0F0F0F0F0F0F0F) + ((res >> 4)  & 0x0F0F0F0F0F0F0F0F);
+	res = (res & 0x00FF00FF00FF00FF) + ((res >> 8)  & 0x00FF00FF00FF00FF);
+	res = (res & 0x0000FFFF0000FFFF) + ((res >> 16) & 0x0000FFFF0000FFFF);
+	res = (res & 0x00000000FFFFFFFF) + ((res >> 32) & 0x00000000FFFFFFFF);
+
+	return res;
+}
+#endif /* !USE_64BIT_BITSTR */
+
+/*
+ * Word level helpers. Bitstring words are examined as unsigned values in
+ * "normalized" form: bit i of a normalized word is bit (word_base + i) of
+ * the bitstring regardless of SLURM_BIGENDIAN, so that the first bit of
+ * a word is found with a count of trailing zeros and the last one with a
+ * count of leading zeros.
+ */
+#ifdef USE_64BIT_BITSTR
+typedef uint64_t bitword_t;
+#  define BITWORD_ONES		0xffffffffffffffffULL
+#else
+typedef uint32_t bitword_t;
+#  define BITWORD_ONES		0xffffffffU
+#endif
+#define BITWORD_BITS		(sizeof(bitstr_t) * 8)
+
+#if defined(__GNUC__) && \
+    ((__GNUC__ > 3) || ((__GNUC__ == 3) && (__GNUC_MINOR__ >= 4)))
+#  define HAVE_BIT_BUILTINS 1
+#endif
+
+/* count of trailing (low order) zero bits in a non-zero word */
+static inline int _word_ctz(bitword_t w)
+{
+#ifdef HAVE_BIT_BUILTINS
+#  ifdef USE_64BIT_BITSTR
+	return __builtin_ctzll(w);
+#  else
+	return __builtin_ctz(w);
+#  endif
+#else
+	int n = 0;
+
+	while ((w & 1) == 0) {
+		w >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/* count of leading (high order) zero bits in a non-zero word */
+static inline int _word_clz(bitword_t w)
+{
+#ifdef HAVE_BIT_BUILTINS
+#  ifdef USE_64BIT_BITSTR
+	return __builtin_clzll(w);
+#  else
+	return __builtin_clz(w);
+#  endif
+#else
+	int n = 0;
+
+	while ((w & ((bitword_t) 1 << BITSTR_MAXPOS)) == 0) {
+		w <<= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/* count of bits set in a word */
+static inline int _word_popcount(bitword_t w)
+{
+#ifdef HAVE_BIT_BUILTINS
+#  ifdef USE_64BIT_BITSTR
+	return __builtin_popcountll(w);
+#  else
+	return __builtin_popcount(w);
+#  endif
+#else
+	return (int) hweight(w);
+#endif
+}
+
+#ifdef SLURM_BIGENDIAN
+/* reverse the order of bits in a word */
+static inline bitword_t _word_reverse(bitword_t w)
+{
+#ifdef USE_64BIT_BITSTR
+	w = ((w >> 1)  & 0x5555555555555555ULL) |
+	    ((w & 0x5555555555555555ULL) << 1);
+	w = ((w >> 2)  & 0x3333333333333333ULL) |
+	    ((w & 0x3333333333333333ULL) << 2);
+	w = ((w >> 4)  & 0x0F0F0F0F0F0F0F0FULL) |
+	    ((w & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	w = ((w >> 8)  & 0x00FF00FF00FF00FFULL) |
+	    ((w & 0x00FF00FF00FF00FFULL) << 8);
+	w = ((w >> 16) & 0x0000FFFF0000FFFFULL) |
+	    ((w & 0x0000FFFF0000FFFFULL) << 16);
+	w = (w >> 32) | (w << 32);
+#else
+	w = ((w >> 1) & 0x55555555) | ((w & 0x55555555) << 1);
+	w = ((w >> 2) & 0x33333333) | ((w & 0x33333333) << 2);
+	w = ((w >> 4) & 0x0F0F0F0F) | ((w & 0x0F0F0F0F) << 4);
+	w = ((w >> 8) & 0x00FF00FF) | ((w & 0x00FF00FF) << 8);
+	w = (w >> 16) | (w << 16);
+#endif
+	return w;
+}
+#  define _word_norm(w)		_word_reverse((bitword_t) (w))
+#else
+#  define _word_norm(w)		((bitword_t) (w))
+#endif
+
+/* normalized mask of the valid bits in the word containing bit
+ * (nbits - 1), all ones if nbits is a multiple of the word size */
+static inline bitword_t _last_word_mask(bitoff_t nbits)
+{
+	int valid = nbits & BITSTR_MAXPOS;
+
+	if (valid == 0)
+		return BITWORD_ONES;
+	return ((bitword_t) 1 << valid) - 1;
+}
+
+/* Return the normalized word with index inx (zero origin, excluding the
+ * header words) of bitstring b, with any bits beyond its end cleared.
+ * If "clear" is set, return the complement of the word instead, again
+ * with bits beyond the end cleared. */
+static inline bitword_t _get_word(bitstr_t *b, bitoff_t inx, bool clear)
+{
+	bitoff_t nbits = _bitstr_bits(b);
+	bitword_t w = _word_norm(b[inx + BITSTR_OVERHEAD]);
+
+	if (clear)
+		w = ~w;
+	if (((inx + 1) * BITWORD_BITS) > nbits)
+		w &= _last_word_mask(nbits);
+	return w;
+}
+
+/* Return the position of the first bit at or after position "start" which
+ * is set (or clear if "clear" is set), -1 if none found */
+static bitoff_t _find_first(bitstr_t *b, bitoff_t start, bool clear)
+{
+	bitoff_t nbits = _bitstr_bits(b);
+	bitoff_t inx, words;
+	bitword_t w;
+
+	if (start >= nbits)
+		return -1;
+	words = (nbits + BITSTR_MAXPOS) >> BITSTR_SHIFT;
+	inx = start >> BITSTR_SHIFT;
+	w = _get_word(b, inx, clear);
+	w &= BITWORD_ONES << (start & BITSTR_MAXPOS);
+	while (1) {
+		if (w)
+			return (inx * BITWORD_BITS) + _word_ctz(w);
+		if (++inx >= words)
+			return -1;
+		w = _get_word(b, inx, clear);
+	}
+}
+
+/* Return the position of the first run of n bits clear (or set if "set" is
+ * true) which starts at or after position "start" and ends before position
+ * "stop", -1 if none found */
+static bitoff_t _find_run(bitstr_t *b, int n, bitoff_t start, bitoff_t stop,
+			  bool set)
+{
+	bitoff_t bit = start, run_start;
+
+	while ((bit + n) <= stop) {
+		/* find the start of a run */
+		run_start = _find_first(b, bit, !set);
+		if ((run_start == -1) || ((run_start + n) > stop))
+			return -1;
+		/* find the end of the run */
+		bit = _find_first(b, run_start, set);
+		if ((bit == -1) || (bit > stop))
+			bit = stop;
+		if ((bit - run_start) >= n)
+			return run_start;
+	}
+	return -1;
+}
+
 /*
  * Allocate a bitstring.
  *   nbits (IN)		valid bits in new bitstring, initialized to all clear
@@ -264,26 +480,9 @@ bit_nclear(bitstr_t *b, bitoff_t start, bitoff_t stop)
 bitoff_t
 bit_ffc(bitstr_t *b)
 {
-	bitoff_t bit = 0, value = -1;
-
 	_assert_bitstr_valid(b);
 
-	while (bit < _bitstr_bits(b) && value == -1) {
-		int word = _bit_word(bit);
-
-		if (b[word] == BITSTR_MAXPOS) {
-			bit += sizeof(bitstr_t)*8;
-			continue;
-		}
-		while (bit < _bitstr_bits(b) && _bit_word(bit) == word) {
-			if (!bit_test(b, bit)) {
-				value = bit;
-				break;
-			}
-			bit++;
-		}
-	}
-	return value;
+	return _find_first(b, 0, true);
 }
 
 /* Find the first n contiguous bits clear in b.
@@ -294,26 +493,10 @@ bit_ffc(bitstr_t *b)
 bitoff_t
 bit_nffc(bitstr_t *b, int n)
 {
-	bitoff_t value = -1;
-	bitoff_t bit;
-	int cnt = 0;
-
 	_assert_bitstr_valid(b);
 	assert(n > 0 && n < _bitstr_bits(b));
 
-	for (bit = 0; bit < _bitstr_bits(b); bit++) {
-		if (bit_test(b, bit)) {		/* fail */
-			cnt = 0;
-		} else {
-			cnt++;
-			if (cnt >= n) {
-				value = bit - (cnt - 1);
-				break;
-			}
-		}
-	}
-
-	return value;
+	return _find_run(b, n, 0, _bitstr_bits(b), false);
 }
 
 /* Find n contiguous bits clear in b starting at some offset.
@@ -325,9 +508,7 @@ bit_nffc(bitstr_t *b, int n)
 bitoff_t
 bit_noc(bitstr_t *b, int n, int seed)
 {
-	bitoff_t value = -1;
-	bitoff_t bit;
-	int cnt = 0;
+	bitoff_t value, stop;
 
 	_assert_bitstr_valid(b);
 	assert(n > 0 && n <= _bitstr_bits(b));
@@ -335,34 +516,16 @@ bit_noc(bitstr_t *b, int n, int seed)
 	if ((seed + n) >= _bitstr_bits(b))
 		seed = _bitstr_bits(b);	/* skip offset test, too small */
 
-	for (bit = seed; bit < _bitstr_bits(b); bit++) {	/* start at offset */
-		if (bit_test(b, bit)) {		/* fail */
-			cnt = 0;
-		} else {
-			cnt++;
-			if (cnt >= n) {
-				value = bit - (cnt - 1);
-				return value;
-			}
-		}
-	}
-
-	cnt = 0;	/* start at beginning */
-	for (bit = 0; bit < _bitstr_bits(b); bit++) {
-		if (bit_test(b, bit)) {		/* fail */
-			if (bit >= seed)
-				break;
-			cnt = 0;
-		} else {
-			cnt++;
-			if (cnt >= n) {
-				value = bit - (cnt - 1);
-				return value;
-			}
-		}
-	}
+	value = _find_run(b, n, seed, _bitstr_bits(b), false);
+	if (value != -1)
+		return value;
 
-	return -1;
+	/* start at beginning, the run must end before the first set bit
+	 * at or after the offset */
+	stop = _find_first(b, seed, false);
+	if (stop == -1)
+		stop = _bitstr_bits(b);
+	return _find_run(b, n, 0, stop, false);
 }
 
 /* Find the first n contiguous bits set in b.
@@ -403,26 +566,9 @@ bit_nffs(bitstr_t *b, int n)
 bitoff_t
 bit_ffs(bitstr_t *b)
 {
-	bitoff_t bit = 0, value = -1;
-
 	_assert_bitstr_valid(b);
 
-	while (bit < _bitstr_bits(b) && value == -1) {
-		int word = _bit_word(bit);
-
-		if (b[word] == 0) {
-			bit += sizeof(bitstr_t)*8;
-			continue;
-		}
-		while (bit < _bitstr_bits(b) && _bit_word(bit) == word) {
-			if (bit_test(b, bit)) {
-				value = bit;
-				break;
-			}
-			bit++;
-		}
-	}
-	return value;
+	return _find_first(b, 0, false);
 }
 
 /*
@@ -433,39 +579,21 @@ bit_ffs(bitstr_t *b)
 bitoff_t
 bit_fls(bitstr_t *b)
 {
-	bitoff_t bit, value = -1;
-	int word;
+	bitoff_t inx;
+	bitword_t w;
 
 	_assert_bitstr_valid(b);
 
 	if (_bitstr_bits(b) == 0)	/* empty bitstring */
 		return -1;
 
-	bit = _bitstr_bits(b) - 1;	/* zero origin */
-
-	while (bit >= 0 && 		/* test partitial words */
-		(_bit_word(bit) == _bit_word(bit + 1))) {
-		if (bit_test(b, bit)) {
-			value = bit;
-			break;
-		}
-		bit--;
+	for (inx = (_bitstr_bits(b) - 1) >> BITSTR_SHIFT; inx >= 0; inx--) {
+		w = _get_word(b, inx, false);
+		if (w)
+			return (inx * BITWORD_BITS) + BITSTR_MAXPOS -
+			       _word_clz(w);
 	}
-	while (bit >= 0 && value == -1) {	/* test whole words */
-		word = _bit_word(bit);
-		if (b[word] == 0) {
-			bit -= sizeof(bitstr_t) * 8;
-			continue;
-		}
-		while (bit >= 0) {
-			if (bit_test(b, bit)) {
-				value = bit;
-				break;
-			}
-			bit--;
-		}
-	}
-	return value;
+	return -1;
 }
 
 /*
@@ -493,15 +621,15 @@ bit_fill_gaps(bitstr_t *b) {
  */
 int
 bit_super_set(bitstr_t *b1, bitstr_t *b2)  {
-	bitoff_t bit;
+	bitoff_t inx, words;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8) {
-		if (b1[_bit_word(bit)] != (b1[_bit_word(bit)] &
-		                           b2[_bit_word(bit)]))
+	words = _bitstr_words(_bitstr_bits(b1));
+	for (inx = BITSTR_OVERHEAD; inx < words; inx++) {
+		if (b1[inx] & ~b2[inx])
 			return 0;
 	}
 
@@ -539,14 +667,15 @@ bit_equal(bitstr_t *b1, bitstr_t *b2)
  */
 void
 bit_and(bitstr_t *b1, bitstr_t *b2) {
-	bitoff_t bit;
+	bitoff_t inx, words;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8)
-		b1[_bit_word(bit)] &= b2[_bit_word(bit)];
+	words = _bitstr_words(_bitstr_bits(b1));
+	for (inx = BITSTR_OVERHEAD; inx < words; inx++)
+		b1[inx] &= b2[inx];
 }
 
 /*
@@ -570,14 +699,15 @@ bit_not(bitstr_t *b) {
  */
 void
 bit_or(bitstr_t *b1, bitstr_t *b2) {
-	bitoff_t bit;
+	bitoff_t inx, words;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8)
-		b1[_bit_word(bit)] |= b2[_bit_word(bit)];
+	words = _bitstr_words(_bitstr_bits(b1));
+	for (inx = BITSTR_OVERHEAD; inx < words; inx++)
+		b1[inx] |= b2[inx];
 }
 
 
@@ -616,43 +746,6 @@ bit_copybits(bitstr_t *dest, bitstr_t *src)
 	memcpy(&dest[BITSTR_OVERHEAD], &src[BITSTR_OVERHEAD], len);
 }
 
-#if !defined(USE_64BIT_BITSTR)
-/*
- * Returns the hamming weight (i.e. the number of bits set) in a word.
- * NOTE: This routine borrowed from Linux 2.4.9 <linux/bitops.h>.
- */
-static uint32_t
-hweight(uint32_t w)
-{
-	uint32_t res;
-
-	res = (w   & 0x55555555) + ((w >> 1)    & 0x55555555);
-	res = (res & 0x33333333) + ((res >> 2)  & 0x33333333);
-	res = (res & 0x0F0F0F0F) + ((res >> 4)  & 0x0F0F0F0F);
-	res = (res & 0x00FF00FF) + ((res >> 8)  & 0x00FF00FF);
-	res = (res & 0x0000FFFF) + ((res >> 16) & 0x0000FFFF);
-
-	return res;
-}
-#else
-/*
- * A 64 bit version crafted from 32-bit one borrowed above.
- */
-static uint64_t
-hweight(uint64_t w)
-{
-	uint64_t res;
-
-	res = (w   & 0x5555555555555555) + ((w >> 1)    & 0x5555555555555555);
-	res = (res & 0x3333333333333333) + ((res >> 2)  & 0x3333333333333333);
-	res = (res & 0x0F0F0F0F0F0F0F0F) + ((res >> 4)  & 0x0F0F0F0F0F0F0F0F);
-	res = (res & 0x00FF00FF00FF00FF) + ((res >> 8)  & 0x00FF00FF00FF00FF);
-	res = (res & 0x0000FFFF0000FFFF) + ((res >> 16) & 0x0000FFFF0000FFFF);
-	res = (res & 0x00000000FFFFFFFF) + ((res >> 32) & 0x00000000FFFFFFFF);
-
-	return res;
-}
-#endif /* !USE_64BIT_BITSTR */
 
 /*
  * Count the number of bits set in bitstring.
@@ -663,21 +756,13 @@ int
 bit_set_count(bitstr_t *b)
 {
 	int count = 0;
-	bitoff_t bit, bit_cnt;
-	int word_size = sizeof(bitstr_t) * 8;
+	bitoff_t inx, words;
 
 	_assert_bitstr_valid(b);
 
-	bit_cnt = _bitstr_bits(b);
-	for (bit = 0; bit < bit_cnt; bit += word_size) {
-		if ((bit + word_size - 1) >= bit_cnt)
-			break;
-		count += hweight(b[_bit_word(bit)]);
-	}
-	for ( ; bit < bit_cnt; bit++) {
-		if (bit_test(b, bit))
-			count++;
-	}
+	words = (_bitstr_bits(b) + BITSTR_MAXPOS) >> BITSTR_SHIFT;
+	for (inx = 0; inx < words; inx++)
+		count += _word_popcount(_get_word(b, inx, false));
 
 	return count;
 }
@@ -689,22 +774,16 @@ extern int
 bit_overlap(bitstr_t *b1, bitstr_t *b2)
 {
 	int count = 0;
-	bitoff_t bit, bit_cnt;
-	int word_size = sizeof(bitstr_t) * 8;
+	bitoff_t inx, words;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	bit_cnt = _bitstr_bits(b1);
-	for (bit = 0; bit < bit_cnt; bit += word_size) {
-		if ((bit + word_size - 1) >= bit_cnt)
-			break;
-		count += hweight(b1[_bit_word(bit)] & b2[_bit_word(bit)]);
-	}
-	for ( ; bit < bit_cnt; bit++) {
-		if (bit_test(b1, bit) && bit_test(b2, bit))
-			count++;
+	words = (_bitstr_bits(b1) + BITSTR_MAXPOS) >> BITSTR_SHIFT;
+	for (inx = 0; inx < words; inx++) {
+		count += _word_popcount(_get_word(b1, inx, false) &
+					_get_word(b2, inx, false));
 	}
 
 	return count;
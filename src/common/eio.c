@@ -43,6 +43,10 @@
 #include <unistd.h>
 #include <errno.h>
 
+#if HAVE_SYS_EPOLL_H
+#  include <sys/epoll.h>
+#endif
+
 #include "src/common/fd.h"
 #include "src/common/eio.h"
 #include "src/common/log.h"
@@ -69,12 +73,20 @@ struct eio_handle_components {
 	int  fds[2];
 	List obj_list;
 	List new_objs;
+
+	int  epoll_fd;		/* -1 to use poll() */
+	eio_obj_t **fd_owner;	/* object holding each fd's registration */
+	int  fd_owner_cnt;
 };
 
 
 /* Function prototypes
  */
 
+static int          _poll_mainloop(eio_handle_t *eio);
+#if HAVE_SYS_EPOLL_H
+static int          _epoll_mainloop(eio_handle_t *eio);
+#endif
 static int          _poll_internal(struct pollfd *pfds, unsigned int nfds);
 static unsigned int _poll_setup_pollfds(struct pollfd *, eio_obj_t **, List);
 static void         _poll_dispatch(struct pollfd *, unsigned int, eio_obj_t **,
@@ -103,15 +115,48 @@ eio_handle_t *eio_handle_create(void)
 	eio->obj_list = list_create(eio_obj_destroy);
 	eio->new_objs = list_create(eio_obj_destroy);
 
+	eio->epoll_fd = -1;
+#if HAVE_SYS_EPOLL_H
+	if ((eio->epoll_fd = epoll_create(64)) < 0) {
+		debug("eio_create: epoll_create: %m, using poll");
+	} else {
+		struct epoll_event ev;
+
+		fd_set_close_on_exec(eio->epoll_fd);
+		/* The handle itself marks events on the signalling fd */
+		ev.events = EPOLLIN;
+		ev.data.ptr = eio;
+		if (epoll_ctl(eio->epoll_fd, EPOLL_CTL_ADD, eio->fds[0],
+			      &ev) < 0) {
+			debug("eio_create: epoll_ctl: %m, using poll");
+			eio_handle_use_poll(eio);
+		}
+	}
+#endif
+
 	return eio;
 }
 
+void eio_handle_use_poll(eio_handle_t *eio)
+{
+	xassert(eio != NULL);
+	xassert(eio->magic == EIO_MAGIC);
+
+	if (eio->epoll_fd >= 0) {
+		close(eio->epoll_fd);
+		eio->epoll_fd = -1;
+	}
+}
+
 void eio_handle_destroy(eio_handle_t *eio)
 {
 	xassert(eio != NULL);
 	xassert(eio->magic == EIO_MAGIC);
 	close(eio->fds[0]);
 	close(eio->fds[1]);
+	if (eio->epoll_fd >= 0)
+		close(eio->epoll_fd);
+	xfree(eio->fd_owner);
 	if (eio->obj_list)
 		list_destroy(eio->obj_list);
 
@@ -252,6 +297,18 @@ static int _eio_wakeup_handler(eio_handle_t *eio)
 }
 
 int eio_handle_mainloop(eio_handle_t *eio)
+{
+	xassert (eio != NULL);
+	xassert (eio->magic == EIO_MAGIC);
+
+#if HAVE_SYS_EPOLL_H
+	if (eio->epoll_fd >= 0)
+		return _epoll_mainloop(eio);
+#endif
+	return _poll_mainloop(eio);
+}
+
+static int _poll_mainloop(eio_handle_t *eio)
 {
 	int            retval  = 0;
 	struct pollfd *pollfds = NULL;
@@ -259,9 +316,6 @@ int eio_handle_mainloop(eio_handle_t *eio)
 	unsigned int   maxnfds = 0, nfds = 0;
 	unsigned int   n       = 0;
 
-	xassert (eio != NULL);
-	xassert (eio->magic == EIO_MAGIC);
-
 	for (;;) {
 
 		/* Alloc memory for pfds and map if needed */
@@ -473,6 +527,232 @@ _poll_handle_event(short revents, eio_obj_t *obj, List objList)
 	}
 }
 
+#if HAVE_SYS_EPOLL_H
+/* Forget the epoll registrations of all objects, done when falling back
+ * to poll() */
+static void _epoll_forget(List l)
+{
+	ListIterator objs;
+	eio_obj_t *obj;
+
+	objs = list_iterator_create(l);
+	while ((obj = list_next(objs))) {
+		obj->reg_fd = -1;
+		obj->reg_events = 0;
+		obj->reg_always = false;
+	}
+	list_iterator_destroy(objs);
+}
+
+/*
+ * Bring the epoll registration of "obj" in line with the events wanted,
+ * none meaning the fd is not to be watched at all. Registrations are kept
+ * by fd: an object's fd may be closed, which drops its registration, and
+ * the number reused by another object before the first one is updated.
+ * RET 0, or -1 if epoll can't be used for this set of objects
+ */
+static int _epoll_update(eio_handle_t *eio, eio_obj_t *obj, uint32_t events)
+{
+	struct epoll_event ev;
+	eio_obj_t *other;
+	int fd = obj->fd, op, rc;
+
+	if (!events)
+		fd = -1;
+	if ((obj->reg_fd == fd) && ((fd == -1) || (obj->reg_events == events)))
+		return 0;
+
+	/* Drop the old registration if it is still this object's */
+	if ((obj->reg_fd >= 0) && (obj->reg_fd != fd) && !obj->reg_always &&
+	    (eio->fd_owner[obj->reg_fd] == obj)) {
+		(void) epoll_ctl(eio->epoll_fd, EPOLL_CTL_DEL, obj->reg_fd,
+				 &ev);
+		eio->fd_owner[obj->reg_fd] = NULL;
+	}
+	obj->reg_fd = -1;
+	obj->reg_always = false;
+	if (fd < 0)
+		return 0;
+
+	if (fd >= eio->fd_owner_cnt) {
+		int cnt = MAX(fd + 1, eio->fd_owner_cnt * 2);
+		xrealloc(eio->fd_owner, cnt * sizeof(eio_obj_t *));
+		eio->fd_owner_cnt = cnt;
+	}
+	other = eio->fd_owner[fd];
+	if (other == obj) {
+		op = EPOLL_CTL_MOD;
+	} else {
+		op = EPOLL_CTL_ADD;
+		if (other && (other->fd == fd)) {
+			debug("eio: fd %d shared by two objects, using poll",
+			      fd);
+			return -1;
+		}
+		if (other)	/* other's fd was closed and the number reused */
+			other->reg_fd = -1;
+		eio->fd_owner[fd] = NULL;
+	}
+
+	ev.events = events;
+	ev.data.ptr = obj;
+	rc = epoll_ctl(eio->epoll_fd, op, fd, &ev);
+	if ((rc < 0) && (errno == EEXIST))
+		rc = epoll_ctl(eio->epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+	else if ((rc < 0) && (errno == ENOENT))	/* closed and reopened */
+		rc = epoll_ctl(eio->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+	if ((rc < 0) && (errno == EPERM)) {
+		/* Regular files can't be epolled, poll() reports them as
+		 * always ready, so do the same */
+		obj->reg_always = true;
+	} else if ((rc < 0) && (errno == EBADF)) {
+		/* Closed without resetting obj->fd, poll() would report
+		 * POLLNVAL for it */
+		debug("eio: fd %d is not open, using poll", fd);
+		return -1;
+	} else if (rc < 0) {
+		error("eio: epoll_ctl(%d): %m, using poll", fd);
+		return -1;
+	} else {
+		eio->fd_owner[fd] = obj;
+	}
+	obj->reg_fd = fd;
+	obj->reg_events = events;
+	return 0;
+}
+
+static short _epoll_revents(uint32_t events)
+{
+	short revents = 0;
+
+	if (events & EPOLLIN)
+		revents |= POLLIN;
+	if (events & EPOLLOUT)
+		revents |= POLLOUT;
+	if (events & EPOLLERR)
+		revents |= POLLERR;
+	if (events & EPOLLHUP)
+		revents |= POLLHUP;
+#ifdef POLLRDHUP
+	if (events & EPOLLRDHUP)
+		revents |= POLLRDHUP;
+#endif
+	return revents;
+}
+
+/*
+ * Main loop using epoll. The readable() and writable() functions of every
+ * object are still called on each pass, as the io_operations interface
+ * requires, but epoll_ctl() is only called for the objects whose answer
+ * changed and only the objects which are ready are dispatched. Readiness
+ * is level-triggered: handlers may leave data unread, expecting to be
+ * called again, as they do with poll().
+ */
+static int _epoll_mainloop(eio_handle_t *eio)
+{
+	struct epoll_event *events = NULL;
+	int max_events = 0, nobjs, always, timeout, n, i;
+	bool readable, writable;
+	ListIterator objs;
+	eio_obj_t *obj;
+	uint32_t want;
+
+	for (;;) {
+		nobjs = always = 0;
+		objs = list_iterator_create(eio->obj_list);
+		while ((obj = list_next(objs))) {
+			writable = _is_writable(obj);
+			readable = _is_readable(obj);
+			want = 0;
+			if (readable) {
+#ifdef EPOLLRDHUP
+				want |= EPOLLIN | EPOLLRDHUP;
+#else
+				want |= EPOLLIN;
+#endif
+			}
+			if (writable)
+				want |= EPOLLOUT;
+			if (want)
+				nobjs++;
+			if (_epoll_update(eio, obj, want) < 0)
+				break;
+			if (want && obj->reg_always)
+				always++;
+		}
+		list_iterator_destroy(objs);
+		if (obj) {	/* _epoll_update() failed */
+			xfree(events);
+			_epoll_forget(eio->obj_list);
+			eio_handle_use_poll(eio);
+			return _poll_mainloop(eio);
+		}
+		debug4("eio: handling events for %d objects", nobjs);
+		if (nobjs == 0)
+			break;
+
+		if (max_events < nobjs + 1) {
+			max_events = nobjs + 1;
+			xrealloc(events, max_events * sizeof(struct epoll_event));
+		}
+		if (always)
+			timeout = 0;
+		else if (eio_shutdown_time)
+			timeout = 1000;	/* Return every 1000 msec during shutdown */
+		else
+			timeout = -1;
+		while ((n = epoll_wait(eio->epoll_fd, events, max_events,
+				       timeout)) < 0) {
+			if (errno == EINTR) {
+				n = 0;
+				break;
+			}
+			if (errno != EAGAIN) {
+				error("epoll_wait: %m");
+				xfree(events);
+				return -1;
+			}
+		}
+
+		for (i = 0; i < n; i++) {
+			if (events[i].data.ptr == eio) {
+				_eio_wakeup_handler(eio);
+				break;
+			}
+		}
+		for (i = 0; i < n; i++) {
+			if (events[i].data.ptr == eio)
+				continue;
+			_poll_handle_event(_epoll_revents(events[i].events),
+					   (eio_obj_t *) events[i].data.ptr,
+					   eio->obj_list);
+		}
+		if (always) {
+			objs = list_iterator_create(eio->obj_list);
+			while ((obj = list_next(objs))) {
+				if (!obj->reg_always || (obj->reg_fd < 0))
+					continue;
+				_poll_handle_event(
+					_epoll_revents(obj->reg_events),
+					obj, eio->obj_list);
+			}
+			list_iterator_destroy(objs);
+		}
+
+		if (eio_shutdown_time &&
+		    (difftime(time(NULL), eio_shutdown_time) >=
+		     EIO_SHUTDOWN_WAIT)) {
+			error("Abandoning IO %d secs after job shutdown "
+			      "initiated", EIO_SHUTDOWN_WAIT);
+			break;
+		}
+	}
+
+	xfree(events);
+	return 0;
+}
+#endif	/* HAVE_SYS_EPOLL_H */
+
 static struct io_operations *
 _ops_copy(struct io_operations *ops)
 {
@@ -491,6 +771,7 @@ eio_obj_create(int fd, struct io_operations *ops, void *arg)
 	obj->arg = arg;
 	obj->ops = _ops_copy(ops);
 	obj->shutdown = false;
+	obj->reg_fd = -1;
 	return obj;
 }
 
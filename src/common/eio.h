@@ -67,11 +67,27 @@ struct eio_obj {
 	void *arg;                        /* application-specific data       */
 	struct io_operations *ops;        /* pointer to ops struct for obj   */
 	bool shutdown;
+
+	/* epoll registration, private to eio.c */
+	int reg_fd;                       /* fd registered, or -1            */
+	uint32_t reg_events;              /* epoll events registered         */
+	bool reg_always;                  /* fd can't be epolled, e.g. a file */
 };
 
+/*
+ * Create an eio handle.  Where epoll is available the main loop keeps each
+ * object's fd registered with epoll, changing the registration only when
+ * the result of its readable() and writable() functions changes, and
+ * dispatches only the objects which are ready.  Otherwise, or after
+ * eio_handle_use_poll(), a poll() array is built from every object on
+ * each pass.
+ */
 eio_handle_t *eio_handle_create(void);
 void eio_handle_destroy(eio_handle_t *eio);
 
+/* Use poll() rather than epoll for this handle. Call before the main loop */
+void eio_handle_use_poll(eio_handle_t *eio);
+
 /*
  * Add an eio_obj_t "obj" to an eio_handle_t "eio"'s internal object list.
  *
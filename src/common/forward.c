@@ -45,6 +45,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <sys/time.h>
 #include <sys/types.h>
 
 #include "slurm/slurm.h"
@@ -55,6 +56,7 @@
 #include "src/common/slurm_auth.h"
 #include "src/common/read_config.h"
 #include "src/common/slurm_protocol_interface.h"
+#include "src/common/xhash.h"
 
 #ifdef WITH_PTHREADS
 #  include <pthread.h>
@@ -72,6 +74,40 @@ typedef struct {
 	pthread_mutex_t *tree_mutex;
 } fwd_tree_t;
 
+/*
+ * With forward_tree_init(), as in slurmctld, the subtrees of
+ * start_msg_tree() are sent by a fixed pool of threads shared by all of its
+ * callers, rather than by a thread created for each subtree, and the
+ * outcome of the RPCs to each node is recorded. A node whose last RPC
+ * failed is not made the head of a subtree, where it would cost the whole
+ * subtree a connect timeout before the next node is tried, and among the
+ * others the node with the shortest mean response time is preferred.
+ */
+typedef struct {
+	char *name;
+	uint32_t rpc_cnt;	/* RPCs to the node, direct or forwarded */
+	uint32_t fail_cnt;	/* of which failed */
+	uint32_t direct_cnt;	/* RPCs sent to the node alone */
+	uint64_t direct_usec;	/* total response time of those */
+	time_t last_fail;
+	time_t last_ok;
+} fwd_node_stats_t;
+
+#define FWD_SUSPECT_TIME 300	/* seconds a failed node is not a head */
+
+static pthread_mutex_t fwd_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  fwd_pool_cond  = PTHREAD_COND_INITIALIZER;
+static List fwd_pool_queue = NULL;	/* fwd_tree_t waiting for a thread */
+static pthread_t *fwd_pool_tids = NULL;
+static int fwd_pool_threads = 0;
+static int fwd_pool_idle = 0;		/* threads waiting for a send */
+static bool fwd_pool_shutdown = false;
+
+static pthread_mutex_t fwd_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static xhash_t *fwd_stats = NULL;	/* fwd_node_stats_t by node name */
+
+void *_fwd_tree_thread(void *arg);
+
 void _destroy_tree_fwd(fwd_tree_t *fwd_tree)
 {
 	if (fwd_tree) {
@@ -91,6 +127,131 @@ void _destroy_tree_fwd(fwd_tree_t *fwd_tree)
 	}
 }
 
+static const char *_fwd_stats_id(void *item)
+{
+	return ((fwd_node_stats_t *) item)->name;
+}
+
+static void _fwd_stats_free(void *item, void *arg)
+{
+	fwd_node_stats_t *stats = (fwd_node_stats_t *) item;
+
+	xfree(stats->name);
+	xfree(stats);
+}
+
+/* Record the responses of a subtree sent to head, usec is the response
+ * time of head if it was sent the message alone, otherwise -1 */
+static void _fwd_stats_record(List ret_list, char *head, long usec)
+{
+	fwd_node_stats_t *stats;
+	ret_data_info_t *ret_data_info;
+	ListIterator itr;
+	time_t now = time(NULL);
+	bool failed;
+
+	slurm_mutex_lock(&fwd_stats_mutex);
+	itr = list_iterator_create(ret_list);
+	while ((ret_data_info = list_next(itr))) {
+		if (!ret_data_info->node_name)
+			continue;
+		if (!(stats = xhash_get(fwd_stats, ret_data_info->node_name))) {
+			stats = xmalloc(sizeof(fwd_node_stats_t));
+			stats->name = xstrdup(ret_data_info->node_name);
+			xhash_add(fwd_stats, stats);
+		}
+		failed = (ret_data_info->type == RESPONSE_FORWARD_FAILED);
+		stats->rpc_cnt++;
+		if (failed) {
+			stats->fail_cnt++;
+			stats->last_fail = now;
+		} else {
+			stats->last_ok = now;
+			if ((usec >= 0) && !strcmp(stats->name, head)) {
+				stats->direct_cnt++;
+				stats->direct_usec += usec;
+			}
+		}
+	}
+	list_iterator_destroy(itr);
+	slurm_mutex_unlock(&fwd_stats_mutex);
+}
+
+/* Move the node best able to forward to the others to the front of hl */
+static void _fwd_pick_head(hostlist_t *hl)
+{
+	fwd_node_stats_t *stats;
+	hostlist_iterator_t itr;
+	hostlist_t new_hl;
+	uint64_t mean, best_mean = 0;
+	time_t now = time(NULL);
+	char *name;
+	int inx = 0, best_inx = -1;
+
+	slurm_mutex_lock(&fwd_stats_mutex);
+	itr = hostlist_iterator_create(*hl);
+	while ((name = hostlist_next(itr))) {
+		stats = xhash_get(fwd_stats, name);
+		free(name);
+		if (stats && (stats->last_fail > stats->last_ok) &&
+		    (now - stats->last_fail < FWD_SUSPECT_TIME)) {
+			debug2("%s failed %u of %u RPCs, not a forwarding head",
+			       stats->name, stats->fail_cnt, stats->rpc_cnt);
+			inx++;
+			continue;
+		}
+		/* nodes without a measured response time are taken as
+		 * fast, so the first of them is used, as without stats */
+		if (stats && stats->direct_cnt)
+			mean = stats->direct_usec / stats->direct_cnt;
+		else
+			mean = 0;
+		if ((best_inx < 0) || (mean < best_mean)) {
+			best_inx = inx;
+			best_mean = mean;
+			if (mean == 0)
+				break;
+		}
+		inx++;
+	}
+	hostlist_iterator_destroy(itr);
+	slurm_mutex_unlock(&fwd_stats_mutex);
+
+	if (best_inx <= 0)
+		return;
+	name = hostlist_nth(*hl, best_inx);
+	hostlist_delete_nth(*hl, best_inx);
+	new_hl = hostlist_create(name);
+	free(name);
+	while ((name = hostlist_shift(*hl))) {
+		hostlist_push_host(new_hl, name);
+		free(name);
+	}
+	hostlist_destroy(*hl);
+	*hl = new_hl;
+}
+
+static void *_fwd_pool_thread(void *arg)
+{
+	fwd_tree_t *fwd_tree;
+
+	while (1) {
+		/* queued sends are still made once shutdown is requested,
+		 * so the waiting start_msg_tree() calls complete */
+		slurm_mutex_lock(&fwd_pool_mutex);
+		fwd_pool_idle++;
+		while (!(fwd_tree = list_dequeue(fwd_pool_queue)) &&
+		       !fwd_pool_shutdown)
+			pthread_cond_wait(&fwd_pool_cond, &fwd_pool_mutex);
+		fwd_pool_idle--;
+		slurm_mutex_unlock(&fwd_pool_mutex);
+		if (!fwd_tree)
+			break;
+		_fwd_tree_thread(fwd_tree);
+	}
+	return NULL;
+}
+
 void *_forward_thread(void *arg)
 {
 	forward_msg_t *fwd_msg = (forward_msg_t *)arg;
@@ -319,6 +480,8 @@ void *_fwd_tree_thread(void *arg)
 	char *name = NULL;
 	char *buf = NULL;
 	slurm_msg_t send_msg;
+	struct timeval tv1, tv2;
+	long usec;
 
 	slurm_msg_t_init(&send_msg);
 	send_msg.msg_type = fwd_tree->orig_msg->msg_type;
@@ -354,13 +517,25 @@ void *_fwd_tree_thread(void *arg)
 		} else
 			debug3("Tree sending to %s", name);
 
+		gettimeofday(&tv1, NULL);
 		ret_list = slurm_send_addr_recv_msgs(&send_msg, name,
 						     fwd_tree->timeout);
+		gettimeofday(&tv2, NULL);
 
 		xfree(send_msg.forward.nodelist);
 
 		if (ret_list) {
 			int ret_cnt = list_count(ret_list);
+
+			if (fwd_stats) {
+				if (send_msg.forward.cnt == 0) {
+					usec = (tv2.tv_sec - tv1.tv_sec) *
+					       1000000 +
+					       (tv2.tv_usec - tv1.tv_usec);
+				} else
+					usec = -1;
+				_fwd_stats_record(ret_list, name, usec);
+			}
 			/* This is most common if a slurmd is running
 			   an older version of Slurm than the
 			   originator of the message.
@@ -431,6 +606,80 @@ void *_fwd_tree_thread(void *arg)
 	return NULL;
 }
 
+/*
+ * forward_tree_init - send the subtrees of start_msg_tree() with a pool of
+ *	threads and choose the head of each from the outcome of past RPCs
+ * IN threads - count of threads in the pool, the pool grows if called
+ *	again with a larger count
+ */
+extern void forward_tree_init(int threads)
+{
+	pthread_attr_t attr;
+	int i;
+
+	slurm_mutex_lock(&fwd_stats_mutex);
+	if (!fwd_stats)
+		fwd_stats = xhash_init(_fwd_stats_id, NULL, 0);
+	slurm_mutex_unlock(&fwd_stats_mutex);
+
+	slurm_mutex_lock(&fwd_pool_mutex);
+	if (threads <= fwd_pool_threads) {
+		slurm_mutex_unlock(&fwd_pool_mutex);
+		return;
+	}
+	if (!fwd_pool_queue)
+		fwd_pool_queue = list_create(NULL);
+	xrealloc(fwd_pool_tids, sizeof(pthread_t) * threads);
+	fwd_pool_shutdown = false;
+	for (i = fwd_pool_threads; i < threads; i++) {
+		slurm_attr_init(&attr);
+		if (pthread_create(&fwd_pool_tids[i], &attr, _fwd_pool_thread,
+				   NULL)) {
+			error("forward_tree_init: pthread_create error %m");
+			slurm_attr_destroy(&attr);
+			break;
+		}
+		slurm_attr_destroy(&attr);
+	}
+	fwd_pool_threads = i;
+	debug2("forward_tree_init: %d forwarding threads", fwd_pool_threads);
+	slurm_mutex_unlock(&fwd_pool_mutex);
+}
+
+/*
+ * forward_tree_fini - stop the threads of forward_tree_init() once no
+ *	sends are queued and free the RPC records
+ */
+extern void forward_tree_fini(void)
+{
+	int i, threads;
+
+	slurm_mutex_lock(&fwd_pool_mutex);
+	threads = fwd_pool_threads;
+	fwd_pool_shutdown = true;
+	pthread_cond_broadcast(&fwd_pool_cond);
+	slurm_mutex_unlock(&fwd_pool_mutex);
+	for (i = 0; i < threads; i++)
+		pthread_join(fwd_pool_tids[i], NULL);
+
+	slurm_mutex_lock(&fwd_pool_mutex);
+	fwd_pool_threads = 0;
+	xfree(fwd_pool_tids);
+	if (fwd_pool_queue) {
+		list_destroy(fwd_pool_queue);
+		fwd_pool_queue = NULL;
+	}
+	slurm_mutex_unlock(&fwd_pool_mutex);
+
+	slurm_mutex_lock(&fwd_stats_mutex);
+	if (fwd_stats) {
+		xhash_walk(fwd_stats, _fwd_stats_free, NULL);
+		xhash_free(fwd_stats);
+		fwd_stats = NULL;
+	}
+	slurm_mutex_unlock(&fwd_stats_mutex);
+}
+
 /*
  * forward_init    - initilize forward structure
  * IN: forward     - forward_t *   - struct to store forward info
@@ -620,6 +869,8 @@ extern List start_msg_tree(hostlist_t hl, slurm_msg_t *msg, int timeout)
 			hostlist_push(fwd_tree->tree_hl, name);
 			free(name);
 		}
+		if (fwd_stats)
+			_fwd_pick_head(&fwd_tree->tree_hl);
 
 		/*
 		 * Lock and increase thread counter, we need that to protect
@@ -632,6 +883,21 @@ extern List start_msg_tree(hostlist_t hl, slurm_msg_t *msg, int timeout)
 		thr_count++;
 		slurm_mutex_unlock(&tree_mutex);
 
+		/* Only queue a send an idle pool thread will take at once,
+		 * otherwise the pool is held by subtrees whose head is not
+		 * responding and a thread of its own is started, as
+		 * without the pool, so they can not delay other sends */
+		slurm_mutex_lock(&fwd_pool_mutex);
+		if (fwd_pool_threads && !fwd_pool_shutdown &&
+		    (list_count(fwd_pool_queue) < fwd_pool_idle)) {
+			list_enqueue(fwd_pool_queue, fwd_tree);
+			pthread_cond_signal(&fwd_pool_cond);
+			slurm_mutex_unlock(&fwd_pool_mutex);
+			slurm_attr_destroy(&attr_agent);
+			continue;
+		}
+		slurm_mutex_unlock(&fwd_pool_mutex);
+
 		while (pthread_create(&thread_agent, &attr_agent,
 				      _fwd_tree_thread, (void *)fwd_tree)) {
 			error("pthread_create error %m");
@@ -44,6 +44,21 @@
 #include <stdint.h>
 #include "src/common/slurm_protocol_api.h"
 
+/*
+ * forward_tree_init - have start_msg_tree() send its subtrees with a fixed
+ *	pool of threads shared by all callers, rather than a thread for each
+ *	subtree, and record the outcome of the RPCs to each node, so that a
+ *	node which failed its last RPC, or responds slowly, is not made the
+ *	head of a subtree. Used by slurmctld, whose agents fan out at once.
+ * IN threads - count of threads in the pool, the pool grows if called
+ *	again with a larger count
+ */
+extern void forward_tree_init(int threads);
+
+/* forward_tree_fini - stop the threads of forward_tree_init() once the
+ *	queued sends are done and free the RPC records */
+extern void forward_tree_fini(void);
+
 /*
  * forward_init    - initilize forward structure
  * IN: forward     - forward_t *   - struct to store forward info
@@ -0,0 +1,283 @@
+/*****************************************************************************\
+ *  id_hash.c - hash table of pointers keyed on a uint32_t id (e.g. job ID)
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/id_hash.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+
+/* Smallest table is 1 << ID_HASH_MIN_BITS entries */
+#define ID_HASH_MIN_BITS	4
+/* Number of old table slots moved to the new table by each add or remove
+ * while a resize is in progress */
+#define ID_HASH_MIGRATE_CNT	8
+
+typedef struct id_hash_ent {
+	uint32_t id;
+	void *ptr;		/* NULL if slot is empty */
+} id_hash_ent_t;
+
+struct id_hash {
+	id_hash_ent_t *table;
+	uint32_t bits;		/* table has 1 << bits slots */
+	uint32_t count;		/* entries in table */
+	uint32_t min_bits;	/* never shrink below this size */
+
+	/* Table being emptied into "table" during a resize, the slots from
+	 * old_inx onward (wrapping) remain to be moved */
+	id_hash_ent_t *old_table;
+	uint32_t old_bits;
+	uint32_t old_count;
+	uint32_t old_inx;
+};
+
+/* Fibonacci hashing, consecutive ids are spread across the table */
+static inline uint32_t _hash(uint32_t id, uint32_t bits)
+{
+	return (id * 2654435769U) >> (32 - bits);
+}
+
+/* Return the index of the slot holding id or of the empty slot where it
+ * would be added */
+static inline uint32_t _find_slot(id_hash_ent_t *table, uint32_t bits,
+				  uint32_t id)
+{
+	uint32_t mask = (1U << bits) - 1;
+	uint32_t inx = _hash(id, bits);
+
+	while (table[inx].ptr && (table[inx].id != id))
+		inx = (inx + 1) & mask;
+	return inx;
+}
+
+/* Add an entry whose id is not in the table to the current table */
+static inline void _insert(id_hash_t *hash, uint32_t id, void *ptr)
+{
+	uint32_t inx = _find_slot(hash->table, hash->bits, id);
+
+	xassert(hash->table[inx].ptr == NULL);
+	hash->table[inx].id  = id;
+	hash->table[inx].ptr = ptr;
+	hash->count++;
+}
+
+/* Empty slot inx of the current table, shifting later entries of the
+ * cluster back so that no probe sequence is broken */
+static void _delete_slot(id_hash_t *hash, uint32_t inx)
+{
+	uint32_t mask = (1U << hash->bits) - 1;
+	uint32_t next = inx, home;
+
+	while (1) {
+		next = (next + 1) & mask;
+		if (!hash->table[next].ptr)
+			break;
+		home = _hash(hash->table[next].id, hash->bits);
+		/* Move the entry unless its home slot lies in (inx, next] */
+		if ((inx <= next) ? ((home <= inx) || (home > next)) :
+				    ((home <= inx) && (home > next))) {
+			hash->table[inx] = hash->table[next];
+			inx = next;
+		}
+	}
+	hash->table[inx].ptr = NULL;
+	hash->count--;
+}
+
+/* Empty slot inx of the old table. Rather than shifting the rest of its
+ * cluster back (possibly into the part of the old table already moved),
+ * move the rest of the cluster to the current table. */
+static void _delete_old_slot(id_hash_t *hash, uint32_t inx)
+{
+	uint32_t mask = (1U << hash->old_bits) - 1;
+	id_hash_ent_t *ent;
+
+	hash->old_table[inx].ptr = NULL;
+	hash->old_count--;
+	for (inx = (inx + 1) & mask; hash->old_table[inx].ptr;
+	     inx = (inx + 1) & mask) {
+		ent = &hash->old_table[inx];
+		_insert(hash, ent->id, ent->ptr);
+		ent->ptr = NULL;
+		hash->old_count--;
+	}
+}
+
+/* Move up to cnt slots of the old table (plus the remainder of any cluster
+ * reached) to the current table. Since moving starts at an empty slot and
+ * whole clusters are moved at once, the entries left in the old table can
+ * still be found by probing it. */
+static void _migrate(id_hash_t *hash, uint32_t cnt)
+{
+	uint32_t mask;
+	id_hash_ent_t *ent;
+
+	if (!hash->old_table)
+		return;
+
+	mask = (1U << hash->old_bits) - 1;
+	while (hash->old_count && cnt--) {
+		while ((ent = &hash->old_table[hash->old_inx])->ptr) {
+			_insert(hash, ent->id, ent->ptr);
+			ent->ptr = NULL;
+			hash->old_count--;
+			hash->old_inx = (hash->old_inx + 1) & mask;
+		}
+		hash->old_inx = (hash->old_inx + 1) & mask;
+	}
+	if (hash->old_count == 0)
+		xfree(hash->old_table);
+}
+
+/* Start moving the entries to a new table of 1 << bits slots */
+static void _resize(id_hash_t *hash, uint32_t bits)
+{
+	uint32_t inx = 0;
+
+	_migrate(hash, (uint32_t) -1);	/* finish any earlier resize */
+	xassert(hash->old_table == NULL);
+
+	if (hash->count) {
+		hash->old_table = hash->table;
+		hash->old_bits  = hash->bits;
+		hash->old_count = hash->count;
+		while (hash->old_table[inx].ptr)
+			inx++;
+		hash->old_inx = inx;
+	} else
+		xfree(hash->table);
+	hash->table = xmalloc(sizeof(id_hash_ent_t) << bits);
+	hash->bits  = bits;
+	hash->count = 0;
+}
+
+extern id_hash_t *id_hash_create(uint32_t size_hint)
+{
+	id_hash_t *hash = xmalloc(sizeof(id_hash_t));
+	uint32_t bits = ID_HASH_MIN_BITS;
+
+	/* Keep the load factor under 1/2 */
+	while ((bits < 31) && ((1U << bits) < (size_hint * 2)))
+		bits++;
+	hash->table = xmalloc(sizeof(id_hash_ent_t) << bits);
+	hash->bits = bits;
+	hash->min_bits = bits;
+	return hash;
+}
+
+extern void id_hash_destroy(id_hash_t *hash)
+{
+	if (!hash)
+		return;
+	xfree(hash->table);
+	xfree(hash->old_table);
+	xfree(hash);
+}
+
+extern int id_hash_add(id_hash_t *hash, uint32_t id, void *ptr)
+{
+	uint32_t inx;
+
+	xassert(ptr);
+	inx = _find_slot(hash->table, hash->bits, id);
+	if (hash->table[inx].ptr)
+		return SLURM_ERROR;
+	if (hash->old_table &&
+	    hash->old_table[_find_slot(hash->old_table, hash->old_bits,
+				       id)].ptr)
+		return SLURM_ERROR;
+	hash->table[inx].id  = id;
+	hash->table[inx].ptr = ptr;
+	hash->count++;
+
+	if (hash->old_table)
+		_migrate(hash, ID_HASH_MIGRATE_CNT);
+	else if ((hash->count * 2) > (1U << hash->bits))
+		_resize(hash, hash->bits + 1);
+	return SLURM_SUCCESS;
+}
+
+extern void *id_hash_find(id_hash_t *hash, uint32_t id)
+{
+	uint32_t inx;
+
+	/* NOTE: Do not modify the table here so that callers may look up
+	 * entries concurrently */
+	inx = _find_slot(hash->table, hash->bits, id);
+	if (hash->table[inx].ptr)
+		return hash->table[inx].ptr;
+	if (hash->old_table) {
+		inx = _find_slot(hash->old_table, hash->old_bits, id);
+		return hash->old_table[inx].ptr;
+	}
+	return NULL;
+}
+
+extern void *id_hash_remove(id_hash_t *hash, uint32_t id)
+{
+	uint32_t inx;
+	void *ptr = NULL;
+
+	inx = _find_slot(hash->table, hash->bits, id);
+	if (hash->table[inx].ptr) {
+		ptr = hash->table[inx].ptr;
+		_delete_slot(hash, inx);
+	} else if (hash->old_table) {
+		inx = _find_slot(hash->old_table, hash->old_bits, id);
+		if (hash->old_table[inx].ptr) {
+			ptr = hash->old_table[inx].ptr;
+			_delete_old_slot(hash, inx);
+		}
+	}
+	if (!ptr)
+		return NULL;
+
+	if (hash->old_table)
+		_migrate(hash, ID_HASH_MIGRATE_CNT);
+	else if ((hash->bits > hash->min_bits) &&
+		 ((hash->count * 8) < (1U << hash->bits)))
+		_resize(hash, hash->bits - 1);
+	return ptr;
+}
+
+extern uint32_t id_hash_count(id_hash_t *hash)
+{
+	return hash->count + hash->old_count;
+}
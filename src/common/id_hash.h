@@ -0,0 +1,96 @@
+/*****************************************************************************\
+ *  id_hash.h - hash table of pointers keyed on a uint32_t id (e.g. job ID)
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _ID_HASH_H
+#define _ID_HASH_H
+
+#include <inttypes.h>
+
+/*
+ * An open addressing (linear probing) hash table mapping a uint32_t id to
+ * a pointer. Ids and pointers are stored together in one array so a lookup
+ * normally touches a single cache line. The table grows and shrinks with
+ * the number of entries. Resizing is incremental: the entries of the old
+ * array are moved a few at a time by subsequent operations rather than all
+ * at once, so no single operation takes time proportional to the table size.
+ *
+ * The table does no locking of its own, callers must serialize access.
+ */
+typedef struct id_hash id_hash_t;
+
+/*
+ * id_hash_create - create an empty hash table
+ * IN size_hint - expected number of entries, used to size the table
+ * RET the new table, free with id_hash_destroy()
+ */
+extern id_hash_t *id_hash_create(uint32_t size_hint);
+
+/*
+ * id_hash_destroy - free a hash table, the pointers it holds are not freed
+ */
+extern void id_hash_destroy(id_hash_t *hash);
+
+/*
+ * id_hash_add - add an entry to the table
+ * IN hash - the table
+ * IN id - the entry's id
+ * IN ptr - the entry's pointer, must not be NULL
+ * RET SLURM_SUCCESS or SLURM_ERROR if the table already has an entry with
+ *	this id, which is left unchanged (remove it first to replace it)
+ */
+extern int id_hash_add(id_hash_t *hash, uint32_t id, void *ptr);
+
+/*
+ * id_hash_find - find an entry
+ * IN hash - the table
+ * IN id - the entry's id
+ * RET the entry's pointer or NULL if not found
+ */
+extern void *id_hash_find(id_hash_t *hash, uint32_t id);
+
+/*
+ * id_hash_remove - remove an entry
+ * IN hash - the table
+ * IN id - the entry's id
+ * RET the removed entry's pointer or NULL if not found
+ */
+extern void *id_hash_remove(id_hash_t *hash, uint32_t id);
+
+/*
+ * id_hash_count - return the number of entries in the table
+ */
+extern uint32_t id_hash_count(id_hash_t *hash);
+
+#endif /* !_ID_HASH_H */
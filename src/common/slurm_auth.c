@@ -41,6 +41,7 @@
 #include <string.h>
 
 #include <pthread.h>
+#include <sys/time.h>
 
 #include "src/common/macros.h"
 #include "src/common/xmalloc.h"
@@ -98,6 +99,11 @@ static slurm_auth_ops_t ops;
 static plugin_context_t *g_context = NULL;
 static pthread_mutex_t      context_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/* Per thread count of microseconds spent in credential create and verify,
+ * reported by g_slurm_auth_thread_usec() */
+static pthread_once_t auth_thread_once = PTHREAD_ONCE_INIT;
+static pthread_key_t  auth_thread_key;
+
 /*
  * Order of advisory arguments passed to some of the plugins.
  */
@@ -233,11 +239,56 @@ slurm_auth_fini( void )
  * the API function dispatcher.
  */
 
+static void _auth_thread_usec_free(void *arg)
+{
+	xfree(arg);
+}
+
+static void _auth_thread_key_create(void)
+{
+	if (pthread_key_create(&auth_thread_key, _auth_thread_usec_free))
+		error("pthread_key_create: %m");
+}
+
+/* Return the calling thread's count of auth time, creating it as needed */
+static uint64_t *_auth_thread_usec(void)
+{
+	uint64_t *usec;
+
+	(void) pthread_once(&auth_thread_once, _auth_thread_key_create);
+	usec = pthread_getspecific(auth_thread_key);
+	if (usec == NULL) {
+		usec = xmalloc(sizeof(uint64_t));
+		(void) pthread_setspecific(auth_thread_key, usec);
+	}
+	return usec;
+}
+
+static void _auth_time_add(struct timeval *start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	*_auth_thread_usec() += (now.tv_sec - start->tv_sec) * 1000000 +
+				(now.tv_usec - start->tv_usec);
+}
+
+extern uint64_t g_slurm_auth_thread_usec( bool reset )
+{
+	uint64_t *usec = _auth_thread_usec();
+	uint64_t rc = *usec;
+
+	if (reset)
+		*usec = 0;
+	return rc;
+}
+
 void *
 g_slurm_auth_create( void *hosts, int timeout, char *auth_info )
 {
         void **argv;
         void *ret;
+	struct timeval start;
 
 	if ( slurm_auth_init(NULL) < 0 )
 		return NULL;
@@ -249,7 +300,9 @@ g_slurm_auth_create( void *hosts, int timeout, char *auth_info )
                 return NULL;
         }
 
+	gettimeofday(&start, NULL);
         ret = (*(ops.create))( argv, auth_info );
+	_auth_time_add(&start);
         xfree( argv );
         return ret;
 }
@@ -271,6 +324,7 @@ g_slurm_auth_verify( void *cred, void *hosts, int timeout, char *auth_info )
 {
         int ret;
         void **argv = (void **) NULL;
+	struct timeval start;
 
         if ( slurm_auth_init(NULL) < 0 )
                 return SLURM_ERROR;
@@ -282,7 +336,9 @@ g_slurm_auth_verify( void *cred, void *hosts, int timeout, char *auth_info )
                 return SLURM_ERROR;
         }
 
+	gettimeofday(&start, NULL);
         ret = (*(ops.verify))( cred, auth_info );
+	_auth_time_add(&start);
         xfree( argv );
         return ret;
 }
@@ -167,6 +167,13 @@ extern int	g_slurm_auth_pack( void *cred, Buf buf );
 extern void	*g_slurm_auth_unpack( Buf buf );
 
 int	g_slurm_auth_print( void *cred, FILE *fp );
+
+/*
+ * Return the microseconds the calling thread has spent creating and
+ * verifying credentials, as by round trips to munged, since the last reset
+ * IN reset - if set, restart the count from zero
+ */
+extern uint64_t	g_slurm_auth_thread_usec( bool reset );
 int	g_slurm_auth_errno( void *cred );
 const char *g_slurm_auth_errstr( int slurm_errno );
 
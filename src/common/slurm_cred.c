@@ -2311,3 +2311,8 @@ void  print_sbcast_cred(sbcast_cred_t *sbcast_cred)
 	info("Sbcast_cred: ctime   %s", ctime(&sbcast_cred->ctime) );
 	info("Sbcast_cred: Expire  %s", ctime(&sbcast_cred->expiration) );
 }
+
+uint32_t get_sbcast_cred_jobid(sbcast_cred_t *sbcast_cred)
+{
+	return sbcast_cred->jobid;
+}
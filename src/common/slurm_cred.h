@@ -335,6 +335,8 @@ void slurm_cred_print(slurm_cred_t *cred);
 /*
  * Functions to create, delete, pack, and unpack an sbcast credential
  * Caller of extract_sbcast_cred() must xfree returned node string
+ * get_sbcast_cred_jobid() returns the job id without verifying the
+ * credential
  */
 sbcast_cred_t *create_sbcast_cred(slurm_cred_ctx_t ctx,
 				  uint32_t job_id, char *nodes,
@@ -347,6 +349,7 @@ int           extract_sbcast_cred(slurm_cred_ctx_t ctx,
 void          pack_sbcast_cred(sbcast_cred_t *sbcast_cred, Buf buffer);
 sbcast_cred_t *unpack_sbcast_cred(Buf buffer);
 void          print_sbcast_cred(sbcast_cred_t *sbcast_cred);
+uint32_t      get_sbcast_cred_jobid(sbcast_cred_t *sbcast_cred);
 
 
 #ifdef DISABLE_LOCALTIME
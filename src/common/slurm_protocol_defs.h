@@ -903,8 +903,17 @@ typedef struct file_bcast_msg {
 	sbcast_cred_t *cred;	/* credential for the RPC */
 	uint32_t block_len;	/* length of this data block */
 	char *block;		/* data for this block */
+	uint16_t compress;	/* FILE_BCAST_COMPRESS_* of block */
+	uint32_t uncomp_len;	/* length of block once uncompressed */
+	uint64_t block_offset;	/* offset of this data in the file or
+				 * FILE_BCAST_APPEND from old clients */
 } file_bcast_msg_t;
 
+#define FILE_BCAST_COMPRESS_NONE 0
+#define FILE_BCAST_COMPRESS_ZLIB 1
+#define FILE_BCAST_MAX_UNCOMP_LEN (256 * 1024 * 1024)
+#define FILE_BCAST_APPEND	 ((uint64_t) -1)
+
 typedef struct multi_core_data {
 	uint16_t boards_per_node;	/* boards per node required by job   */
 	uint16_t sockets_per_board;	/* sockets per board required by job */
@@ -1178,6 +1187,9 @@ extern uint16_t preempt_mode_num(const char *preempt_mode);
 extern char *log_num2string(uint16_t inx);
 extern uint16_t log_string2num(char *name);
 
+/* Convert a message type to its name (e.g. "REQUEST_JOB_INFO") */
+extern char *rpc_num2string(uint16_t opcode);
+
 /* Convert HealthCheckNodeState numeric value to a string.
  * Caller must xfree() the return value */
 extern char *health_check_node_state_str(uint16_t node_state);
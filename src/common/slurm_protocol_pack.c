@@ -9932,6 +9932,12 @@ static void _pack_file_bcast(file_bcast_msg_t * msg , Buf buffer,
 	pack32 ( msg->block_len, buffer );
 	packmem ( msg->block, msg->block_len, buffer );
 	pack_sbcast_cred( msg->cred, buffer );
+
+	if (protocol_version >= SLURM_2_6_PROTOCOL_VERSION) {
+		pack16 ( msg->compress, buffer );
+		pack32 ( msg->uncomp_len, buffer );
+		pack64 ( msg->block_offset, buffer );
+	}
 }
 
 static int _unpack_file_bcast(file_bcast_msg_t ** msg_ptr , Buf buffer,
@@ -9966,6 +9972,16 @@ static int _unpack_file_bcast(file_bcast_msg_t ** msg_ptr , Buf buffer,
 	if (msg->cred == NULL)
 		goto unpack_error;
 
+	if (protocol_version >= SLURM_2_6_PROTOCOL_VERSION) {
+		safe_unpack16 ( & msg->compress, buffer );
+		safe_unpack32 ( & msg->uncomp_len, buffer );
+		safe_unpack64 ( & msg->block_offset, buffer );
+	} else {
+		msg->compress = FILE_BCAST_COMPRESS_NONE;
+		msg->uncomp_len = msg->block_len;
+		msg->block_offset = FILE_BCAST_APPEND;
+	}
+
 	return SLURM_SUCCESS;
 
 unpack_error:
@@ -10799,12 +10815,127 @@ static int  _unpack_stats_response_msg(stats_info_response_msg_t **msg_ptr,
 				       Buf buffer, uint16_t protocol_version)
 {
 	stats_info_response_msg_t * msg;
+	uint32_t uint32_tmp = 0;
 	xassert ( msg_ptr != NULL );
 
 	msg = xmalloc ( sizeof (stats_info_response_msg_t) );
 	*msg_ptr = msg ;
 
-	if (protocol_version >= SLURM_2_4_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_2_6_PROTOCOL_VERSION) {
+		safe_unpack32(&msg->parts_packed,	buffer);
+		if (msg->parts_packed) {
+			safe_unpack_time(&msg->req_time,	buffer);
+			safe_unpack_time(&msg->req_time_start,	buffer);
+			safe_unpack32(&msg->server_thread_count,buffer);
+			safe_unpack32(&msg->agent_queue_size,	buffer);
+			safe_unpack32(&msg->jobs_submitted,	buffer);
+			safe_unpack32(&msg->jobs_started,	buffer);
+			safe_unpack32(&msg->jobs_completed,	buffer);
+			safe_unpack32(&msg->jobs_canceled,	buffer);
+			safe_unpack32(&msg->jobs_failed,	buffer);
+
+			safe_unpack32(&msg->schedule_cycle_max,	buffer);
+			safe_unpack32(&msg->schedule_cycle_last,buffer);
+			safe_unpack32(&msg->schedule_cycle_sum,	buffer);
+			safe_unpack32(&msg->schedule_cycle_counter, buffer);
+			safe_unpack32(&msg->schedule_cycle_depth, buffer);
+			safe_unpack32(&msg->schedule_queue_len,	buffer);
+			safe_unpack32(&msg->schedule_queue_maint_last, buffer);
+			safe_unpack32(&msg->schedule_queue_maint_sum, buffer);
+			safe_unpack32(&msg->schedule_latency_last, buffer);
+			safe_unpack32(&msg->schedule_latency_max, buffer);
+			safe_unpack32(&msg->schedule_latency_sum, buffer);
+			safe_unpack32(&msg->schedule_latency_cnt, buffer);
+
+			safe_unpack32(&msg->bf_backfilled_jobs,	buffer);
+			safe_unpack32(&msg->bf_last_backfilled_jobs, buffer);
+			safe_unpack32(&msg->bf_cycle_counter,	buffer);
+			safe_unpack32(&msg->bf_cycle_sum,	buffer);
+			safe_unpack32(&msg->bf_cycle_last,	buffer);
+			safe_unpack32(&msg->bf_last_depth,	buffer);
+			safe_unpack32(&msg->bf_last_depth_try,	buffer);
+
+			safe_unpack32(&msg->bf_queue_len,	buffer);
+			safe_unpack32(&msg->bf_cycle_max,	buffer);
+			safe_unpack_time(&msg->bf_when_last_cycle, buffer);
+			safe_unpack32(&msg->bf_depth_sum,	buffer);
+			safe_unpack32(&msg->bf_depth_try_sum,	buffer);
+			safe_unpack32(&msg->bf_queue_len_sum,	buffer);
+			safe_unpack32(&msg->bf_active,		buffer);
+			safe_unpack32(&msg->bf_last_test_rate,	buffer);
+
+			safe_unpack32(&msg->rpc_queue_len,	buffer);
+			safe_unpack32(&msg->rpc_queue_max,	buffer);
+			safe_unpack32(&msg->rpc_worker_cnt,	buffer);
+
+			safe_unpack32(&msg->time_limit_cycle_counter, buffer);
+			safe_unpack32(&msg->time_limit_jobs_last, buffer);
+			safe_unpack32(&msg->time_limit_jobs_max, buffer);
+			safe_unpack32(&msg->time_limit_jobs_sum, buffer);
+			safe_unpack32(&msg->time_limit_jobs_timed, buffer);
+
+			safe_unpack16_array(&msg->rpc_type_id,
+					    &msg->rpc_type_size, buffer);
+			safe_unpack32_array(&msg->rpc_type_cnt,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->rpc_type_size)
+				goto unpack_error;
+			safe_unpack64_array(&msg->rpc_type_time,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->rpc_type_size)
+				goto unpack_error;
+			safe_unpack64_array(&msg->rpc_type_time_max,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->rpc_type_size)
+				goto unpack_error;
+			safe_unpack64_array(&msg->rpc_type_auth_time,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->rpc_type_size)
+				goto unpack_error;
+
+			safe_unpack32_array(&msg->lock_type_cnt,
+					    &msg->lock_type_size, buffer);
+			safe_unpack64_array(&msg->lock_type_wait_time,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->lock_type_size)
+				goto unpack_error;
+			safe_unpack64_array(&msg->lock_type_wait_max,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->lock_type_size)
+				goto unpack_error;
+			safe_unpack64_array(&msg->lock_type_hold_time,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->lock_type_size)
+				goto unpack_error;
+			safe_unpack64_array(&msg->lock_type_hold_max,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->lock_type_size)
+				goto unpack_error;
+
+			safe_unpackstr_array(&msg->lock_caller_name,
+					     &msg->lock_caller_size, buffer);
+			safe_unpack32_array(&msg->lock_caller_cnt,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->lock_caller_size)
+				goto unpack_error;
+			safe_unpack64_array(&msg->lock_caller_wait_time,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->lock_caller_size)
+				goto unpack_error;
+			safe_unpack64_array(&msg->lock_caller_wait_max,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->lock_caller_size)
+				goto unpack_error;
+			safe_unpack64_array(&msg->lock_caller_hold_time,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->lock_caller_size)
+				goto unpack_error;
+			safe_unpack64_array(&msg->lock_caller_hold_max,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->lock_caller_size)
+				goto unpack_error;
+		}
+	} else if (protocol_version >= SLURM_2_4_PROTOCOL_VERSION) {
 		safe_unpack32(&msg->parts_packed,	buffer);
 		if (msg->parts_packed) {
 			safe_unpack_time(&msg->req_time,	buffer);
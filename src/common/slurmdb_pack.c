@@ -4900,6 +4900,11 @@ extern void slurmdb_pack_job_cond(void *in, uint16_t rpc_version, Buf buffer)
 			pack32(NO_VAL, buffer);	/* count(wckey_list) */
 			pack16(0, buffer);	/* without_steps */
 			pack16(0, buffer);	/* without_usage_truncation */
+			if (rpc_version >= SLURMDBD_2_6_VERSION) {
+				packnull(buffer);	/* page_cluster */
+				pack32(0, buffer);	/* page_jobid */
+				pack32(0, buffer);	/* page_size */
+			}
 			return;
 		}
 
@@ -5089,6 +5094,11 @@ extern void slurmdb_pack_job_cond(void *in, uint16_t rpc_version, Buf buffer)
 
 		pack16(object->without_steps, buffer);
 		pack16(object->without_usage_truncation, buffer);
+		if (rpc_version >= SLURMDBD_2_6_VERSION) {
+			packstr(object->page_cluster, buffer);
+			pack32(object->page_jobid, buffer);
+			pack32(object->page_size, buffer);
+		}
 	} else if (rpc_version >= 8) {
 		if (!object) {
 			pack32(NO_VAL, buffer);
@@ -5650,6 +5660,12 @@ extern int slurmdb_unpack_job_cond(void **object, uint16_t rpc_version,
 
 		safe_unpack16(&object_ptr->without_steps, buffer);
 		safe_unpack16(&object_ptr->without_usage_truncation, buffer);
+		if (rpc_version >= SLURMDBD_2_6_VERSION) {
+			safe_unpackstr_xmalloc(&object_ptr->page_cluster,
+					       &uint32_tmp, buffer);
+			safe_unpack32(&object_ptr->page_jobid, buffer);
+			safe_unpack32(&object_ptr->page_size, buffer);
+		}
 	} else if (rpc_version >= 8) {
 		safe_unpack32(&count, buffer);
 		if (count != NO_VAL) {
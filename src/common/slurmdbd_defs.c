@@ -53,6 +53,7 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <syslog.h>
 #include <sys/poll.h>
 #include <sys/stat.h>
@@ -84,7 +85,12 @@ strong_alias(slurmdbd_free_id_rc_msg,	slurmdb_slurmdbd_free_id_rc_msg);
 
 
 #define DBD_MAGIC		0xDEAD3219
-#define MAX_AGENT_QUEUE		10000
+#define MAX_AGENT_QUEUE		10000	/* Messages held in memory, more are
+					 * appended to the journal file */
+#define MAX_AGENT_BATCH		1000	/* Messages per DBD_SEND_MULT_MSG */
+#define MAX_AGENT_IN_FLIGHT	4	/* Batches sent ahead of replies */
+#define MAX_AGENT_ROUND		16	/* Batches sent per hold of
+					 * slurmdbd_lock */
 #define MAX_DBD_MSG_LEN		16384
 #define SLURMDBD_TIMEOUT	900	/* Seconds SlurmDBD for response */
 
@@ -98,9 +104,28 @@ static List      agent_list     = (List) NULL;
 static pthread_t agent_tid      = 0;
 static time_t    agent_shutdown = 0;
 
+/* Messages queued while agent_list is full are appended to a journal file
+ * in the state save directory and moved back into agent_list, in order, as
+ * it drains. Protected by agent_lock. */
+static int       journal_wfd    = -1;	/* appends records */
+static int       journal_rfd    = -1;	/* reads records not yet queued */
+static off_t     journal_size   = 0;	/* bytes written to journal */
+static off_t     journal_hdr_size = 0;	/* bytes in version header */
+static uint32_t  journal_cnt    = 0;	/* records not yet queued */
+static uint16_t  journal_rpc_version = 0;
+
+/* A batch of messages sent to the SlurmDBD and awaiting its reply. The
+ * messages remain at the head of agent_list until acknowledged. */
+typedef struct agent_batch {
+	int msg_cnt;		/* count of messages in the batch */
+	bool mult;		/* sent as DBD_SEND_MULT_MSG */
+	uint32_t conn_gen;	/* slurmdbd_conn_gen when sent */
+} agent_batch_t;
+
 static pthread_mutex_t slurmdbd_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  slurmdbd_cond = PTHREAD_COND_INITIALIZER;
 static slurm_fd_t  slurmdbd_fd         = -1;
+static uint32_t  slurmdbd_conn_gen   = 0;	/* count of connections made */
 static char *    slurmdbd_auth_info  = NULL;
 static char *    slurmdbd_cluster    = NULL;
 static bool      rollback_started    = 0;
@@ -109,6 +134,7 @@ static slurm_trigger_callbacks_t callback;
 static bool      callbacks_requested = 0;
 static bool      from_ctld           = 0;
 static bool      need_to_register    = 0;
+static uint16_t  slurmdbd_srv_version = 0;	/* 0 if not reported */
 
 static void * _agent(void *x);
 static void   _close_slurmdbd_fd(void);
@@ -116,10 +142,14 @@ static void   _create_agent(void);
 static bool   _fd_readable(slurm_fd_t fd, int read_timeout);
 static int    _fd_writeable(slurm_fd_t fd);
 static int    _get_return_code(uint16_t rpc_version, int read_timeout);
+static int    _journal_append(Buf buffer);
+static void   _journal_close(void);
+static void   _journal_recover(void);
+static void   _journal_refill(void);
+static int    _journal_reopen(void);
 static Buf    _load_dbd_rec(int fd);
 static void   _load_dbd_state(void);
 static void   _open_slurmdbd_fd(bool db_needed);
-static int    _purge_job_start_req(void);
 static Buf    _recv_msg(int read_timeout);
 static void   _reopen_slurmdbd_fd(void);
 static int    _save_dbd_rec(int fd, Buf buffer);
@@ -127,6 +157,7 @@ static void   _save_dbd_state(void);
 static int    _send_init_msg(void);
 static int    _send_fini_msg(void);
 static int    _send_msg(Buf buffer);
+static int    _write_msg(Buf buffer, bool reopen);
 static void   _sig_handler(int signal);
 static void   _shutdown_agent(void);
 static void   _slurmdbd_packstr(void *str, uint16_t rpc_version, Buf buffer);
@@ -230,6 +261,18 @@ extern int slurm_close_slurmdbd_conn(void)
 	return SLURM_SUCCESS;
 }
 
+/* Return the protocol version reported by the SlurmDBD when connecting,
+ * 0 if it reported none */
+extern uint16_t slurmdbd_get_server_version(void)
+{
+	uint16_t version;
+
+	slurm_mutex_lock(&slurmdbd_lock);
+	version = slurmdbd_srv_version;
+	slurm_mutex_unlock(&slurmdbd_lock);
+	return version;
+}
+
 /* Send an RPC to the SlurmDBD and wait for the return code reply.
  * The RPC will not be queued if an error occurs.
  * Returns SLURM_SUCCESS or an error code */
@@ -357,6 +400,18 @@ end_it:
 	return rc;
 }
 
+/* Whatever our max job count is times that by 2 or
+ * MAX_AGENT_QUEUE which ever is bigger */
+static int _max_agent_queue(void)
+{
+	static int max_agent_queue = 0;
+
+	if (!max_agent_queue)
+		max_agent_queue =
+			MAX(MAX_AGENT_QUEUE, slurmctld_conf.max_job_cnt * 2);
+	return max_agent_queue;
+}
+
 /* Send an RPC to the SlurmDBD. Do not wait for the reply. The RPC
  * will be queued and processed later if the SlurmDBD is not responding.
  * NOTE: slurm_open_slurmdbd_conn() must have been called with callbacks set
@@ -365,15 +420,8 @@ end_it:
 extern int slurm_send_slurmdbd_msg(uint16_t rpc_version, slurmdbd_msg_t *req)
 {
 	Buf buffer;
-	int cnt, rc = SLURM_SUCCESS;
-	static time_t syslog_time = 0;
-	static int max_agent_queue = 0;
-
-	/* Whatever our max job count is times that by 2 or
-	 * MAX_AGENT_QUEUE which ever is bigger */
-	if (!max_agent_queue)
-		max_agent_queue =
-			MAX(MAX_AGENT_QUEUE, slurmctld_conf.max_job_cnt * 2);
+	int cnt, max_agent_queue, rc = SLURM_SUCCESS;
+	static time_t syslog_time = 0, journal_err_time = 0;
 
 	buffer = pack_slurmdbd_msg(req, rpc_version);
 
@@ -387,6 +435,7 @@ extern int slurm_send_slurmdbd_msg(uint16_t rpc_version, slurmdbd_msg_t *req)
 		}
 	}
 	cnt = list_count(agent_list);
+	max_agent_queue = _max_agent_queue();
 	if ((cnt >= (max_agent_queue / 2)) &&
 	    (difftime(time(NULL), syslog_time) > 120)) {
 		/* Record critical error every 120 seconds */
@@ -396,16 +445,28 @@ extern int slurm_send_slurmdbd_msg(uint16_t rpc_version, slurmdbd_msg_t *req)
 		if (callbacks_requested)
 			(callback.dbd_fail)();
 	}
-	if (cnt == (max_agent_queue - 1))
-		cnt -= _purge_job_start_req();
-	if (cnt < max_agent_queue) {
+	/* Once the journal is in use, later messages go there too so
+	 * that they are sent in order */
+	if ((journal_cnt == 0) && (cnt < max_agent_queue)) {
 		if (list_enqueue(agent_list, buffer) == NULL)
 			fatal("list_enqueue: memory allocation failure");
+	} else if (_journal_append(buffer) == SLURM_SUCCESS) {
+		if (journal_cnt == 1) {
+			error("slurmdbd: agent queue is full, saving "
+			      "requests to journal file");
+			if (callbacks_requested)
+				(callback.acct_full)();
+		}
+		free_buf(buffer);
 	} else {
-		error("slurmdbd: agent queue is full, discarding request");
-		if (callbacks_requested)
-			(callback.acct_full)();
-		rc = SLURM_ERROR;
+		/* Rather than discard the request, exceed the queue limit */
+		if (difftime(time(NULL), journal_err_time) > 120) {
+			journal_err_time = time(NULL);
+			error("slurmdbd: unable to save request to journal "
+			      "file, agent queue size %d", cnt);
+		}
+		if (list_enqueue(agent_list, buffer) == NULL)
+			fatal("list_enqueue: memory allocation failure");
 	}
 
 	pthread_cond_broadcast(&agent_cond);
@@ -460,6 +521,7 @@ again:
 		} else {
 			int rc;
 			fd_set_nonblocking(slurmdbd_fd);
+			slurmdbd_conn_gen++;
 			rc = _send_init_msg();
 			if (rc == SLURM_SUCCESS) {
 				if (from_ctld)
@@ -1488,6 +1550,7 @@ static int _send_init_msg()
 	int tmp_errno = SLURM_SUCCESS;
 
 	errno = tmp_errno;
+	slurmdbd_srv_version = 0;
 
 	buffer = init_buf(1024);
 	pack16((uint16_t) DBD_INIT, buffer);
@@ -1556,6 +1619,13 @@ static void _reopen_slurmdbd_fd(void)
 }
 
 static int _send_msg(Buf buffer)
+{
+	return _write_msg(buffer, true);
+}
+
+/* Write a message to the SlurmDBD. If the SlurmDBD closed the connection,
+ * open a new one and write the message there only if reopen is set. */
+static int _write_msg(Buf buffer, bool reopen)
 {
 	uint32_t msg_size, nw_size;
 	char *msg;
@@ -1568,7 +1638,7 @@ static int _send_msg(Buf buffer)
 	rc =_fd_writeable(slurmdbd_fd);
 	if (rc == -1) {
 	re_open:	/* SlurmDBD shutdown, try to reopen a connection now */
-		if (retry_cnt++ > 3)
+		if (!reopen || (retry_cnt++ > 3))
 			return EAGAIN;
 		/* if errno is ACCESS_DENIED do not try to reopen to
 		   connection just return that */
@@ -1652,6 +1722,11 @@ static int _unpack_return_code(uint16_t rpc_version, Buf buffer)
 
 			} else if (msg->sent_type == DBD_REGISTER_CTLD)
 				need_to_register = 0;
+			/* A slurmdbd which can give jobs a page at a time
+			 * follows its reply to DBD_INIT with its version */
+			if ((msg->sent_type == DBD_INIT) &&
+			    (remaining_buf(buffer) >= sizeof(uint16_t)))
+				unpack16(&slurmdbd_srv_version, buffer);
 			slurmdbd_free_rc_msg(msg);
 		} else
 			error("slurmdbd: unpack message error");
@@ -1678,19 +1753,16 @@ static int _get_return_code(uint16_t rpc_version, int read_timeout)
 	return rc;
 }
 
-static int _handle_mult_rc_ret(uint16_t rpc_version, int read_timeout)
+/* Process the reply to a DBD_SEND_MULT_MSG, removing the messages
+ * acknowledged from agent_list, and free the reply buffer */
+static int _handle_mult_rc_ret(uint16_t rpc_version, Buf buffer)
 {
-	Buf buffer;
 	uint16_t msg_type;
 	dbd_rc_msg_t *msg;
 	dbd_list_msg_t *list_msg;
 	int rc = SLURM_ERROR;
 	Buf out_buf = NULL;
 
-	buffer = _recv_msg(read_timeout);
-	if (buffer == NULL)
-		return rc;
-
 	safe_unpack16(&msg_type, buffer);
 	switch(msg_type) {
 	case DBD_GOT_MULT_MSG:
@@ -1906,9 +1978,11 @@ static int _fd_writeable(slurm_fd_t fd)
 		 * If not then exit out and notify the sender.  This
  		 * is here since a write doesn't always tell you the
 		 * socket is gone, but getting 0 back from a
-		 * nonblocking read means just that.
+		 * nonblocking read means just that. Only peek, replies
+		 * to earlier messages may be waiting to be read.
 		 */
-		if (ufds.revents & POLLHUP || (recv(fd, &temp, 1, 0) == 0)) {
+		if (ufds.revents & POLLHUP ||
+		    (recv(fd, &temp, 1, MSG_PEEK) == 0)) {
 			debug2("SlurmDBD connection is closed");
 			if (callbacks_requested)
 				(callback.dbd_fail)();
@@ -1948,6 +2022,7 @@ static void _create_agent(void)
 	if (agent_list == NULL) {
 		agent_list = list_create(slurmdbd_free_buffer);
 		_load_dbd_state();
+		_journal_recover();
 	}
 
 	if (agent_tid == 0) {
@@ -2001,21 +2076,186 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+/* Pack the messages in agent_list which follow the first "skip" messages
+ * (those already sent) into a batch, up to MAX_AGENT_BATCH of them.
+ * RET buffer to send, free it only if batch->mult is set, or NULL if there
+ *	is nothing more to send
+ * NOTE: Caller must hold agent_lock */
+static Buf _pack_agent_batch(int skip, agent_batch_t *batch)
+{
+	slurmdbd_msg_t list_req;
+	dbd_list_msg_t list_msg;
+	ListIterator agent_itr;
+	Buf buffer;
+	int cnt;
+
+	if (!agent_list || ((cnt = list_count(agent_list) - skip) <= 0))
+		return NULL;
+
+	agent_itr = list_iterator_create(agent_list);
+	while (skip--)
+		(void) list_next(agent_itr);
+	batch->msg_cnt = 0;
+	if (cnt == 1) {
+		buffer = (Buf) list_next(agent_itr);
+		batch->msg_cnt = 1;
+		batch->mult = false;
+	} else {
+		list_req.msg_type = DBD_SEND_MULT_MSG;
+		list_req.data = &list_msg;
+		memset(&list_msg, 0, sizeof(dbd_list_msg_t));
+		list_msg.my_list = list_create(NULL);
+		while ((buffer = list_next(agent_itr))) {
+			list_enqueue(list_msg.my_list, buffer);
+			if (++batch->msg_cnt >= MAX_AGENT_BATCH)
+				break;
+		}
+		buffer = pack_slurmdbd_msg(&list_req, SLURMDBD_VERSION);
+		list_destroy(list_msg.my_list);
+		batch->mult = true;
+	}
+	list_iterator_destroy(agent_itr);
+	batch->conn_gen = slurmdbd_conn_gen;
+
+	return buffer;
+}
+
+/* Read the reply to a batch. If successful, remove the messages it
+ * acknowledges from agent_list. */
+static int _recv_agent_batch(agent_batch_t *batch, int read_timeout)
+{
+	Buf buffer;
+	int rc;
+
+	buffer = _recv_msg(read_timeout);
+	if (buffer == NULL) {
+		/* Do not leave a late reply to be read as the reply to
+		 * some later message */
+		_close_slurmdbd_fd();
+		return SLURM_ERROR;
+	}
+
+	if (batch->mult)
+		return _handle_mult_rc_ret(SLURMDBD_VERSION, buffer);
+
+	rc = _unpack_return_code(SLURMDBD_VERSION, buffer);
+	free_buf(buffer);
+	if (rc == SLURM_SUCCESS) {
+		slurm_mutex_lock(&agent_lock);
+		if (agent_list && (buffer = list_dequeue(agent_list)))
+			free_buf(buffer);
+		slurm_mutex_unlock(&agent_lock);
+	} else if (rc == EAGAIN) {
+		error("slurmdbd: Failure with "
+		      "message need to resend: %d: %m", rc);
+	}
+	return rc;
+}
+
+/* Return true if a reply from the SlurmDBD can be read without waiting */
+static bool _reply_ready(void)
+{
+	struct pollfd ufds;
+
+	if (slurmdbd_fd < 0)
+		return false;
+	ufds.fd     = slurmdbd_fd;
+	ufds.events = POLLIN;
+	ufds.revents = 0;
+	return ((poll(&ufds, 1, 0) > 0) && (ufds.revents & POLLIN));
+}
+
+/*
+ * Send batches of queued messages to the SlurmDBD, keeping up to
+ * MAX_AGENT_IN_FLIGHT batches sent ahead of their replies. The SlurmDBD
+ * processes the messages of one connection in order, so replies are read
+ * in the order the batches were sent. If sending a batch fails, no more
+ * are sent but the replies to those already sent are still processed, so
+ * their messages are not sent twice. Once a reply fails, the replies to
+ * the batches sent after it are read and discarded, and their messages
+ * are sent again later.
+ * NOTE: Caller must hold slurmdbd_lock
+ */
+static int _send_agent_batches(int read_timeout)
+{
+	agent_batch_t batch[MAX_AGENT_IN_FLIGHT], *batch_ptr;
+	int head = 0, in_flight = 0, sent_msgs = 0, batch_cnt = 0;
+	int rc = SLURM_SUCCESS, send_rc = SLURM_SUCCESS;
+	Buf buffer;
+
+	while (agent_shutdown == 0) {
+		if (in_flight && (rc == SLURM_SUCCESS) && _reply_ready()) {
+			;	/* read the reply before sending more */
+		} else if ((rc == SLURM_SUCCESS) &&
+			   (send_rc == SLURM_SUCCESS) &&
+			   (in_flight < MAX_AGENT_IN_FLIGHT) &&
+			   (batch_cnt < MAX_AGENT_ROUND)) {
+			batch_ptr = &batch[(head + in_flight) %
+					   MAX_AGENT_IN_FLIGHT];
+			slurm_mutex_lock(&agent_lock);
+			buffer = _pack_agent_batch(sent_msgs, batch_ptr);
+			slurm_mutex_unlock(&agent_lock);
+			if (buffer) {
+				/* NOTE: agent_lock is clear here, so we can
+				 * add more requests to the queue while
+				 * sending this batch. */
+				/* Re-opening the connection would lose the
+				 * replies to the batches in flight */
+				send_rc = _write_msg(buffer, (in_flight == 0));
+				if (batch_ptr->mult)
+					free_buf(buffer);
+				if (send_rc == SLURM_SUCCESS) {
+					batch_ptr->conn_gen = slurmdbd_conn_gen;
+					sent_msgs += batch_ptr->msg_cnt;
+					in_flight++;
+					batch_cnt++;
+					continue;
+				}
+				if (agent_shutdown)
+					break;
+				error("slurmdbd: Failure sending message: "
+				      "%d: %m", send_rc);
+			}
+		}
+		if (in_flight == 0)
+			break;
+
+		batch_ptr = &batch[head];
+		if (batch_ptr->conn_gen != slurmdbd_conn_gen) {
+			/* Connection re-opened, reply lost */
+			if (rc == SLURM_SUCCESS)
+				rc = EAGAIN;
+		} else if (rc == SLURM_SUCCESS) {
+			rc = _recv_agent_batch(batch_ptr, read_timeout);
+		} else if ((buffer = _recv_msg(read_timeout))) {
+			free_buf(buffer);
+		}
+		head = (head + 1) % MAX_AGENT_IN_FLIGHT;
+		sent_msgs -= batch_ptr->msg_cnt;
+		in_flight--;
+
+		slurm_mutex_lock(&agent_lock);
+		_journal_refill();
+		slurm_mutex_unlock(&agent_lock);
+	}
+
+	/* A message may have been partly written, or replies left unread
+	 * at shutdown. Start over with a new connection. */
+	if ((send_rc != SLURM_SUCCESS) || in_flight) {
+		_close_slurmdbd_fd();
+		if (rc == SLURM_SUCCESS)
+			rc = (send_rc != SLURM_SUCCESS) ? send_rc : EAGAIN;
+	}
+	return rc;
+}
+
 static void *_agent(void *x)
 {
 	int cnt, rc;
-	Buf buffer;
 	struct timespec abs_time;
 	static time_t fail_time = 0;
 	int sigarray[] = {SIGUSR1, 0};
 	int read_timeout = SLURMDBD_TIMEOUT * 1000;
-	slurmdbd_msg_t list_req;
-	dbd_list_msg_t list_msg;
-
-	list_req.msg_type = DBD_SEND_MULT_MSG;
-	list_req.data = &list_msg;
-	memset(&list_msg, 0, sizeof(dbd_list_msg_t));
-	/* DEF_TIMERS; */
 
 	/* Prepare to catch SIGUSR1 to interrupt pending
 	 * I/O and terminate in a timely fashion. */
@@ -2023,7 +2263,6 @@ static void *_agent(void *x)
 	xsignal_unblock(sigarray);
 
 	while (agent_shutdown == 0) {
-		/* START_TIMER; */
 		slurm_mutex_lock(&slurmdbd_lock);
 		if (halt_agent)
 			pthread_cond_wait(&slurmdbd_cond, &slurmdbd_lock);
@@ -2037,6 +2276,7 @@ static void *_agent(void *x)
 		}
 
 		slurm_mutex_lock(&agent_lock);
+		_journal_refill();
 		if (agent_list && slurmdbd_fd)
 			cnt = list_count(agent_list);
 		else
@@ -2052,105 +2292,23 @@ static void *_agent(void *x)
 			continue;
 		} else if ((cnt > 0) && ((cnt % 50) == 0))
 			info("slurmdbd: agent queue size %u", cnt);
-		/* Leave item on the queue until processing complete */
-		if (agent_list) {
-			int handle_agent_count = 1000;
-			if (cnt > handle_agent_count) {
-				int agent_count = 0;
-				ListIterator agent_itr =
-					list_iterator_create(agent_list);
-				list_msg.my_list = list_create(NULL);
-				while ((buffer = list_next(agent_itr))) {
-					list_enqueue(list_msg.my_list, buffer);
-					agent_count++;
-					if (agent_count > handle_agent_count)
-						break;
-				}
-				list_iterator_destroy(agent_itr);
-				buffer = pack_slurmdbd_msg(&list_req,
-							   SLURMDBD_VERSION);
-			} else if (cnt > 1) {
-				list_msg.my_list = agent_list;
-				buffer = pack_slurmdbd_msg(&list_req,
-							   SLURMDBD_VERSION);
-			} else
-				buffer = (Buf) list_peek(agent_list);
-		} else
-			buffer = NULL;
 		slurm_mutex_unlock(&agent_lock);
-		if (buffer == NULL) {
-			slurm_mutex_unlock(&slurmdbd_lock);
-
-			slurm_mutex_lock(&assoc_cache_mutex);
-			if (slurmdbd_fd >= 0 && running_cache)
-				pthread_cond_signal(&assoc_cache_cond);
-			slurm_mutex_unlock(&assoc_cache_mutex);
 
-			continue;
-		}
-
-		/* NOTE: agent_lock is clear here, so we can add more
-		 * requests to the queue while waiting for this RPC to
-		 * complete. */
-		rc = _send_msg(buffer);
-		if (rc != SLURM_SUCCESS) {
-			if (agent_shutdown) {
-				slurm_mutex_unlock(&slurmdbd_lock);
-				break;
-			}
-			error("slurmdbd: Failure sending message: %d: %m", rc);
-		} else if (list_msg.my_list) {
-			rc = _handle_mult_rc_ret(SLURMDBD_VERSION,
-						 read_timeout);
-		} else {
-			rc = _get_return_code(SLURMDBD_VERSION, read_timeout);
-			if (rc == EAGAIN) {
-				if (agent_shutdown) {
-					slurm_mutex_unlock(&slurmdbd_lock);
-					break;
-				}
-				error("slurmdbd: Failure with "
-				      "message need to resend: %d: %m", rc);
-			}
-		}
+		rc = _send_agent_batches(read_timeout);
 		slurm_mutex_unlock(&slurmdbd_lock);
+		if ((rc != SLURM_SUCCESS) && agent_shutdown)
+			break;
+
 		slurm_mutex_lock(&assoc_cache_mutex);
 		if (slurmdbd_fd >= 0 && running_cache)
 			pthread_cond_signal(&assoc_cache_cond);
 		slurm_mutex_unlock(&assoc_cache_mutex);
 
-		slurm_mutex_lock(&agent_lock);
-		if (agent_list && (rc == SLURM_SUCCESS)) {
-			/* If we sent a mult_msg we just need to free
-			   buffer, we don't need to requeue, just mark
-			   list_msg.my_list as NULL as that is the
-			   sign we sent a mult_msg.
-			*/
-			if (list_msg.my_list) {
-				if (list_msg.my_list != agent_list)
-					list_destroy(list_msg.my_list);
-				list_msg.my_list = NULL;
-			} else
-				buffer = (Buf) list_dequeue(agent_list);
-
-			free_buf(buffer);
+		if (rc == SLURM_SUCCESS)
 			fail_time = 0;
-		} else {
-			/* We still need to free a mult_msg even if we
-			   got a failure.
-			*/
-			if (list_msg.my_list) {
-				if (list_msg.my_list != agent_list)
-					list_destroy(list_msg.my_list);
-				list_msg.my_list = NULL;
-				free_buf(buffer);
-			}
-
+		else
 			fail_time = time(NULL);
-		}
-		slurm_mutex_unlock(&agent_lock);
-		/* END_TIMER; */
-		/* info("at the end with %s", TIME_STR); */
+
 		if (need_to_register) {
 			need_to_register = 0;
 			/* This is going to be always using the
@@ -2164,6 +2322,7 @@ static void *_agent(void *x)
 
 	slurm_mutex_lock(&agent_lock);
 	_save_dbd_state();
+	_journal_close();
 	if (agent_list) {
 		list_destroy(agent_list);
 		agent_list = NULL;
@@ -2233,6 +2392,43 @@ end_it:
 	xfree(dbd_fname);
 }
 
+/* Repack a saved message in SLURMDBD_VERSION if it was saved in some other
+ * version (rpc_version of zero if unknown)
+ * RET the message or NULL on error, the original buffer is consumed */
+static Buf _convert_dbd_rec(Buf buffer, uint16_t rpc_version)
+{
+	slurmdbd_msg_t msg;
+	int rc;
+
+	if (rpc_version == SLURMDBD_VERSION)
+		return buffer;
+
+	set_buf_offset(buffer, 0);
+	if (rpc_version == 0) {
+		/* This should only happen for
+		   pre 2.2.0.rc4 and 2.1
+		   machines so no real need to
+		   keep it add more to it.
+		*/
+		rc = unpack_slurmdbd_msg(&msg, SLURMDBD_VERSION, buffer);
+		if ((rc == SLURM_SUCCESS) && !remaining_buf(buffer))
+			goto got_it;
+
+		/* If the current version
+		   failed lets try the last
+		   version.
+		*/
+		set_buf_offset(buffer, 0);
+		rc = unpack_slurmdbd_msg(&msg, SLURMDBD_VERSION_MIN, buffer);
+	} else
+		rc = unpack_slurmdbd_msg(&msg, rpc_version, buffer);
+got_it:
+	free_buf(buffer);
+	if (rc == SLURM_SUCCESS)
+		return pack_slurmdbd_msg(&msg, SLURMDBD_VERSION);
+	return NULL;
+}
+
 static void _load_dbd_state(void)
 {
 	char *dbd_fname;
@@ -2286,41 +2482,7 @@ static void _load_dbd_state(void)
 				buffer = _load_dbd_rec(fd);
 			if (buffer == NULL)
 				break;
-			if (rpc_version != SLURMDBD_VERSION) {
-				slurmdbd_msg_t msg;
-				int rc;
-				set_buf_offset(buffer, 0);
-				if (rpc_version == 0) {
-					/* This should only happen for
-					   pre 2.2.0.rc4 and 2.1
-					   machines so no real need to
-					   keep it add more to it.
-					*/
-					rc = unpack_slurmdbd_msg(
-						&msg, SLURMDBD_VERSION, buffer);
-					if ((rc == SLURM_SUCCESS)
-					    && !remaining_buf(buffer))
-						goto got_it;
-
-					/* If the current version
-					   failed lets try the last
-					   version.
-					*/
-					set_buf_offset(buffer, 0);
-					rc = unpack_slurmdbd_msg(
-						&msg, SLURMDBD_VERSION_MIN,
-						buffer);
-				} else
-					rc = unpack_slurmdbd_msg(
-						&msg, rpc_version, buffer);
-			got_it:
-				free_buf(buffer);
-				if (rc == SLURM_SUCCESS)
-					buffer = pack_slurmdbd_msg(
-						&msg, SLURMDBD_VERSION);
-				else
-					buffer = NULL;
-			}
+			buffer = _convert_dbd_rec(buffer, rpc_version);
 			if (!buffer) {
 				error("no buffer given");
 				continue;
@@ -2425,38 +2587,285 @@ static Buf _load_dbd_rec(int fd)
 	return buffer;
 }
 
-static void _sig_handler(int signal)
+static char *_journal_fname(void)
 {
+	char *journal_fname = slurm_get_state_save_location();
+
+	xstrcat(journal_fname, "/dbd.journal");
+	return journal_fname;
 }
 
-/* Purge queued job/step start records from the agent queue
- * RET number of records purged */
-static int _purge_job_start_req(void)
+/* Close and remove the journal file, if any */
+static void _journal_reset(void)
 {
-	int purged = 0;
-	ListIterator iter;
-	uint16_t msg_type;
-	uint32_t offset;
+	char *journal_fname;
+
+	if (journal_wfd >= 0)
+		(void) close(journal_wfd);
+	if (journal_rfd >= 0)
+		(void) close(journal_rfd);
+	journal_wfd = journal_rfd = -1;
+	journal_cnt = 0;
+	journal_size = journal_hdr_size = 0;
+
+	journal_fname = _journal_fname();
+	(void) unlink(journal_fname);
+	xfree(journal_fname);
+}
+
+static int _journal_write_header(int fd)
+{
+	char curr_ver_str[10];
+	Buf buffer;
+	int rc;
+
+	snprintf(curr_ver_str, sizeof(curr_ver_str), "VER%d", SLURMDBD_VERSION);
+	buffer = init_buf(strlen(curr_ver_str));
+	packstr(curr_ver_str, buffer);
+	rc = _save_dbd_rec(fd, buffer);
+	free_buf(buffer);
+	return rc;
+}
+
+/* Read the version string at the start of a journal file
+ * RET the rpc_version of its records or 0 if the file is not valid */
+static uint16_t _journal_read_header(int fd)
+{
+	Buf buffer;
+	char *ver_str = NULL;
+	uint32_t ver_str_len;
+	uint16_t rpc_version = 0;
+
+	if (!(buffer = _load_dbd_rec(fd)))
+		return 0;
+	set_buf_offset(buffer, 0);
+	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
+	if (ver_str && !strncmp(ver_str, "VER", 3))
+		rpc_version = atoi(ver_str + 3);
+unpack_error:
+	xfree(ver_str);
+	free_buf(buffer);
+	return rpc_version;
+}
+
+static int _journal_create(void)
+{
+	char *journal_fname = _journal_fname();
+
+	journal_wfd = open(journal_fname, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (journal_wfd < 0) {
+		error("slurmdbd: Creating journal file %s: %m", journal_fname);
+		xfree(journal_fname);
+		return SLURM_ERROR;
+	}
+	journal_rfd = open(journal_fname, O_RDONLY);
+	xfree(journal_fname);
+	if ((journal_rfd < 0) ||
+	    (_journal_write_header(journal_wfd) != SLURM_SUCCESS)) {
+		error("slurmdbd: Writing journal file: %m");
+		_journal_reset();
+		return SLURM_ERROR;
+	}
+	journal_hdr_size = journal_size = lseek(journal_wfd, 0, SEEK_CUR);
+	(void) lseek(journal_rfd, journal_hdr_size, SEEK_SET);
+	journal_rpc_version = SLURMDBD_VERSION;
+
+	return SLURM_SUCCESS;
+}
+
+/* Reopen for appending a journal file which still holds unread messages,
+ * discarding anything after its last complete record
+ * NOTE: Caller must hold agent_lock */
+static int _journal_reopen(void)
+{
+	char *journal_fname = _journal_fname();
+	int save_errno;
+
+	journal_wfd = open(journal_fname, O_WRONLY);
+	xfree(journal_fname);
+	if ((journal_wfd < 0) || ftruncate(journal_wfd, journal_size) ||
+	    (lseek(journal_wfd, journal_size, SEEK_SET) < 0)) {
+		save_errno = errno;
+		if (journal_wfd >= 0)
+			(void) close(journal_wfd);
+		journal_wfd = -1;
+		errno = save_errno;
+		return SLURM_ERROR;
+	}
+	return SLURM_SUCCESS;
+}
+
+/* Append a message to the journal file
+ * NOTE: Caller must hold agent_lock */
+static int _journal_append(Buf buffer)
+{
+	if (get_buf_offset(buffer) > MAX_DBD_MSG_LEN)
+		return SLURM_ERROR;	/* could not be read back */
+	if (journal_wfd < 0) {
+		/* A recovered journal could not be reopened for writing.
+		 * Never recreate it while it holds unread messages, the
+		 * caller keeps the message in memory if this fails again */
+		if (journal_rfd >= 0) {
+			if (_journal_reopen() != SLURM_SUCCESS)
+				return SLURM_ERROR;
+		} else if (_journal_create() != SLURM_SUCCESS)
+			return SLURM_ERROR;
+	}
+
+	if (_save_dbd_rec(journal_wfd, buffer) != SLURM_SUCCESS) {
+		/* Remove any partial record so later ones can be read */
+		if (ftruncate(journal_wfd, journal_size) ||
+		    (lseek(journal_wfd, journal_size, SEEK_SET) < 0))
+			error("slurmdbd: journal file truncate: %m");
+		return SLURM_ERROR;
+	}
+	journal_size = lseek(journal_wfd, 0, SEEK_CUR);
+	journal_cnt++;
+
+	return SLURM_SUCCESS;
+}
+
+/* Move messages from the journal file to agent_list once it is half empty
+ * NOTE: Caller must hold agent_lock */
+static void _journal_refill(void)
+{
+	int cnt, max_agent_queue = _max_agent_queue();
 	Buf buffer;
 
-	iter = list_iterator_create(agent_list);
-	while ((buffer = list_next(iter))) {
-		offset = get_buf_offset(buffer);
-		if (offset < 2)
+	if ((journal_cnt == 0) || (agent_list == NULL))
+		return;
+	cnt = list_count(agent_list);
+	if (cnt >= (max_agent_queue / 2))
+		return;
+
+	while ((cnt < max_agent_queue) && journal_cnt) {
+		if (!(buffer = _load_dbd_rec(journal_rfd))) {
+			error("slurmdbd: journal file read error, "
+			      "%u pending RPCs lost", journal_cnt);
+			journal_cnt = 0;
+			break;
+		}
+		journal_cnt--;
+		if (!(buffer = _convert_dbd_rec(buffer, journal_rpc_version))) {
+			error("slurmdbd: journal file unpack error");
 			continue;
-		set_buf_offset(buffer, 0);
-		unpack16(&msg_type, buffer);
-		set_buf_offset(buffer, offset);
-		if ((msg_type == DBD_JOB_START) ||
-		    (msg_type == DBD_STEP_START) ||
-		    (msg_type == DBD_STEP_COMPLETE)) {
-			list_remove(iter);
-			purged++;
 		}
+		if (!list_enqueue(agent_list, buffer))
+			fatal("slurmdbd: list_enqueue, no memory");
+		cnt++;
 	}
-	list_iterator_destroy(iter);
-	info("slurmdbd: purge %d job/step start records", purged);
-	return purged;
+	if (journal_cnt == 0) {
+		info("slurmdbd: journal file emptied");
+		_journal_reset();
+	}
+}
+
+/* Reopen a journal file left by an earlier run. Its messages are moved to
+ * agent_list as that drains, after those recovered by _load_dbd_state().
+ * NOTE: Caller must hold agent_lock */
+static void _journal_recover(void)
+{
+	char *journal_fname = _journal_fname();
+	off_t end_offset;
+	Buf buffer;
+	uint32_t cnt = 0;
+
+	journal_rfd = open(journal_fname, O_RDONLY);
+	if (journal_rfd < 0) {
+		if (errno != ENOENT)
+			error("slurmdbd: Opening journal file %s: %m",
+			      journal_fname);
+		xfree(journal_fname);
+		return;
+	}
+
+	journal_rpc_version = _journal_read_header(journal_rfd);
+	journal_hdr_size = end_offset = lseek(journal_rfd, 0, SEEK_CUR);
+	while ((buffer = _load_dbd_rec(journal_rfd))) {
+		free_buf(buffer);
+		end_offset = lseek(journal_rfd, 0, SEEK_CUR);
+		cnt++;
+	}
+	(void) lseek(journal_rfd, journal_hdr_size, SEEK_SET);
+	journal_cnt = cnt;
+
+	if ((cnt == 0) || (journal_rpc_version != SLURMDBD_VERSION)) {
+		/* New messages are added in the current version, so move
+		 * any in an old version into agent_list now */
+		while (journal_cnt && agent_list) {
+			journal_cnt--;
+			if (!(buffer = _load_dbd_rec(journal_rfd)) ||
+			    !(buffer = _convert_dbd_rec(buffer,
+							journal_rpc_version)))
+				continue;
+			if (!list_enqueue(agent_list, buffer))
+				fatal("slurmdbd: list_enqueue, no memory");
+		}
+		verbose("slurmdbd: recovered %u pending RPCs from journal",
+			cnt);
+		_journal_reset();
+		xfree(journal_fname);
+		return;
+	}
+
+	/* Discard any partial record written as we stopped */
+	journal_size = end_offset;
+	if (_journal_reopen() != SLURM_SUCCESS) {
+		/* retried as new messages are appended */
+		error("slurmdbd: Opening journal file %s: %m", journal_fname);
+	}
+	verbose("slurmdbd: %u pending RPCs in journal file", cnt);
+	xfree(journal_fname);
+}
+
+/* Close the journal file at shutdown. Messages already moved to agent_list
+ * were saved by _save_dbd_state(), so remove them from the journal.
+ * NOTE: Caller must hold agent_lock */
+static void _journal_close(void)
+{
+	char *journal_fname, *new_fname = NULL;
+	off_t read_offset;
+	Buf buffer;
+	int fd, rc = SLURM_SUCCESS;
+
+	if ((journal_cnt == 0) || (journal_rfd < 0)) {
+		_journal_reset();
+		return;
+	}
+
+	read_offset = lseek(journal_rfd, 0, SEEK_CUR);
+	if (read_offset > journal_hdr_size) {
+		journal_fname = _journal_fname();
+		new_fname = xstrdup_printf("%s.new", journal_fname);
+		fd = open(new_fname, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		if ((fd < 0) || _journal_write_header(fd))
+			rc = SLURM_ERROR;
+		while ((rc == SLURM_SUCCESS) &&
+		       (buffer = _load_dbd_rec(journal_rfd))) {
+			rc = _save_dbd_rec(fd, buffer);
+			free_buf(buffer);
+		}
+		if (fd >= 0)
+			(void) close(fd);
+		if ((rc != SLURM_SUCCESS) || rename(new_fname, journal_fname))
+			error("slurmdbd: Saving journal file %s: %m",
+			      journal_fname);
+		xfree(new_fname);
+		xfree(journal_fname);
+	}
+	verbose("slurmdbd: saved %u pending RPCs in journal file",
+		journal_cnt);
+
+	if (journal_wfd >= 0)
+		(void) close(journal_wfd);
+	(void) close(journal_rfd);
+	journal_wfd = journal_rfd = -1;
+	journal_cnt = 0;
+	journal_size = journal_hdr_size = 0;
+}
+
+static void _sig_handler(int signal)
+{
 }
 
 /****************************************************************************\
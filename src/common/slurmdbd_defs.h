@@ -417,6 +417,10 @@ extern int slurm_open_slurmdbd_conn(char *auth_info,
 /* Close the SlurmDBD socket connection */
 extern int slurm_close_slurmdbd_conn();
 
+/* Return the protocol version reported by the SlurmDBD when connecting,
+ * 0 if it is older than one which can give jobs a page at a time */
+extern uint16_t slurmdbd_get_server_version(void);
+
 /* Send an RPC to the SlurmDBD. Do not wait for the reply. The RPC
  * will be queued and processed later if the SlurmDBD is not responding.
  * NOTE: slurm_open_slurmdbd_conn() must have been called with make_agent set
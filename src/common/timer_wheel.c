@@ -0,0 +1,283 @@
+/*****************************************************************************\
+ *  timer_wheel.c - hierarchical timer wheel of events keyed on a time_t
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "src/common/timer_wheel.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+
+/* Each level has 1 << TW_BITS slots */
+#define TW_BITS		6
+#define TW_SIZE		(1 << TW_BITS)
+#define TW_MASK		(TW_SIZE - 1)
+#define TW_LEVELS	4
+/* Entries due further in the future than this are held in the last level */
+#define TW_RANGE	((time_t) 1 << (TW_BITS * TW_LEVELS))
+/* If the wheel falls further behind than this, redistribute every entry
+ * rather than advancing it one second at a time */
+#define TW_CATCH_UP	(60 * 60)
+
+/* Slots and the expired list are circular lists headed by a dummy entry */
+struct timer_wheel {
+	timer_ent_t slot[TW_LEVELS][TW_SIZE];
+	timer_ent_t expired;	/* collected by timer_wheel_expire() */
+	time_t clk;		/* next second to be processed */
+	uint32_t count;		/* entries in the wheel */
+};
+
+static void _head_init(timer_ent_t *head)
+{
+	head->prev = head;
+	head->next = head;
+}
+
+static void _link(timer_ent_t *head, timer_ent_t *ent)
+{
+	ent->prev = head->prev;
+	ent->next = head;
+	head->prev->next = ent;
+	head->prev = ent;
+}
+
+static void _unlink(timer_ent_t *ent)
+{
+	ent->prev->next = ent->next;
+	ent->next->prev = ent->prev;
+	ent->prev = NULL;
+	ent->next = NULL;
+}
+
+/* Move all entries of list src to the end of list dest */
+static void _splice(timer_ent_t *dest, timer_ent_t *src)
+{
+	if (src->next == src)
+		return;
+	src->next->prev = dest->prev;
+	dest->prev->next = src->next;
+	src->prev->next = dest;
+	dest->prev = src->prev;
+	_head_init(src);
+}
+
+/* Put an entry in the slot for its expiration time relative to tw->clk */
+static void _place(timer_wheel_t *tw, timer_ent_t *ent)
+{
+	time_t when = ent->expires, delta;
+	int level;
+
+	if (when < tw->clk)
+		when = tw->clk;
+	delta = when - tw->clk;
+	if (delta >= TW_RANGE) {
+		when = tw->clk + TW_RANGE - 1;
+		delta = TW_RANGE - 1;
+	}
+	for (level = 0; level < (TW_LEVELS - 1); level++) {
+		if (delta < ((time_t) 1 << (TW_BITS * (level + 1))))
+			break;
+	}
+	_link(&tw->slot[level][(when >> (TW_BITS * level)) & TW_MASK], ent);
+}
+
+/* Redistribute the entries of one slot to the levels below */
+static void _cascade(timer_wheel_t *tw, int level, int inx)
+{
+	timer_ent_t head, *ent;
+
+	_head_init(&head);
+	_splice(&head, &tw->slot[level][inx]);
+	while ((ent = head.next) != &head) {
+		_unlink(ent);
+		_place(tw, ent);
+	}
+}
+
+/* Process second tw->clk, RET count of entries expired */
+static uint32_t _tick(timer_wheel_t *tw)
+{
+	timer_ent_t *head, *ent;
+	uint32_t cnt = 0;
+	int inx = tw->clk & TW_MASK, level, level_inx;
+
+	if (inx == 0) {
+		/* Lowest level wrapped, bring down the next second's slots */
+		for (level = 1; level < TW_LEVELS; level++) {
+			level_inx = (tw->clk >> (TW_BITS * level)) & TW_MASK;
+			_cascade(tw, level, level_inx);
+			if (level_inx)
+				break;
+		}
+	}
+
+	head = &tw->slot[0][inx];
+	for (ent = head->next; ent != head; ent = ent->next)
+		cnt++;
+	_splice(&tw->expired, head);
+	tw->clk++;
+	return cnt;
+}
+
+/* Redistribute every entry for a clock far ahead of tw->clk,
+ * RET count of entries expired */
+static uint32_t _catch_up(timer_wheel_t *tw, time_t now)
+{
+	timer_ent_t head, *ent;
+	uint32_t cnt = 0;
+	int level, inx;
+
+	_head_init(&head);
+	for (level = 0; level < TW_LEVELS; level++) {
+		for (inx = 0; inx < TW_SIZE; inx++)
+			_splice(&head, &tw->slot[level][inx]);
+	}
+	tw->clk = now + 1;
+	while ((ent = head.next) != &head) {
+		_unlink(ent);
+		if (ent->expires <= now) {
+			_link(&tw->expired, ent);
+			cnt++;
+		} else
+			_place(tw, ent);
+	}
+	return cnt;
+}
+
+extern void timer_ent_init(timer_ent_t *ent, void *arg)
+{
+	ent->expires = (time_t) 0;
+	ent->prev = NULL;
+	ent->next = NULL;
+	ent->arg = arg;
+}
+
+extern bool timer_ent_pending(timer_ent_t *ent)
+{
+	return (ent->prev != NULL);
+}
+
+extern timer_wheel_t *timer_wheel_create(time_t now)
+{
+	timer_wheel_t *tw = xmalloc(sizeof(timer_wheel_t));
+	int level, inx;
+
+	for (level = 0; level < TW_LEVELS; level++) {
+		for (inx = 0; inx < TW_SIZE; inx++)
+			_head_init(&tw->slot[level][inx]);
+	}
+	_head_init(&tw->expired);
+	tw->clk = now;
+	return tw;
+}
+
+extern void timer_wheel_destroy(timer_wheel_t *tw)
+{
+	timer_ent_t head, *ent;
+	int level, inx;
+
+	if (!tw)
+		return;
+	_head_init(&head);
+	for (level = 0; level < TW_LEVELS; level++) {
+		for (inx = 0; inx < TW_SIZE; inx++)
+			_splice(&head, &tw->slot[level][inx]);
+	}
+	_splice(&head, &tw->expired);
+	while ((ent = head.next) != &head)
+		_unlink(ent);
+	xfree(tw);
+}
+
+extern void timer_wheel_add(timer_wheel_t *tw, timer_ent_t *ent,
+			    time_t expires)
+{
+	xassert(tw);
+	xassert(ent);
+
+	if (ent->prev)
+		_unlink(ent);
+	else
+		tw->count++;
+	ent->expires = expires;
+	_place(tw, ent);
+}
+
+extern void timer_wheel_del(timer_wheel_t *tw, timer_ent_t *ent)
+{
+	xassert(tw);
+
+	if (!ent->prev)
+		return;
+	_unlink(ent);
+	tw->count--;
+}
+
+extern uint32_t timer_wheel_expire(timer_wheel_t *tw, time_t now)
+{
+	uint32_t cnt = 0;
+
+	xassert(tw);
+
+	if (now < tw->clk)
+		return 0;
+	if ((now - tw->clk) > TW_CATCH_UP)
+		return _catch_up(tw, now);
+	while (tw->clk <= now)
+		cnt += _tick(tw);
+	return cnt;
+}
+
+extern timer_ent_t *timer_wheel_next(timer_wheel_t *tw)
+{
+	timer_ent_t *ent;
+
+	xassert(tw);
+
+	ent = tw->expired.next;
+	if (ent == &tw->expired)
+		return NULL;
+	_unlink(ent);
+	tw->count--;
+	return ent;
+}
+
+extern uint32_t timer_wheel_count(timer_wheel_t *tw)
+{
+	xassert(tw);
+	return tw->count;
+}
@@ -0,0 +1,131 @@
+/*****************************************************************************\
+ *  timer_wheel.h - hierarchical timer wheel of events keyed on a time_t
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifndef _TIMER_WHEEL_H
+#define _TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <time.h>
+
+/*
+ * A hierarchical timer wheel with a resolution of one second. Each entry
+ * is placed in a slot of one of several levels according to how far in the
+ * future it expires: the first level has one slot per second, each further
+ * level has slots covering the whole range of the level below. As time
+ * advances the slots of the higher levels are redistributed to the lower
+ * ones, so adding, removing and expiring an entry each take constant time
+ * no matter how many entries are held and expiring touches only the entries
+ * which are due (plus those being redistributed).
+ *
+ * Entries are embedded in the records they time, the wheel allocates no
+ * memory per entry. Entries further in the future than the range of the
+ * wheel (about 194 days) are held in the last slot and redistributed until
+ * they are due.
+ *
+ * The wheel does no locking of its own, callers must serialize access.
+ */
+typedef struct timer_wheel timer_wheel_t;
+
+typedef struct timer_ent {
+	time_t expires;			/* time the entry is due */
+	struct timer_ent *prev;		/* NULL if not in a wheel */
+	struct timer_ent *next;
+	void *arg;			/* caller's record */
+} timer_ent_t;
+
+/*
+ * timer_ent_init - initialize an entry which is not in a wheel
+ * IN ent - the entry
+ * IN arg - pointer returned with the entry, normally its containing record
+ */
+extern void timer_ent_init(timer_ent_t *ent, void *arg);
+
+/*
+ * timer_ent_pending - return true if the entry is in a wheel
+ */
+extern bool timer_ent_pending(timer_ent_t *ent);
+
+/*
+ * timer_wheel_create - create an empty timer wheel
+ * IN now - current time, entries due at or before it expire on the first
+ *	call to timer_wheel_expire()
+ * RET the new wheel, free with timer_wheel_destroy()
+ */
+extern timer_wheel_t *timer_wheel_create(time_t now);
+
+/*
+ * timer_wheel_destroy - free a timer wheel, removing any entries it holds
+ */
+extern void timer_wheel_destroy(timer_wheel_t *tw);
+
+/*
+ * timer_wheel_add - add an entry to the wheel or move it if already present
+ * IN tw - the wheel
+ * IN ent - the entry
+ * IN expires - time the entry is due, entries due in the past expire on the
+ *	next call to timer_wheel_expire()
+ */
+extern void timer_wheel_add(timer_wheel_t *tw, timer_ent_t *ent,
+			    time_t expires);
+
+/*
+ * timer_wheel_del - remove an entry from the wheel, if present
+ */
+extern void timer_wheel_del(timer_wheel_t *tw, timer_ent_t *ent);
+
+/*
+ * timer_wheel_expire - advance the wheel to the given time, collecting all
+ *	entries due at or before it. Collected entries remain in the wheel
+ *	until returned by timer_wheel_next() or removed.
+ * IN tw - the wheel
+ * IN now - current time, if earlier than the previous call nothing expires
+ * RET count of entries collected by this call
+ */
+extern uint32_t timer_wheel_expire(timer_wheel_t *tw, time_t now);
+
+/*
+ * timer_wheel_next - remove and return one of the collected entries
+ * RET the entry or NULL if none remain. The entry may be added again.
+ */
+extern timer_ent_t *timer_wheel_next(timer_wheel_t *tw);
+
+/*
+ * timer_wheel_count - return the number of entries in the wheel
+ */
+extern uint32_t timer_wheel_count(timer_wheel_t *tw);
+
+#endif /* !_TIMER_WHEEL_H */
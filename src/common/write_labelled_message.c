@@ -41,56 +41,70 @@
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include <sys/uio.h>
 
 #include "src/common/write_labelled_message.h"
 #include "slurm/slurm_errno.h"
 #include "src/common/log.h"
 
-static int _write_label(int fd, int taskid, int label_width);
+/* Most lines written with one writev(), each taking a label, the line
+ * and for a partial line a newline */
+#define MAX_LINES_PER_WRITE 64
+
 static int _write_line(int fd, void *buf, int len);
-static int _write_newline(int fd);
+static int _writev_all(int fd, struct iovec *iov, int iovcnt);
 
 
 
 int write_labelled_message(int fd, void *buf, int len, int taskid,
 			   bool label, int label_width)
 {
+	struct iovec iov[MAX_LINES_PER_WRITE * 3];
+	char label_buf[16];
+	int label_len;
 	void *start;
 	void *end;
 	int remaining = len;
 	int written = 0;
+	int pending = 0;
 	int line_len;
+	int iovcnt = 0;
+	int lines = 0;
 	int rc = -1;
 
+	if (len <= 0)
+		return -1;
+	if (!label)
+		return _write_line(fd, buf, len);
+
+	label_len = snprintf(label_buf, sizeof(label_buf), "%0*d: ",
+			     label_width, taskid);
 	while (remaining > 0) {
-		start = buf + written;
+		start = buf + written + pending;
 		end = memchr(start, '\n', remaining);
-		if (label)
-			if (_write_label(fd, taskid, label_width)
-			    != SLURM_SUCCESS)
-				goto done;
-		if (end == NULL) { /* no newline found */
-			rc = _write_line(fd, start, remaining);
-			if (rc <= 0) {
-				goto done;
-			} else {
-				remaining -= rc;
-				written += rc;
-			}
-			if (label)
-				if (_write_newline(fd) != SLURM_SUCCESS)
-					goto done;
-		} else {
+		if (end == NULL) /* no newline found */
+			line_len = remaining;
+		else
 			line_len = (int)(end - start) + 1;
-			rc = _write_line(fd, start, line_len);
-			if (rc <= 0) {
-				goto done;
-			} else {
-				remaining -= rc;
-				written += rc;
-			}
+		iov[iovcnt].iov_base = label_buf;
+		iov[iovcnt++].iov_len = label_len;
+		iov[iovcnt].iov_base = start;
+		iov[iovcnt++].iov_len = line_len;
+		if (end == NULL) {
+			iov[iovcnt].iov_base = "\n";
+			iov[iovcnt++].iov_len = 1;
 		}
+		remaining -= line_len;
+		pending += line_len;
 
+		if ((++lines == MAX_LINES_PER_WRITE) || (remaining == 0)) {
+			if (_writev_all(fd, iov, iovcnt) != SLURM_SUCCESS)
+				goto done;
+			written += pending;
+			pending = 0;
+			iovcnt = 0;
+			lines = 0;
+		}
 	}
 done:
 	if (written > 0)
@@ -100,53 +114,6 @@ done:
 }
 
 
-static int _write_label(int fd, int taskid, int label_width)
-{
-	int n;
-	int left = label_width + 2;
-	char buf[16];
-	void *ptr = buf;
-
-	snprintf(buf, 16, "%0*d: ", label_width, taskid);
-	while (left > 0) {
-	again:
-		if ((n = write(fd, ptr, left)) < 0) {
-			if (errno == EINTR)
-				goto again;
-			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
-				debug3("  got EAGAIN in _write_label");
-				goto again;
-			}
-			error("In _write_label: %m");
-			return SLURM_ERROR;
-		}
-		left -= n;
-		ptr += n;
-	}
-
-	return SLURM_SUCCESS;
-}
-
-
-static int _write_newline(int fd)
-{
-	int n;
-
-	debug2("Called _write_newline");
-again:
-	if ((n = write(fd, "\n", 1)) < 0) {
-		if (errno == EINTR
-		    || errno == EAGAIN
-		    || errno == EWOULDBLOCK) {
-			goto again;
-		}
-		error("In _write_newline: %m");
-		return SLURM_ERROR;
-	}
-	return SLURM_SUCCESS;
-}
-
-
 /*
  * Blocks until write is complete, regardless of the file
  * descriptor being in non-blocking mode.
@@ -175,3 +142,33 @@ static int _write_line(int fd, void *buf, int len)
 
 	return len;
 }
+
+/*
+ * Write all of an iovec array, blocking until complete regardless of the
+ * file descriptor being in non-blocking mode.  The array is modified.
+ */
+static int _writev_all(int fd, struct iovec *iov, int iovcnt)
+{
+	ssize_t n;
+
+	while (iovcnt > 0) {
+		if ((n = writev(fd, iov, iovcnt)) < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN) ||
+			    (errno == EWOULDBLOCK))
+				continue;
+			error("In _writev_all: %m");
+			return SLURM_ERROR;
+		}
+		while ((iovcnt > 0) && (n >= iov->iov_len)) {
+			n -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (n > 0) {
+			iov->iov_base += n;
+			iov->iov_len -= n;
+		}
+	}
+
+	return SLURM_SUCCESS;
+}
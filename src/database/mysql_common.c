@@ -743,6 +743,20 @@ extern int mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query)
 
 }
 
+/* run a delete query, RET count of rows deleted or -1 on error */
+extern int mysql_db_delete_affected_rows(mysql_conn_t *mysql_conn, char *query)
+{
+	int rc = -1;
+
+	if (!mysql_conn || !mysql_conn->db_conn)
+		fatal("You haven't inited this storage yet.");
+	slurm_mutex_lock(&mysql_conn->lock);
+	if (_mysql_query_internal(mysql_conn->db_conn, query) != SLURM_ERROR)
+		rc = mysql_affected_rows(mysql_conn->db_conn);
+	slurm_mutex_unlock(&mysql_conn->lock);
+	return rc;
+}
+
 extern int mysql_db_create_table(mysql_conn_t *mysql_conn, char *table_name,
 				 storage_field_t *fields, char *ending)
 {
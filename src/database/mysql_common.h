@@ -114,6 +114,8 @@ extern int mysql_db_query_check_after(mysql_conn_t *mysql_conn, char *query);
 
 extern int mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query);
 
+extern int mysql_db_delete_affected_rows(mysql_conn_t *mysql_conn, char *query);
+
 extern int mysql_db_create_table(mysql_conn_t *mysql_conn, char *table_name,
 				 storage_field_t *fields, char *ending);
 
@@ -43,6 +43,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <arpa/inet.h>
 #include "src/common/slurmdbd_defs.h"
 #include "src/common/slurm_auth.h"
 #include "src/common/xstring.h"
@@ -50,6 +51,35 @@
 #include "src/slurmdbd/read_config.h"
 #include "common_as.h"
 
+#ifdef HAVE_ZLIB_H
+#  include <zlib.h>
+#endif
+
+/*
+ * An archive stream is ARCHIVE_STREAM_MAGIC followed by blocks, each of
+ * which is a header of three network order 32 bit words, the block type,
+ * the size stored and the size of the data, followed by the stored data.
+ * The data of each block is a complete buffer as written by the archive
+ * functions, compressed when zlib is available.
+ */
+#define ARCHIVE_STREAM_MAGIC	"SLURM_ARCHIVE_STREAM\n"
+#define ARCHIVE_BLOCK_RAW	0
+#define ARCHIVE_BLOCK_ZLIB	1
+
+struct archive_stream {
+	int fd;
+	char *new_file;
+	char *reg_file;
+	uint32_t blocks;
+	uint64_t data_size;	/* before compression */
+	uint64_t stored_size;	/* after compression */
+	off_t size;		/* of the file */
+	uint32_t last_data;	/* sizes of the last block, for */
+	uint32_t last_stored;	/* archive_stream_undo() */
+};
+
+static pthread_mutex_t archive_file_lock = PTHREAD_MUTEX_INITIALIZER;
+
 extern char *assoc_hour_table;
 extern char *assoc_day_table;
 extern char *assoc_month_table;
@@ -788,11 +818,10 @@ extern int archive_write_file(Buf buffer, char *cluster_name,
 	int rc = SLURM_SUCCESS;
 	char *old_file = NULL, *new_file = NULL, *reg_file = NULL;
 	static int high_buffer_size = (1024 * 1024);
-	static pthread_mutex_t local_file_lock = PTHREAD_MUTEX_INITIALIZER;
 
 	xassert(buffer);
 
-	slurm_mutex_lock(&local_file_lock);
+	slurm_mutex_lock(&archive_file_lock);
 
 	/* write the buffer to file */
 	reg_file = _make_archive_name(period_start, period_end,
@@ -840,7 +869,265 @@ extern int archive_write_file(Buf buffer, char *cluster_name,
 	xfree(old_file);
 	xfree(reg_file);
 	xfree(new_file);
-	slurm_mutex_unlock(&local_file_lock);
+	slurm_mutex_unlock(&archive_file_lock);
+
+	return rc;
+}
+
+static int _write_all(int fd, char *data, uint32_t size)
+{
+	int amount;
+
+	while (size > 0) {
+		amount = write(fd, data, size);
+		if (amount < 0) {
+			if (errno == EINTR)
+				continue;
+			return SLURM_ERROR;
+		}
+		size -= amount;
+		data += amount;
+	}
+	return SLURM_SUCCESS;
+}
+
+/* RET SLURM_SUCCESS, 0 bytes read at end of file or SLURM_ERROR */
+static int _read_all(int fd, char *data, uint32_t size, bool *eof)
+{
+	int amount;
+	uint32_t got = 0;
+
+	*eof = false;
+	while (got < size) {
+		amount = read(fd, data + got, size - got);
+		if (amount < 0) {
+			if (errno == EINTR)
+				continue;
+			return SLURM_ERROR;
+		} else if (amount == 0) {
+			if (!got) {
+				*eof = true;
+				return SLURM_SUCCESS;
+			}
+			errno = EIO;	/* truncated */
+			return SLURM_ERROR;
+		}
+		got += amount;
+	}
+	return SLURM_SUCCESS;
+}
+
+extern archive_stream_t *archive_stream_open(char *cluster_name,
+					     time_t period_start,
+					     time_t period_end,
+					     char *arch_dir, char *arch_type,
+					     uint32_t archive_period)
+{
+	archive_stream_t *stream = xmalloc(sizeof(archive_stream_t));
+
+	stream->reg_file = _make_archive_name(period_start, period_end,
+					      cluster_name, arch_dir,
+					      arch_type, archive_period);
+	stream->new_file = xstrdup_printf("%s.new", stream->reg_file);
+
+	debug("Storing %s archive for %s at %s",
+	      arch_type, cluster_name, stream->reg_file);
+	stream->fd = creat(stream->new_file, 0600);
+	if (stream->fd < 0) {
+		error("Can't save archive, create file %s error %m",
+		      stream->new_file);
+	} else if (_write_all(stream->fd, ARCHIVE_STREAM_MAGIC,
+			      strlen(ARCHIVE_STREAM_MAGIC))) {
+		error("Error writing file %s, %m", stream->new_file);
+		close(stream->fd);
+		(void) unlink(stream->new_file);
+		stream->fd = -1;
+	}
+	stream->size = strlen(ARCHIVE_STREAM_MAGIC);
+	if (stream->fd < 0) {
+		xfree(stream->new_file);
+		xfree(stream->reg_file);
+		xfree(stream);
+	}
+	return stream;
+}
+
+extern int archive_stream_write(archive_stream_t *stream, Buf buffer)
+{
+	uint32_t header[3];
+	uint32_t data_size = get_buf_offset(buffer);
+	char *data = get_buf_data(buffer), *stored = data;
+	int rc = SLURM_SUCCESS;
+#ifdef HAVE_ZLIB_H
+	uLongf zsize = compressBound(data_size);
+	char *zdata = xmalloc(zsize);
+
+	if (compress2((Bytef *) zdata, &zsize, (Bytef *) data, data_size,
+		      Z_DEFAULT_COMPRESSION) == Z_OK) {
+		header[0] = htonl(ARCHIVE_BLOCK_ZLIB);
+		header[1] = htonl(zsize);
+		stored = zdata;
+	} else {
+		header[0] = htonl(ARCHIVE_BLOCK_RAW);
+		header[1] = htonl(data_size);
+	}
+#else
+	header[0] = htonl(ARCHIVE_BLOCK_RAW);
+	header[1] = htonl(data_size);
+#endif
+	header[2] = htonl(data_size);
+
+	/* on disk before the caller deletes the rows it holds */
+	if (_write_all(stream->fd, (char *) header, sizeof(header)) ||
+	    _write_all(stream->fd, stored, ntohl(header[1])) ||
+	    fsync(stream->fd)) {
+		error("Error writing file %s, %m", stream->new_file);
+		/* leave no partial block to be read back */
+		if (ftruncate(stream->fd, stream->size))
+			error("Truncate file %s: %m", stream->new_file);
+		rc = SLURM_ERROR;
+	} else {
+		stream->blocks++;
+		stream->data_size += data_size;
+		stream->stored_size += ntohl(header[1]);
+		stream->size += sizeof(header) + ntohl(header[1]);
+		stream->last_data = data_size;
+		stream->last_stored = ntohl(header[1]);
+	}
+#ifdef HAVE_ZLIB_H
+	xfree(zdata);
+#endif
+	return rc;
+}
+
+extern int archive_stream_undo(archive_stream_t *stream)
+{
+	off_t size;
+
+	if (!stream->last_stored && !stream->last_data)
+		return SLURM_ERROR;
+	size = stream->size - (3 * sizeof(uint32_t)) - stream->last_stored;
+	if (ftruncate(stream->fd, size) || fsync(stream->fd)) {
+		error("Truncate file %s: %m", stream->new_file);
+		return SLURM_ERROR;
+	}
+	stream->size = size;
+	stream->blocks--;
+	stream->data_size -= stream->last_data;
+	stream->stored_size -= stream->last_stored;
+	stream->last_data = stream->last_stored = 0;
+	return SLURM_SUCCESS;
+}
+
+extern int archive_stream_close(archive_stream_t *stream, bool keep)
+{
+	char *old_file;
+	int rc = SLURM_SUCCESS;
+
+	if (!stream)
+		return SLURM_SUCCESS;
+
+	close(stream->fd);
+	if (!keep) {
+		(void) unlink(stream->new_file);
+		goto fini;
+	}
 
+	debug("Archive %s has %u blocks, %"PRIu64" bytes stored of %"PRIu64,
+	      stream->reg_file, stream->blocks, stream->stored_size,
+	      stream->data_size);
+	old_file = xstrdup_printf("%s.old", stream->reg_file);
+	slurm_mutex_lock(&archive_file_lock);
+	/* file shuffle */
+	(void) unlink(old_file);
+	if (link(stream->reg_file, old_file))
+		debug4("Link(%s, %s): %m", stream->reg_file, old_file);
+	(void) unlink(stream->reg_file);
+	if (link(stream->new_file, stream->reg_file)) {
+		error("Link(%s, %s): %m, archive left in %s",
+		      stream->new_file, stream->reg_file, stream->new_file);
+		rc = SLURM_ERROR;
+	} else
+		(void) unlink(stream->new_file);
+	slurm_mutex_unlock(&archive_file_lock);
+	xfree(old_file);
+
+fini:
+	xfree(stream->new_file);
+	xfree(stream->reg_file);
+	xfree(stream);
 	return rc;
 }
+
+extern bool archive_stream_check(int fd)
+{
+	char magic[sizeof(ARCHIVE_STREAM_MAGIC)];
+	uint32_t size = strlen(ARCHIVE_STREAM_MAGIC);
+	bool eof;
+
+	if (!_read_all(fd, magic, size, &eof) && !eof &&
+	    !memcmp(magic, ARCHIVE_STREAM_MAGIC, size))
+		return true;
+
+	(void) lseek(fd, 0, SEEK_SET);
+	return false;
+}
+
+extern int archive_stream_read(int fd, Buf *buffer)
+{
+	uint32_t header[3], type, stored_size, data_size;
+	char *stored = NULL, *data = NULL;
+	bool eof;
+
+	*buffer = NULL;
+	if (_read_all(fd, (char *) header, sizeof(header), &eof))
+		goto read_error;
+	if (eof)
+		return SLURM_SUCCESS;
+
+	type = ntohl(header[0]);
+	stored_size = ntohl(header[1]);
+	data_size = ntohl(header[2]);
+	if ((stored_size > MAX_BUF_SIZE) || (data_size > MAX_BUF_SIZE)) {
+		error("Archive block of %u bytes is too large", data_size);
+		return SLURM_ERROR;
+	}
+
+	stored = xmalloc(stored_size + 1);
+	if (_read_all(fd, stored, stored_size, &eof) ||
+	    (eof && stored_size)) {
+		xfree(stored);
+		goto read_error;
+	}
+
+	if ((type == ARCHIVE_BLOCK_RAW) && (stored_size == data_size)) {
+		data = stored;
+#ifdef HAVE_ZLIB_H
+	} else if (type == ARCHIVE_BLOCK_ZLIB) {
+		uLongf size = data_size;
+
+		data = xmalloc(data_size + 1);
+		if ((uncompress((Bytef *) data, &size, (Bytef *) stored,
+				stored_size) != Z_OK) || (size != data_size)) {
+			error("Archive block is corrupt");
+			xfree(data);
+			xfree(stored);
+			return SLURM_ERROR;
+		}
+		xfree(stored);
+#endif
+	} else {
+		error("Archive block of type %u size %u/%u can not be read, "
+		      "compressed archives need zlib", type, stored_size,
+		      data_size);
+		xfree(stored);
+		return SLURM_ERROR;
+	}
+
+	*buffer = create_buf(data, data_size);
+	return SLURM_SUCCESS;
+
+read_error:
+	error("Read error on archive: %m");
+	return SLURM_ERROR;
+}
@@ -86,4 +86,45 @@ extern int archive_write_file(Buf buffer, char *cluster_name,
 			      char *arch_dir, char *arch_type,
 			      uint32_t archive_period);
 
+/*
+ * An archive stream is written a chunk of records at a time, each chunk a
+ * buffer in the same layout as given to archive_write_file(), so a large
+ * archive is never held in memory whole.
+ */
+typedef struct archive_stream archive_stream_t;
+
+/* archive_stream_open - create the archive file for a period, the name as
+ *	used by archive_write_file() with ".new" appended until closed
+ * RET stream or NULL on error */
+extern archive_stream_t *archive_stream_open(char *cluster_name,
+					     time_t period_start,
+					     time_t period_end,
+					     char *arch_dir, char *arch_type,
+					     uint32_t archive_period);
+
+/* archive_stream_write - append a buffer to the stream, compressed if zlib
+ *	is available, and sync it to disk
+ * RET SLURM_SUCCESS or SLURM_ERROR */
+extern int archive_stream_write(archive_stream_t *stream, Buf buffer);
+
+/* archive_stream_undo - remove the last block written to the stream, only
+ *	one block can be removed after each archive_stream_write()
+ * RET SLURM_SUCCESS or SLURM_ERROR */
+extern int archive_stream_undo(archive_stream_t *stream);
+
+/* archive_stream_close - close and free a stream
+ * IN keep - move the file into place if set, else remove it
+ * RET SLURM_SUCCESS or SLURM_ERROR */
+extern int archive_stream_close(archive_stream_t *stream, bool keep);
+
+/* archive_stream_check - read the start of an open archive file
+ * RET true if it is an archive stream, positioned at its first block,
+ *	false with the file rewound otherwise */
+extern bool archive_stream_check(int fd);
+
+/* archive_stream_read - read the next block of an archive stream
+ * OUT buffer - the block, free with free_buf(), NULL at end of file
+ * RET SLURM_SUCCESS or SLURM_ERROR */
+extern int archive_stream_read(int fd, Buf *buffer);
+
 #endif
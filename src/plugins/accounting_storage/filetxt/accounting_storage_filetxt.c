@@ -963,6 +963,8 @@ extern int jobacct_storage_p_suspend(void *db_conn,
 extern List jobacct_storage_p_get_jobs_cond(void *db_conn, uid_t uid,
 					    slurmdb_job_cond_t *job_cond)
 {
+	if (job_cond)
+		job_cond->page_size = 0;	/* every job at once */
 	return filetxt_jobacct_process_get_jobs(job_cond);
 }
 
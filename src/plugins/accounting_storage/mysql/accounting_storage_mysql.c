@@ -120,6 +120,15 @@ static char *mysql_db_name = NULL;
 
 #define DELETE_SEC_BACK 86400
 
+/* Database connections released by closed (non-rollback) storage connections
+ * are kept here and handed to the next storage connection opened, so that
+ * short lived clients (sacct, sreport, sacctmgr) do not each pay for a new
+ * login to the database server. */
+#define DB_CONN_POOL_SIZE 16
+static MYSQL *db_conn_pool[DB_CONN_POOL_SIZE];
+static int db_conn_pool_cnt = 0;
+static pthread_mutex_t db_conn_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
 char *acct_coord_table = "acct_coord_table";
 char *acct_table = "acct_table";
 char *assoc_day_table = "assoc_usage_day_table";
@@ -156,6 +165,80 @@ enum {
 
 extern int acct_storage_p_close_connection(mysql_conn_t **mysql_conn);
 
+/* Set up a new database session for a connection
+ * RET SLURM_SUCCESS or an error code */
+static int _db_session_init(mysql_conn_t *mysql_conn)
+{
+	if (mysql_conn->rollback)
+		mysql_autocommit(mysql_conn->db_conn, 0);
+	return mysql_db_query(mysql_conn,
+			      "SET session sql_mode='ANSI_QUOTES';");
+}
+
+/* Ping the database. With MYSQL_OPT_RECONNECT the client library quietly
+ * opens a new session if the old one was lost, losing its sql_mode, its
+ * autocommit setting and any uncommitted changes.
+ * RET 0 if the session is alive, 1 if it was replaced, -1 on error */
+static int _db_ping(mysql_conn_t *mysql_conn)
+{
+	unsigned long thread_id = mysql_thread_id(mysql_conn->db_conn);
+
+	if (mysql_db_ping(mysql_conn) != 0)
+		return -1;
+	if (mysql_thread_id(mysql_conn->db_conn) != thread_id)
+		return 1;
+	return 0;
+}
+
+/* Take a database connection from the pool and verify it is still usable
+ * RET true if mysql_conn->db_conn was set */
+static bool _db_conn_pool_get(mysql_conn_t *mysql_conn)
+{
+	MYSQL *db_conn;
+
+	while (1) {
+		slurm_mutex_lock(&db_conn_pool_lock);
+		if (db_conn_pool_cnt == 0) {
+			slurm_mutex_unlock(&db_conn_pool_lock);
+			return false;
+		}
+		db_conn = db_conn_pool[--db_conn_pool_cnt];
+		slurm_mutex_unlock(&db_conn_pool_lock);
+
+		mysql_conn->db_conn = db_conn;
+		switch (_db_ping(mysql_conn)) {
+		case 0:
+			return true;
+		case 1:
+			if (_db_session_init(mysql_conn) == SLURM_SUCCESS)
+				return true;
+			break;
+		}
+		debug2("discarding stale pooled database connection");
+		mysql_close(db_conn);
+		mysql_conn->db_conn = NULL;
+	}
+}
+
+/* Return a connection's database connection to the pool
+ * RET true if the pool took it, false if it should be closed */
+static bool _db_conn_pool_put(mysql_conn_t *mysql_conn)
+{
+	bool rc = false;
+
+	if (!mysql_conn->db_conn || mysql_conn->rollback)
+		return false;
+
+	slurm_mutex_lock(&db_conn_pool_lock);
+	if (db_conn_pool_cnt < DB_CONN_POOL_SIZE) {
+		db_conn_pool[db_conn_pool_cnt++] = mysql_conn->db_conn;
+		mysql_conn->db_conn = NULL;
+		rc = true;
+	}
+	slurm_mutex_unlock(&db_conn_pool_lock);
+	return rc;
+}
+
 static List _get_cluster_names(mysql_conn_t *mysql_conn, bool with_deleted)
 {
 	MYSQL_RES *result = NULL;
@@ -776,26 +859,43 @@ extern int check_connection(mysql_conn_t *mysql_conn)
 		error("We need a connection to run this");
 		errno = SLURM_ERROR;
 		return SLURM_ERROR;
-	} else if (mysql_db_ping(mysql_conn) != 0) {
+	}
+
+	/* slurmdbd services a connection from whichever worker thread is
+	 * free, so the calling thread may not have used the client library
+	 * yet. This is a no-op if it already has. */
+	if (mysql_thread_safe())
+		mysql_thread_init();
+
+	switch (_db_ping(mysql_conn)) {
+	case 0:
+		break;
+	case 1:
+		/* The client library reconnected, set up the new session */
+		if (_db_session_init(mysql_conn) != SLURM_SUCCESS) {
+			error("couldn't set sql_mode on reconnect");
+			errno = ESLURM_DB_CONNECTION;
+			return ESLURM_DB_CONNECTION;
+		}
+		if (mysql_conn->rollback) {
+			error("database connection lost, "
+			      "uncommitted changes were discarded");
+			errno = ESLURM_DB_CONNECTION;
+			return ESLURM_DB_CONNECTION;
+		}
+		break;
+	default:
 		if (mysql_db_get_db_connection(
 			    mysql_conn, mysql_db_name, mysql_db_info)
 		    != SLURM_SUCCESS) {
 			error("unable to re-connect to as_mysql database");
 			errno = ESLURM_DB_CONNECTION;
 			return ESLURM_DB_CONNECTION;
-		} else {
-			int rc;
-			if (mysql_conn->rollback)
-				mysql_autocommit(mysql_conn->db_conn, 0);
-			rc = mysql_db_query(mysql_conn,
-					    "SET session "
-					    "sql_mode='ANSI_QUOTES';");
-			if (rc != SLURM_SUCCESS) {
-				error("couldn't set sql_mode on reconnect");
-				acct_storage_p_close_connection(&mysql_conn);
-				errno = ESLURM_DB_CONNECTION;
-				return ESLURM_DB_CONNECTION;
-			}
+		} else if (_db_session_init(mysql_conn) != SLURM_SUCCESS) {
+			error("couldn't set sql_mode on reconnect");
+			acct_storage_p_close_connection(&mysql_conn);
+			errno = ESLURM_DB_CONNECTION;
+			return ESLURM_DB_CONNECTION;
 		}
 	}
 
@@ -2133,6 +2233,10 @@ extern int fini ( void )
 	}
 	slurm_mutex_unlock(&as_mysql_cluster_list_lock);
 	slurm_mutex_destroy(&as_mysql_cluster_list_lock);
+	slurm_mutex_lock(&db_conn_pool_lock);
+	while (db_conn_pool_cnt)
+		mysql_close(db_conn_pool[--db_conn_pool_cnt]);
+	slurm_mutex_unlock(&db_conn_pool_lock);
 	destroy_mysql_db_info(mysql_db_info);
 	xfree(mysql_db_name);
 	xfree(default_qos_str);
@@ -2157,14 +2261,13 @@ extern void *acct_storage_p_get_connection(const slurm_trigger_callbacks_t *cb,
 		fatal("couldn't get a mysql_conn");
 
 	errno = SLURM_SUCCESS;
+	if (!rollback && _db_conn_pool_get(mysql_conn))
+		return (void *)mysql_conn;
+
 	mysql_db_get_db_connection(mysql_conn, mysql_db_name, mysql_db_info);
 
        	if (mysql_conn->db_conn) {
-		int rc;
-		if (rollback)
-			mysql_autocommit(mysql_conn->db_conn, 0);
-		rc = mysql_db_query(mysql_conn,
-				    "SET session sql_mode='ANSI_QUOTES';");
+		int rc = _db_session_init(mysql_conn);
 		if (rc != SLURM_SUCCESS) {
 			error("couldn't set sql_mode");
 			acct_storage_p_close_connection(&mysql_conn);
@@ -2184,6 +2287,7 @@ extern int acct_storage_p_close_connection(mysql_conn_t **mysql_conn)
 		return SLURM_SUCCESS;
 
 	acct_storage_p_commit((*mysql_conn), 0);
+	_db_conn_pool_put(*mysql_conn);
 	rc = destroy_mysql_conn(*mysql_conn);
 	*mysql_conn = NULL;
 
@@ -46,6 +46,9 @@
 #include "src/common/slurmdbd_defs.h"
 #include "src/common/env.h"
 
+/* rows archived and purged at a time, between which other queries run */
+#define MAX_PURGE_LIMIT 50000
+
 typedef struct {
 	char *cluster_nodes;
 	char *cpu_count;
@@ -1148,46 +1151,14 @@ static int _process_old_sql(char **data)
 	return rc;
 }
 
-/* returns count of events archived or SLURM_ERROR on error */
-static uint32_t _archive_events(mysql_conn_t *mysql_conn, char *cluster_name,
-				time_t period_end, char *arch_dir,
-				uint32_t archive_period)
+/* pack a chunk of events selected for archiving into a buffer in the
+ * archive file layout, the start time of the first in period_start */
+static Buf _pack_archive_events(MYSQL_RES *result, char *cluster_name,
+				uint32_t cnt, time_t *period_start)
 {
-	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
-	char *tmp = NULL, *query = NULL;
-	time_t period_start = 0;
-	uint32_t cnt = 0;
 	local_event_t event;
 	Buf buffer;
-	int error_code = 0, i = 0;
-
-	xfree(tmp);
-	xstrfmtcat(tmp, "%s", event_req_inx[0]);
-	for(i=1; i<EVENT_REQ_COUNT; i++) {
-		xstrfmtcat(tmp, ", %s", event_req_inx[i]);
-	}
-
-	/* get all the events started before this time listed */
-	query = xstrdup_printf("select %s from \"%s_%s\" where "
-			       "time_start <= %ld "
-			       "&& time_end != 0 order by time_start asc",
-			       tmp, cluster_name, event_table, period_end);
-	xfree(tmp);
-
-//	START_TIMER;
-	debug3("%d(%s:%d) query\n%s",
-	       mysql_conn->conn, THIS_FILE, __LINE__, query);
-	if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
-		xfree(query);
-		return SLURM_ERROR;
-	}
-	xfree(query);
-
-	if (!(cnt = mysql_num_rows(result))) {
-		mysql_free_result(result);
-		return 0;
-	}
 
 	buffer = init_buf(high_buffer_size);
 	pack16(SLURMDBD_VERSION, buffer);
@@ -1197,8 +1168,8 @@ static uint32_t _archive_events(mysql_conn_t *mysql_conn, char *cluster_name,
 	pack32(cnt, buffer);
 
 	while ((row = mysql_fetch_row(result))) {
-		if (!period_start)
-			period_start = slurm_atoul(row[EVENT_REQ_START]);
+		if (!*period_start)
+			*period_start = slurm_atoul(row[EVENT_REQ_START]);
 
 		memset(&event, 0, sizeof(local_event_t));
 
@@ -1213,20 +1184,7 @@ static uint32_t _archive_events(mysql_conn_t *mysql_conn, char *cluster_name,
 
 		_pack_local_event(&event, SLURMDBD_VERSION, buffer);
 	}
-	mysql_free_result(result);
-
-//	END_TIMER2("step query");
-//	info("event query took %s", TIME_STR);
-
-	error_code = archive_write_file(buffer, cluster_name,
-					period_start, period_end,
-					arch_dir, "event", archive_period);
-	free_buf(buffer);
-
-	if (error_code != SLURM_SUCCESS)
-		return error_code;
-
-	return cnt;
+	return buffer;
 }
 
 /* returns sql statement from archived data or NULL on error */
@@ -1277,46 +1235,14 @@ _load_events(uint16_t rpc_version, Buf buffer, char *cluster_name,
 	return insert;
 }
 
-/* returns count of jobs archived or SLURM_ERROR on error */
-static uint32_t _archive_jobs(mysql_conn_t *mysql_conn, char *cluster_name,
-			      time_t period_end, char *arch_dir,
-			      uint32_t archive_period)
+/* pack a chunk of jobs selected for archiving into a buffer in the
+ * archive file layout, the start time of the first in period_start */
+static Buf _pack_archive_jobs(MYSQL_RES *result, char *cluster_name,
+			      uint32_t cnt, time_t *period_start)
 {
-	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
-	char *tmp = NULL, *query = NULL;
-	time_t period_start = 0;
-	uint32_t cnt = 0;
 	local_job_t job;
 	Buf buffer;
-	int error_code = 0, i = 0;
-
-	xfree(tmp);
-	xstrfmtcat(tmp, "%s", job_req_inx[0]);
-	for(i=1; i<JOB_REQ_COUNT; i++) {
-		xstrfmtcat(tmp, ", %s", job_req_inx[i]);
-	}
-
-	/* get all the events started before this time listed */
-	query = xstrdup_printf("select %s from \"%s_%s\" where "
-			       "time_submit < %ld && time_end != 0 && !deleted "
-			       "order by time_submit asc",
-			       tmp, cluster_name, job_table, period_end);
-	xfree(tmp);
-
-//	START_TIMER;
-	debug3("%d(%s:%d) query\n%s",
-	       mysql_conn->conn, THIS_FILE, __LINE__, query);
-	if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
-		xfree(query);
-		return SLURM_ERROR;
-	}
-	xfree(query);
-
-	if (!(cnt = mysql_num_rows(result))) {
-		mysql_free_result(result);
-		return 0;
-	}
 
 	buffer = init_buf(high_buffer_size);
 	pack16(SLURMDBD_VERSION, buffer);
@@ -1326,8 +1252,8 @@ static uint32_t _archive_jobs(mysql_conn_t *mysql_conn, char *cluster_name,
 	pack32(cnt, buffer);
 
 	while ((row = mysql_fetch_row(result))) {
-		if (!period_start)
-			period_start = slurm_atoul(row[JOB_REQ_SUBMIT]);
+		if (!*period_start)
+			*period_start = slurm_atoul(row[JOB_REQ_SUBMIT]);
 
 		memset(&job, 0, sizeof(local_job_t));
 
@@ -1365,20 +1291,7 @@ static uint32_t _archive_jobs(mysql_conn_t *mysql_conn, char *cluster_name,
 
 		_pack_local_job(&job, SLURMDBD_VERSION, buffer);
 	}
-	mysql_free_result(result);
-
-//	END_TIMER2("step query");
-//	info("event query took %s", TIME_STR);
-
-	error_code = archive_write_file(buffer, cluster_name,
-					period_start, period_end,
-					arch_dir, "job", archive_period);
-	free_buf(buffer);
-
-	if (error_code != SLURM_SUCCESS)
-		return error_code;
-
-	return cnt;
+	return buffer;
 }
 
 /* returns sql statement from archived data or NULL on error */
@@ -1451,46 +1364,14 @@ static char *_load_jobs(uint16_t rpc_version, Buf buffer,
 	return insert;
 }
 
-/* returns count of steps archived or SLURM_ERROR on error */
-static uint32_t _archive_steps(mysql_conn_t *mysql_conn, char *cluster_name,
-			       time_t period_end, char *arch_dir,
-			       uint32_t archive_period)
+/* pack a chunk of steps selected for archiving into a buffer in the
+ * archive file layout, the start time of the first in period_start */
+static Buf _pack_archive_steps(MYSQL_RES *result, char *cluster_name,
+			       uint32_t cnt, time_t *period_start)
 {
-	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
-	char *tmp = NULL, *query = NULL;
-	time_t period_start = 0;
-	uint32_t cnt = 0;
 	local_step_t step;
 	Buf buffer;
-	int error_code = 0, i = 0;
-
-	xfree(tmp);
-	xstrfmtcat(tmp, "%s", step_req_inx[0]);
-	for(i=1; i<STEP_REQ_COUNT; i++) {
-		xstrfmtcat(tmp, ", %s", step_req_inx[i]);
-	}
-
-	/* get all the events started before this time listed */
-	query = xstrdup_printf("select %s from \"%s_%s\" where "
-			       "time_start <= %ld && time_end != 0 "
-			       "&& !deleted order by time_start asc",
-			       tmp, cluster_name, step_table, period_end);
-	xfree(tmp);
-
-//	START_TIMER;
-	debug3("%d(%s:%d) query\n%s",
-	       mysql_conn->conn, THIS_FILE, __LINE__, query);
-	if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
-		xfree(query);
-		return SLURM_ERROR;
-	}
-	xfree(query);
-
-	if (!(cnt = mysql_num_rows(result))) {
-		mysql_free_result(result);
-		return 0;
-	}
 
 	buffer = init_buf(high_buffer_size);
 	pack16(SLURMDBD_VERSION, buffer);
@@ -1500,8 +1381,8 @@ static uint32_t _archive_steps(mysql_conn_t *mysql_conn, char *cluster_name,
 	pack32(cnt, buffer);
 
 	while ((row = mysql_fetch_row(result))) {
-		if (!period_start)
-			period_start = slurm_atoul(row[STEP_REQ_START]);
+		if (!*period_start)
+			*period_start = slurm_atoul(row[STEP_REQ_START]);
 
 		memset(&step, 0, sizeof(local_step_t));
 
@@ -1545,20 +1426,7 @@ static uint32_t _archive_steps(mysql_conn_t *mysql_conn, char *cluster_name,
 
 		_pack_local_step(&step, SLURMDBD_VERSION, buffer);
 	}
-	mysql_free_result(result);
-
-//	END_TIMER2("step query");
-//	info("event query took %s", TIME_STR);
-
-	error_code = archive_write_file(buffer, cluster_name,
-					period_start, period_end,
-					arch_dir, "step", archive_period);
-	free_buf(buffer);
-
-	if (error_code != SLURM_SUCCESS)
-		return error_code;
-
-	return cnt;
+	return buffer;
 }
 
 /* returns sql statement from archived data or NULL on error */
@@ -1637,46 +1505,14 @@ static char *_load_steps(uint16_t rpc_version, Buf buffer,
 	return insert;
 }
 
-/* returns count of events archived or SLURM_ERROR on error */
-static uint32_t _archive_suspend(mysql_conn_t *mysql_conn, char *cluster_name,
-				 time_t period_end, char *arch_dir,
-				 uint32_t archive_period)
+/* pack a chunk of suspends selected for archiving into a buffer in the
+ * archive file layout, the start time of the first in period_start */
+static Buf _pack_archive_suspend(MYSQL_RES *result, char *cluster_name,
+				 uint32_t cnt, time_t *period_start)
 {
-	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
-	char *tmp = NULL, *query = NULL;
-	time_t period_start = 0;
-	uint32_t cnt = 0;
 	local_suspend_t suspend;
 	Buf buffer;
-	int error_code = 0, i = 0;
-
-	xfree(tmp);
-	xstrfmtcat(tmp, "%s", suspend_req_inx[0]);
-	for(i=1; i<SUSPEND_REQ_COUNT; i++) {
-		xstrfmtcat(tmp, ", %s", suspend_req_inx[i]);
-	}
-
-	/* get all the events started before this time listed */
-	query = xstrdup_printf("select %s from \"%s_%s\" where "
-			       "time_start <= %ld && time_end != 0 "
-			       "order by time_start asc",
-			       tmp, cluster_name, suspend_table, period_end);
-	xfree(tmp);
-
-//	START_TIMER;
-	debug3("%d(%s:%d) query\n%s",
-	       mysql_conn->conn, THIS_FILE, __LINE__, query);
-	if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
-		xfree(query);
-		return SLURM_ERROR;
-	}
-	xfree(query);
-
-	if (!(cnt = mysql_num_rows(result))) {
-		mysql_free_result(result);
-		return 0;
-	}
 
 	buffer = init_buf(high_buffer_size);
 	pack16(SLURMDBD_VERSION, buffer);
@@ -1686,8 +1522,8 @@ static uint32_t _archive_suspend(mysql_conn_t *mysql_conn, char *cluster_name,
 	pack32(cnt, buffer);
 
 	while ((row = mysql_fetch_row(result))) {
-		if (!period_start)
-			period_start = slurm_atoul(row[SUSPEND_REQ_START]);
+		if (!*period_start)
+			*period_start = slurm_atoul(row[SUSPEND_REQ_START]);
 
 		memset(&suspend, 0, sizeof(local_suspend_t));
 
@@ -1698,20 +1534,7 @@ static uint32_t _archive_suspend(mysql_conn_t *mysql_conn, char *cluster_name,
 
 		_pack_local_suspend(&suspend, SLURMDBD_VERSION, buffer);
 	}
-	mysql_free_result(result);
-
-//	END_TIMER2("step query");
-//	info("event query took %s", TIME_STR);
-
-	error_code = archive_write_file(buffer, cluster_name,
-					period_start, period_end,
-					arch_dir, "suspend", archive_period);
-	free_buf(buffer);
-
-	if (error_code != SLURM_SUCCESS)
-		return error_code;
-
-	return cnt;
+	return buffer;
 }
 
 /* returns sql statement from archived data or NULL on error */
@@ -1757,170 +1580,331 @@ static char *_load_suspend(uint16_t rpc_version, Buf buffer,
 	return insert;
 }
 
-static int _execute_archive(mysql_conn_t *mysql_conn,
-			    char *cluster_name,
-			    slurmdb_archive_cond_t *arch_cond)
+/*
+ * Describes how to archive and purge one table.  Rows are taken MAX_PURGE_LIMIT
+ * at a time in the order of the table's primary key, each chunk starting past
+ * the last key of the one before, so a chunk reads only its own rows through
+ * the key rather than scanning the table.  The select locks the rows it reads
+ * (and under REPEATABLE READ the gaps between them) until the chunk is
+ * committed, and the delete is limited to the key range just read, so each
+ * delete removes exactly the rows just written out.
+ */
+#define MAX_ARCHIVE_KEY 2
+
+typedef struct {
+	char *arch_type;	/* name used in the archive file */
+	char **table;
+	char *cond;		/* rows to purge, given the purge end time */
+	char *key[MAX_ARCHIVE_KEY]; /* primary key, the order rows are taken */
+	int key_cnt;
+	bool has_deleted;	/* has a deleted column, deleted rows are purged
+				 * but not archived */
+	char **req_inx;
+	int req_cnt;
+	Buf (*pack)(MYSQL_RES *result, char *cluster_name, uint32_t cnt,
+		    time_t *period_start);
+} archive_table_t;
+
+static archive_table_t event_archive = {
+	"event", &event_table, "time_start <= %ld && time_end != 0",
+	{ "node_name", "time_start" }, 2, false,
+	event_req_inx, EVENT_REQ_COUNT, _pack_archive_events
+};
+/* NOTE: The suspend table has no key, each chunk scans it. It only has
+ * rows for jobs which were suspended, so is small. */
+static archive_table_t suspend_archive = {
+	"suspend", &suspend_table, "time_start <= %ld && time_end != 0",
+	{ "job_db_inx", "time_start" }, 2, false,
+	suspend_req_inx, SUSPEND_REQ_COUNT, _pack_archive_suspend
+};
+static archive_table_t step_archive = {
+	"step", &step_table, "time_start <= %ld && time_end != 0",
+	{ "job_db_inx", "id_step" }, 2, true,
+	step_req_inx, STEP_REQ_COUNT, _pack_archive_steps
+};
+static archive_table_t job_archive = {
+	"job", &job_table, "time_submit <= %ld && time_end != 0",
+	{ "job_db_inx" }, 1, true,
+	job_req_inx, JOB_REQ_COUNT, _pack_archive_jobs
+};
+
+/* Return the condition for rows with a key before ("<", "<=") or after
+ * (">", ">=") the key given, in the order of the key's columns */
+static char *_key_cond(archive_table_t *arch, char **key, char *op)
 {
-	int rc = SLURM_SUCCESS;
-	char *query = NULL;
-	time_t curr_end;
-	time_t last_submit = time(NULL);
+	char *cond = NULL, *strict = (op[0] == '<') ? "<" : ">";
+	int i, j;
+
+	xstrcat(cond, "(");
+	for (i = 0; i < arch->key_cnt; i++) {
+		xstrcat(cond, i ? " || (" : "(");
+		for (j = 0; j < i; j++)
+			xstrfmtcat(cond, "%s = '%s' && ", arch->key[j], key[j]);
+		xstrfmtcat(cond, "%s %s '%s')", arch->key[i],
+			   (i == arch->key_cnt - 1) ? op : strict, key[i]);
+	}
+	xstrcat(cond, ")");
+	return cond;
+}
 
-	if (arch_cond->archive_script)
-		return archive_run_script(arch_cond, cluster_name, last_submit);
-	else if (!arch_cond->archive_dir) {
-		error("No archive dir given, can't process");
-		return SLURM_ERROR;
+/* Copy the key of the row at index inx of result, quoted for a query */
+static void _get_key(archive_table_t *arch, MYSQL_RES *result,
+		     my_ulonglong inx, int key_col, char **key)
+{
+	MYSQL_ROW row;
+	int i;
+
+	mysql_data_seek(result, inx);
+	row = mysql_fetch_row(result);
+	for (i = 0; i < arch->key_cnt; i++) {
+		xfree(key[i]);
+		key[i] = slurm_add_slash_to_quotes(row[key_col + i]);
 	}
+}
 
-	if (arch_cond->purge_event != NO_VAL) {
-		/* remove all data from event table that was older than
-		 * period_start * arch_cond->purge_event.
-		 */
-		if (!(curr_end = archive_setup_end_time(
-			      last_submit, arch_cond->purge_event))) {
-			error("Parsing purge event");
-			return SLURM_ERROR;
-		}
+/*
+ * Archive, if requested, and purge the rows of a table matching cond, a
+ * chunk at a time.  Each chunk is written to the archive stream and synced
+ * before it is deleted, then committed before the next is read, so no lock
+ * is held for longer than one chunk takes.  If a chunk can not be deleted it
+ * is taken back out of the archive, which keeps only the rows purged.
+ * RET count of rows purged or -1 on error
+ */
+static int _archive_rows(mysql_conn_t *mysql_conn, char *cluster_name,
+			 archive_table_t *arch, char *cond, bool archive,
+			 time_t period_end, char *arch_dir,
+			 uint32_t archive_period)
+{
+	MYSQL_RES *result = NULL;
+	MYSQL_ROW row;
+	archive_stream_t *stream = NULL;
+	char *cols = NULL, *order = NULL, *query = NULL, *bound = NULL;
+	char *after = NULL, *from = NULL, *to = NULL;
+	char *first[MAX_ARCHIVE_KEY], *last[MAX_ARCHIVE_KEY];
+	time_t period_start = 0;
+	uint32_t cnt;
+	int deleted, i, key_col = 0, total = 0, rc = SLURM_SUCCESS;
+	bool written = false;
+	Buf buffer = NULL;
+
+	/* Find the last key to purge with a plain read which locks
+	 * nothing, so no chunk reads, and locks, the newer rows past it */
+	query = xstrdup_printf("select max(%s) from \"%s_%s\" where %s",
+			       arch->key[0], cluster_name, *arch->table, cond);
+	debug3("%d(%s:%d) query\n%s",
+	       mysql_conn->conn, THIS_FILE, __LINE__, query);
+	result = mysql_db_query_ret(mysql_conn, query, 0);
+	xfree(query);
+	if (!result)
+		return -1;
+	if ((row = mysql_fetch_row(result)) && row[0]) {
+		char *max_key = slurm_add_slash_to_quotes(row[0]);
+		bound = xstrdup_printf("%s <= '%s'", arch->key[0], max_key);
+		xfree(max_key);
+	}
+	mysql_free_result(result);
+	if (!bound)
+		return 0;
 
-		debug4("Purging event entries before %ld for %s",
-		       curr_end, cluster_name);
-
-		if (SLURMDB_PURGE_ARCHIVE_SET(arch_cond->purge_event)) {
-			rc = _archive_events(mysql_conn, cluster_name,
-					     curr_end, arch_cond->archive_dir,
-					     arch_cond->purge_event);
-			if (!rc)
-				goto exit_events;
-			else if (rc == SLURM_ERROR)
-				return rc;
-		}
-		query = xstrdup_printf("delete from \"%s_%s\" where "
-				       "time_start <= %ld && time_end != 0",
-				       cluster_name, event_table, curr_end);
+	if (archive) {
+		xstrcat(cols, arch->req_inx[0]);
+		for (i = 1; i < arch->req_cnt; i++)
+			xstrfmtcat(cols, ", %s", arch->req_inx[i]);
+		key_col = arch->req_cnt;
+	}
+	for (i = 0; i < arch->key_cnt; i++) {
+		xstrfmtcat(cols, "%s%s", cols ? ", " : "", arch->key[i]);
+		xstrfmtcat(order, "%s%s", order ? ", " : "", arch->key[i]);
+		first[i] = last[i] = NULL;
+	}
+
+	while (1) {
+		/* A plain select reads a snapshot while the delete reads the
+		 * current rows, a row ended in between would be purged
+		 * without being archived. Read the current rows and lock
+		 * them instead. */
+		query = xstrdup_printf("select %s from \"%s_%s\" where %s "
+				       "&& %s%s%s order by %s limit %d "
+				       "for update",
+				       cols, cluster_name, *arch->table, cond,
+				       bound, after ? " && " : "",
+				       after ? after : "", order,
+				       MAX_PURGE_LIMIT);
 		debug3("%d(%s:%d) query\n%s",
 		       mysql_conn->conn, THIS_FILE, __LINE__, query);
-		rc = mysql_db_query(mysql_conn, query);
+		result = mysql_db_query_ret(mysql_conn, query, 0);
 		xfree(query);
-		if (rc != SLURM_SUCCESS) {
-			error("Couldn't remove old event data");
-			return SLURM_ERROR;
+		if (!result) {
+			rc = SLURM_ERROR;
+			break;
 		}
-	}
+		if (!(cnt = mysql_num_rows(result))) {
+			mysql_free_result(result);
+			mysql_db_commit(mysql_conn);
+			break;
+		}
+		_get_key(arch, result, 0, key_col, first);
+		_get_key(arch, result, cnt - 1, key_col, last);
+		mysql_data_seek(result, 0);
+		if (archive)
+			buffer = (arch->pack)(result, cluster_name, cnt,
+					      &period_start);
+		mysql_free_result(result);
 
-exit_events:
+		xfree(after);
+		after = _key_cond(arch, last, ">");
 
-	if (arch_cond->purge_suspend != NO_VAL) {
-		/* remove all data from suspend table that was older than
-		 * period_start * arch_cond->purge_suspend.
-		 */
-		if (!(curr_end = archive_setup_end_time(
-			      last_submit, arch_cond->purge_suspend))) {
-			error("Parsing purge suspend");
-			return SLURM_ERROR;
+		if (archive) {
+			/* the file is named for the first chunk's start */
+			if (!stream && !(stream = archive_stream_open(
+						 cluster_name, period_start,
+						 period_end, arch_dir,
+						 arch->arch_type,
+						 archive_period)))
+				rc = SLURM_ERROR;
+			else
+				rc = archive_stream_write(stream, buffer);
+			free_buf(buffer);
+			if (rc != SLURM_SUCCESS)
+				break;
 		}
 
-		debug4("Purging suspend entries before %ld for %s",
-		       curr_end, cluster_name);
-
-		if (SLURMDB_PURGE_ARCHIVE_SET(arch_cond->purge_suspend)) {
-			rc = _archive_suspend(mysql_conn, cluster_name,
-					      curr_end, arch_cond->archive_dir,
-					      arch_cond->purge_suspend);
-			if (!rc)
-				goto exit_suspend;
-			else if (rc == SLURM_ERROR)
-				return rc;
-		}
-		query = xstrdup_printf("delete from \"%s_%s\" where "
-				       "time_start <= %ld && time_end != 0",
-				       cluster_name, suspend_table, curr_end);
+		from = _key_cond(arch, first, ">=");
+		to = _key_cond(arch, last, "<=");
+		query = xstrdup_printf("delete from \"%s_%s\" where %s "
+				       "&& %s && %s",
+				       cluster_name, *arch->table, cond,
+				       from, to);
+		xfree(from);
+		xfree(to);
 		debug3("%d(%s:%d) query\n%s",
 		       mysql_conn->conn, THIS_FILE, __LINE__, query);
-		rc = mysql_db_query(mysql_conn, query);
+		deleted = mysql_db_delete_affected_rows(mysql_conn, query);
 		xfree(query);
-		if (rc != SLURM_SUCCESS) {
-			error("Couldn't remove old suspend data");
-			return SLURM_ERROR;
+		if ((deleted < 0) ||
+		    (mysql_db_commit(mysql_conn) != SLURM_SUCCESS)) {
+			if (stream && (archive_stream_undo(stream)
+				       != SLURM_SUCCESS))
+				error("Archive of %s records for %s holds "
+				      "%u records which were not purged",
+				      arch->arch_type, cluster_name, cnt);
+			rc = SLURM_ERROR;
+			break;
 		}
+		written = archive;
+		if (deleted != cnt)
+			error("Archived %u %s records for %s but purged %d",
+			      cnt, arch->arch_type, cluster_name, deleted);
+		total += deleted;
+		if (cnt < MAX_PURGE_LIMIT)
+			break;
+	}
+	for (i = 0; i < arch->key_cnt; i++) {
+		xfree(first[i]);
+		xfree(last[i]);
 	}
+	xfree(after);
+	xfree(bound);
+	xfree(cols);
+	xfree(order);
+	if (rc != SLURM_SUCCESS)	/* release the chunk's row locks */
+		mysql_db_rollback(mysql_conn);
+
+	/* keep what was written, its rows have been purged */
+	if (archive_stream_close(stream, written) != SLURM_SUCCESS)
+		rc = SLURM_ERROR;
+	if (rc != SLURM_SUCCESS)
+		return -1;
 
-exit_suspend:
+	return total;
+}
 
-	if (arch_cond->purge_step != NO_VAL) {
-		/* remove all data from step table that was older than
-		 * start * arch_cond->purge_step.
-		 */
-		if (!(curr_end = archive_setup_end_time(
-			      last_submit, arch_cond->purge_step))) {
-			error("Parsing purge step");
-			return SLURM_ERROR;
+/*
+ * Archive, if requested, and purge the rows of a table older than
+ * period_end.
+ * RET count of rows purged or -1 on error
+ */
+static int _archive_table(mysql_conn_t *mysql_conn, char *cluster_name,
+			  archive_table_t *arch, time_t period_end,
+			  bool archive, char *arch_dir, uint32_t archive_period)
+{
+	char *cond = NULL;
+	int deleted, total = 0;
+
+	cond = xstrdup_printf(arch->cond, period_end);
+	if (arch->has_deleted) {
+		/* records removed by the user are not archived */
+		char *deleted_cond = xstrdup_printf("%s && deleted", cond);
+		deleted = _archive_rows(mysql_conn, cluster_name, arch,
+					deleted_cond, false, period_end,
+					arch_dir, archive_period);
+		xfree(deleted_cond);
+		if (deleted < 0) {
+			xfree(cond);
+			return -1;
 		}
+		total += deleted;
+		xstrcat(cond, " && !deleted");
+	}
 
-		debug4("Purging step entries before %ld for %s",
-		       curr_end, cluster_name);
-
-		if (SLURMDB_PURGE_ARCHIVE_SET(arch_cond->purge_step)) {
-			rc = _archive_steps(mysql_conn, cluster_name,
-					    curr_end, arch_cond->archive_dir,
-					    arch_cond->purge_step);
-			if (!rc)
-				goto exit_steps;
-			else if (rc == SLURM_ERROR)
-				return rc;
-		}
+	deleted = _archive_rows(mysql_conn, cluster_name, arch, cond, archive,
+				period_end, arch_dir, archive_period);
+	xfree(cond);
+	if (deleted < 0)
+		return -1;
 
-		query = xstrdup_printf("delete from \"%s_%s\" where "
-				       "time_start <= %ld && time_end != 0",
-				       cluster_name, step_table, curr_end);
-		debug3("%d(%s:%d) query\n%s",
-		       mysql_conn->conn, THIS_FILE, __LINE__, query);
-		rc = mysql_db_query(mysql_conn, query);
-		xfree(query);
-		if (rc != SLURM_SUCCESS) {
-			error("Couldn't remove old step data");
-			return SLURM_ERROR;
-		}
+	return total + deleted;
+}
+
+static int _execute_archive(mysql_conn_t *mysql_conn,
+			    char *cluster_name,
+			    slurmdb_archive_cond_t *arch_cond)
+{
+	archive_table_t *arch[] = { &event_archive, &suspend_archive,
+				    &step_archive, &job_archive };
+	uint32_t purge[] = { arch_cond->purge_event,
+			     arch_cond->purge_suspend,
+			     arch_cond->purge_step,
+			     arch_cond->purge_job };
+	time_t curr_end;
+	time_t last_submit = time(NULL);
+	int i, cnt;
+
+	if (arch_cond->archive_script)
+		return archive_run_script(arch_cond, cluster_name, last_submit);
+	else if (!arch_cond->archive_dir) {
+		error("No archive dir given, can't process");
+		return SLURM_ERROR;
 	}
-exit_steps:
 
-	if (arch_cond->purge_job != NO_VAL) {
-		/* remove all data from job table that was older than
-		 * last_submit * arch_cond->purge_job.
+	for (i = 0; i < sizeof(arch) / sizeof(arch[0]); i++) {
+		if (purge[i] == NO_VAL)
+			continue;
+		/* remove all data from the table that was older than
+		 * last_submit - purge[i].
 		 */
 		if (!(curr_end = archive_setup_end_time(
-			      last_submit, arch_cond->purge_job))) {
-			error("Parsing purge job");
+			      last_submit, purge[i]))) {
+			error("Parsing purge %s", arch[i]->arch_type);
 			return SLURM_ERROR;
 		}
 
-		debug4("Purging job entires before %ld for %s",
-		       curr_end, cluster_name);
-
-		if (SLURMDB_PURGE_ARCHIVE_SET(arch_cond->purge_job)) {
-			rc = _archive_jobs(mysql_conn, cluster_name,
-					   curr_end, arch_cond->archive_dir,
-					   arch_cond->purge_job);
-			if (!rc)
-				goto exit_jobs;
-			else if (rc == SLURM_ERROR)
-				return rc;
-		}
+		debug4("Purging %s entries before %ld for %s",
+		       arch[i]->arch_type, curr_end, cluster_name);
 
-		query = xstrdup_printf("delete from \"%s_%s\" "
-				       "where time_submit <= %ld "
-				       "&& time_end != 0",
-				       cluster_name, job_table, curr_end);
-		debug3("%d(%s:%d) query\n%s",
-		       mysql_conn->conn, THIS_FILE, __LINE__, query);
-		rc = mysql_db_query(mysql_conn, query);
-		xfree(query);
-		if (rc != SLURM_SUCCESS) {
-			error("Couldn't remove old job data");
+		cnt = _archive_table(mysql_conn, cluster_name, arch[i],
+				     curr_end,
+				     SLURMDB_PURGE_ARCHIVE_SET(purge[i]),
+				     arch_cond->archive_dir, purge[i]);
+		if (cnt < 0) {
+			error("Couldn't remove old %s data",
+			      arch[i]->arch_type);
 			return SLURM_ERROR;
 		}
+		debug("Purged %d %s records for %s",
+		      cnt, arch[i]->arch_type, cluster_name);
 	}
-exit_jobs:
+
 	return SLURM_SUCCESS;
 }
 
@@ -1958,15 +1942,104 @@ extern int as_mysql_jobacct_process_archive(mysql_conn_t *mysql_conn,
 	return rc;
 }
 
+/* returns sql statement to load a buffer of archived records or NULL on
+ * error */
+static char *_load_archive_buffer(Buf buffer)
+{
+	char *data = NULL, *cluster_name = NULL;
+	time_t buf_time;
+	uint16_t type = 0, ver = 0;
+	uint32_t rec_cnt = 0, tmp32 = 0;
+
+	safe_unpack16(&ver, buffer);
+	debug3("Version in archive header is %u", ver);
+	if (ver > SLURMDBD_VERSION || ver < SLURMDBD_VERSION_MIN) {
+		error("***********************************************");
+		error("Can not recover archive file, incompatible version, "
+		      "got %u need >= %u <= %u", ver,
+		      SLURMDBD_VERSION_MIN, SLURMDBD_VERSION);
+		error("***********************************************");
+		return NULL;
+	}
+	safe_unpack_time(&buf_time, buffer);
+	safe_unpack16(&type, buffer);
+	unpackstr_ptr(&cluster_name, &tmp32, buffer);
+	safe_unpack32(&rec_cnt, buffer);
+
+	if (!rec_cnt) {
+		error("we didn't get any records from this file of type '%s'",
+		      slurmdbd_msg_type_2_str(type, 0));
+		return NULL;
+	}
+
+	switch(type) {
+	case DBD_GOT_EVENTS:
+		data = _load_events(ver, buffer, cluster_name, rec_cnt);
+		break;
+	case DBD_GOT_JOBS:
+		data = _load_jobs(ver, buffer, cluster_name, rec_cnt);
+		break;
+	case DBD_STEP_START:
+		data = _load_steps(ver, buffer, cluster_name, rec_cnt);
+		break;
+	case DBD_JOB_SUSPEND:
+		data = _load_suspend(ver, buffer, cluster_name, rec_cnt);
+		break;
+	default:
+		error("Unknown type '%u' to load from archive", type);
+		break;
+	}
+	return data;
+
+unpack_error:
+	error("Couldn't unpack archive header");
+	return NULL;
+}
+
+/* load an archive stream a block at a time, committing each block */
+static int _load_archive_stream(mysql_conn_t *mysql_conn, int fd,
+				char *file_name)
+{
+	char *data = NULL;
+	uint32_t blocks = 0;
+	int rc = SLURM_SUCCESS;
+	Buf buffer;
+
+	while ((rc = archive_stream_read(fd, &buffer)) == SLURM_SUCCESS) {
+		if (!buffer)	/* end of file */
+			break;
+		data = _load_archive_buffer(buffer);
+		free_buf(buffer);
+		if (!data) {
+			rc = SLURM_ERROR;
+			break;
+		}
+		debug3("%d(%s:%d) query\n%s",
+		       mysql_conn->conn, THIS_FILE, __LINE__, data);
+		rc = mysql_db_query_check_after(mysql_conn, data);
+		xfree(data);
+		if (rc != SLURM_SUCCESS)
+			break;
+		mysql_db_commit(mysql_conn);
+		blocks++;
+	}
+
+	if (rc != SLURM_SUCCESS) {
+		error("Couldn't load old data from %s, %u blocks loaded",
+		      file_name, blocks);
+		return SLURM_ERROR;
+	}
+	debug("Loaded %u blocks from %s", blocks, file_name);
+	return SLURM_SUCCESS;
+}
+
 extern int as_mysql_jobacct_process_archive_load(
 	mysql_conn_t *mysql_conn, slurmdb_archive_rec_t *arch_rec)
 {
-	char *data = NULL, *cluster_name = NULL;
+	char *data = NULL;
 	int error_code = SLURM_SUCCESS;
 	Buf buffer;
-	time_t buf_time;
-	uint16_t type = 0, ver = 0;
-	uint32_t data_size = 0, rec_cnt = 0, tmp32 = 0;
+	uint32_t data_size = 0;
 
 	if (!arch_rec) {
 		error("We need a slurmdb_archive_rec to load anything.");
@@ -1982,6 +2055,11 @@ extern int as_mysql_jobacct_process_archive_load(
 			info("No archive file (%s) to recover",
 			     arch_rec->archive_file);
 			error_code = ENOENT;
+		} else if (archive_stream_check(state_fd)) {
+			error_code = _load_archive_stream(
+				mysql_conn, state_fd, arch_rec->archive_file);
+			close(state_fd);
+			return error_code;
 		} else {
 			data_allocated = BUF_SIZE;
 			data = xmalloc(data_allocated);
@@ -2031,47 +2109,7 @@ extern int as_mysql_jobacct_process_archive_load(
 	}
 
 	buffer = create_buf(data, data_size);
-
-	safe_unpack16(&ver, buffer);
-	debug3("Version in assoc_mgr_state header is %u", ver);
-	if (ver <= SLURMDBD_VERSION || ver < SLURMDBD_VERSION_MIN) {
-		error("***********************************************");
-		error("Can not recover archive file, incompatible version, "
-		      "got %u need > %u <= %u", ver,
-		      SLURMDBD_VERSION_MIN, SLURMDBD_VERSION);
-		error("***********************************************");
-		free_buf(buffer);
-		return EFAULT;
-	}
-	safe_unpack_time(&buf_time, buffer);
-	safe_unpack16(&type, buffer);
-	unpackstr_ptr(&cluster_name, &tmp32, buffer);
-	safe_unpack32(&rec_cnt, buffer);
-
-	if (!rec_cnt) {
-		error("we didn't get any records from this file of type '%s'",
-		      slurmdbd_msg_type_2_str(type, 0));
-		free_buf(buffer);
-		goto got_sql;
-	}
-
-	switch(type) {
-	case DBD_GOT_EVENTS:
-		data = _load_events(ver, buffer, cluster_name, rec_cnt);
-		break;
-	case DBD_GOT_JOBS:
-		data = _load_jobs(ver, buffer, cluster_name, rec_cnt);
-		break;
-	case DBD_STEP_START:
-		data = _load_steps(ver, buffer, cluster_name, rec_cnt);
-		break;
-	case DBD_JOB_SUSPEND:
-		data = _load_suspend(ver, buffer, cluster_name, rec_cnt);
-		break;
-	default:
-		error("Unknown type '%u' to load from archive", type);
-		break;
-	}
+	data = _load_archive_buffer(buffer);
 	free_buf(buffer);
 
 got_sql:
@@ -2084,7 +2122,6 @@ got_sql:
 	error_code = mysql_db_query_check_after(mysql_conn, data);
 	xfree(data);
 	if (error_code != SLURM_SUCCESS) {
-	unpack_error:
 		error("Couldn't load old data");
 		return SLURM_ERROR;
 	}
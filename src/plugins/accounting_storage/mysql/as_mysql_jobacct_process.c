@@ -308,13 +308,21 @@ static void _destroy_local_cluster(void *object)
 	}
 }
 
+/*
+ * IN/OUT after_jobid - if set only look at jobs with a larger id, set to the
+ *	last job id looked at when limit is set
+ * IN limit - if set look at only about this many job records, those of the
+ *	last job id of a full set are left for the next call
+ * OUT more - set if there may be jobs after after_jobid
+ */
 static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 			     slurmdb_user_rec_t *user,
 			     slurmdb_job_cond_t *job_cond,
 			     char *cluster_name,
 			     char *job_fields, char *step_fields,
 			     char *sent_extra,
-			     bool is_admin, int only_pending, List sent_list)
+			     bool is_admin, int only_pending, List sent_list,
+			     uint32_t *after_jobid, uint32_t limit, bool *more)
 {
 	char *query = NULL;
 	char *extra = xstrdup(sent_extra);
@@ -332,8 +340,11 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	char *prefix="t2";
 	int rc = SLURM_SUCCESS;
 	int last_id = -1, curr_id = -1;
+	uint32_t stop_id = 0;
 	local_cluster_t *curr_cluster = NULL;
 
+	*more = false;
+
 	/* This is here to make sure we are looking at only this user
 	 * if this flag is set.  We also include any accounts they may be
 	 * coordinator of.
@@ -391,6 +402,14 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	setup_job_cluster_cond_limits(mysql_conn, job_cond,
 				      cluster_name, &extra);
 
+	if (*after_jobid) {
+		if (extra)
+			xstrfmtcat(extra, " && (t1.id_job>%u)", *after_jobid);
+		else
+			xstrfmtcat(extra, " where (t1.id_job>%u)",
+				   *after_jobid);
+	}
+
 	query = xstrdup_printf("select %s from \"%s_%s\" as t1 "
 			       "left join \"%s_%s\" as t2 "
 			       "on t1.id_assoc=t2.id_assoc",
@@ -403,9 +422,14 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 
 	/* Here we want to order them this way in such a way so it is
 	   easy to look for duplicates, it is also easy to sort the
-	   resized jobs.
+	   resized jobs.  The order is given explicitly rather than left
+	   to the group by, as a page ends at the last id_job read and
+	   the next starts after it.
 	*/
-	xstrcat(query, " group by id_job, time_submit desc");
+	xstrcat(query, " group by id_job, time_submit "
+		"order by id_job, time_submit desc");
+	if (limit)
+		xstrfmtcat(query, " limit %u", limit);
 
 	debug3("%d(%s:%d) query\n%s",
 	       mysql_conn->conn, THIS_FILE, __LINE__, query);
@@ -416,6 +440,19 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	}
 	xfree(query);
 
+	/* A full set may end part way through the records of its last job
+	   id, if so leave them all for the next call. */
+	if (limit && (mysql_num_rows(result) >= limit)) {
+		*more = true;
+		mysql_data_seek(result, mysql_num_rows(result) - 1);
+		if ((row = mysql_fetch_row(result)))
+			stop_id = slurm_atoul(row[JOB_REQ_JOBID]);
+		mysql_data_seek(result, 0);
+		if ((row = mysql_fetch_row(result))
+		    && (slurm_atoul(row[JOB_REQ_JOBID]) == stop_id))
+			stop_id = 0;
+		mysql_data_seek(result, 0);
+	}
 
 	/* Here we set up environment to check used nodes of jobs.
 	   Since we store the bitmap of the entire cluster we can use
@@ -438,6 +475,10 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 		int submit = slurm_atoul(row[JOB_REQ_SUBMIT]);
 
 		curr_id = slurm_atoul(row[JOB_REQ_JOBID]);
+		if (stop_id && (curr_id == stop_id))
+			break;
+		if (limit)
+			*after_jobid = curr_id;
 
 		if (job_cond && !job_cond->duplicates
 		    && (curr_id == last_id)
@@ -1426,6 +1467,8 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 	int only_pending = 0;
 	List use_cluster_list = as_mysql_cluster_list;
 	char *cluster_name;
+	uint32_t after_jobid, page_size = 0;
+	bool more, page_found = true;
 
 	memset(&user, 0, sizeof(slurmdb_user_rec_t));
 	user.uid = uid;
@@ -1467,16 +1510,42 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 	else
 		slurm_mutex_lock(&as_mysql_cluster_list_lock);
 
+	/* With a page_size the jobs are gathered in sets of about that many
+	   records until the page is full, starting after the last job of
+	   the previous page. */
+	if (job_cond && job_cond->page_size) {
+		page_size = job_cond->page_size;
+		if (job_cond->page_cluster)
+			page_found = false;
+	}
+
 	job_list = list_create(slurmdb_destroy_job_rec);
 	itr = list_iterator_create(use_cluster_list);
 	while ((cluster_name = list_next(itr))) {
 		int rc;
-		if ((rc = _cluster_get_jobs(mysql_conn, &user, job_cond,
-					    cluster_name, tmp, tmp2, extra,
-					    is_admin, only_pending, job_list))
-		    != SLURM_SUCCESS)
-			error("Problem getting jobs for cluster %s",
-			      cluster_name);
+
+		after_jobid = 0;
+		if (!page_found) {
+			if (strcmp(cluster_name, job_cond->page_cluster))
+				continue;
+			page_found = true;
+			after_jobid = job_cond->page_jobid;
+		}
+		do {
+			if ((rc = _cluster_get_jobs(mysql_conn, &user,
+						    job_cond, cluster_name,
+						    tmp, tmp2, extra,
+						    is_admin, only_pending,
+						    job_list, &after_jobid,
+						    page_size, &more))
+			    != SLURM_SUCCESS) {
+				error("Problem getting jobs for cluster %s",
+				      cluster_name);
+				break;
+			}
+		} while (more && (list_count(job_list) < page_size));
+		if (page_size && (list_count(job_list) >= page_size))
+			break;
 	}
 	list_iterator_destroy(itr);
 
@@ -42,6 +42,10 @@
 #include "as_mysql_archive.h"
 #include "src/common/parse_time.h"
 
+#define ROLLUP_MAX_CONNECTIONS	4	/* connections rolling up hours */
+#define ROLLUP_RANGE_MIN_HOURS	24	/* fewer are done on one connection */
+#define ROLLUP_REPORT_INTERVAL	60	/* seconds between progress messages */
+
 typedef struct {
 	int id;
 	uint64_t a_cpu;
@@ -71,6 +75,34 @@ typedef struct {
 	time_t end;
 } local_resv_usage_t;
 
+typedef struct hour_rollup hour_rollup_t;
+
+/* The hours rolled up by one connection */
+typedef struct {
+	time_t start;
+	time_t end;
+	time_t done;		/* end of the last hour committed */
+	hour_rollup_t *rollup;
+} hour_range_t;
+
+/* An hourly rollup split into ranges of hours done at once, each hour is
+ * committed as it is done so an interrupted rollup resumes from there */
+struct hour_rollup {
+	char *cluster_name;
+	bool checkpoint;	/* record progress in last_ran_table */
+	time_t last_ran;	/* hours before this are committed */
+	mysql_conn_t *mysql_conn;
+	pthread_mutex_t lock;
+	hour_range_t *ranges;
+	int range_cnt;
+	int rc;
+	time_t begin;
+	time_t last_report;
+	uint32_t hours;
+	uint32_t hours_done;
+	uint64_t rows;		/* usage rows written */
+};
+
 static void _destroy_local_id_usage(void *object)
 {
 	local_id_usage_t *a_usage = (local_id_usage_t *)object;
@@ -446,17 +478,77 @@ static local_cluster_usage_t *_setup_cluster_usage(mysql_conn_t *mysql_conn,
 	return c_usage;
 }
 
-extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
-				  char *cluster_name,
-				  time_t start, time_t end,
-				  uint16_t archive_data)
+/* Note an hour of a range as done: commit it, and once every hour before
+ * it is done, record that in last_ran_table */
+static int _hour_done(mysql_conn_t *mysql_conn, hour_range_t *range,
+		      time_t hour_end, uint32_t rows)
+{
+	hour_rollup_t *rollup = range->rollup;
+	time_t now, last_ran = 0;
+	char *query = NULL;
+	int i, rc = SLURM_SUCCESS;
+
+	if (mysql_db_commit(mysql_conn)) {
+		error("Couldn't commit hour rollup of cluster %s",
+		      rollup->cluster_name);
+		return SLURM_ERROR;
+	}
+
+	slurm_mutex_lock(&rollup->lock);
+	range->done = hour_end;
+	rollup->hours_done++;
+	rollup->rows += rows;
+
+	/* Everything before the first range not finished is done */
+	for (i = 0; i < rollup->range_cnt; i++) {
+		last_ran = rollup->ranges[i].done;
+		if (last_ran < rollup->ranges[i].end)
+			break;
+	}
+	if (rollup->checkpoint && (last_ran > rollup->last_ran)) {
+		query = xstrdup_printf(
+			"update \"%s_%s\" set hourly_rollup=%ld "
+			"where hourly_rollup<%ld",
+			rollup->cluster_name, last_ran_table,
+			last_ran, last_ran);
+		debug3("%d(%s:%d) query\n%s",
+		       mysql_conn->conn, THIS_FILE, __LINE__, query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if ((rc == SLURM_SUCCESS) && mysql_db_commit(mysql_conn))
+			rc = SLURM_ERROR;
+		if (rc == SLURM_SUCCESS)
+			rollup->last_ran = last_ran;
+		else
+			error("Couldn't record hour rollup of cluster %s",
+			      rollup->cluster_name);
+	}
+
+	now = time(NULL);
+	if ((now - rollup->last_report) >= ROLLUP_REPORT_INTERVAL) {
+		info("hourly_rollup for %s: %u of %u hours done, "
+		     "%"PRIu64" rows, %"PRIu64" rows/sec",
+		     rollup->cluster_name, rollup->hours_done, rollup->hours,
+		     rollup->rows,
+		     rollup->rows / MAX(now - rollup->begin, 1));
+		rollup->last_report = now;
+	}
+	slurm_mutex_unlock(&rollup->lock);
+
+	return rc;
+}
+
+static int _hourly_rollup_range(mysql_conn_t *mysql_conn, hour_range_t *range)
 {
 	int rc = SLURM_SUCCESS;
 	int add_sec = 3600;
 	int i=0;
+	char *cluster_name = range->rollup->cluster_name;
 	time_t now = time(NULL);
-	time_t curr_start = start;
+	time_t curr_start = range->start;
 	time_t curr_end = curr_start + add_sec;
+	time_t end = range->end;
+	uint32_t rows;
 	char *query = NULL;
 	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
@@ -1068,11 +1160,19 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 		}
 
 	end_loop:
+		rows = list_count(assoc_usage_list) + (c_usage ? 1 : 0);
+		if (track_wckey)
+			rows += list_count(wckey_usage_list);
 		_destroy_local_cluster_usage(c_usage);
 		list_flush(assoc_usage_list);
 		list_flush(cluster_down_list);
 		list_flush(wckey_usage_list);
 		list_flush(resv_usage_list);
+		if (curr_end > end)
+			curr_end = end;
+		if ((rc = _hour_done(mysql_conn, range, curr_end, rows))
+		    != SLURM_SUCCESS)
+			goto end_it;
 		curr_start = curr_end;
 		curr_end = curr_start + add_sec;
 	}
@@ -1093,6 +1193,108 @@ end_it:
 /* 	info("stop start %s", ctime(&curr_start)); */
 /* 	info("stop end %s", ctime(&curr_end)); */
 
+	return rc;
+}
+
+static void *_hourly_rollup_thread(void *arg)
+{
+	hour_range_t *range = (hour_range_t *)arg;
+	hour_rollup_t *rollup = range->rollup;
+	mysql_conn_t mysql_conn;
+	int rc;
+
+	memset(&mysql_conn, 0, sizeof(mysql_conn_t));
+	mysql_conn.rollback = 1;
+	mysql_conn.conn = rollup->mysql_conn->conn;
+	slurm_mutex_init(&mysql_conn.lock);
+
+	/* Each range is done on a connection of its own, an hour not
+	 * committed is rolled back when it is closed. */
+	if ((rc = check_connection(&mysql_conn)) == SLURM_SUCCESS)
+		rc = _hourly_rollup_range(&mysql_conn, range);
+
+	mysql_db_close_db_connection(&mysql_conn);
+	slurm_mutex_destroy(&mysql_conn.lock);
+
+	slurm_mutex_lock(&rollup->lock);
+	if ((rc != SLURM_SUCCESS) && (rollup->rc == SLURM_SUCCESS))
+		rollup->rc = rc;
+	slurm_mutex_unlock(&rollup->lock);
+
+	return NULL;
+}
+
+extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
+				  char *cluster_name,
+				  time_t start, time_t end,
+				  uint16_t archive_data, bool checkpoint)
+{
+	hour_rollup_t rollup;
+	pthread_t *tids;
+	pthread_attr_t attr;
+	uint32_t hours_per_range;
+	time_t now;
+	int i, rc;
+
+	memset(&rollup, 0, sizeof(hour_rollup_t));
+	rollup.cluster_name = cluster_name;
+	rollup.checkpoint = checkpoint;
+	rollup.last_ran = start;
+	rollup.mysql_conn = mysql_conn;
+	slurm_mutex_init(&rollup.lock);
+	rollup.begin = rollup.last_report = time(NULL);
+	rollup.hours = (end - start + 3599) / 3600;
+
+	/* Catching up on many hours, as after an outage, split them into
+	 * ranges rolled up at once on connections of their own. */
+	rollup.range_cnt = rollup.hours / ROLLUP_RANGE_MIN_HOURS;
+	rollup.range_cnt = MIN(rollup.range_cnt, ROLLUP_MAX_CONNECTIONS);
+	rollup.range_cnt = MAX(rollup.range_cnt, 1);
+	hours_per_range = (rollup.hours + rollup.range_cnt - 1) /
+			  rollup.range_cnt;
+	rollup.ranges = xmalloc(sizeof(hour_range_t) * rollup.range_cnt);
+	for (i = 0; i < rollup.range_cnt; i++) {
+		rollup.ranges[i].rollup = &rollup;
+		rollup.ranges[i].start = start + i * hours_per_range * 3600;
+		rollup.ranges[i].end = MIN(rollup.ranges[i].start +
+					   hours_per_range * 3600, end);
+		rollup.ranges[i].done = rollup.ranges[i].start;
+	}
+
+	if (rollup.range_cnt == 1) {
+		rollup.rc = _hourly_rollup_range(mysql_conn, &rollup.ranges[0]);
+	} else {
+		tids = xmalloc(sizeof(pthread_t) * rollup.range_cnt);
+		for (i = 0; i < rollup.range_cnt; i++) {
+			slurm_attr_init(&attr);
+			if (pthread_create(&tids[i], &attr,
+					   _hourly_rollup_thread,
+					   &rollup.ranges[i])) {
+				error("pthread_create error %m");
+				tids[i] = 0;
+				_hourly_rollup_thread(&rollup.ranges[i]);
+			}
+			slurm_attr_destroy(&attr);
+		}
+		for (i = 0; i < rollup.range_cnt; i++) {
+			if (tids[i])
+				pthread_join(tids[i], NULL);
+		}
+		xfree(tids);
+	}
+	rc = rollup.rc;
+
+	if (rollup.hours > 1) {
+		now = time(NULL);
+		info("hourly_rollup for %s: %u of %u hours done on %d "
+		     "connections, %"PRIu64" rows, %"PRIu64" rows/sec",
+		     cluster_name, rollup.hours_done, rollup.hours,
+		     rollup.range_cnt, rollup.rows,
+		     rollup.rows / MAX(now - rollup.begin, 1));
+	}
+	xfree(rollup.ranges);
+	slurm_mutex_destroy(&rollup.lock);
+
 	/* go check to see if we archive and purge */
 
 	if (rc == SLURM_SUCCESS)
@@ -44,11 +44,18 @@
 
 #include "accounting_storage_mysql.h"
 
+/*
+ * as_mysql_hourly_rollup - roll up the usage of each hour from start to
+ *	end, many hours are split into ranges done at once on connections of
+ *	their own. Each hour is committed when done.
+ * IN checkpoint - record in last_ran_table the end of the hours done
+ */
 extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
-				  char *cluster_name, 
+				  char *cluster_name,
 				  time_t start,
 				  time_t end,
-				  uint16_t archive_data);
+				  uint16_t archive_data,
+				  bool checkpoint);
 extern int as_mysql_daily_rollup(mysql_conn_t *mysql_conn,
 			      char *cluster_name,
 				 time_t start, 
@@ -295,12 +295,20 @@ static void *_cluster_rollup_usage(void *arg)
 /* 	info("diff is %d", month_end-month_start); */
 
 	if ((hour_end - hour_start) > 0) {
+		/* The hourly rollup commits each hour, possibly on
+		 * connections of its own which must neither wait on nor miss
+		 * what was done here. */
+		if (mysql_db_commit(&mysql_conn)) {
+			rc = SLURM_ERROR;
+			goto end_it;
+		}
 		START_TIMER;
 		rc = as_mysql_hourly_rollup(&mysql_conn,
 					    local_rollup->cluster_name,
 					    hour_start,
 					    hour_end,
-					    local_rollup->archive_data);
+					    local_rollup->archive_data,
+					    !local_rollup->sent_end);
 		snprintf(timer_str, sizeof(timer_str),
 			 "hourly_rollup for %s", local_rollup->cluster_name);
 		END_TIMER3(timer_str, 5000000);
@@ -700,6 +700,8 @@ extern int jobacct_storage_p_suspend(pgsql_conn_t *pg_conn,
 extern List jobacct_storage_p_get_jobs_cond(pgsql_conn_t *pg_conn, uid_t uid,
 					    slurmdb_job_cond_t *job_cond)
 {
+	if (job_cond)
+		job_cond->page_size = 0;	/* every job at once */
 	return js_pg_get_jobs_cond(pg_conn, uid, job_cond);
 }
 
@@ -2355,6 +2355,13 @@ extern List jobacct_storage_p_get_jobs_cond(void *db_conn, uid_t uid,
 
 	memset(&get_msg, 0, sizeof(dbd_cond_msg_t));
 
+	/* An older slurmdbd would ignore the page and send every job */
+	if (job_cond && job_cond->page_size &&
+	    (slurmdbd_get_server_version() < SLURMDBD_2_6_VERSION)) {
+		debug("slurmdbd: not giving jobs a page at a time");
+		job_cond->page_size = 0;
+	}
+
 	get_msg.cond = job_cond;
 
 	req.msg_type = DBD_GET_JOBS_COND;
@@ -72,6 +72,7 @@
 #include "src/slurmctld/acct_policy.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/locks.h"
+#include "src/slurmctld/pend_queue.h"
 #include "src/slurmd/slurmstepd/slurmstepd_job.h"
 
 /* These are defined here so when we link with something other than
@@ -585,9 +586,9 @@ static void _send_sig(uint32_t job_id, uint32_t step_id, uint16_t signal,
 
 static void _requeue_when_finished(uint32_t job_id)
 {
-	/* Locks: read job */
+	/* Locks: write job, read partition */
 	slurmctld_lock_t job_write_lock = {
-		NO_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK };
+		NO_LOCK, WRITE_LOCK, NO_LOCK, READ_LOCK };
 	struct job_record *job_ptr;
 
 	while (1) {
@@ -600,6 +601,8 @@ static void _requeue_when_finished(uint32_t job_id)
 			/* Since the job completion logger
 			 * removes the submit we need to add it again. */
 			acct_policy_add_job_submit(job_ptr);
+			job_journal_mark(job_ptr);
+			pend_queue_update(job_ptr);
 			unlock_slurmctld(job_write_lock);
 			break;
 		} else {
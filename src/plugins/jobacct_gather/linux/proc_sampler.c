@@ -0,0 +1,518 @@
+/*****************************************************************************\
+ *  proc_sampler.c - cached sampling of /proc/<pid>/stat for job accounting
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "src/common/slurm_xlator.h"
+#include "src/common/log.h"
+#include "src/common/xmalloc.h"
+#include "src/plugins/jobacct_gather/linux/proc_sampler.h"
+
+#define PROC_HASH_MIN	256	/* initial hash table size, a power of 2 */
+#define PROC_MAX_OPEN	1024	/* stat files held open between polls, the
+				 * others are opened each poll */
+
+struct proc_sampler {
+	proc_rec_t **hash;
+	uint32_t hash_size;	/* a power of 2 */
+	uint32_t rec_cnt;
+	uint32_t open_cnt;	/* records with fd open */
+	uint32_t poll_gen;
+	uint32_t sum_gen;
+	DIR *slash_proc;
+	long page_kb;		/* page size in KB */
+	proc_rec_t **stack;	/* for proc_sampler_sum() */
+	uint32_t stack_size;
+};
+
+static void _tree_unlink(proc_rec_t *rec);
+
+#ifndef O_CLOEXEC
+#  define O_CLOEXEC 0
+#endif
+
+/* Open a file of /proc, closed on exec() of user tasks. With O_CLOEXEC no
+ * task forked meanwhile can inherit it, which could cause problems for
+ * checkpoint/restart. */
+static int _open_proc(char *path)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if ((fd >= 0) && (O_CLOEXEC == 0))
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+	return fd;
+}
+
+static int _open_stat(pid_t pid)
+{
+	char path[64];
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", (int) pid);
+	return _open_proc(path);	/* -1 if the process went away */
+}
+
+/* Hold a record's stat file open between polls, or close it */
+static void _keep_open(proc_sampler_t *ps, proc_rec_t *rec, bool keep)
+{
+	if (keep && (rec->fd < 0) && (ps->open_cnt < PROC_MAX_OPEN)) {
+		if ((rec->fd = _open_stat(rec->pid)) >= 0)
+			ps->open_cnt++;
+	} else if (!keep && (rec->fd >= 0)) {
+		(void) close(rec->fd);
+		rec->fd = -1;
+		ps->open_cnt--;
+	}
+}
+
+/* Parse the next number from a /proc file, advancing *ptr past it
+ * RET false if no number is found */
+static bool _next_num(char **ptr, int64_t *val)
+{
+	char *p = *ptr;
+	bool neg = false;
+	uint64_t v = 0;
+
+	while (*p == ' ')
+		p++;
+	if (*p == '-') {
+		neg = true;
+		p++;
+	}
+	if ((*p < '0') || (*p > '9'))
+		return false;
+	while ((*p >= '0') && (*p <= '9'))
+		v = (v * 10) + (*p++ - '0');
+	*val = neg ? -(int64_t) v : (int64_t) v;
+	*ptr = p;
+	return true;
+}
+
+/*
+ * Parse the contents of /proc/<pid>/stat. The executable name in field 2
+ * may contain spaces and ')', so fields are counted from the last ')'.
+ * Field numbers are those of proc(5).
+ */
+static bool _parse_stat(char *buf, proc_rec_t *rec, long page_kb)
+{
+	char *p = strrchr(buf, ')');
+	int64_t val, rss = 0, vsize = 0;
+	int field;
+
+	if (!p || (p[1] != ' '))
+		return false;
+	p += 2;
+	while (*p && (*p != ' '))	/* field 3, state */
+		p++;
+	for (field = 4; field <= 39; field++) {
+		if (!_next_num(&p, &val))
+			return false;
+		switch (field) {
+		case 4:
+			rec->ppid = (pid_t) val;
+			break;
+		case 12:
+			rec->pages = (uint32_t) val;
+			break;
+		case 14:
+			rec->usec = (uint32_t) val;
+			break;
+		case 15:
+			rec->ssec = (uint32_t) val;
+			break;
+		case 23:
+			vsize = val;
+			break;
+		case 24:
+			rss = val;
+			break;
+		case 39:
+			rec->last_cpu = (int) val;
+			break;
+		}
+	}
+	if (rss < 0)
+		return false;
+	rec->vsize = (uint32_t) (vsize / 1024);	/* convert from bytes to KB */
+	rec->rss   = (uint32_t) (rss * page_kb);/* convert from pages to KB */
+	return true;
+}
+
+/* Read a process' stat file into its record
+ * RET false if the process has gone (or its pid has been reused) */
+static bool _read_stat(proc_sampler_t *ps, proc_rec_t *rec)
+{
+	char buf[1024];
+	ssize_t len;
+	int fd = rec->fd;
+
+	if ((fd < 0) && ((fd = _open_stat(rec->pid)) < 0))
+		return false;
+	do {
+		len = pread(fd, buf, sizeof(buf) - 1, 0);
+	} while ((len < 0) && (errno == EINTR));
+	if (rec->fd < 0)
+		(void) close(fd);
+	if (len <= 0)
+		return false;
+	buf[len] = '\0';
+	return _parse_stat(buf, rec, ps->page_kb);
+}
+
+/* RET 1 if pid is a light weight process (POSIX thread) of another process,
+ *     0 if not, -1 if unknown */
+static int _is_a_lwp(pid_t pid)
+{
+	char path[64], buf[1024], *p;
+	ssize_t len;
+	int fd;
+	int64_t tgid;
+
+	snprintf(path, sizeof(path), "/proc/%d/status", (int) pid);
+	if ((fd = _open_proc(path)) < 0) {
+		debug3("jobacct_gather_linux: unable to open %s", path);
+		return -1;
+	}
+	do {
+		len = read(fd, buf, sizeof(buf) - 1);
+	} while ((len < 0) && (errno == EINTR));
+	(void) close(fd);
+	if (len <= 0)
+		return -1;
+	buf[len] = '\0';
+
+	if (!(p = strstr(buf, "\nTgid:"))) {
+		debug3("jobacct_gather_linux: unable to read requested "
+		       "pattern in %s", path);
+		return -1;
+	}
+	p += 6;
+	while (*p == '\t')
+		p++;
+	if (!_next_num(&p, &tgid))
+		return -1;
+
+	/* if tgid differs from pid, this is a LWP (Thread POSIX) */
+	if ((pid_t) tgid != pid) {
+		debug3("jobacct_gather_linux: pid=%d is a lightweight process",
+		       (int) tgid);
+		return 1;
+	}
+	return 0;
+}
+
+static proc_rec_t **_hash_slot(proc_sampler_t *ps, pid_t pid)
+{
+	return &ps->hash[(uint32_t) pid & (ps->hash_size - 1)];
+}
+
+static void _hash_grow(proc_sampler_t *ps)
+{
+	proc_rec_t **old_hash = ps->hash, *rec, *next, **slot;
+	uint32_t i, old_size = ps->hash_size;
+
+	ps->hash_size *= 2;
+	ps->hash = xmalloc(sizeof(proc_rec_t *) * ps->hash_size);
+	for (i = 0; i < old_size; i++) {
+		for (rec = old_hash[i]; rec; rec = next) {
+			next = rec->hash_next;
+			slot = _hash_slot(ps, rec->pid);
+			rec->hash_next = *slot;
+			*slot = rec;
+		}
+	}
+	xfree(old_hash);
+}
+
+static proc_rec_t *_find(proc_sampler_t *ps, pid_t pid)
+{
+	proc_rec_t *rec;
+
+	for (rec = *_hash_slot(ps, pid); rec; rec = rec->hash_next) {
+		if (rec->pid == pid)
+			return rec;
+	}
+	return NULL;
+}
+
+/* Remove a record, its children are left without a parent until the tree
+ * is next linked */
+static void _remove(proc_sampler_t *ps, proc_rec_t *rec)
+{
+	proc_rec_t **slot, *child, *next;
+
+	for (slot = _hash_slot(ps, rec->pid); *slot;
+	     slot = &(*slot)->hash_next) {
+		if (*slot == rec) {
+			*slot = rec->hash_next;
+			break;
+		}
+	}
+	ps->rec_cnt--;
+
+	_tree_unlink(rec);
+	for (child = rec->child; child; child = next) {
+		next = child->sibling;
+		child->parent  = NULL;
+		child->sibling = NULL;
+	}
+
+	_keep_open(ps, rec, false);
+	xfree(rec);
+}
+
+/* Remove a record from its parent's list of children */
+static void _tree_unlink(proc_rec_t *rec)
+{
+	proc_rec_t **link;
+
+	if (!rec->parent)
+		return;
+	for (link = &rec->parent->child; *link; link = &(*link)->sibling) {
+		if (*link == rec) {
+			*link = rec->sibling;
+			break;
+		}
+	}
+	rec->parent  = NULL;
+	rec->sibling = NULL;
+}
+
+/*
+ * Sample one process
+ * IN own - the process is one of the step's, listed to proc_sampler_poll()
+ * RET 1 if sampled, 0 if not
+ */
+static int _sample(proc_sampler_t *ps, pid_t pid, bool own)
+{
+	proc_rec_t *rec = _find(ps, pid), **slot;
+
+	if (rec) {
+		if (rec->poll_gen == ps->poll_gen)
+			return 0;	/* listed twice */
+		/* Of all of /proc, only the processes counted by the last
+		 * sums are the step's */
+		_keep_open(ps, rec, own || (rec->sum_poll &&
+					    (rec->sum_poll + 1 ==
+					     ps->poll_gen)));
+		if (_read_stat(ps, rec)) {
+			rec->poll_gen = ps->poll_gen;
+			return 1;
+		}
+		/* The process exited, if the pid is in use again it is a
+		 * new process */
+		_remove(ps, rec);
+	}
+
+	rec = xmalloc(sizeof(proc_rec_t));
+	rec->pid = pid;
+	rec->fd  = -1;
+	_keep_open(ps, rec, own);
+	if (!_read_stat(ps, rec)) {
+		_keep_open(ps, rec, false);
+		xfree(rec);
+		return 0;
+	}
+	/* If current pid corresponds to a Light Weight Process (Thread
+	 * POSIX) skip it, we will only account the original process
+	 * (pid==tgid). Entries of /proc are never threads. */
+	if (own && (_is_a_lwp(pid) > 0))
+		rec->lwp = true;
+	rec->poll_gen = ps->poll_gen;
+
+	if (ps->rec_cnt >= ps->hash_size)
+		_hash_grow(ps);
+	slot = _hash_slot(ps, pid);
+	rec->hash_next = *slot;
+	*slot = rec;
+	ps->rec_cnt++;
+	return 1;
+}
+
+/* Drop the records of processes not found by this poll and link each
+ * remaining record to its parent's, where that has changed */
+static void _update_tree(proc_sampler_t *ps)
+{
+	proc_rec_t *rec, *next, *parent;
+	uint32_t i;
+
+	for (i = 0; i < ps->hash_size; i++) {
+		for (rec = ps->hash[i]; rec; rec = next) {
+			next = rec->hash_next;
+			if (rec->poll_gen != ps->poll_gen)
+				_remove(ps, rec);
+		}
+	}
+
+	for (i = 0; i < ps->hash_size; i++) {
+		for (rec = ps->hash[i]; rec; rec = rec->hash_next) {
+			parent = NULL;
+			if (!rec->lwp && (rec->ppid != rec->pid))
+				parent = _find(ps, rec->ppid);
+			if (parent && parent->lwp)
+				parent = NULL;
+			if (parent == rec->parent)
+				continue;
+			_tree_unlink(rec);
+			if (parent) {
+				rec->parent  = parent;
+				rec->sibling = parent->child;
+				parent->child = rec;
+			}
+		}
+	}
+}
+
+extern proc_sampler_t *proc_sampler_create(void)
+{
+	proc_sampler_t *ps = xmalloc(sizeof(proc_sampler_t));
+
+	ps->hash_size = PROC_HASH_MIN;
+	ps->hash = xmalloc(sizeof(proc_rec_t *) * ps->hash_size);
+	ps->page_kb = getpagesize() / 1024;
+	return ps;
+}
+
+extern void proc_sampler_destroy(proc_sampler_t *ps)
+{
+	proc_rec_t *rec;
+	uint32_t i;
+
+	if (!ps)
+		return;
+	for (i = 0; i < ps->hash_size; i++) {
+		while ((rec = ps->hash[i]))
+			_remove(ps, rec);
+	}
+	if (ps->slash_proc)
+		(void) closedir(ps->slash_proc);
+	xfree(ps->hash);
+	xfree(ps->stack);
+	xfree(ps);
+}
+
+extern int proc_sampler_poll(proc_sampler_t *ps, pid_t *pids, int npids)
+{
+	struct dirent *slash_proc_entry;
+	char *iptr;
+	pid_t pid;
+	int i, cnt = 0;
+
+	ps->poll_gen++;
+	if (pids) {
+		for (i = 0; i < npids; i++)
+			cnt += _sample(ps, pids[i], true);
+	} else {
+		if (ps->slash_proc) {
+			rewinddir(ps->slash_proc);
+		} else if (!(ps->slash_proc = opendir("/proc"))) {
+			error("opendir(/proc): %m");
+			return -1;
+		}
+		while ((slash_proc_entry = readdir(ps->slash_proc))) {
+			/* only numeric file names, which are pids */
+			pid = 0;
+			for (iptr = slash_proc_entry->d_name; *iptr; iptr++) {
+				if ((*iptr < '0') || (*iptr > '9'))
+					break;
+				pid = (pid * 10) + (*iptr - '0');
+			}
+			if (*iptr || (pid == 0))
+				continue;
+			cnt += _sample(ps, pid, false);
+		}
+	}
+	_update_tree(ps);
+	return cnt;
+}
+
+extern proc_rec_t *proc_sampler_find(proc_sampler_t *ps, pid_t pid)
+{
+	return _find(ps, pid);
+}
+
+extern int proc_sampler_sum(proc_sampler_t *ps, pid_t pid, proc_rec_t *total)
+{
+	proc_rec_t *rec = _find(ps, pid), *child;
+	uint32_t depth = 0;
+	int cnt = 0;
+
+	memset(total, 0, sizeof(proc_rec_t));
+	if (!rec || rec->lwp)
+		return 0;
+	total->pid = rec->pid;
+	total->ppid = rec->ppid;
+	total->last_cpu = rec->last_cpu;
+
+	/* The sum_gen mark guards against a parent loop, which a pid reused
+	 * between reads of two stat files could create */
+	ps->sum_gen++;
+	if (ps->stack_size == 0) {
+		ps->stack_size = 64;
+		ps->stack = xmalloc(sizeof(proc_rec_t *) * ps->stack_size);
+	}
+	ps->stack[depth++] = rec;
+	while (depth) {
+		rec = ps->stack[--depth];
+		if (rec->sum_gen == ps->sum_gen)
+			continue;
+		rec->sum_gen = ps->sum_gen;
+		rec->sum_poll = ps->poll_gen;
+		total->usec  += rec->usec;
+		total->ssec  += rec->ssec;
+		total->pages += rec->pages;
+		total->rss   += rec->rss;
+		total->vsize += rec->vsize;
+		cnt++;
+		for (child = rec->child; child; child = child->sibling) {
+			if (depth >= ps->stack_size) {
+				ps->stack_size *= 2;
+				xrealloc(ps->stack, sizeof(proc_rec_t *) *
+					 ps->stack_size);
+			}
+			ps->stack[depth++] = child;
+		}
+	}
+	return cnt;
+}
@@ -0,0 +1,108 @@
+/*****************************************************************************\
+ *  proc_sampler.h - cached sampling of /proc/<pid>/stat for job accounting
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _PROC_SAMPLER_H
+#define _PROC_SAMPLER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * A sampler keeps a record for each process seen in the last poll. The
+ * records of the step's own processes hold their /proc/<pid>/stat file
+ * open so later polls only pread() it: those of the pids given to
+ * proc_sampler_poll() or, when all of /proc is sampled, those counted by
+ * proc_sampler_sum() after the previous poll. Whether a pid is a thread
+ * of another process is checked once, when it is first seen.
+ * Records of processes which exit are dropped by the next poll. A process
+ * tree linking each record to its children is maintained across polls and
+ * relinked only where a parent changed.
+ */
+typedef struct proc_rec proc_rec_t;
+struct proc_rec {
+	pid_t pid;
+	pid_t ppid;
+	int fd;			/* open /proc/<pid>/stat or -1 */
+	bool lwp;		/* thread of another process, not counted */
+	uint32_t poll_gen;	/* last poll which found the process */
+	uint32_t sum_gen;	/* last proc_sampler_sum() to count it */
+	uint32_t sum_poll;	/* last poll after which it was counted */
+
+	/* from the last read of /proc/<pid>/stat */
+	uint32_t usec;		/* user cpu time, clock ticks */
+	uint32_t ssec;		/* system cpu time, clock ticks */
+	uint32_t pages;		/* major page faults */
+	uint32_t rss;		/* KB */
+	uint32_t vsize;		/* KB */
+	int last_cpu;
+
+	proc_rec_t *hash_next;
+	proc_rec_t *parent;	/* record of ppid, NULL if none */
+	proc_rec_t *child;	/* first child */
+	proc_rec_t *sibling;	/* next child of parent */
+};
+
+typedef struct proc_sampler proc_sampler_t;
+
+/* proc_sampler_create - create an empty sampler
+ * RET sampler, free with proc_sampler_destroy() */
+extern proc_sampler_t *proc_sampler_create(void);
+
+/* proc_sampler_destroy - close all files and free a sampler */
+extern void proc_sampler_destroy(proc_sampler_t *ps);
+
+/*
+ * proc_sampler_poll - read the current state of a set of processes
+ * IN pids - processes to sample, or NULL to sample every process in /proc
+ * IN npids - count of pids
+ * RET count of processes sampled or -1 if /proc could not be read
+ */
+extern int proc_sampler_poll(proc_sampler_t *ps, pid_t *pids, int npids);
+
+/* proc_sampler_find - return the record of a process found by the last poll
+ *	or NULL if none */
+extern proc_rec_t *proc_sampler_find(proc_sampler_t *ps, pid_t pid);
+
+/*
+ * proc_sampler_sum - total the usage of a process and all of its
+ *	descendants found by the last poll
+ * IN pid - process at the base of the tree
+ * OUT total - usec, ssec, pages, rss and vsize summed, last_cpu of pid
+ * RET count of processes included, 0 if pid was not found
+ */
+extern int proc_sampler_sum(proc_sampler_t *ps, pid_t pid, proc_rec_t *total);
+
+#endif	/* _PROC_SAMPLER_H */
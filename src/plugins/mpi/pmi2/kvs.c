@@ -47,44 +47,106 @@ int tasks_to_wait = 0;
 int children_to_wait = 0;
 
 
+/* key-value pair, with the hash of the key to compare first */
+typedef struct kvs_pair {
+	char *key;
+	char *val;
+	uint32_t hash;
+} kvs_pair_t;
+
 /* bucket of key-value pairs */
 typedef struct kvs_bucket {
-	char **pairs;
+	kvs_pair_t *pairs;
 	uint32_t count;
 	uint32_t size;
 } kvs_bucket_t;
 
 static kvs_bucket_t *kvs_hash = NULL;
 static uint32_t hash_size = 0;
+static uint32_t kvs_count = 0;
 
 static char *temp_kvs_buf = NULL;
 static int temp_kvs_cnt = 0;
 static int temp_kvs_size = 0;
 
+/*
+ * with direct get, each key is owned by the stepd of one node, chosen by
+ * the hash of the key. at fence, the pairs put by local tasks are sent to
+ * their owners instead of up the tree, and a task getting a key owned by
+ * another node is answered once the owner has sent the value.
+ */
+static Buf local_kvs_buf = NULL;	/* pairs put by local tasks */
+static hostlist_t step_hl = NULL;	/* to name the owner nodes */
+static List pending_gets = NULL;	/* kvs_get_req_t waiting for owners */
+
+typedef struct kvs_get_req {
+	char *key;
+	int fd;
+	int lrank;
+	kvs_get_resp_fn_t resp_fn;
+} kvs_get_req_t;
+
+static void _kvs_send_owners(void);
+
 static int no_dup_keys = 0;
 
-#define TASKS_PER_BUCKET 8
-#define TEMP_KVS_SIZE_INC 2048
+#define PAIRS_PER_BUCKET 4	/* average, the hash doubles beyond this */
+#define MIN_HASH_SIZE 16
+#define TEMP_KVS_SIZE_INIT 2048
 
-#define KEY_INDEX(i) (i * 2)
-#define VAL_INDEX(i) (i * 2 + 1)
-#define HASH(key) ( _hash(key) % hash_size)
 
+/* FNV-1a, every character of the key affects every bit of the hash */
 inline static uint32_t
 _hash(char *key)
 {
-	int len, i;
-	uint32_t hash = 0;
-	uint8_t shift;
-
-	len = strlen(key);
-	for (i = 0; i < len; i ++) {
-		shift = (uint8_t)(hash >> 24);
-		hash = (hash << 8) | (uint32_t)(shift ^ (uint8_t)key[i]);
+	uint32_t hash = 2166136261U;
+
+	while (*key) {
+		hash ^= (uint8_t)*key++;
+		hash *= 16777619U;
 	}
 	return hash;
 }
 
+static void
+_destroy_get_req(void *x)
+{
+	kvs_get_req_t *req = (kvs_get_req_t *)x;
+
+	xfree(req->key);
+	xfree(req);
+}
+
+static int
+_find_get_req(void *x, void *key)
+{
+	kvs_get_req_t *req = (kvs_get_req_t *)x;
+
+	return (! strcmp(req->key, (char *)key));
+}
+
+/* RET nodeid of the stepd owning key with direct get */
+static int
+_kvs_owner(char *key)
+{
+	/* the high bits, as the hash buckets are chosen by the low bits */
+	return (int)(((uint64_t)_hash(key) * job_info.nnodes) >> 32);
+}
+
+/*
+ * make room for size more bytes in temp_kvs_buf. the buffer doubles so
+ * that collecting the pairs of a large job is not quadratic in copying.
+ */
+static void
+_temp_kvs_grow(uint32_t size)
+{
+	if (temp_kvs_cnt + size <= temp_kvs_size)
+		return;
+	while (temp_kvs_cnt + size > temp_kvs_size)
+		temp_kvs_size *= 2;
+	xrealloc(temp_kvs_buf, temp_kvs_size);
+}
+
 extern int
 temp_kvs_init(void)
 {
@@ -94,7 +156,7 @@ temp_kvs_init(void)
 	
 	xfree(temp_kvs_buf);
 	temp_kvs_cnt = 0;
-	temp_kvs_size = TEMP_KVS_SIZE_INC;
+	temp_kvs_size = TEMP_KVS_SIZE_INIT;
 	temp_kvs_buf = xmalloc(temp_kvs_size);
 
 	/* put the tree cmd here to simplify message sending */
@@ -116,10 +178,7 @@ temp_kvs_init(void)
 		pack32((uint32_t)num_children, buf); /* num_children */
 	}
 	size = get_buf_offset(buf);
-	if (temp_kvs_cnt + size > temp_kvs_size) {
-		temp_kvs_size += TEMP_KVS_SIZE_INC;
-		xrealloc(temp_kvs_buf, temp_kvs_size);
-	}
+	_temp_kvs_grow(size);
 	memcpy(&temp_kvs_buf[temp_kvs_cnt], get_buf_data(buf), size);
 	temp_kvs_cnt += size;
 	free_buf(buf);
@@ -139,14 +198,19 @@ temp_kvs_add(char *key, char *val)
 	if ( key == NULL || val == NULL )
 		return SLURM_SUCCESS;
 
-	buf = init_buf(PMI2_MAX_KEYLEN + PMI2_MAX_VALLEN + 2 * sizeof(uint32_t));
+	if (local_kvs_buf) {
+		/* sent to the owner of the key at fence */
+		packstr(key, local_kvs_buf);
+		packstr(val, local_kvs_buf);
+		return SLURM_SUCCESS;
+	}
+
+	/* init_buf() zeroes the buffer, so size it to the pair */
+	buf = init_buf(strlen(key) + strlen(val) + 2 * (sizeof(uint32_t) + 1));
 	packstr(key, buf);
 	packstr(val, buf);
 	size = get_buf_offset(buf);
-	if (temp_kvs_cnt + size > temp_kvs_size) {
-		temp_kvs_size += TEMP_KVS_SIZE_INC;
-		xrealloc(temp_kvs_buf, temp_kvs_size);
-	}
+	_temp_kvs_grow(size);
 	memcpy(&temp_kvs_buf[temp_kvs_cnt], get_buf_data(buf), size);
 	temp_kvs_cnt += size;
 	free_buf(buf);
@@ -167,10 +231,7 @@ temp_kvs_merge(Buf buf)
 	data = get_buf_data(buf);
 	offset = get_buf_offset(buf);
 
-	if (temp_kvs_cnt + size > temp_kvs_size) {
-		temp_kvs_size += size;
-		xrealloc(temp_kvs_buf, temp_kvs_size);
-	}
+	_temp_kvs_grow(size);
 	memcpy(&temp_kvs_buf[temp_kvs_cnt], &data[offset], size);
 	temp_kvs_cnt += size;
 	
@@ -183,6 +244,9 @@ temp_kvs_send(void)
 	int rc;
 
 	/* cmd included in temp_kvs_buf */
+
+	if (local_kvs_buf)
+		_kvs_send_owners();
 	
 	if (! in_stepd()) {	/* srun */
 		rc = tree_msg_to_stepds(job_info.step_nodelist,
@@ -203,18 +267,87 @@ temp_kvs_send(void)
 
 /**************************************************************/
 
+static void
+_bucket_append(kvs_bucket_t *bucket, uint32_t hash, char *key, char *val)
+{
+	kvs_pair_t *pair;
+
+	if (bucket->count >= bucket->size) {
+		bucket->size = bucket->size ? bucket->size * 2 : 2;
+		xrealloc(bucket->pairs, bucket->size * sizeof(kvs_pair_t));
+	}
+	pair = &bucket->pairs[bucket->count];
+	pair->key = key;
+	pair->val = val;
+	pair->hash = hash;
+	bucket->count ++;
+}
+
+/* move all pairs into a hash of new_size buckets */
+static void
+_kvs_rehash(uint32_t new_size)
+{
+	kvs_bucket_t *new_hash, *bucket;
+	kvs_pair_t *pair;
+	int i, j;
+
+	debug3("mpi/pmi2: growing kvs hash from %u to %u buckets for %u "
+	       "pairs", hash_size, new_size, kvs_count);
+
+	new_hash = xmalloc(new_size * sizeof(kvs_bucket_t));
+	for (i = 0; i < hash_size; i ++) {
+		bucket = &kvs_hash[i];
+		for (j = 0; j < bucket->count; j ++) {
+			pair = &bucket->pairs[j];
+			_bucket_append(&new_hash[pair->hash % new_size],
+				       pair->hash, pair->key, pair->val);
+		}
+		xfree(bucket->pairs);
+	}
+	xfree(kvs_hash);
+	kvs_hash = new_hash;
+	hash_size = new_size;
+}
+
+/* RET the stored value of key or NULL */
+static char *
+_kvs_find(char *key)
+{
+	kvs_bucket_t *bucket;
+	uint32_t hash = _hash(key);
+	int i;
+
+	bucket = &kvs_hash[hash % hash_size];
+	for (i = 0; i < bucket->count; i ++) {
+		if ((bucket->pairs[i].hash == hash) &&
+		    ! strcmp(key, bucket->pairs[i].key))
+			return bucket->pairs[i].val;
+	}
+	return NULL;
+}
+
 extern int
 kvs_init(void)
 {
 	debug3("mpi/pmi2: in kvs_init");
 
-	hash_size = ((job_info.ntasks + TASKS_PER_BUCKET - 1) / TASKS_PER_BUCKET);
+	hash_size = ((job_info.ntasks + PAIRS_PER_BUCKET - 1) /
+		     PAIRS_PER_BUCKET);
+	if (hash_size < MIN_HASH_SIZE)
+		hash_size = MIN_HASH_SIZE;
+	kvs_count = 0;
 	
 	kvs_hash = xmalloc(hash_size * sizeof(kvs_bucket_t));
 
 	if (getenv(PMI2_KVS_NO_DUP_KEYS_ENV))
 		no_dup_keys = 1;
 
+	if (job_info.kvs_direct_get && in_stepd()) {
+		local_kvs_buf = init_buf(TEMP_KVS_SIZE_INIT);
+		step_hl = hostlist_create(job_info.step_nodelist);
+		pending_gets = list_create(_destroy_get_req);
+	}
+
 	return SLURM_SUCCESS;
 }
 
@@ -224,21 +357,11 @@ kvs_init(void)
 extern char *
 kvs_get(char *key)
 {
-	kvs_bucket_t *bucket;
-	char *val = NULL;
-	int i;
+	char *val;
 
 	debug3("mpi/pmi2: in kvs_get, key=%s", key);
 	
-	bucket = &kvs_hash[HASH(key)];
-	if (bucket->count > 0) {
-		for(i = 0; i < bucket->count; i ++) {
-			if (! strcmp(key, bucket->pairs[KEY_INDEX(i)])) { 
-				val = bucket->pairs[VAL_INDEX(i)];
-				break;
-			}
-		}
-	}
+	val = _kvs_find(key);
 
 	debug3("mpi/pmi2: out kvs_get, val=%s", val);
 	
@@ -249,37 +372,209 @@ extern int
 kvs_put(char *key, char *val)
 {
 	kvs_bucket_t *bucket;
+	uint32_t hash = _hash(key);
 	int i;
 
 	debug3("mpi/pmi2: in kvs_put");
 
-	bucket = &kvs_hash[HASH(key)];
+	bucket = &kvs_hash[hash % hash_size];
 
 	if (! no_dup_keys) {
 		for (i = 0; i < bucket->count; i ++) {
-			if (! strcmp(key, bucket->pairs[KEY_INDEX(i)])) {
+			if ((bucket->pairs[i].hash == hash) &&
+			    ! strcmp(key, bucket->pairs[i].key)) {
 				/* replace the k-v pair */
-				xfree(bucket->pairs[VAL_INDEX(i)]);
-				bucket->pairs[VAL_INDEX(i)] = xstrdup(val);
+				xfree(bucket->pairs[i].val);
+				bucket->pairs[i].val = xstrdup(val);
 				debug("mpi/pmi2: put kvs %s=%s", key, val);
 				return SLURM_SUCCESS;
 			}
 		}
 	}
-	if (bucket->count * 2 >= bucket->size) {
-		bucket->size += (TASKS_PER_BUCKET * 2);
-		xrealloc(bucket->pairs, bucket->size * sizeof(char *));
-	}
 	/* add the k-v pair */
-	i = bucket->count;
-	bucket->pairs[KEY_INDEX(i)] = xstrdup(key);
-	bucket->pairs[VAL_INDEX(i)] = xstrdup(val);
-	bucket->count ++;
+	_bucket_append(bucket, hash, xstrdup(key), xstrdup(val));
+	kvs_count ++;
+	if (kvs_count > hash_size * PAIRS_PER_BUCKET)
+		_kvs_rehash(hash_size * 2);
 	
 	debug3("mpi/pmi2: put kvs %s=%s", key, val);
 	return SLURM_SUCCESS;
 }
 
+/*
+ * put all pairs packed in buf, as by temp_kvs_add(), into the hash
+ */
+extern int
+kvs_put_buf(Buf buf)
+{
+	char *key, *val;
+	uint32_t temp32;
+
+	while (remaining_buf(buf) > 0) {
+		safe_unpackmem_ptr(&key, &temp32, buf);
+		safe_unpackmem_ptr(&val, &temp32, buf);
+		if (key && val)
+			kvs_put(key, val);
+	}
+	return SLURM_SUCCESS;
+
+unpack_error:
+	return SLURM_ERROR;
+}
+
+/* send a message to the stepd of node nodeid */
+static int
+_kvs_msg_to_node(int nodeid, Buf buf)
+{
+	char *node;
+	int rc;
+
+	if ((step_hl == NULL) ||
+	    ((node = hostlist_nth(step_hl, nodeid)) == NULL))
+		return SLURM_ERROR;
+	rc = tree_msg_to_stepds(node, get_buf_offset(buf), get_buf_data(buf));
+	free(node);
+	return rc;
+}
+
+/*
+ * at fence with direct get, send the pairs put by local tasks to the
+ * stepds owning them. pairs are kept here if owned here or, as they can
+ * not be replaced, if keys are never put twice.
+ */
+static void
+_kvs_send_owners(void)
+{
+	Buf buf, *owner_bufs;
+	char *key, *val;
+	uint32_t size, temp32, sent = 0;
+	int i, owner;
+
+	size = get_buf_offset(local_kvs_buf);
+	buf = create_buf(xmalloc(size), size);
+	memcpy(get_buf_data(buf), get_buf_data(local_kvs_buf), size);
+	set_buf_offset(local_kvs_buf, 0);
+
+	owner_bufs = xmalloc(job_info.nnodes * sizeof(Buf));
+	while (remaining_buf(buf) > 0) {
+		if ((unpackmem_ptr(&key, &temp32, buf) != SLURM_SUCCESS) ||
+		    (unpackmem_ptr(&val, &temp32, buf) != SLURM_SUCCESS))
+			break;
+		owner = _kvs_owner(key);
+		if ((owner == job_info.nodeid) || no_dup_keys)
+			kvs_put(key, val);
+		if (owner == job_info.nodeid)
+			continue;
+		if (owner_bufs[owner] == NULL) {
+			owner_bufs[owner] = init_buf(1024);
+			pack16((uint16_t)TREE_CMD_KVS_PUT, owner_bufs[owner]);
+		}
+		packstr(key, owner_bufs[owner]);
+		packstr(val, owner_bufs[owner]);
+	}
+	for (i = 0; i < job_info.nnodes; i ++) {
+		if (owner_bufs[i] == NULL)
+			continue;
+		sent += get_buf_offset(owner_bufs[i]);
+		if (_kvs_msg_to_node(i, owner_bufs[i]) != SLURM_SUCCESS)
+			error("mpi/pmi2: failed to send kvs to node %d", i);
+		free_buf(owner_bufs[i]);
+	}
+	xfree(owner_bufs);
+	free_buf(buf);
+	debug3("mpi/pmi2: sent %u bytes of kvs to owners", sent);
+}
+
+/*
+ * get the value of key for task lrank, whose requests are read from fd.
+ * resp_fn sends the response to the task: here if the value is known
+ * locally, otherwise, with direct get, once the stepd owning the key has
+ * sent the value. the agent keeps serving other tasks meanwhile.
+ */
+extern int
+kvs_get_async(char *key, int fd, int lrank, kvs_get_resp_fn_t resp_fn)
+{
+	kvs_get_req_t *req;
+	bool sent;
+	char *val;
+	Buf buf;
+	int owner, rc;
+
+	val = kvs_get(key);
+	if ((val != NULL) || (local_kvs_buf == NULL) ||
+	    ((owner = _kvs_owner(key)) == job_info.nodeid))
+		return resp_fn(fd, lrank, val);
+
+	/* a single request to the owner serves every task waiting */
+	sent = (list_find_first(pending_gets, _find_get_req, key) != NULL);
+	req = xmalloc(sizeof(kvs_get_req_t));
+	req->key = xstrdup(key);
+	req->fd = fd;
+	req->lrank = lrank;
+	req->resp_fn = resp_fn;
+	list_append(pending_gets, req);
+	if (sent)
+		return SLURM_SUCCESS;
+
+	buf = init_buf(PMI2_MAX_KEYLEN + 16);
+	pack16((uint16_t)TREE_CMD_KVS_GET, buf);
+	pack32((uint32_t)job_info.nodeid, buf);
+	packstr(key, buf);
+	rc = _kvs_msg_to_node(owner, buf);
+	free_buf(buf);
+	if (rc != SLURM_SUCCESS) {
+		error("mpi/pmi2: failed to get kvs %s from node %d", key,
+		      owner);
+		kvs_get_resp(key, NULL);
+	}
+	return SLURM_SUCCESS;
+}
+
+/*
+ * direct get, in the stepd owning key: send its value to the stepd of
+ * node nodeid
+ */
+extern int
+kvs_get_send(char *key, int nodeid)
+{
+	Buf buf;
+	int rc;
+
+	buf = init_buf(1024);
+	pack16((uint16_t)TREE_CMD_KVS_GET_RESP, buf);
+	packstr(key, buf);
+	packstr(kvs_get(key), buf);
+	rc = _kvs_msg_to_node(nodeid, buf);
+	free_buf(buf);
+	return rc;
+}
+
+/*
+ * direct get: respond to the tasks waiting for key with the value sent
+ * by its owner, NULL if not found
+ */
+extern int
+kvs_get_resp(char *key, char *val)
+{
+	kvs_get_req_t *req;
+	ListIterator itr;
+	int rc = SLURM_SUCCESS;
+
+	if (val && no_dup_keys)
+		kvs_put(key, val);	/* can not change, keep it */
+
+	itr = list_iterator_create(pending_gets);
+	while ((req = list_next(itr))) {
+		if (strcmp(req->key, key))
+			continue;
+		if (req->resp_fn(req->fd, req->lrank, val) != SLURM_SUCCESS)
+			rc = SLURM_ERROR;
+		list_delete_item(itr);
+	}
+	list_iterator_destroy(itr);
+	return rc;
+}
+
 extern int
 kvs_clear(void)
 {
@@ -289,11 +584,26 @@ kvs_clear(void)
 	for (i = 0; i < hash_size; i ++){
 		bucket = &kvs_hash[i];
 		for (j = 0; j < bucket->count; j ++) {
-			xfree (bucket->pairs[KEY_INDEX(j)]);
-			xfree (bucket->pairs[VAL_INDEX(j)]);
+			xfree (bucket->pairs[j].key);
+			xfree (bucket->pairs[j].val);
 		}
+		xfree(bucket->pairs);
 	}
 	xfree(kvs_hash);
+	hash_size = 0;
+	kvs_count = 0;
+	if (local_kvs_buf) {
+		free_buf(local_kvs_buf);
+		local_kvs_buf = NULL;
+	}
+	if (step_hl) {
+		hostlist_destroy(step_hl);
+		step_hl = NULL;
+	}
+	if (pending_gets) {
+		list_destroy(pending_gets);
+		pending_gets = NULL;
+	}
 
 	return SLURM_SUCCESS;
 }
@@ -56,9 +56,17 @@ extern int   temp_kvs_add(char *key, char *val);
 extern int   temp_kvs_merge(Buf buf);
 extern int   temp_kvs_send(void);
 
+/* sends the response to a get by task lrank, val is NULL if not found */
+typedef int (*kvs_get_resp_fn_t)(int fd, int lrank, char *val);
+
 extern int   kvs_init(void);
 extern char *kvs_get(char *key);
+extern int   kvs_get_async(char *key, int fd, int lrank,
+			   kvs_get_resp_fn_t resp_fn);
+extern int   kvs_get_send(char *key, int nodeid);
+extern int   kvs_get_resp(char *key, char *val);
 extern int   kvs_put(char *key, char *val);
+extern int   kvs_put_buf(Buf buf);
 extern int   kvs_clear(void);
 
 
@@ -224,6 +224,7 @@
 #define PMI2_PREPUT_CNT_ENV     "SLURM_PMI2_PREPUT_COUNT"
 #define PMI2_PPKEY_ENV          "SLURM_PMI2_PPKEY"
 #define PMI2_PPVAL_ENV          "SLURM_PMI2_PPVAL"
+#define PMI2_KVS_DIRECT_GET_ENV "SLURM_PMI2_KVS_DIRECT_GET"
 /* old PMIv1 envs */
 #define PMI2_PMI_DEBUGGED_ENV   "PMI_DEBUG"
 #define PMI2_KVS_NO_DUP_KEYS_ENV "SLURM_PMI_KVS_NO_DUP_KEYS"
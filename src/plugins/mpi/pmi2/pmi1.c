@@ -280,19 +280,10 @@ _handle_put(int fd, int lrank, client_req_t *req)
 }
 
 static int
-_handle_get(int fd, int lrank, client_req_t *req)
+_send_get_resp(int fd, int lrank, char *val)
 {
 	int rc;
 	client_resp_t *resp;
-	char *kvsname = NULL, *key = NULL, *val = NULL;
-
-	debug3("mpi/pmi2: in _handle_get");
-	
-	client_req_parse_body(req);
-	client_req_get_str(req, KVSNAME_KEY, &kvsname); /* not used */
-	client_req_get_str(req, KEY_KEY, &key);
-	
-	val = kvs_get(key);
 
 	resp = client_resp_new();
 	if (val != NULL) {
@@ -304,6 +295,23 @@ _handle_get(int fd, int lrank, client_req_t *req)
 	}
 	rc = client_resp_send(resp, fd);
 	client_resp_free(resp);
+	return rc;
+}
+
+static int
+_handle_get(int fd, int lrank, client_req_t *req)
+{
+	int rc;
+	char *kvsname = NULL, *key = NULL;
+
+	debug3("mpi/pmi2: in _handle_get");
+	
+	client_req_parse_body(req);
+	client_req_get_str(req, KVSNAME_KEY, &kvsname); /* not used */
+	client_req_get_str(req, KEY_KEY, &key);
+	
+	/* the response may be sent once the value is got from its owner */
+	rc = kvs_get_async(key, fd, lrank, _send_get_resp);
 
 	debug3("mpi/pmi2: out _handle_get");
 	return rc;
@@ -264,18 +264,10 @@ _handle_kvs_fence(int fd, int lrank, client_req_t *req)
 
 
 static int
-_handle_kvs_get(int fd, int lrank, client_req_t *req)
+_send_kvs_get_resp(int fd, int lrank, char *val)
 {
 	int rc;
 	client_resp_t *resp;
-	char *key, *val;
-
-	debug3("mpi/pmi2: in _handle_kvs_get");
-	
-	client_req_parse_body(req);
-	client_req_get_str(req, KEY_KEY, &key);
-	
-	val = kvs_get(key);
 
 	resp = client_resp_new();
 	if (val != NULL) {
@@ -288,6 +280,22 @@ _handle_kvs_get(int fd, int lrank, client_req_t *req)
 	}
 	rc = client_resp_send(resp, fd);
 	client_resp_free(resp);
+	return rc;
+}
+
+static int
+_handle_kvs_get(int fd, int lrank, client_req_t *req)
+{
+	int rc;
+	char *key;
+
+	debug3("mpi/pmi2: in _handle_kvs_get");
+	
+	client_req_parse_body(req);
+	client_req_get_str(req, KEY_KEY, &key);
+	
+	/* the response may be sent once the value is got from its owner */
+	rc = kvs_get_async(key, fd, lrank, _send_kvs_get_resp);
 
 	debug3("mpi/pmi2: out _handle_kvs_get");
 	return rc;
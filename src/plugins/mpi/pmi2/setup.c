@@ -113,6 +113,8 @@ _setup_stepd_job_info(const slurmd_job_t *job, char ***env)
 	} else {
 		job_info.pmi_debugged = 0;
 	}
+	if (getenvp(*env, PMI2_KVS_DIRECT_GET_ENV))
+		job_info.kvs_direct_get = 1;
 	p = getenvp(*env, PMI2_SPAWN_SEQ_ENV);
 	if (p) { 		/* spawned */
 		job_info.spawn_seq = atoi(p);
@@ -515,6 +517,8 @@ _setup_srun_job_info(const mpi_plugin_client_info_t *job)
 	} else {
 		job_info.pmi_debugged = 0;
 	}
+	if (getenv(PMI2_KVS_DIRECT_GET_ENV))
+		job_info.kvs_direct_get = 1;
 	p = getenv(PMI2_SPAWN_SEQ_ENV);
 	if (p) { 		/* spawned */
 		job_info.spawn_seq = atoi(p);
@@ -629,6 +633,8 @@ _setup_srun_environ(const mpi_plugin_client_info_t *job, char ***env)
 				job_info.step_nodelist);
 	env_array_overwrite_fmt(env, PMI2_PROC_MAPPING_ENV, "%s",
 				job_info.proc_mapping);
+	if (job_info.kvs_direct_get)
+		env_array_overwrite(env, PMI2_KVS_DIRECT_GET_ENV, "1");
 	return SLURM_SUCCESS;
 }
 
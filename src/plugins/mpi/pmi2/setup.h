@@ -75,6 +75,7 @@ typedef struct pmi2_job_info {
 	uint32_t spawn_seq;	/* seq of spawn. 0 if not spawned */
 
 	int pmi_debugged;    /* whether output verbose PMI messages */
+	int kvs_direct_get;  /* get KVS values from srun on demand */
 	char *step_nodelist; /* list of nodes in this job step */
 	char *proc_mapping;  /* processor mapping */
 	char *pmi_jobid;     /* PMI job id */
@@ -56,12 +56,18 @@ static int _handle_kvs_fence(int fd, Buf buf);
 static int _handle_kvs_fence_resp(int fd, Buf buf);
 static int _handle_spawn(int fd, Buf buf);
 static int _handle_spawn_resp(int fd, Buf buf);
+static int _handle_kvs_get(int fd, Buf buf);
+static int _handle_kvs_get_resp(int fd, Buf buf);
+static int _handle_kvs_put(int fd, Buf buf);
 
 static int (*tree_cmd_handlers[]) (int fd, Buf buf) = {
 	_handle_kvs_fence,
 	_handle_kvs_fence_resp,
 	_handle_spawn,
 	_handle_spawn_resp,
+	_handle_kvs_get,
+	_handle_kvs_get_resp,
+	_handle_kvs_put,
 	NULL
 };
 
@@ -70,6 +76,9 @@ static char *tree_cmd_names[] = {
 	"TREE_CMD_KVS_FENCE_RESP",
 	"TREE_CMD_SPAWN",
 	"TREE_CMD_SPAWN_RESP",
+	"TREE_CMD_KVS_GET",
+	"TREE_CMD_KVS_GET_RESP",
+	"TREE_CMD_KVS_PUT",
 	NULL,
 };
 	
@@ -109,25 +118,17 @@ unpack_error:
 static int
 _handle_kvs_fence_resp(int fd, Buf buf)
 {
-	char *key, *val;
 	int rc = 0, i = 0;
 	client_resp_t *resp;
-	uint32_t temp32;
 
 	debug3("mpi/pmi2: in _handle_kvs_fence_resp");
-	temp32 = remaining_buf(buf);
-	debug3("mpi/pmi2: buf length: %u", temp32);
+	debug3("mpi/pmi2: buf length: %u", remaining_buf(buf));
 	/* put kvs into local hash */
-	while (remaining_buf(buf) > 0) {
-		safe_unpackstr_xmalloc(&key, &temp32, buf);
-		safe_unpackstr_xmalloc(&val, &temp32, buf);
-		kvs_put(key, val);
-		//temp32 = remaining_buf(buf);
-		xfree(key);
-		xfree(val);
+	if (kvs_put_buf(buf) != SLURM_SUCCESS) {
+		error("mpi/pmi2: unpack kvs error in fence resp");
+		rc = SLURM_ERROR;
 	}
 
-resp:
 	/* send fence_resp/barrier_out to tasks */
 	resp = client_resp_new();
 	if ( is_pmi11() ) {
@@ -142,11 +143,6 @@ resp:
 	}
 	client_resp_free(resp);
 	return rc;
-
-unpack_error:
-	error("mpi/pmi2: unpack kvs error in fence resp");
-	rc = SLURM_ERROR;
-	goto resp;
 }
 
 /* only called in srun */
@@ -324,6 +320,69 @@ _handle_spawn_resp(int fd, Buf buf)
 	return rc;
 }
 
+/* only called in stepd owning the key, with direct get */
+static int
+_handle_kvs_get(int fd, Buf buf)
+{
+	uint32_t from_nodeid, temp32;
+	char *key = NULL;
+	int rc;
+
+	safe_unpack32(&from_nodeid, buf);
+	safe_unpackstr_xmalloc(&key, &temp32, buf);
+	debug3("mpi/pmi2: in _handle_kvs_get, key=%s from node %u", key,
+	       from_nodeid);
+
+	rc = kvs_get_send(key, from_nodeid);
+	if (rc != SLURM_SUCCESS)
+		error("mpi/pmi2: failed to send kvs %s to node %u", key,
+		      from_nodeid);
+	xfree(key);
+	return rc;
+
+unpack_error:
+	error("mpi/pmi2: failed to unpack kvs get message");
+	xfree(key);
+	return SLURM_ERROR;
+}
+
+/* only called in stepd, with direct get */
+static int
+_handle_kvs_get_resp(int fd, Buf buf)
+{
+	char *key = NULL, *val = NULL;
+	uint32_t temp32;
+	int rc;
+
+	safe_unpackstr_xmalloc(&key, &temp32, buf);
+	safe_unpackstr_xmalloc(&val, &temp32, buf);
+	debug3("mpi/pmi2: in _handle_kvs_get_resp, key=%s", key);
+
+	rc = kvs_get_resp(key, val);
+	xfree(key);
+	xfree(val);
+	return rc;
+
+unpack_error:
+	error("mpi/pmi2: failed to unpack kvs get response");
+	xfree(key);
+	xfree(val);
+	return SLURM_ERROR;
+}
+
+/* only called in stepd owning the keys, with direct get */
+static int
+_handle_kvs_put(int fd, Buf buf)
+{
+	debug3("mpi/pmi2: in _handle_kvs_put");
+
+	if (kvs_put_buf(buf) != SLURM_SUCCESS) {
+		error("mpi/pmi2: failed to unpack kvs put message");
+		return SLURM_ERROR;
+	}
+	return SLURM_SUCCESS;
+}
+
 /**************************************************************/
 extern int
 handle_tree_cmd(int fd)
@@ -47,6 +47,9 @@ enum {
 	TREE_CMD_KVS_FENCE_RESP,
 	TREE_CMD_SPAWN,
 	TREE_CMD_SPAWN_RESP,
+	TREE_CMD_KVS_GET,
+	TREE_CMD_KVS_GET_RESP,
+	TREE_CMD_KVS_PUT,
 	TREE_CMD_COUNT
 };
 
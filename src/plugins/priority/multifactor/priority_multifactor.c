@@ -69,6 +69,7 @@
 #include "src/common/parse_time.h"
 
 #include "src/slurmctld/locks.h"
+#include "src/slurmctld/pend_queue.h"
 
 #define SECS_PER_DAY	(24 * 60 * 60)
 #define SECS_PER_WEEK	(7 * SECS_PER_DAY)
@@ -1073,6 +1074,7 @@ static int _apply_new_usage(struct job_record *job_ptr, double decay_factor,
 static void *_decay_ticket_thread(void *no_data)
 {
 	struct job_record *job_ptr = NULL;
+	uint32_t new_prio;
 	ListIterator itr;
 	time_t start_time = time(NULL);
 	time_t last_ran = 0;
@@ -1248,8 +1250,12 @@ static void *_decay_ticket_thread(void *no_data)
 			    || !IS_JOB_PENDING(job_ptr))
 				continue;
 
-			job_ptr->priority =
-				_get_priority_internal(start_time, job_ptr);
+			new_prio = _get_priority_internal(start_time, job_ptr);
+			if (new_prio != job_ptr->priority) {
+				job_ptr->priority = new_prio;
+				job_journal_mark(job_ptr);
+			}
+			pend_queue_update(job_ptr);
 			last_job_update = time(NULL);
 			debug2("priority for job %u is now %u",
 			       job_ptr->job_id, job_ptr->priority);
@@ -1280,6 +1286,7 @@ static void *_decay_ticket_thread(void *no_data)
 static void *_decay_usage_thread(void *no_data)
 {
 	struct job_record *job_ptr = NULL;
+	uint32_t new_prio;
 	ListIterator itr;
 	time_t start_time = time(NULL);
 	time_t last_ran = 0;
@@ -1442,8 +1449,12 @@ static void *_decay_usage_thread(void *no_data)
 			    || !IS_JOB_PENDING(job_ptr))
 				continue;
 
-			job_ptr->priority =
-				_get_priority_internal(start_time, job_ptr);
+			new_prio = _get_priority_internal(start_time, job_ptr);
+			if (new_prio != job_ptr->priority) {
+				job_ptr->priority = new_prio;
+				job_journal_mark(job_ptr);
+			}
+			pend_queue_update(job_ptr);
 			last_job_update = time(NULL);
 			debug2("priority for job %u is now %u",
 			       job_ptr->job_id, job_ptr->priority);
@@ -79,6 +79,7 @@
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/srun_comm.h"
 #include "backfill.h"
+#include "node_space.h"
 
 #ifndef BACKFILL_INTERVAL
 #  define BACKFILL_INTERVAL	30
@@ -102,17 +103,38 @@
 
 #define SLURMCTLD_THREAD_LIMIT	5
 
-typedef struct node_space_map {
-	time_t begin_time;
-	time_t end_time;
-	bitstr_t *avail_bitmap;
-	int next;	/* next record, by time, zero termination */
-} node_space_map_t;
+/* Seconds before a recurring reservation ends from which reservations are
+ * tested under a node write lock, see _resv_lock() */
+#define BF_RESV_ADVANCE_MARGIN	2
+
+/* A job planned to start now. Jobs are started in batches, when the node
+ * write lock is next taken. */
+typedef struct bf_start {
+	uint32_t job_id;
+	struct job_record *job_ptr;
+	struct part_record *part_ptr;
+	bitstr_t *exc_bitmap;		/* all nodes except those planned */
+	uint32_t time_limit;		/* time limit to start with */
+	uint32_t orig_time_limit;	/* job's time limit */
+	uint32_t comp_time_limit;	/* time limit allowed by partition */
+	bool no_reserve;		/* QOS_FLAG_NO_RESERVE */
+} bf_start_t;
 
 /* Diag statistics */
 extern diag_stats_t slurmctld_diag_stats;
 int bf_last_ints = 0;
 
+/* Locks held while planning: nodes, partitions and reservations are only
+ * read, so node and partition information requests are not blocked by
+ * backfill. Starting jobs and advancing recurring reservations swap the
+ * node read lock for a write lock. */
+static slurmctld_lock_t plan_locks = {
+	READ_LOCK, WRITE_LOCK, READ_LOCK, READ_LOCK };
+static slurmctld_lock_t node_read_locks = {
+	NO_LOCK, NO_LOCK, READ_LOCK, READ_LOCK };
+static slurmctld_lock_t node_write_locks = {
+	NO_LOCK, NO_LOCK, WRITE_LOCK, READ_LOCK };
+
 /*********************** local variables *********************/
 static bool stop_backfill = false;
 static pthread_mutex_t thread_flag_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -127,12 +149,14 @@ static int max_backfill_job_cnt = 50;
 static int max_backfill_job_per_user = 0;
 
 /*********************** local functions *********************/
-static void _add_reservation(uint32_t start_time, uint32_t end_reserve,
-			     bitstr_t *res_bitmap,
-			     node_space_map_t *node_space,
-			     int *node_space_recs);
+static void _add_reservation(uint32_t job_id, uint32_t start_time,
+			     uint32_t end_reserve, bitstr_t *res_bitmap,
+			     node_space_map_t *node_space);
 static int  _attempt_backfill(void);
+static int  _commit_starts(List start_list, node_space_map_t *node_space);
 static bool _job_is_completing(void);
+static bool _job_whole_nodes(struct job_record *job_ptr,
+			     struct part_record *part_ptr);
 static void _load_config(void);
 static bool _many_pending_rpcs(void);
 static bool _more_work(time_t last_backfill_time);
@@ -140,36 +164,14 @@ static void _my_sleep(int secs);
 static int  _num_feature_count(struct job_record *job_ptr);
 static void _reset_job_time_limit(struct job_record *job_ptr, time_t now,
 				  node_space_map_t *node_space);
+static bool _resv_lock(time_t *part_update);
+static int  _resv_unlock(bool write_locked, time_t part_update);
+static bool _start_eligible(struct job_record *job_ptr);
 static int  _start_job(struct job_record *job_ptr, bitstr_t *avail_bitmap);
-static bool _test_resv_overlap(node_space_map_t *node_space,
-			       bitstr_t *use_bitmap, uint32_t start_time,
-			       uint32_t end_reserve);
 static int  _try_sched(struct job_record *job_ptr, bitstr_t **avail_bitmap,
 		       uint32_t min_nodes, uint32_t max_nodes,
 		       uint32_t req_nodes, bitstr_t *exc_core_bitmap);
 
-/* Log resource allocate table */
-static void _dump_node_space_table(node_space_map_t *node_space_ptr)
-{
-	int i = 0;
-	char begin_buf[32], end_buf[32], *node_list;
-
-	info("=========================================");
-	while (1) {
-		slurm_make_time_str(&node_space_ptr[i].begin_time,
-				    begin_buf, sizeof(begin_buf));
-		slurm_make_time_str(&node_space_ptr[i].end_time,
-				    end_buf, sizeof(end_buf));
-		node_list = bitmap2node_name(node_space_ptr[i].avail_bitmap);
-		info("Begin:%s End:%s Nodes:%s",
-		     begin_buf, end_buf, node_list);
-		xfree(node_list);
-		if ((i = node_space_ptr[i].next) == 0)
-			break;
-	}
-	info("=========================================");
-}
-
 /*
  * _job_is_completing - Determine if jobs are in the process of completing.
  *	This is a variant of job_is_completing in slurmctld/job_scheduler.c.
@@ -428,6 +430,11 @@ static void _do_diag_stats(struct timeval *tv1, struct timeval *tv2)
 							bf_interval_usecs));
    	slurmctld_diag_stats.bf_cycle_last = delta_t - (bf_last_ints *
 							bf_interval_usecs);
+	if (slurmctld_diag_stats.bf_cycle_last > 0) {
+		slurmctld_diag_stats.bf_last_test_rate =
+			(uint64_t) slurmctld_diag_stats.bf_last_depth *
+			1000000 / slurmctld_diag_stats.bf_cycle_last;
+	}
 	slurmctld_diag_stats.bf_depth_sum += slurmctld_diag_stats.bf_last_depth;
 	slurmctld_diag_stats.bf_depth_try_sum += slurmctld_diag_stats.
 						 bf_last_depth_try;
@@ -447,9 +454,6 @@ extern void *backfill_agent(void *args)
 	time_t now;
 	double wait_time;
 	static time_t last_backfill_time = 0;
-	/* Read config and partitions; Write jobs and nodes */
-	slurmctld_lock_t all_locks = {
-		READ_LOCK, WRITE_LOCK, WRITE_LOCK, READ_LOCK };
 
 	_load_config();
 	last_backfill_time = time(NULL);
@@ -468,33 +472,44 @@ extern void *backfill_agent(void *args)
 		    !avail_front_end() || !_more_work(last_backfill_time))
 			continue;
 
-		lock_slurmctld(all_locks);
+		lock_slurmctld(plan_locks);
 		while (_attempt_backfill()) ;
 		last_backfill_time = time(NULL);
-		unlock_slurmctld(all_locks);
+		unlock_slurmctld(plan_locks);
 	}
 	return NULL;
 }
 
-/* Return non-zero to break the backfill loop if change in job, node or
- * partition state or the backfill scheduler needs to be stopped. */
-static int _yield_locks(int secs)
+/* Return true if a job holding a backfill reservation is no longer pending,
+ * so its reservation can be released */
+static bool _job_not_pending(uint32_t job_id, void *arg)
+{
+	struct job_record *job_ptr = find_job_record(job_id);
+
+	if (job_ptr && IS_JOB_PENDING(job_ptr))
+		return false;
+	return true;
+}
+
+/* Return non-zero to break the backfill loop if change in node or
+ * partition state or the backfill scheduler needs to be stopped.
+ * Set job_change if job state changed, in which case job records and
+ * reservations held by the caller must be validated before use. */
+static int _yield_locks(int secs, bool *job_change)
 {
-	slurmctld_lock_t all_locks = {
-		READ_LOCK, WRITE_LOCK, WRITE_LOCK, READ_LOCK };
 	time_t job_update, node_update, part_update;
 
 	job_update  = last_job_update;
 	node_update = last_node_update;
 	part_update = last_part_update;
 
-	unlock_slurmctld(all_locks);
+	unlock_slurmctld(plan_locks);
 	bf_last_ints++;
 	_my_sleep(secs);
-	lock_slurmctld(all_locks);
+	lock_slurmctld(plan_locks);
 
-	if ((last_job_update  == job_update)  &&
-	    (last_node_update == node_update) &&
+	*job_change = (last_job_update != job_update);
+	if ((last_node_update == node_update) &&
 	    (last_part_update == part_update) &&
 	    (! stop_backfill) && (! config_flag))
 		return 0;
@@ -502,6 +517,220 @@ static int _yield_locks(int secs)
 		return 1;
 }
 
+static void _start_del(void *x)
+{
+	bf_start_t *start_ptr = (bf_start_t *) x;
+
+	if (start_ptr) {
+		FREE_NULL_BITMAP(start_ptr->exc_bitmap);
+		xfree(start_ptr);
+	}
+}
+
+static int _start_find(void *x, void *key)
+{
+	bf_start_t *start_ptr = (bf_start_t *) x;
+	uint32_t *job_id = (uint32_t *) key;
+
+	if (start_ptr->job_id == *job_id)
+		return 1;
+	return 0;
+}
+
+/* Return true if the job will be allocated whole nodes, so no other job can
+ * start on its nodes until it ends. Follows _resolve_shared_status() in
+ * slurmctld/node_scheduler.c, which may already have set details->shared
+ * to its result. */
+static bool _job_whole_nodes(struct job_record *job_ptr,
+			     struct part_record *part_ptr)
+{
+	static uint32_t cr_enabled = NO_VAL;
+	uint16_t user_flag = job_ptr->details->shared;
+	uint16_t max_share = part_ptr->max_share;
+
+	if (cr_enabled == NO_VAL) {
+		cr_enabled = 0;	/* select/linear and bluegene are no-ops */
+		if (select_g_get_info_from_plugin(SELECT_CR_PLUGIN, NULL,
+						  &cr_enabled) !=
+		    SLURM_SUCCESS) {
+			cr_enabled = NO_VAL;
+			return false;
+		}
+	}
+
+	if (max_share == 0)
+		return true;
+	if ((max_share & SHARED_FORCE) && ((max_share & (~SHARED_FORCE)) > 1))
+		return false;
+	if (cr_enabled)
+		return (user_flag == 0);
+	if (max_share == 1)
+		return true;
+	return (user_flag != 1);
+}
+
+/*
+ * _resv_lock - Once a recurring reservation ends, license_job_test() and
+ *	job_test_resv() advance its times. Swap the node read lock for a
+ *	write lock if that may happen while testing a job.
+ * OUT part_update - last_part_update before the swap, for _resv_unlock()
+ * RET true if the write lock was taken, to be passed to _resv_unlock()
+ */
+static bool _resv_lock(time_t *part_update)
+{
+	time_t advance = find_resv_advance();
+
+	*part_update = last_part_update;
+	if ((advance == 0) ||
+	    (advance > (time(NULL) + BF_RESV_ADVANCE_MARGIN)))
+		return false;
+	unlock_slurmctld(node_read_locks);
+	lock_slurmctld(node_write_locks);
+	return true;
+}
+
+/*
+ * _resv_unlock - Swap a write lock taken by _resv_lock() back for the
+ *	node read lock
+ * RET 0 to continue planning, 1 to restart backfill because partitions
+ *	changed while the locks were swapped
+ */
+static int _resv_unlock(bool write_locked, time_t part_update)
+{
+	if (!write_locked)
+		return 0;
+	unlock_slurmctld(node_write_locks);
+	lock_slurmctld(node_read_locks);
+	if (last_part_update != part_update) {
+		if (debug_flags & DEBUG_FLAG_BACKFILL)
+			info("backfill: partitions changed, restarting");
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * _start_eligible - Test again whether a planned job may start. Jobs
+ *	started earlier in the batch may have taken the licenses or used up
+ *	the association and QOS limits the job needs, and its dependencies,
+ *	partition or reservation may have changed while locks were yielded.
+ *	Call with the node write lock.
+ */
+static bool _start_eligible(struct job_record *job_ptr)
+{
+	if ((job_ptr->part_ptr->state_up & PARTITION_SCHED) == 0)
+		return false;
+	if (!job_independent(job_ptr, 0))
+		return false;
+	if (license_job_test(job_ptr, time(NULL)) != SLURM_SUCCESS) {
+		job_ptr->state_reason = WAIT_LICENSES;
+		xfree(job_ptr->state_desc);
+		return false;
+	}
+	if (job_test_resv_now(job_ptr) != SLURM_SUCCESS)
+		return false;
+	if (!acct_policy_job_runnable(job_ptr))
+		return false;
+	return true;
+}
+
+static bool _job_id_match(uint32_t job_id, void *arg)
+{
+	return (job_id == *(uint32_t *) arg);
+}
+
+/*
+ * _commit_starts - Start the jobs the plan has selected to start now.
+ *	Planning holds only read locks on nodes, so swap these for a write
+ *	lock while starting the jobs. The job write lock is held throughout,
+ *	so the job records remain valid. Node state may change while the
+ *	locks are swapped, select_nodes() tests each job's nodes again.
+ * IN/OUT start_list - bf_start_t records, emptied
+ * IN node_space - the plan, reservations of these jobs are released
+ * RET 0 to continue planning, 1 to restart backfill because partitions
+ *	changed, -1 to end the backfill cycle because of a failed start
+ */
+static int _commit_starts(List start_list, node_space_map_t *node_space)
+{
+	bf_start_t *start_ptr;
+	struct job_record *job_ptr;
+	time_t part_update = last_part_update;
+	int rc = 0, start_rc;
+
+	if (list_count(start_list) == 0)
+		return rc;
+
+	unlock_slurmctld(node_read_locks);
+	lock_slurmctld(node_write_locks);
+
+	if (last_part_update != part_update) {
+		if (debug_flags & DEBUG_FLAG_BACKFILL) {
+			info("backfill: partitions changed, discarding %d "
+			     "planned job starts", list_count(start_list));
+		}
+		rc = 1;
+	}
+
+	while ((start_ptr = (bf_start_t *) list_pop(start_list))) {
+		job_ptr = start_ptr->job_ptr;
+		node_space_release_if(node_space, _job_id_match,
+				      &start_ptr->job_id);
+		if (rc || !IS_JOB_PENDING(job_ptr)) {
+			if (IS_JOB_PENDING(job_ptr))
+				job_ptr->start_time = 0;
+			_start_del(start_ptr);
+			continue;
+		}
+
+		job_ptr->part_ptr = start_ptr->part_ptr;
+		if (!_start_eligible(job_ptr)) {
+			if (debug_flags & DEBUG_FLAG_BACKFILL) {
+				info("backfill: job %u no longer eligible "
+				     "to start", job_ptr->job_id);
+			}
+			job_ptr->start_time = 0;
+			_start_del(start_ptr);
+			continue;
+		}
+		job_ptr->time_limit = start_ptr->time_limit;
+		start_rc = _start_job(job_ptr, start_ptr->exc_bitmap);
+		if (start_ptr->no_reserve) {
+			if (start_ptr->orig_time_limit == NO_VAL) {
+				start_ptr->orig_time_limit =
+					start_ptr->comp_time_limit;
+			}
+			job_ptr->time_limit = start_ptr->orig_time_limit;
+			job_ptr->end_time = job_ptr->start_time +
+					    (start_ptr->orig_time_limit * 60);
+		} else if ((start_rc == SLURM_SUCCESS) && job_ptr->time_min) {
+			/* Set time limit as high as possible */
+			job_ptr->time_limit = start_ptr->comp_time_limit;
+			job_ptr->end_time = job_ptr->start_time +
+					    (start_ptr->comp_time_limit * 60);
+			_reset_job_time_limit(job_ptr, time(NULL),
+					      node_space);
+		} else {
+			job_ptr->time_limit = start_ptr->orig_time_limit;
+		}
+		if (start_rc == SLURM_SUCCESS)
+			job_timer_arm(job_ptr);
+		if (start_rc == ESLURM_ACCOUNTING_POLICY) {
+			/* Unknown future start time, just skip job */
+			job_ptr->start_time = 0;
+		} else if (start_rc != SLURM_SUCCESS) {
+			/* Planned to start job, but something bad
+			 * happended. Start no more jobs this cycle. */
+			job_ptr->start_time = 0;
+			rc = -1;
+		}
+		_start_del(start_ptr);
+	}
+
+	unlock_slurmctld(node_write_locks);
+	lock_slurmctld(node_read_locks);
+	return rc;
+}
+
 static int _attempt_backfill(void)
 {
 	DEF_TIMERS;
@@ -509,7 +738,7 @@ static int _attempt_backfill(void)
 	List job_queue;
 	job_queue_rec_t *job_queue_rec;
 	slurmdb_qos_rec_t *qos_ptr = NULL;
-	int i, j, node_space_recs;
+	int j;
 	struct job_record *job_ptr;
 	struct part_record *part_ptr;
 	uint32_t end_time, end_reserve;
@@ -518,24 +747,33 @@ static int _attempt_backfill(void)
 	bitstr_t *avail_bitmap = NULL, *resv_bitmap = NULL;
 	bitstr_t *exc_core_bitmap = NULL;
 	time_t now, sched_start, later_start, start_res, resv_end;
+	time_t part_update;
 	node_space_map_t *node_space;
+	node_space_rec_t *ns_ptr;
+	List start_list;
+	bf_start_t *start_ptr;
 	struct timeval bf_time1, bf_time2;
 	static int sched_timeout = 0;
 	int this_sched_timeout = 0, rc = 0;
 	int job_test_count = 0;
 	uint32_t *uid = NULL, nuser = 0;
 	uint16_t *njobs = NULL;
-	bool already_counted;
+	bool already_counted, job_change = false, resv_write_locked;
 	uint32_t reject_array_job_id = 0;
 
 #ifdef HAVE_CRAY
 	/*
 	 * Run a Basil Inventory immediately before setting up the schedule
 	 * plan, to avoid race conditions caused by ALPS node state change.
-	 * Needs to be done with the node-state lock taken.
+	 * Needs to be done with the node-state write lock taken.
 	 */
 	START_TIMER;
-	if (select_g_reconfigure()) {
+	unlock_slurmctld(node_read_locks);
+	lock_slurmctld(node_write_locks);
+	j = select_g_reconfigure();
+	unlock_slurmctld(node_write_locks);
+	lock_slurmctld(node_read_locks);
+	if (j) {
 		debug4("backfill: not scheduling due to ALPS");
 		return SLURM_SUCCESS;
 	}
@@ -545,7 +783,7 @@ static int _attempt_backfill(void)
 
 	/* The Basil inventory can take a long time to complete. Process
 	 * pending RPCs before starting the backfill scheduling logic */
-	_yield_locks(1);
+	_yield_locks(1, &job_change);
 #endif
 
 	START_TIMER;
@@ -580,15 +818,16 @@ static int _attempt_backfill(void)
 	bf_last_ints = 0;
 	slurmctld_diag_stats.bf_active = 1;
 
-	node_space = xmalloc(sizeof(node_space_map_t) *
-			     (max_backfill_job_cnt + 3));
-	node_space[0].begin_time = sched_start;
-	node_space[0].end_time = sched_start + backfill_window;
-	node_space[0].avail_bitmap = bit_copy(avail_node_bitmap);
-	node_space[0].next = 0;
-	node_space_recs = 1;
+	/* The map holds only reservations for pending jobs, which depend on
+	 * the order of this cycle's queue, so it is not carried over from
+	 * the last cycle. Within the cycle it is updated in place as jobs
+	 * start or end, see node_space_release_if(). */
+	node_space = node_space_create(sched_start,
+				       sched_start + backfill_window,
+				       avail_node_bitmap);
+	start_list = list_create(_start_del);
 	if (debug_flags & DEBUG_FLAG_BACKFILL)
-		_dump_node_space_table(node_space);
+		node_space_dump(node_space);
 
 	if (max_backfill_job_per_user) {
 		uid = xmalloc(BF_MAX_USERS * sizeof(uint32_t));
@@ -599,9 +838,17 @@ static int _attempt_backfill(void)
 		job_test_count++;
 		job_ptr  = job_queue_rec->job_ptr;
 		part_ptr = job_queue_rec->part_ptr;
+		if (job_change &&
+		    (find_job_record(job_queue_rec->job_id) != job_ptr)) {
+			/* purged while locks were yielded */
+			xfree(job_queue_rec);
+			continue;
+		}
 		xfree(job_queue_rec);
 		if (!IS_JOB_PENDING(job_ptr))
 			continue;	/* started in other partition */
+		if (list_find_first(start_list, _start_find, &job_ptr->job_id))
+			continue;	/* to be started in other partition */
 		if (job_ptr->array_task_id != (uint16_t) NO_VAL) {
 			if (reject_array_job_id == job_ptr->array_job_id)
 				continue;  /* already rejected array element */
@@ -658,8 +905,15 @@ static int _attempt_backfill(void)
 		if ((part_ptr->flags & PART_FLAG_ROOT_ONLY) && filter_root)
 			continue;
 
-		if ((!job_independent(job_ptr, 0)) ||
-		    (license_job_test(job_ptr, time(NULL)) != SLURM_SUCCESS))
+		if (!job_independent(job_ptr, 0))
+			continue;
+		resv_write_locked = _resv_lock(&part_update);
+		j = license_job_test(job_ptr, time(NULL));
+		if (_resv_unlock(resv_write_locked, part_update)) {
+			rc = 1;
+			break;
+		}
+		if (j != SLURM_SUCCESS)
 			continue;
 
 		/* Determine minimum and maximum node counts */
@@ -708,8 +962,14 @@ static int _attempt_backfill(void)
 		FREE_NULL_BITMAP(exc_core_bitmap);
 		start_res   = later_start;
 		later_start = 0;
+		resv_write_locked = _resv_lock(&part_update);
 		j = job_test_resv(job_ptr, &start_res, true, &avail_bitmap,
 				  &exc_core_bitmap);
+		if (_resv_unlock(resv_write_locked, part_update)) {
+			job_ptr->time_limit = orig_time_limit;
+			rc = 1;
+			break;
+		}
 		if (j != SLURM_SUCCESS) {
 			job_ptr->time_limit = orig_time_limit;
 			continue;
@@ -722,19 +982,13 @@ static int _attempt_backfill(void)
 		/* Identify usable nodes for this job */
 		bit_and(avail_bitmap, part_ptr->node_bitmap);
 		bit_and(avail_bitmap, up_node_bitmap);
-		for (j=0; ; ) {
-			if ((node_space[j].end_time > start_res) &&
-			     node_space[j].next && (later_start == 0))
-				later_start = node_space[j].end_time;
-			if (node_space[j].end_time <= start_res)
-				;
-			else if (node_space[j].begin_time <= end_time) {
-				bit_and(avail_bitmap,
-					node_space[j].avail_bitmap);
-			} else
-				break;
-			if ((j = node_space[j].next) == 0)
+		for (ns_ptr = node_space_find(node_space, start_res); ns_ptr;
+		     ns_ptr = ns_ptr->next) {
+			if (ns_ptr->next && (later_start == 0))
+				later_start = ns_ptr->end_time;
+			if (ns_ptr->begin_time > end_time)
 				break;
+			bit_and(avail_bitmap, ns_ptr->avail_bitmap);
 		}
 		if ((resv_end++) &&
 		    ((later_start == 0) || (resv_end < later_start))) {
@@ -773,14 +1027,21 @@ static int _attempt_backfill(void)
 
 		if ((time(NULL) - sched_start) >= this_sched_timeout) {
 			uint32_t save_time_limit = job_ptr->time_limit;
+			uint32_t save_job_id = job_ptr->job_id;
 			job_ptr->time_limit = orig_time_limit;
+			j = _commit_starts(start_list, node_space);
+			if (j) {
+				if (j > 0)
+					rc = 1;
+				break;
+			}
 			if (debug_flags & DEBUG_FLAG_BACKFILL) {
 				END_TIMER;
 				info("backfill: yielding locks after testing "
 				     "%d jobs, %s",
 				     job_test_count, TIME_STR);
 			}
-			if (_yield_locks(backfill_interval)) {
+			if (_yield_locks(backfill_interval, &job_change)) {
 				if (debug_flags & DEBUG_FLAG_BACKFILL) {
 					info("backfill: system state changed, "
 					     "breaking out after testing %d "
@@ -789,11 +1050,26 @@ static int _attempt_backfill(void)
 				rc = 1;
 				break;
 			}
-			job_ptr->time_limit = save_time_limit;
 			/* Reset backfill scheduling timers, resume testing */
 			sched_start = time(NULL);
 			job_test_count = 0;
 			START_TIMER;
+			if (job_change) {
+				/* Jobs started or ended while the locks were
+				 * yielded. Keep the plan, but drop the
+				 * reservations of jobs no longer pending. */
+				j = node_space_release_if(node_space,
+							  _job_not_pending,
+							  NULL);
+				if (debug_flags & DEBUG_FLAG_BACKFILL) {
+					info("backfill: job state changed, "
+					     "released %d reservations", j);
+				}
+				if ((find_job_record(save_job_id) != job_ptr) ||
+				    !IS_JOB_PENDING(job_ptr))
+					continue;
+			}
+			job_ptr->time_limit = save_time_limit;
 		}
 		/* this is the time consuming operation */
 		debug2("backfill: entering _try_sched for job %u.",
@@ -819,39 +1095,39 @@ static int _attempt_backfill(void)
 			last_job_update = now;
 		}
 		if (job_ptr->start_time <= now) {
-			int rc = _start_job(job_ptr, resv_bitmap);
-			if (qos_ptr && (qos_ptr->flags & QOS_FLAG_NO_RESERVE)){
-				if (orig_time_limit == NO_VAL)
-					orig_time_limit = comp_time_limit;
-				job_ptr->time_limit = orig_time_limit;
-				job_ptr->end_time = job_ptr->start_time +
-						    (orig_time_limit * 60);
-			}
-			else if ((rc == SLURM_SUCCESS) && job_ptr->time_min) {
-				/* Set time limit as high as possible */
-				job_ptr->time_limit = comp_time_limit;
-				job_ptr->end_time = job_ptr->start_time +
-						    (comp_time_limit * 60);
-				_reset_job_time_limit(job_ptr, now,
-						      node_space);
-				time_limit = job_ptr->time_limit;
-			} else {
-				job_ptr->time_limit = orig_time_limit;
-			}
-			if (rc == ESLURM_ACCOUNTING_POLICY) {
-				/* Unknown future start time, just skip job */
-				job_ptr->start_time = 0;	
-				continue;
-			} else if (rc != SLURM_SUCCESS) {
-				/* Planned to start job, but something bad
-				 * happended. */
-				job_ptr->start_time = 0;	
-				break;
-			} else {
-				/* Started this job, move to next one */
-				reject_array_job_id = 0;
+			/* Start the job with the next batch of starts. Until
+			 * then keep the nodes selected out of the plan. */
+			bit_not(avail_bitmap);
+			start_ptr = xmalloc(sizeof(bf_start_t));
+			start_ptr->job_id = job_ptr->job_id;
+			start_ptr->job_ptr = job_ptr;
+			start_ptr->part_ptr = part_ptr;
+			start_ptr->exc_bitmap = bit_copy(avail_bitmap);
+			start_ptr->time_limit = job_ptr->time_limit;
+			start_ptr->orig_time_limit = orig_time_limit;
+			start_ptr->comp_time_limit = comp_time_limit;
+			if (qos_ptr && (qos_ptr->flags & QOS_FLAG_NO_RESERVE))
+				start_ptr->no_reserve = true;
+			list_append(start_list, start_ptr);
+			job_ptr->time_limit = orig_time_limit;
+			reject_array_job_id = 0;
+			if (!_job_whole_nodes(job_ptr, part_ptr)) {
+				/* Other jobs may start on its nodes, which
+				 * the plan can not represent. Start it now
+				 * so the select plugin counts its resources
+				 * when testing later jobs. */
+				j = _commit_starts(start_list, node_space);
+				if (j) {
+					if (j > 0)
+						rc = 1;
+					break;
+				}
 				continue;
 			}
+			_add_reservation(job_ptr->job_id, now,
+					 now + (time_limit * 60),
+					 avail_bitmap, node_space);
+			continue;
 		} else
 			job_ptr->time_limit = orig_time_limit;
 
@@ -867,13 +1143,19 @@ static int _attempt_backfill(void)
 			continue;
 		}
 
-		if (node_space_recs >= max_backfill_job_cnt) {
-			/* Already have too many jobs to deal with */
-			break;
+		if (node_space->rec_cnt >= max_backfill_job_cnt) {
+			/* Start the jobs planned to start now, releasing
+			 * their records. If that is not enough, we already
+			 * have too many jobs to deal with. */
+			j = _commit_starts(start_list, node_space);
+			if (j > 0)
+				rc = 1;
+			if (j || (node_space->rec_cnt >= max_backfill_job_cnt))
+				break;
 		}
 
 		end_reserve = job_ptr->start_time + (time_limit * 60);
-		if (_test_resv_overlap(node_space, avail_bitmap,
+		if (node_space_overlap(node_space, avail_bitmap,
 				       job_ptr->start_time, end_reserve)) {
 			/* This job overlaps with an existing reservation for
 			 * job to be backfill scheduled, which the sched
@@ -890,23 +1172,20 @@ static int _attempt_backfill(void)
 			continue;
 		reject_array_job_id = 0;
 		bit_not(avail_bitmap);
-		_add_reservation(job_ptr->start_time, end_reserve,
-				 avail_bitmap, node_space, &node_space_recs);
+		_add_reservation(job_ptr->job_id, job_ptr->start_time,
+				 end_reserve, avail_bitmap, node_space);
 		if (debug_flags & DEBUG_FLAG_BACKFILL)
-			_dump_node_space_table(node_space);
+			node_space_dump(node_space);
 	}
+	if (_commit_starts(start_list, node_space) > 0)
+		rc = 1;
+	list_destroy(start_list);
 	xfree(uid);
 	xfree(njobs);
 	FREE_NULL_BITMAP(avail_bitmap);
 	FREE_NULL_BITMAP(exc_core_bitmap);
 	FREE_NULL_BITMAP(resv_bitmap);
-
-	for (i=0; ; ) {
-		FREE_NULL_BITMAP(node_space[i].avail_bitmap);
-		if ((i = node_space[i].next) == 0)
-			break;
-	}
-	xfree(node_space);
+	node_space_destroy(node_space);
 	list_destroy(job_queue);
 	gettimeofday(&bf_time2, NULL);
 	_do_diag_stats(&bf_time1, &bf_time2);
@@ -979,22 +1258,22 @@ static int _start_job(struct job_record *job_ptr, bitstr_t *resv_bitmap)
 static void _reset_job_time_limit(struct job_record *job_ptr, time_t now,
 				  node_space_map_t *node_space)
 {
-	int32_t j, resv_delay;
+	int32_t resv_delay;
 	uint32_t orig_time_limit = job_ptr->time_limit;
+	node_space_rec_t *ns_ptr;
 
-	for (j=0; ; ) {
-		if ((node_space[j].begin_time != now) &&
-		    (node_space[j].begin_time < job_ptr->end_time) &&
+	for (ns_ptr = node_space->first;
+	     ns_ptr && (ns_ptr->begin_time < job_ptr->end_time);
+	     ns_ptr = ns_ptr->next) {
+		if ((ns_ptr->begin_time != now) &&
 		    (!bit_super_set(job_ptr->node_bitmap,
-				    node_space[j].avail_bitmap))) {
+				    ns_ptr->avail_bitmap))) {
 			/* Job overlaps pending job's resource reservation */
-			resv_delay = difftime(node_space[j].begin_time, now);
+			resv_delay = difftime(ns_ptr->begin_time, now);
 			resv_delay /= 60;	/* seconds to minutes */
 			if (resv_delay < job_ptr->time_limit)
 				job_ptr->time_limit = resv_delay;
 		}
-		if ((j = node_space[j].next) == 0)
-			break;
 	}
 	job_ptr->time_limit = MAX(job_ptr->time_min, job_ptr->time_limit);
 	job_ptr->end_time = job_ptr->start_time + (job_ptr->time_limit * 60);
@@ -1023,92 +1302,15 @@ static bool _more_work (time_t last_backfill_time)
 }
 
 /* Create a reservation for a job in the future */
-static void _add_reservation(uint32_t start_time, uint32_t end_reserve,
-			     bitstr_t *res_bitmap,
-			     node_space_map_t *node_space,
-			     int *node_space_recs)
+static void _add_reservation(uint32_t job_id, uint32_t start_time,
+			     uint32_t end_reserve, bitstr_t *res_bitmap,
+			     node_space_map_t *node_space)
 {
-	bool placed = false;
-	int i, j;
-
 	/* If we decrease the resolution of our timing information, this can
 	 * decrease the number of records managed and increase performance */
 	start_time = (start_time / backfill_resolution) * backfill_resolution;
 	end_reserve = (end_reserve / backfill_resolution) * backfill_resolution;
 
-	for (j=0; ; ) {
-		if (node_space[j].end_time > start_time) {
-			/* insert start entry record */
-			i = *node_space_recs;
-			node_space[i].begin_time = start_time;
-			node_space[i].end_time = node_space[j].end_time;
-			node_space[j].end_time = start_time;
-			node_space[i].avail_bitmap =
-				bit_copy(node_space[j].avail_bitmap);
-			node_space[i].next = node_space[j].next;
-			node_space[j].next = i;
-			(*node_space_recs)++;
-			placed = true;
-		}
-		if (node_space[j].end_time == start_time) {
-			/* no need to insert new start entry record */
-			placed = true;
-		}
-		if (placed == true) {
-			j = node_space[j].next;
-			if (j && (end_reserve < node_space[j].end_time)) {
-				/* insert end entry record */
-				i = *node_space_recs;
-				node_space[i].begin_time = end_reserve;
-				node_space[i].end_time = node_space[j].
-							 end_time;
-				node_space[j].end_time = end_reserve;
-				node_space[i].avail_bitmap =
-					bit_copy(node_space[j].avail_bitmap);
-				node_space[i].next = node_space[j].next;
-				node_space[j].next = i;
-				(*node_space_recs)++;
-			}
-			break;
-		}
-		if ((j = node_space[j].next) == 0)
-			break;
-	}
-
-	for (j=0; ; ) {
-		if ((node_space[j].begin_time >= start_time) &&
-		    (node_space[j].end_time <= end_reserve))
-			bit_and(node_space[j].avail_bitmap, res_bitmap);
-		if ((node_space[j].begin_time >= end_reserve) ||
-		    ((j = node_space[j].next) == 0))
-			break;
-	}
-}
-
-/*
- * Determine if the resource specification for a new job overlaps with a
- *	reservation that the backfill scheduler has made for a job to be
- *	started in the future.
- * IN use_bitmap - nodes to be allocated
- * IN start_time - start time of job
- * IN end_reserve - end time of job
- */
-static bool _test_resv_overlap(node_space_map_t *node_space,
-			       bitstr_t *use_bitmap, uint32_t start_time,
-			       uint32_t end_reserve)
-{
-	bool overlap = false;
-	int j;
-
-	for (j=0; ; ) {
-		if ((node_space[j].end_time   > start_time) &&
-		    (node_space[j].begin_time < end_reserve) &&
-		    (!bit_super_set(use_bitmap, node_space[j].avail_bitmap))) {
-			overlap = true;
-			break;
-		}
-		if ((j = node_space[j].next) == 0)
-			break;
-	}
-	return overlap;
+	node_space_reserve(node_space, job_id, start_time, end_reserve,
+			   res_bitmap);
 }
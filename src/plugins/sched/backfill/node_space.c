@@ -0,0 +1,404 @@
+/*****************************************************************************\
+ *  node_space.c - backfill scheduler's map of node availability over time
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/parse_time.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/slurmctld.h"
+
+#include "node_space.h"
+
+/* A reservation made for a pending job */
+typedef struct node_space_resv {
+	uint32_t job_id;
+	time_t start_time;
+	time_t end_time;
+	bitstr_t *avail_bitmap;		/* nodes which remain available */
+} node_space_resv_t;
+
+static void _resv_del(void *x)
+{
+	node_space_resv_t *resv = (node_space_resv_t *) x;
+
+	if (resv) {
+		FREE_NULL_BITMAP(resv->avail_bitmap);
+		xfree(resv);
+	}
+}
+
+/*****************************************************************************\
+ *  AVL tree of slices, keyed on begin_time
+\*****************************************************************************/
+
+static inline int _height(node_space_rec_t *rec)
+{
+	return rec ? rec->height : 0;
+}
+
+static inline void _set_height(node_space_rec_t *rec)
+{
+	rec->height = MAX(_height(rec->left), _height(rec->right)) + 1;
+}
+
+static node_space_rec_t *_rotate_right(node_space_rec_t *rec)
+{
+	node_space_rec_t *top = rec->left;
+
+	rec->left = top->right;
+	top->right = rec;
+	_set_height(rec);
+	_set_height(top);
+	return top;
+}
+
+static node_space_rec_t *_rotate_left(node_space_rec_t *rec)
+{
+	node_space_rec_t *top = rec->right;
+
+	rec->right = top->left;
+	top->left = rec;
+	_set_height(rec);
+	_set_height(top);
+	return top;
+}
+
+/* Restore the AVL property at rec, RET the new root of the subtree */
+static node_space_rec_t *_balance(node_space_rec_t *rec)
+{
+	int diff;
+
+	_set_height(rec);
+	diff = _height(rec->left) - _height(rec->right);
+	if (diff > 1) {
+		if (_height(rec->left->left) < _height(rec->left->right))
+			rec->left = _rotate_left(rec->left);
+		return _rotate_right(rec);
+	}
+	if (diff < -1) {
+		if (_height(rec->right->right) < _height(rec->right->left))
+			rec->right = _rotate_right(rec->right);
+		return _rotate_left(rec);
+	}
+	return rec;
+}
+
+static node_space_rec_t *_tree_insert(node_space_rec_t *root,
+				      node_space_rec_t *rec)
+{
+	if (root == NULL) {
+		rec->left = rec->right = NULL;
+		rec->height = 1;
+		return rec;
+	}
+	if (rec->begin_time < root->begin_time)
+		root->left = _tree_insert(root->left, rec);
+	else
+		root->right = _tree_insert(root->right, rec);
+	return _balance(root);
+}
+
+static node_space_rec_t *_tree_remove_min(node_space_rec_t *root,
+					  node_space_rec_t **min_rec)
+{
+	if (root->left == NULL) {
+		*min_rec = root;
+		return root->right;
+	}
+	root->left = _tree_remove_min(root->left, min_rec);
+	return _balance(root);
+}
+
+static node_space_rec_t *_tree_remove(node_space_rec_t *root,
+				      node_space_rec_t *rec)
+{
+	node_space_rec_t *min_rec = NULL;
+
+	xassert(root);
+	if (rec->begin_time < root->begin_time) {
+		root->left = _tree_remove(root->left, rec);
+	} else if (rec->begin_time > root->begin_time) {
+		root->right = _tree_remove(root->right, rec);
+	} else {
+		if (root->right == NULL)
+			return root->left;
+		root->right = _tree_remove_min(root->right, &min_rec);
+		min_rec->left  = root->left;
+		min_rec->right = root->right;
+		root = min_rec;
+	}
+	return _balance(root);
+}
+
+/*****************************************************************************\
+ *  Slice list maintenance
+\*****************************************************************************/
+
+/* Split the slice containing "when" into two slices at that time */
+static void _split(node_space_map_t *map, time_t when)
+{
+	node_space_rec_t *rec, *new_rec;
+
+	rec = node_space_find(map, when);
+	if (!rec || (rec->begin_time >= when))
+		return;
+
+	new_rec = xmalloc(sizeof(node_space_rec_t));
+	new_rec->begin_time = when;
+	new_rec->end_time = rec->end_time;
+	new_rec->avail_bitmap = bit_copy(rec->avail_bitmap);
+	rec->end_time = when;
+
+	new_rec->prev = rec;
+	new_rec->next = rec->next;
+	if (rec->next)
+		rec->next->prev = new_rec;
+	rec->next = new_rec;
+	map->root = _tree_insert(map->root, new_rec);
+	map->rec_cnt++;
+}
+
+/* Merge a slice with the one following it */
+static void _merge_next(node_space_map_t *map, node_space_rec_t *rec)
+{
+	node_space_rec_t *next_rec = rec->next;
+
+	map->root = _tree_remove(map->root, next_rec);
+	rec->end_time = next_rec->end_time;
+	rec->next = next_rec->next;
+	if (rec->next)
+		rec->next->prev = rec;
+	FREE_NULL_BITMAP(next_rec->avail_bitmap);
+	xfree(next_rec);
+	map->rec_cnt--;
+}
+
+/* Count a reservation beginning or ending at the given time on the slice
+ * beginning then. Slices with such a count are not merged into the one
+ * before, so each slice lies either wholly inside or wholly outside each
+ * reservation. No slice begins at a time outside of the window. */
+static void _resv_edge(node_space_map_t *map, time_t when, int delta)
+{
+	node_space_rec_t *rec = node_space_find(map, when);
+
+	if (rec && (rec->begin_time == when))
+		rec->resv_edges += delta;
+}
+
+/* Rebuild the slices in [start_time, end_time) from the base bitmap and
+ * the remaining reservations, then merge identical neighbouring slices */
+static void _rebuild(node_space_map_t *map, time_t start_time,
+		     time_t end_time)
+{
+	node_space_rec_t *rec;
+	node_space_resv_t *resv, **overlap;
+	ListIterator iter;
+	int i, overlap_cnt = 0;
+
+	/* Only the reservations overlapping the span are applied to its
+	 * slices, rather than testing every reservation for every slice */
+	overlap = xmalloc(sizeof(node_space_resv_t *) *
+			  (list_count(map->resv_list) + 1));
+	iter = list_iterator_create(map->resv_list);
+	while ((resv = (node_space_resv_t *) list_next(iter))) {
+		if ((resv->start_time < end_time) &&
+		    (resv->end_time > start_time))
+			overlap[overlap_cnt++] = resv;
+	}
+	list_iterator_destroy(iter);
+
+	for (rec = node_space_find(map, start_time);
+	     rec && (rec->begin_time < end_time); rec = rec->next) {
+		bit_copybits(rec->avail_bitmap, map->base_bitmap);
+		for (i = 0; i < overlap_cnt; i++) {
+			resv = overlap[i];
+			if ((resv->start_time < rec->end_time) &&
+			    (resv->end_time > rec->begin_time))
+				bit_and(rec->avail_bitmap, resv->avail_bitmap);
+		}
+	}
+	xfree(overlap);
+
+	rec = node_space_find(map, start_time);
+	if (rec && rec->prev)
+		rec = rec->prev;
+	while (rec && rec->next && (rec->next->begin_time <= end_time)) {
+		if ((rec->next->resv_edges == 0) &&
+		    bit_equal(rec->avail_bitmap, rec->next->avail_bitmap))
+			_merge_next(map, rec);
+		else
+			rec = rec->next;
+	}
+}
+
+/*****************************************************************************\
+ *  Public functions
+\*****************************************************************************/
+
+extern node_space_map_t *node_space_create(time_t begin_time,
+					   time_t end_time,
+					   bitstr_t *avail_bitmap)
+{
+	node_space_map_t *map = xmalloc(sizeof(node_space_map_t));
+	node_space_rec_t *rec = xmalloc(sizeof(node_space_rec_t));
+
+	rec->begin_time = begin_time;
+	rec->end_time = end_time;
+	rec->avail_bitmap = bit_copy(avail_bitmap);
+	rec->height = 1;
+	map->root = map->first = rec;
+	map->rec_cnt = 1;
+	map->base_bitmap = bit_copy(avail_bitmap);
+	map->resv_list = list_create(_resv_del);
+	return map;
+}
+
+extern void node_space_destroy(node_space_map_t *map)
+{
+	node_space_rec_t *rec, *next_rec;
+
+	if (!map)
+		return;
+	for (rec = map->first; rec; rec = next_rec) {
+		next_rec = rec->next;
+		FREE_NULL_BITMAP(rec->avail_bitmap);
+		xfree(rec);
+	}
+	FREE_NULL_BITMAP(map->base_bitmap);
+	list_destroy(map->resv_list);
+	xfree(map);
+}
+
+extern node_space_rec_t *node_space_find(node_space_map_t *map, time_t when)
+{
+	node_space_rec_t *rec = map->root, *found = NULL;
+
+	while (rec) {
+		if (rec->end_time > when) {
+			found = rec;
+			if (rec->begin_time <= when)
+				break;
+			rec = rec->left;
+		} else
+			rec = rec->right;
+	}
+	return found;
+}
+
+extern void node_space_reserve(node_space_map_t *map, uint32_t job_id,
+			       time_t start_time, time_t end_time,
+			       bitstr_t *res_bitmap)
+{
+	node_space_rec_t *rec;
+	node_space_resv_t *resv;
+
+	if (start_time >= end_time)
+		return;
+
+	resv = xmalloc(sizeof(node_space_resv_t));
+	resv->job_id = job_id;
+	resv->start_time = start_time;
+	resv->end_time = end_time;
+	resv->avail_bitmap = bit_copy(res_bitmap);
+	list_append(map->resv_list, resv);
+
+	_split(map, start_time);
+	_split(map, end_time);
+	_resv_edge(map, start_time, 1);
+	_resv_edge(map, end_time, 1);
+	for (rec = node_space_find(map, start_time);
+	     rec && (rec->begin_time < end_time); rec = rec->next)
+		bit_and(rec->avail_bitmap, res_bitmap);
+}
+
+extern int node_space_release_if(node_space_map_t *map,
+				 bool (*test) (uint32_t job_id, void *arg),
+				 void *arg)
+{
+	node_space_resv_t *resv;
+	ListIterator iter;
+	time_t start_time = 0, end_time = 0;
+	int cnt = 0;
+
+	iter = list_iterator_create(map->resv_list);
+	while ((resv = (node_space_resv_t *) list_next(iter))) {
+		if (!(*test)(resv->job_id, arg))
+			continue;
+		if ((cnt++ == 0) || (resv->start_time < start_time))
+			start_time = resv->start_time;
+		end_time = MAX(end_time, resv->end_time);
+		_resv_edge(map, resv->start_time, -1);
+		_resv_edge(map, resv->end_time, -1);
+		list_delete_item(iter);
+	}
+	list_iterator_destroy(iter);
+
+	if (cnt)
+		_rebuild(map, start_time, end_time);
+	return cnt;
+}
+
+extern bool node_space_overlap(node_space_map_t *map, bitstr_t *use_bitmap,
+			       time_t start_time, time_t end_time)
+{
+	node_space_rec_t *rec;
+
+	for (rec = node_space_find(map, start_time);
+	     rec && (rec->begin_time < end_time); rec = rec->next) {
+		if (!bit_super_set(use_bitmap, rec->avail_bitmap))
+			return true;
+	}
+	return false;
+}
+
+extern void node_space_dump(node_space_map_t *map)
+{
+	node_space_rec_t *rec;
+	char begin_buf[32], end_buf[32], *node_list;
+
+	info("=========================================");
+	for (rec = map->first; rec; rec = rec->next) {
+		slurm_make_time_str(&rec->begin_time,
+				    begin_buf, sizeof(begin_buf));
+		slurm_make_time_str(&rec->end_time,
+				    end_buf, sizeof(end_buf));
+		node_list = bitmap2node_name(rec->avail_bitmap);
+		info("Begin:%s End:%s Nodes:%s",
+		     begin_buf, end_buf, node_list);
+		xfree(node_list);
+	}
+	info("=========================================");
+}
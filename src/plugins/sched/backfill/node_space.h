@@ -0,0 +1,126 @@
+/*****************************************************************************\
+ *  node_space.h - backfill scheduler's map of node availability over time
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _SLURM_BACKFILL_NODE_SPACE_H
+#define _SLURM_BACKFILL_NODE_SPACE_H
+
+#include <time.h>
+
+#include "src/common/bitstring.h"
+#include "src/common/list.h"
+
+/*
+ * The map divides the backfill window into contiguous time slices, each
+ * recording the nodes not reserved for pending jobs during that slice.
+ * Slices are kept both in a balanced (AVL) tree keyed on begin_time, so the
+ * slice containing any time is found in O(log n), and in a list ordered by
+ * time for walking forward from there. Each reservation is also recorded so
+ * that it can be released again when its job starts or ends.
+ */
+typedef struct node_space_rec node_space_rec_t;
+struct node_space_rec {
+	time_t begin_time;
+	time_t end_time;
+	bitstr_t *avail_bitmap;		/* nodes not reserved in this slice */
+	node_space_rec_t *next;		/* next slice by time, NULL if last */
+	node_space_rec_t *prev;		/* previous slice by time */
+	node_space_rec_t *left;		/* AVL tree links */
+	node_space_rec_t *right;
+	int height;
+	int resv_edges;			/* count of reservations beginning or
+					 * ending at begin_time */
+};
+
+typedef struct node_space_map {
+	node_space_rec_t *root;		/* AVL tree of slices */
+	node_space_rec_t *first;	/* earliest slice */
+	int rec_cnt;			/* count of slices */
+	bitstr_t *base_bitmap;		/* nodes available with no
+					 * reservations */
+	List resv_list;			/* node_space_resv_t records */
+} node_space_map_t;
+
+/*
+ * node_space_create - create a map with a single slice
+ * IN begin_time, end_time - the backfill window
+ * IN avail_bitmap - nodes available for use, copied
+ * RET the new map, free with node_space_destroy()
+ */
+extern node_space_map_t *node_space_create(time_t begin_time,
+					   time_t end_time,
+					   bitstr_t *avail_bitmap);
+
+/* node_space_destroy - free a map and all of its slices and reservations */
+extern void node_space_destroy(node_space_map_t *map);
+
+/*
+ * node_space_find - find the earliest slice ending after the given time
+ * RET the slice or NULL if the window ends at or before when
+ */
+extern node_space_rec_t *node_space_find(node_space_map_t *map, time_t when);
+
+/*
+ * node_space_reserve - reserve nodes for a job, splitting slices at
+ *	start_time and end_time as needed
+ * IN job_id - job the reservation is for, see node_space_release_if()
+ * IN start_time, end_time - time span of the reservation
+ * IN res_bitmap - nodes which remain available (NOT the nodes reserved)
+ */
+extern void node_space_reserve(node_space_map_t *map, uint32_t job_id,
+			       time_t start_time, time_t end_time,
+			       bitstr_t *res_bitmap);
+
+/*
+ * node_space_release_if - release the reservations of every job for which
+ *	the function returns true
+ * IN test - function called with each reserved job_id and arg
+ * RET count of reservations released
+ */
+extern int node_space_release_if(node_space_map_t *map,
+				 bool (*test) (uint32_t job_id, void *arg),
+				 void *arg);
+
+/*
+ * node_space_overlap - test if nodes are reserved for some job at any time
+ *	in the span [start_time, end_time)
+ * IN use_bitmap - nodes to be allocated
+ */
+extern bool node_space_overlap(node_space_map_t *map, bitstr_t *use_bitmap,
+			       time_t start_time, time_t end_time);
+
+/* node_space_dump - log the contents of a map */
+extern void node_space_dump(node_space_map_t *map);
+
+#endif	/* _SLURM_BACKFILL_NODE_SPACE_H */
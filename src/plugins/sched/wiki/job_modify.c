@@ -73,6 +73,7 @@ static int	_job_modify(uint32_t jobid, char *bank_ptr,
 		error("wiki: MODIFYJOB jobid %u is finished", jobid);
 		return ESLURM_DISABLED;
 	}
+	job_journal_mark(job_ptr);
 
 	if (depend_ptr) {
 		int rc = update_job_dependency(job_ptr, depend_ptr);
@@ -96,6 +97,7 @@ static int	_job_modify(uint32_t jobid, char *bank_ptr,
 		job_ptr->end_time = job_ptr->end_time +
 				((job_ptr->time_limit -
 				  old_time) * 60);
+		job_timer_arm(job_ptr);
 		last_job_update = time(NULL);
 	}
 
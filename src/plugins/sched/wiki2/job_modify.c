@@ -80,6 +80,7 @@ static int	_job_modify(uint32_t jobid, char *bank_ptr,
 		info("wiki: MODIFYJOB jobid %u is finished", jobid);
 		return ESLURM_DISABLED;
 	}
+	job_journal_mark(job_ptr);
 
 	if (comment_ptr) {
 		info("wiki: change job %u comment %s", jobid, comment_ptr);
@@ -191,6 +192,7 @@ static int	_job_modify(uint32_t jobid, char *bank_ptr,
 		job_ptr->end_time = job_ptr->end_time +
 				((job_ptr->time_limit -
 				  old_time) * 60);
+		job_timer_arm(job_ptr);
 		last_job_update = now;
 	}
 
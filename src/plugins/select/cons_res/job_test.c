@@ -709,6 +709,87 @@ static int _is_node_busy(struct part_res_record *p_ptr, uint32_t node_i,
 }
 
 
+
+/* Clear from node_map the nodes of one switch */
+static void _clear_switch_nodes(bitstr_t *node_map, int switch_inx)
+{
+	bitstr_t *switch_map = switch_record_table[switch_inx].node_bitmap;
+	int i, first, last;
+
+	first = bit_ffs(switch_map);
+	if (first < 0)
+		return;
+	last = MIN(bit_fls(switch_map), bit_size(node_map) - 1);
+	for (i = first; i <= last; i++) {
+		if (bit_test(switch_map, i))
+			bit_clear(node_map, i);
+	}
+}
+
+/* Remove from node_map the leaf switches on which no node has min_mem MB
+ * of memory free, using the summaries of select_node_usage. Switches with
+ * nodes required by the job are left for the node by node test. */
+static void _prune_switches_by_mem(struct job_record *job_ptr,
+				   bitstr_t *node_map, uint32_t min_mem)
+{
+	bitstr_t *req_map = job_ptr->details->req_node_bitmap;
+	int i;
+
+	if (!select_switch_free ||
+	    (select_switch_free_cnt != switch_record_cnt))
+		return;
+	for (i = 0; i < select_switch_free_cnt; i++) {
+		if ((switch_record_table[i].level != 0) ||
+		    (select_switch_free[i].max_free_mem >= min_mem))
+			continue;
+		if (req_map &&
+		    bit_overlap(req_map, switch_record_table[i].node_bitmap))
+			continue;
+		debug3("cons_res: _vns: switch %s no mem %u < %u",
+		       switch_record_table[i].name,
+		       select_switch_free[i].max_free_mem, min_mem);
+		_clear_switch_nodes(node_map, i);
+	}
+}
+
+/* Remove from node_map the nodes with no core free in any partition row,
+ * using the summaries of select_part_record: first the leaf switches on
+ * which no node has a free core, then any remaining busy nodes. Such nodes
+ * could contribute no CPUs to the job when the existing allocations are
+ * removed from its cores.
+ * RET SLURM_ERROR if a node required by the job has no free core */
+static int _prune_busy_nodes(struct job_record *job_ptr, bitstr_t *node_map)
+{
+	bitstr_t *req_map = job_ptr->details->req_node_bitmap;
+	int i, first, last;
+
+	if (select_switch_free &&
+	    (select_switch_free_cnt == switch_record_cnt)) {
+		for (i = 0; i < select_switch_free_cnt; i++) {
+			if ((switch_record_table[i].level != 0) ||
+			    (select_switch_free[i].max_free_cores != 0))
+				continue;
+			if (req_map && bit_overlap(req_map,
+					switch_record_table[i].node_bitmap))
+				continue;
+			_clear_switch_nodes(node_map, i);
+		}
+	}
+
+	first = bit_ffs(node_map);
+	if (first < 0)
+		return SLURM_SUCCESS;
+	last = bit_fls(node_map);
+	for (i = first; i <= last; i++) {
+		if (!bit_test(node_map, i) || select_node_free_cores[i])
+			continue;
+		if (req_map && bit_test(req_map, i))
+			return SLURM_ERROR;
+		bit_clear(node_map, i);
+	}
+	return SLURM_SUCCESS;
+}
+
 /*
  * Determine which of these nodes are usable by this job
  *
@@ -749,6 +830,9 @@ static int _verify_node_state(struct part_res_record *cr_part_ptr,
 	} else {
 		min_mem = job_ptr->details->pn_min_memory;
 	}
+	if ((job_ptr->details->pn_min_memory) && (cr_type & CR_MEMORY) &&
+	    (node_usage == select_node_usage))
+		_prune_switches_by_mem(job_ptr, bitmap, min_mem);
 	size = bit_size(bitmap);
 	for (i = 0; i < size; i++) {
 		if (!bit_test(bitmap, i))
@@ -862,14 +946,13 @@ bitstr_t *_make_core_bitmap(bitstr_t *node_map)
 	if (!core_map)
 		return NULL;
 
-	nodes = bit_size(node_map);
-	for (n = 0, c = 0; n < nodes; n++) {
-		if (bit_test(node_map, n)) {
-			coff = cr_get_coremap_offset(n+1);
-			while (c < coff) {
-				bit_set(core_map, c++);
-			}
-		}
+	for (n = 0; n < nodes; n++) {
+		if (!bit_test(node_map, n))
+			continue;
+		c = cr_get_coremap_offset(n);
+		coff = cr_get_coremap_offset(n+1);
+		if (coff > c)
+			bit_nset(core_map, c, coff - 1);
 	}
 	return core_map;
 }
@@ -2171,9 +2254,16 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *bitmap,
 			bit_and(free_cores, tmpcore);
 		}
 	}
-	cpu_count = _select_nodes(job_ptr, min_nodes, max_nodes, req_nodes,
-				  bitmap, cr_node_cnt, free_cores,
-				  node_usage, cr_type, test_only);
+	/* skip busy switches and nodes before any core level work */
+	if ((cr_part_ptr == select_part_record) && select_node_free_cores &&
+	    (_prune_busy_nodes(job_ptr, bitmap) != SLURM_SUCCESS))
+		cpu_count = NULL;
+	else {
+		cpu_count = _select_nodes(job_ptr, min_nodes, max_nodes,
+					  req_nodes, bitmap, cr_node_cnt,
+					  free_cores, node_usage, cr_type,
+					  test_only);
+	}
 
 	if ((cpu_count) && (job_ptr->best_switch)) {
 		/* job fits! We're done. */
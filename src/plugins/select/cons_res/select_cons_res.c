@@ -183,6 +183,12 @@ uint16_t select_fast_schedule;
 struct part_res_record *select_part_record = NULL;
 struct node_res_record *select_node_record = NULL;
 struct node_use_record *select_node_usage  = NULL;
+uint16_t *select_node_free_cores = NULL;
+struct switch_free_record *select_switch_free = NULL;
+int select_switch_free_cnt = 0;
+static int *node_leaf_start = NULL;	/* index of node's first entry in
+					 * node_leaf_inx, node_cnt + 1 entries */
+static int *node_leaf_inx = NULL;	/* leaf switches of each node */
 static bool select_state_initializing = true;
 static int select_node_cnt = 0;
 static bool job_preemption_enabled = false;
@@ -472,6 +478,196 @@ static void _destroy_node_data(struct node_use_record *node_usage,
 	}
 }
 
+/* Count the cores of a node which are not allocated to any job in any row
+ * of any partition */
+static uint16_t _node_free_cores(int node_inx)
+{
+	struct part_res_record *p_ptr;
+	uint32_t c, core_begin = cr_get_coremap_offset(node_inx);
+	uint32_t core_end = cr_get_coremap_offset(node_inx + 1);
+	uint16_t free_cnt = 0;
+	bool busy;
+	int r;
+
+	for (c = core_begin; c < core_end; c++) {
+		busy = false;
+		for (p_ptr = select_part_record; p_ptr && !busy;
+		     p_ptr = p_ptr->next) {
+			if (!p_ptr->row)
+				continue;
+			for (r = 0; r < p_ptr->num_rows; r++) {
+				if (p_ptr->row[r].row_bitmap &&
+				    bit_test(p_ptr->row[r].row_bitmap, c)) {
+					busy = true;
+					break;
+				}
+			}
+		}
+		if (!busy)
+			free_cnt++;
+	}
+	return free_cnt;
+}
+
+static uint32_t _node_free_mem(int node_inx)
+{
+	if (select_node_record[node_inx].real_memory <=
+	    select_node_usage[node_inx].alloc_memory)
+		return 0;
+	return select_node_record[node_inx].real_memory -
+	       select_node_usage[node_inx].alloc_memory;
+}
+
+/* Recompute the summary of one leaf switch from its nodes' */
+static void _free_switch_sum(int switch_inx)
+{
+	struct switch_free_record *sw_ptr = &select_switch_free[switch_inx];
+	bitstr_t *node_bitmap = switch_record_table[switch_inx].node_bitmap;
+	int i, first, last;
+
+	memset(sw_ptr, 0, sizeof(struct switch_free_record));
+	first = bit_ffs(node_bitmap);
+	if (first < 0)
+		return;
+	last = MIN(bit_fls(node_bitmap), select_node_cnt - 1);
+	for (i = first; i <= last; i++) {
+		if (!bit_test(node_bitmap, i))
+			continue;
+		sw_ptr->free_cores += select_node_free_cores[i];
+		sw_ptr->max_free_cores = MAX(sw_ptr->max_free_cores,
+					     select_node_free_cores[i]);
+		sw_ptr->max_free_mem = MAX(sw_ptr->max_free_mem,
+					   _node_free_mem(i));
+	}
+}
+
+/* Build the free resource summaries for a new node table and partition
+ * records, before any jobs have been added */
+static void _free_res_init(void)
+{
+	bitstr_t *node_bitmap;
+	int i, j, first, last, *leaf_cnt;
+
+	xfree(select_node_free_cores);
+	xfree(select_switch_free);
+	xfree(node_leaf_start);
+	xfree(node_leaf_inx);
+
+	select_node_free_cores = xmalloc(sizeof(uint16_t) *
+					 MAX(select_node_cnt, 1));
+	for (i = 0; i < select_node_cnt; i++)
+		select_node_free_cores[i] = cr_get_coremap_offset(i + 1) -
+					    cr_get_coremap_offset(i);
+
+	/* Map each node to the leaf switches it is on */
+	select_switch_free_cnt = switch_record_table ? switch_record_cnt : 0;
+	if (select_switch_free_cnt == 0)
+		return;
+	node_leaf_start = xmalloc(sizeof(int) * (select_node_cnt + 1));
+	leaf_cnt = xmalloc(sizeof(int) * MAX(select_node_cnt, 1));
+	for (j = 0; j < select_switch_free_cnt; j++) {
+		if (switch_record_table[j].level != 0)
+			continue;
+		node_bitmap = switch_record_table[j].node_bitmap;
+		first = bit_ffs(node_bitmap);
+		if (first < 0)
+			continue;
+		last = MIN(bit_fls(node_bitmap), select_node_cnt - 1);
+		for (i = first; i <= last; i++) {
+			if (bit_test(node_bitmap, i))
+				leaf_cnt[i]++;
+		}
+	}
+	for (i = 0; i < select_node_cnt; i++) {
+		node_leaf_start[i + 1] = node_leaf_start[i] + leaf_cnt[i];
+		leaf_cnt[i] = 0;
+	}
+	node_leaf_inx = xmalloc(sizeof(int) *
+				MAX(node_leaf_start[select_node_cnt], 1));
+	for (j = 0; j < select_switch_free_cnt; j++) {
+		if (switch_record_table[j].level != 0)
+			continue;
+		node_bitmap = switch_record_table[j].node_bitmap;
+		first = bit_ffs(node_bitmap);
+		if (first < 0)
+			continue;
+		last = MIN(bit_fls(node_bitmap), select_node_cnt - 1);
+		for (i = first; i <= last; i++) {
+			if (bit_test(node_bitmap, i)) {
+				node_leaf_inx[node_leaf_start[i] +
+					      leaf_cnt[i]++] = j;
+			}
+		}
+	}
+	xfree(leaf_cnt);
+
+	select_switch_free = xmalloc(sizeof(struct switch_free_record) *
+				     select_switch_free_cnt);
+	for (j = 0; j < select_switch_free_cnt; j++) {
+		if (switch_record_table[j].level == 0)
+			_free_switch_sum(j);
+	}
+}
+
+static void _free_res_fini(void)
+{
+	xfree(select_node_free_cores);
+	xfree(select_switch_free);
+	xfree(node_leaf_start);
+	xfree(node_leaf_inx);
+	select_switch_free_cnt = 0;
+}
+
+/* Update the free resource summaries of the nodes in node_bitmap, and of
+ * their leaf switches, after jobs have been added to or removed from them */
+static void _free_res_update(bitstr_t *node_bitmap)
+{
+	bitstr_t *leaf_bitmap = NULL;
+	int i, j, first, last;
+
+	if (!select_node_free_cores || !node_bitmap)
+		return;
+	first = bit_ffs(node_bitmap);
+	if (first < 0)
+		return;
+	last = MIN(bit_fls(node_bitmap), select_node_cnt - 1);
+	if (select_switch_free)
+		leaf_bitmap = bit_alloc(select_switch_free_cnt);
+	for (i = first; i <= last; i++) {
+		if (!bit_test(node_bitmap, i))
+			continue;
+		select_node_free_cores[i] = _node_free_cores(i);
+		if (!leaf_bitmap)
+			continue;
+		for (j = node_leaf_start[i]; j < node_leaf_start[i + 1]; j++)
+			bit_set(leaf_bitmap, node_leaf_inx[j]);
+	}
+	if (!leaf_bitmap)
+		return;
+	first = bit_ffs(leaf_bitmap);
+	if (first >= 0) {
+		last = bit_fls(leaf_bitmap);
+		for (j = first; j <= last; j++) {
+			if (bit_test(leaf_bitmap, j))
+				_free_switch_sum(j);
+		}
+	}
+	FREE_NULL_BITMAP(leaf_bitmap);
+}
+
+/* As _free_res_update() for one node */
+static void _free_res_update_node(int node_inx)
+{
+	bitstr_t *node_bitmap;
+
+	if (!select_node_free_cores)
+		return;
+	node_bitmap = bit_alloc(select_node_cnt);
+	bit_set(node_bitmap, node_inx);
+	_free_res_update(node_bitmap);
+	FREE_NULL_BITMAP(node_bitmap);
+}
+
 
 static void _add_job_to_row(struct job_resources *job,
 			    struct part_row_data *r_ptr)
@@ -843,6 +1039,7 @@ static int _add_job_to_res(struct job_record *job_ptr, int action)
 		if (!p_ptr) {
 			error("cons_res: could not find cr partition %s",
 			      job_ptr->part_ptr->name);
+			_free_res_update(job->node_bitmap);
 			return SLURM_ERROR;
 		}
 		if (!p_ptr->row) {
@@ -880,6 +1077,7 @@ static int _add_job_to_res(struct job_record *job_ptr, int action)
 			_dump_part(p_ptr);
 		}
 	}
+	_free_res_update(job->node_bitmap);
 
 	return SLURM_SUCCESS;
 }
@@ -1117,7 +1315,7 @@ static int _rm_job_from_res(struct part_res_record *part_record_ptr,
 	struct job_resources *job = job_ptr->job_resrcs;
 	struct node_record *node_ptr;
 	int first_bit, last_bit;
-	int i, n;
+	int i, n, rc = SLURM_SUCCESS;
 	List gres_list;
 
 	if (select_state_initializing) {
@@ -1185,7 +1383,8 @@ static int _rm_job_from_res(struct part_res_record *part_record_ptr,
 			error("cons_res: removed job %u does not have a "
 			      "partition assigned",
 			      job_ptr->job_id);
-			return SLURM_ERROR;
+			rc = SLURM_ERROR;
+			goto fini;
 		}
 
 		for (p_ptr = part_record_ptr; p_ptr; p_ptr = p_ptr->next) {
@@ -1195,11 +1394,12 @@ static int _rm_job_from_res(struct part_res_record *part_record_ptr,
 		if (!p_ptr) {
 			error("cons_res: removed job %u could not find part %s",
 			      job_ptr->job_id, job_ptr->part_ptr->name);
-			return SLURM_ERROR;
+			rc = SLURM_ERROR;
+			goto fini;
 		}
 
 		if (!p_ptr->row)
-			return SLURM_SUCCESS;
+			goto fini;
 
 		/* remove the job from the job_list */
 		n = 0;
@@ -1253,7 +1453,10 @@ static int _rm_job_from_res(struct part_res_record *part_record_ptr,
 		}
 	}
 
-	return SLURM_SUCCESS;
+fini:	if ((part_record_ptr == select_part_record) &&
+	    (node_usage == select_node_usage))
+		_free_res_update(job->node_bitmap);
+	return rc;
 }
 
 static int _rm_job_from_one_node(struct job_record *job_ptr,
@@ -1264,7 +1467,7 @@ static int _rm_job_from_one_node(struct job_record *job_ptr,
 	struct job_resources *job = job_ptr->job_resrcs;
 	struct part_res_record *p_ptr;
 	int first_bit, last_bit;
-	int i, node_inx, n;
+	int i, node_inx, n, rc = SLURM_SUCCESS;
 	List gres_list;
 
 	if (!job || !job->core_bitmap) {
@@ -1319,13 +1522,14 @@ static int _rm_job_from_one_node(struct job_record *job_ptr,
 	}
 
 	if (IS_JOB_SUSPENDED(job_ptr))
-		return SLURM_SUCCESS;	/* No cores allocated to the job now */
+		goto fini;	/* No cores allocated to the job now */
 
 	/* subtract cores, reconstruct rows with remaining jobs */
 	if (!job_ptr->part_ptr) {
 		error("cons_res: removed job %u does not have a partition "
 		      "assigned", job_ptr->job_id);
-		return SLURM_ERROR;
+		rc = SLURM_ERROR;
+		goto fini;
 	}
 
 	for (p_ptr = part_record_ptr; p_ptr; p_ptr = p_ptr->next) {
@@ -1335,11 +1539,12 @@ static int _rm_job_from_one_node(struct job_record *job_ptr,
 	if (!p_ptr) {
 		error("cons_res: removed job %u could not find part %s",
 		      job_ptr->job_id, job_ptr->part_ptr->name);
-		return SLURM_ERROR;
+		rc = SLURM_ERROR;
+		goto fini;
 	}
 
 	if (!p_ptr->row)
-		return SLURM_SUCCESS;
+		goto fini;
 
 	/* look for the job in the partition's job_list */
 	n = 0;
@@ -1359,7 +1564,8 @@ static int _rm_job_from_one_node(struct job_record *job_ptr,
 	if (n == 0) {
 		error("cons_res: could not find job %u in partition %s",
 		      job_ptr->job_id, p_ptr->part_ptr->name);
-		return SLURM_ERROR;
+		rc = SLURM_ERROR;
+		goto fini;
 	}
 
 
@@ -1375,7 +1581,8 @@ static int _rm_job_from_one_node(struct job_record *job_ptr,
 		node_usage[node_inx].node_state = NODE_CR_AVAILABLE;
 	}
 
-	return SLURM_SUCCESS;
+fini:	_free_res_update_node(node_inx);
+	return rc;
 }
 
 static struct multi_core_data * _create_default_mc(void)
@@ -1809,6 +2016,7 @@ extern int fini(void)
 	select_node_usage = NULL;
 	_destroy_part_data(select_part_record);
 	select_part_record = NULL;
+	_free_res_fini();
 	cr_fini_global_core_data();
 
 	if (cr_type)
@@ -1926,6 +2134,7 @@ extern int select_p_node_init(struct node_record *node_ptr, int node_cnt)
 						   node_ptr->gres_list);
 	}
 	_create_part_data();
+	_free_res_init();
 
 	return SLURM_SUCCESS;
 }
@@ -2471,6 +2680,7 @@ extern int select_p_update_node_config (int index)
 
 	select_node_record[index].real_memory = select_node_record[index].
 		node_ptr->real_memory;
+	_free_res_update_node(index);
 	return SLURM_SUCCESS;
 }
 
@@ -102,6 +102,13 @@ struct node_use_record {
 	uint16_t node_state;		/* see node_cr_state comments */
 };
 
+/* resources of a leaf switch's nodes not allocated to any job */
+struct switch_free_record {
+	uint32_t free_cores;		/* free cores on all of its nodes */
+	uint16_t max_free_cores;	/* most free cores on one node */
+	uint32_t max_free_mem;		/* most MB of free memory on one node */
+};
+
 extern uint32_t select_debug_flags;
 extern uint16_t select_fast_schedule;
 
@@ -109,6 +116,14 @@ extern struct part_res_record *select_part_record;
 extern struct node_res_record *select_node_record;
 extern struct node_use_record *select_node_usage;
 
+/* Summaries of select_part_record and select_node_usage, kept current as
+ * jobs are added and removed: per node, the count of cores not allocated in
+ * any partition row, and per switch, a switch_free_record (set for leaf
+ * switches only). NULL if not yet built. */
+extern uint16_t *select_node_free_cores;
+extern struct switch_free_record *select_switch_free;
+extern int select_switch_free_cnt;
+
 extern void cr_sort_part_rows(struct part_res_record *p_ptr);
 extern uint32_t cr_get_coremap_offset(uint32_t node_index);
 
@@ -528,6 +528,7 @@ void _init_params()
 	memset(&params, 0, sizeof(sacct_parameters_t));
 	params.job_cond = xmalloc(sizeof(slurmdb_job_cond_t));
 	params.job_cond->without_usage_truncation = 1;
+	params.job_cond->page_size = SACCT_PAGE_SIZE;
 }
 
 int get_data(void)
@@ -588,6 +589,39 @@ int get_data(void)
 	return SLURM_SUCCESS;
 }
 
+/* get_next_page() -- Replace a full page of jobs from get_data() with
+ * the jobs which follow them.
+ *
+ * RET true if there are more jobs to list
+ */
+bool get_next_page(void)
+{
+	slurmdb_job_cond_t *job_cond = params.job_cond;
+	slurmdb_job_rec_t *job = NULL, *last_job = NULL;
+	ListIterator itr = NULL;
+
+	/* page_size is cleared by storage which gave every job at once */
+	if (params.opt_completion || !job_cond->page_size || !jobs
+	    || (list_count(jobs) < job_cond->page_size))
+		return false;
+
+	itr = list_iterator_create(jobs);
+	while ((job = list_next(itr)))
+		last_job = job;
+	list_iterator_destroy(itr);
+
+	xfree(job_cond->page_cluster);
+	job_cond->page_cluster = xstrdup(last_job->cluster);
+	job_cond->page_jobid = last_job->jobid;
+	list_destroy(jobs);
+	jobs = NULL;
+
+	if (get_data() == SLURM_ERROR)
+		exit(errno);
+
+	return (list_count(jobs) > 0);
+}
+
 void parse_command_line(int argc, char **argv)
 {
 	extern int optind;
@@ -137,8 +137,13 @@ int main(int argc, char **argv)
 			exit(errno);
 		if (params.opt_completion)
 			do_list_completion();
-		else
-			do_list();
+		else {
+			/* Jobs are got a page at a time so the first are
+			 * listed while the rest are still in storage */
+			do {
+				do_list();
+			} while (get_next_page());
+		}
 		break;
 	case SACCT_HELP:
 		do_help();
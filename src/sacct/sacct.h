@@ -76,6 +76,8 @@
 #define STATE_COUNT 10
 
 #define MAX_PRINTFIELDS 100
+#define SACCT_PAGE_SIZE 1000	/* jobs got from storage and printed at a
+				 * time */
 #define FORMAT_STRING_SIZE 34
 
 #define SECONDS_IN_MINUTE 60
@@ -185,6 +187,7 @@ void print_fields(type_t type, void *object);
 
 /* options.c */
 int get_data(void);
+bool get_next_page(void);
 void parse_command_line(int argc, char **argv);
 void do_help(void);
 void do_list(void);
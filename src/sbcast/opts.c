@@ -62,6 +62,7 @@
 
 #define OPT_LONG_HELP   0x100
 #define OPT_LONG_USAGE  0x101
+#define OPT_LONG_PIPELINE 0x102
 
 /* getopt_long options, integers but not characters */
 
@@ -83,6 +84,7 @@ extern void parse_command_line(int argc, char *argv[])
 		{"compress",  no_argument,       0, 'C'},
 		{"fanout",    required_argument, 0, 'F'},
 		{"force",     no_argument,       0, 'f'},
+		{"pipeline",  required_argument, 0, OPT_LONG_PIPELINE},
 		{"preserve",  no_argument,       0, 'p'},
 		{"size",      required_argument, 0, 's'},
 		{"timeout",   required_argument, 0, 't'},
@@ -99,6 +101,9 @@ extern void parse_command_line(int argc, char *argv[])
 		params.fanout = atoi(env_val);
 	if (getenv("SBCAST_FORCE"))
 		params.force = true;
+	params.pipeline = DEFAULT_PIPELINE;
+	if ( ( env_val = getenv("SBCAST_PIPELINE") ) )
+		params.pipeline = atoi(env_val);
 	if (getenv("SBCAST_PRESERVE"))
 		params.preserve = true;
 	if ( ( env_val = getenv("SBCAST_SIZE") ) )
@@ -139,6 +144,9 @@ extern void parse_command_line(int argc, char *argv[])
 		case (int) 'V':
 			print_slurm_version();
 			exit(0);
+		case (int) OPT_LONG_PIPELINE:
+			params.pipeline = atoi(optarg);
+			break;
 		case (int) OPT_LONG_HELP:
 			_help();
 			exit(0);
@@ -155,6 +163,12 @@ extern void parse_command_line(int argc, char *argv[])
 		exit(1);
 	}
 
+	if (params.pipeline < 1) {
+		fprintf(stderr, "pipeline specification is invalid, "
+			"using 1\n");
+		params.pipeline = 1;
+	}
+
 	params.src_fname = xstrdup(argv[optind]);
 	params.dst_fname = xstrdup(argv[optind+1]);
 
@@ -199,6 +213,7 @@ static void _print_options( void )
 	info("compress   = %s", params.compress ? "true" : "false");
 	info("force      = %s", params.force ? "true" : "false");
 	info("fanout     = %d", params.fanout);
+	info("pipeline   = %d", params.pipeline);
 	info("preserve   = %s", params.preserve ? "true" : "false");
 	info("timeout    = %d", params.timeout);
 	info("verbose    = %d", params.verbose);
@@ -221,6 +236,7 @@ Usage: sbcast [OPTIONS] SOURCE DEST\n\
   -f, --force         replace destination file as required\n\
   -F, --fanout=num    specify message fanout\n\
   -p, --preserve      preserve modes and times of source file\n\
+      --pipeline=num  blocks sent before waiting for replies\n\
   -s, --size=num      block size in bytes (rounded off)\n\
   -t, --timeout=secs  specify message timeout (seconds)\n\
   -v, --verbose       provide detailed event logging\n\
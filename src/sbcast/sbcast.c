@@ -47,8 +47,12 @@
 #include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifdef HAVE_ZLIB_H
+#  include <zlib.h>
+#endif
 
 #include "slurm/slurm_errno.h"
 #include "src/common/forward.h"
@@ -187,52 +191,152 @@ static ssize_t _get_block(char *buffer, size_t buf_size)
 	return buf_used;
 }
 
-/* read and broadcast the file */
+#ifdef HAVE_ZLIB_H
+/* compress a block's data into comp_buf, sending it uncompressed instead
+ * if that does not make it any smaller */
+static void _compress_block(file_bcast_msg_t *bcast_msg, char *comp_buf,
+			    uLongf comp_size)
+{
+	uLongf comp_len = comp_size;
+
+	if ((bcast_msg->block_len == 0) ||
+	    (compress2((Bytef *) comp_buf, &comp_len,
+		       (Bytef *) bcast_msg->block, bcast_msg->block_len,
+		       Z_BEST_SPEED) != Z_OK) ||
+	    (comp_len >= bcast_msg->block_len))
+		return;
+
+	bcast_msg->block    = comp_buf;
+	bcast_msg->block_len = comp_len;
+	bcast_msg->compress = FILE_BCAST_COMPRESS_ZLIB;
+}
+#endif
+
+/* read and broadcast the file
+ *
+ * The first block creates the file and validates the credential, so it is
+ * sent alone. Up to params.pipeline of the following blocks are then in
+ * flight at once, each being written at its offset into the file, and the
+ * last block, which sets the file's modes and times, is sent once all of
+ * the others have been acknowledged. */
 static void _bcast_file(void)
 {
-	int buf_size;
+	int buf_size, i, depth = params.pipeline;
 	ssize_t size_read = 0;
-	file_bcast_msg_t bcast_msg;
-	char *buffer;
+	file_bcast_msg_t *bcast_msg, *msgs;
+	char **buffers, **comp_bufs = NULL;
+	int *pending;
+	uint64_t size_sent = 0;
+	uint16_t block_no = 1;
+	bool compress = params.compress;
+	struct timeval start_tv, end_tv;
+	double secs;
+#ifdef HAVE_ZLIB_H
+	uLongf comp_size = 0;
+#endif
 
 	if (params.block_size)
 		buf_size = MIN(params.block_size, f_stat.st_size);
 	else
 		buf_size = MIN((512 * 1024), f_stat.st_size);
 
-	bcast_msg.fname		= params.dst_fname;
-	bcast_msg.block_no	= 1;
-	bcast_msg.last_block	= 0;
-	bcast_msg.force		= params.force;
-	bcast_msg.modes		= f_stat.st_mode;
-	bcast_msg.uid		= f_stat.st_uid;
-	bcast_msg.gid		= f_stat.st_gid;
-	buffer			= xmalloc(buf_size);
-	bcast_msg.block		= buffer;
-	bcast_msg.block_len	= 0;
-	bcast_msg.cred          = sbcast_cred->sbcast_cred;
-
-	if (params.preserve) {
-		bcast_msg.atime     = f_stat.st_atime;
-		bcast_msg.mtime     = f_stat.st_mtime;
-	} else {
-		bcast_msg.atime     = 0;
-		bcast_msg.mtime     = 0;
+#ifdef HAVE_ZLIB_H
+	if (compress && (buf_size > FILE_BCAST_MAX_UNCOMP_LEN)) {
+		error("Block size too large to compress, sending "
+		      "uncompressed");
+		compress = false;
+	}
+	if (compress)
+		comp_size = compressBound(buf_size);
+#else
+	if (compress) {
+		error("Compression not supported, sending uncompressed");
+		compress = false;
+	}
+#endif
+
+	msgs      = xmalloc(sizeof(file_bcast_msg_t) * depth);
+	buffers   = xmalloc(sizeof(char *) * depth);
+	pending   = xmalloc(sizeof(int) * depth);
+	if (compress)
+		comp_bufs = xmalloc(sizeof(char *) * depth);
+	for (i = 0; i < depth; i++) {
+		bcast_msg = &msgs[i];
+		bcast_msg->fname	= params.dst_fname;
+		bcast_msg->force	= params.force;
+		bcast_msg->modes	= f_stat.st_mode;
+		bcast_msg->uid		= f_stat.st_uid;
+		bcast_msg->gid		= f_stat.st_gid;
+		bcast_msg->cred		= sbcast_cred->sbcast_cred;
+		if (params.preserve) {
+			bcast_msg->atime = f_stat.st_atime;
+			bcast_msg->mtime = f_stat.st_mtime;
+		}
+		buffers[i] = xmalloc(buf_size);
+#ifdef HAVE_ZLIB_H
+		if (compress)
+			comp_bufs[i] = xmalloc(comp_size);
+#endif
 	}
 
+	gettimeofday(&start_tv, NULL);
 	while (1) {
-		bcast_msg.block_len = _get_block(buffer, buf_size);
-		debug("block %d, size %u", bcast_msg.block_no,
-		      bcast_msg.block_len);
-		size_read += bcast_msg.block_len;
-		if (size_read >= f_stat.st_size)
-			bcast_msg.last_block = 1;
-
-		send_rpc(&bcast_msg, sbcast_cred);
-		if (bcast_msg.last_block)
+		i = (block_no - 1) % depth;
+		bcast_msg = &msgs[i];
+		/* wait for the previous use of this buffer to complete */
+		send_rpc_wait(&pending[i]);
+
+		bcast_msg->block_no	= block_no;
+		bcast_msg->block_offset	= size_read;
+		bcast_msg->block	= buffers[i];
+		bcast_msg->block_len	= _get_block(buffers[i], buf_size);
+		bcast_msg->uncomp_len	= bcast_msg->block_len;
+		bcast_msg->compress	= FILE_BCAST_COMPRESS_NONE;
+		size_read += bcast_msg->block_len;
+		if (size_read >= f_stat.st_size) {
+			bcast_msg->last_block = 1;
+			for (i = 0; i < depth; i++)
+				send_rpc_wait(&pending[i]);
+			i = (block_no - 1) % depth;
+		}
+#ifdef HAVE_ZLIB_H
+		if (compress)
+			_compress_block(bcast_msg, comp_bufs[i], comp_size);
+#endif
+		debug("block %d, size %u, sent %u", bcast_msg->block_no,
+		      bcast_msg->uncomp_len, bcast_msg->block_len);
+		size_sent += bcast_msg->block_len;
+
+		send_rpc_start(bcast_msg, sbcast_cred, &pending[i]);
+		if ((block_no == 1) || bcast_msg->last_block)
+			send_rpc_wait(&pending[i]);
+		if (bcast_msg->last_block)
 			break;	/* end of file */
-		bcast_msg.block_no++;
+		block_no++;
 	}
+	gettimeofday(&end_tv, NULL);
 
-	xfree(buffer);
+	secs = (end_tv.tv_sec - start_tv.tv_sec) +
+	       (end_tv.tv_usec - start_tv.tv_usec) / 1000000.0;
+	if (secs <= 0)
+		secs = 0.000001;
+	verbose("transferred %ld bytes in %u blocks to %u nodes in %.3f sec, "
+		"%.2f MB/s", (long) size_read, block_no,
+		sbcast_cred->node_cnt, secs,
+		size_read / secs / (1024 * 1024));
+	if (compress) {
+		verbose("sent %"PRIu64" bytes compressed, ratio %.2f",
+			size_sent, size_sent ?
+			((double) size_read / size_sent) : 1.0);
+	}
+
+	for (i = 0; i < depth; i++) {
+		xfree(buffers[i]);
+		if (comp_bufs)
+			xfree(comp_bufs[i]);
+	}
+	xfree(buffers);
+	xfree(comp_bufs);
+	xfree(pending);
+	xfree(msgs);
 }
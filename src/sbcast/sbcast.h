@@ -48,11 +48,15 @@
 #include "src/common/macros.h"
 #include "src/common/slurm_protocol_defs.h"
 
+/* Count of blocks sent before waiting for the first to be acknowledged */
+#define DEFAULT_PIPELINE	4
+
 struct sbcast_parameters {
 	uint32_t block_size;
 	bool compress;
 	int  fanout;
 	bool force;
+	int  pipeline;
 	bool preserve;
 	int  timeout;
 	int  verbose;
@@ -65,5 +69,8 @@ extern struct sbcast_parameters params;
 extern void parse_command_line(int argc, char *argv[]);
 extern void send_rpc(file_bcast_msg_t *bcast_msg,
 		     job_sbcast_cred_msg_t *sbcast_cred);
+extern void send_rpc_start(file_bcast_msg_t *bcast_msg,
+			   job_sbcast_cred_msg_t *sbcast_cred, int *pending);
+extern void send_rpc_wait(int *pending);
 
 #endif
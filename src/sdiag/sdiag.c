@@ -44,6 +44,7 @@
 
 #include <slurm.h>
 #include "src/common/macros.h"
+#include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 #include "src/common/slurm_protocol_defs.h"
 
@@ -56,6 +57,8 @@ stats_info_response_msg_t *buf;
 
 static int _get_info(void);
 static int _print_info(void);
+static void _print_lock_stats(void);
+static void _print_rpc_stats(void);
 
 stats_info_request_msg_t req;
 
@@ -109,6 +112,9 @@ static int _print_info(void)
 	printf("*******************************************************\n");
 
 	printf("Server thread count: %d\n", buf->server_thread_count);
+	printf("RPC worker threads:  %u\n", buf->rpc_worker_cnt);
+	printf("RPC queue length:    %u (max %u)\n",
+	       buf->rpc_queue_len, buf->rpc_queue_max);
 	printf("Agent queue size:    %d\n\n", buf->agent_queue_size);
 	printf("Jobs submitted: %d\n", buf->jobs_submitted);
 	printf("Jobs started:   %d\n",
@@ -132,6 +138,21 @@ static int _print_info(void)
 		       ((buf->req_time - buf->req_time_start) / 60)));
 	}
 	printf("\tLast queue length: %u\n", buf->schedule_queue_len);
+	printf("\tLast queue maintenance: %u\n",
+	       buf->schedule_queue_maint_last);
+	if (buf->schedule_cycle_counter > 0) {
+		printf("\tMean queue maintenance: %u\n",
+		       buf->schedule_queue_maint_sum /
+		       buf->schedule_cycle_counter);
+	}
+	printf("\tLast start latency (seconds): %u\n",
+	       buf->schedule_latency_last);
+	printf("\tMax start latency (seconds):  %u\n",
+	       buf->schedule_latency_max);
+	if (buf->schedule_latency_cnt > 0) {
+		printf("\tMean start latency (seconds): %u\n",
+		       buf->schedule_latency_sum / buf->schedule_latency_cnt);
+	}
 
 	if (buf->bf_active) {
 		printf("\nBackfilling stats (WARNING: data obtained"
@@ -159,11 +180,119 @@ static int _print_info(void)
 		printf("\tDepth Mean (try depth): %u\n",
 		       buf->bf_depth_try_sum / buf->bf_cycle_counter);
 	}
+	printf("\tLast jobs tested per second: %u\n", buf->bf_last_test_rate);
+	if (buf->bf_cycle_sum > 0) {
+		printf("\tJobs tested per second mean: %u\n",
+		       (uint32_t) ((uint64_t) buf->bf_depth_sum * 1000000 /
+				   buf->bf_cycle_sum));
+	}
 	printf("\tLast queue length: %u\n", buf->bf_queue_len);
 	if (buf->bf_cycle_counter > 0) {
 		printf("\tQueue length mean: %u\n",
 		       buf->bf_queue_len_sum / buf->bf_cycle_counter);
 	}
+
+	printf("\nTime limit checks\n");
+	printf("\tTotal cycles: %u\n", buf->time_limit_cycle_counter);
+	printf("\tLast jobs examined: %u\n", buf->time_limit_jobs_last);
+	printf("\tMax jobs examined:  %u\n", buf->time_limit_jobs_max);
+	if (buf->time_limit_cycle_counter > 0) {
+		printf("\tMean jobs examined: %u\n",
+		       buf->time_limit_jobs_sum /
+		       buf->time_limit_cycle_counter);
+	}
+	printf("\tRunning jobs timed: %u\n", buf->time_limit_jobs_timed);
+
+	_print_rpc_stats();
+	_print_lock_stats();
 	return 0;
 }
 
+/* Print RPC statistics by message type, most frequent first */
+static void _print_rpc_stats(void)
+{
+	uint32_t i, j, *order;
+
+	if (buf->rpc_type_size == 0)
+		return;
+
+	order = xmalloc(sizeof(uint32_t) * buf->rpc_type_size);
+	for (i = 0; i < buf->rpc_type_size; i++)
+		order[i] = i;
+	for (i = 1; i < buf->rpc_type_size; i++) {
+		uint32_t tmp = order[i];
+		for (j = i; (j > 0) && (buf->rpc_type_cnt[order[j - 1]] <
+					buf->rpc_type_cnt[tmp]); j--)
+			order[j] = order[j - 1];
+		order[j] = tmp;
+	}
+
+	printf("\nRemote Procedure Call statistics by message type "
+	       "(microseconds)\n");
+	for (i = 0; i < buf->rpc_type_size; i++) {
+		j = order[i];
+		printf("\t%-40s(%5u) count:%-8u ave_time:%-10"PRIu64
+		       " max_time:%-10"PRIu64" ave_auth_time:%"PRIu64"\n",
+		       rpc_num2string(buf->rpc_type_id[j]),
+		       buf->rpc_type_id[j], buf->rpc_type_cnt[j],
+		       buf->rpc_type_time[j] / buf->rpc_type_cnt[j],
+		       buf->rpc_type_time_max[j],
+		       buf->rpc_type_auth_time[j] / buf->rpc_type_cnt[j]);
+	}
+	xfree(order);
+}
+
+/* Print slurmctld lock statistics by data type and lock level, then by the
+ * function acquiring the locks, longest total hold time first */
+static void _print_lock_stats(void)
+{
+	static char *lock_names[] = { "config", "job", "node", "partition" };
+	uint32_t i, j, *order;
+
+	if (buf->lock_type_size == 0)
+		return;
+
+	printf("\nLock statistics (microseconds)\n");
+	for (i = 0; i < buf->lock_type_size; i++) {
+		if ((i / 2) >= (sizeof(lock_names) / sizeof(char *)))
+			break;
+		printf("\t%-9s %-5s count:%-8u wait_time:%-10"PRIu64
+		       " wait_max:%-10"PRIu64" hold_time:%-10"PRIu64
+		       " hold_max:%"PRIu64"\n",
+		       lock_names[i / 2], (i % 2) ? "write" : "read",
+		       buf->lock_type_cnt[i], buf->lock_type_wait_time[i],
+		       buf->lock_type_wait_max[i], buf->lock_type_hold_time[i],
+		       buf->lock_type_hold_max[i]);
+	}
+
+	if (buf->lock_caller_size == 0)
+		return;
+
+	order = xmalloc(sizeof(uint32_t) * buf->lock_caller_size);
+	for (i = 0; i < buf->lock_caller_size; i++)
+		order[i] = i;
+	for (i = 1; i < buf->lock_caller_size; i++) {
+		uint32_t tmp = order[i];
+		for (j = i; (j > 0) &&
+			    (buf->lock_caller_hold_time[order[j - 1]] <
+			     buf->lock_caller_hold_time[tmp]); j--)
+			order[j] = order[j - 1];
+		order[j] = tmp;
+	}
+
+	printf("\nLock statistics by caller (microseconds)\n");
+	for (i = 0; i < buf->lock_caller_size; i++) {
+		j = order[i];
+		if (buf->lock_caller_cnt[j] == 0)
+			continue;
+		printf("\t%-40s count:%-8u ave_wait:%-8"PRIu64
+		       " max_wait:%-8"PRIu64" ave_hold:%-8"PRIu64
+		       " max_hold:%"PRIu64"\n",
+		       buf->lock_caller_name[j], buf->lock_caller_cnt[j],
+		       buf->lock_caller_wait_time[j] / buf->lock_caller_cnt[j],
+		       buf->lock_caller_wait_max[j],
+		       buf->lock_caller_hold_time[j] / buf->lock_caller_cnt[j],
+		       buf->lock_caller_hold_max[j]);
+	}
+	xfree(order);
+}
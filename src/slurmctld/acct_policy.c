@@ -2029,6 +2029,7 @@ extern int acct_policy_update_pending_job(struct job_record *job_ptr)
 	}
 
 	if (update_accounting) {
+		job_journal_mark(job_ptr);
 		last_job_update = time(NULL);
 		debug("limits changed for job %u: updating accounting",
 		      job_ptr->job_id);
@@ -2086,6 +2087,7 @@ extern bool acct_policy_job_time_out(struct job_record *job_ptr)
 
 		if ((qos->grp_cpu_mins != (uint64_t)INFINITE)
 		    && (usage_mins >= qos->grp_cpu_mins)) {
+			job_journal_mark(job_ptr);
 			last_job_update = now;
 			info("Job %u timed out, "
 			     "the job is at or exceeds QOS %s's "
@@ -2101,6 +2103,7 @@ extern bool acct_policy_job_time_out(struct job_record *job_ptr)
 
 		if ((qos->grp_wall != INFINITE)
 		    && (wall_mins >= qos->grp_wall)) {
+			job_journal_mark(job_ptr);
 			last_job_update = now;
 			info("Job %u timed out, "
 			     "the job is at or exceeds QOS %s's "
@@ -2114,6 +2117,7 @@ extern bool acct_policy_job_time_out(struct job_record *job_ptr)
 
 		if ((qos->max_cpu_mins_pj != (uint64_t)INFINITE)
 		    && (job_cpu_usage_mins >= qos->max_cpu_mins_pj)) {
+			job_journal_mark(job_ptr);
 			last_job_update = now;
 			info("Job %u timed out, "
 			     "the job is at or exceeds QOS %s's "
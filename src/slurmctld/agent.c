@@ -204,7 +204,11 @@ static bool wiki2_sched_test = false;
 /*
  * agent - party responsible for transmitting an common RPC in parallel
  *	across a set of nodes. Use agent_queue_request() if immediate
- *	execution is not essential.
+ *	execution is not essential. The agent's own threads (a watchdog and
+ *	up to AGENT_THREAD_COUNT RPC threads) are bounded by MAX_AGENT_CNT,
+ *	and the watchdog enforces the per-node timeouts and retries, so they
+ *	remain. The fanout below each RPC thread is sent by start_msg_tree()
+ *	with the forwarding pool of forward_tree_init().
  * IN pointer to agent_arg_t, which is xfree'd (including hostlist,
  *	and msg_args) upon completion
  * RET always NULL (function format just for use as pthread)
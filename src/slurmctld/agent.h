@@ -50,7 +50,11 @@
 					/* maximum simultaneous agents, note
 					 *   total thread count is product of
 					 *   MAX_AGENT_CNT and
-					 *   (AGENT_THREAD_COUNT + 2) */
+					 *   (AGENT_THREAD_COUNT + 2), threads
+					 *   forwarding to subtrees of nodes
+					 *   come from the shared pool of
+					 *   forward_tree_init() while it has
+					 *   idle threads */
 
 typedef struct agent_arg {
 	uint32_t	node_count;	/* number of nodes to communicate
@@ -0,0 +1,1175 @@
+/*****************************************************************************\
+ *  batch_store.c - store of batch job scripts and environments
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/fd.h"
+#include "src/common/id_hash.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/pack.h"
+#include "src/common/slurm_protocol_api.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmctld/batch_store.h"
+
+/*
+ * The log starts with BATCH_STORE_MAGIC followed by records, each with a
+ * header of four uint32_t values in network byte order: record type, size
+ * of the data following the header, checksum of the type, size, job id and
+ * data, and job id.
+ *	BLOB:  a script or environment, job id 0. The checksum only depends
+ *	       on the content so is also used to find identical content.
+ *	REF:   a job's entry, the offsets of the BLOB records of its script
+ *	       and environment as two uint64_t values, BATCH_STORE_NONE if
+ *	       none. Replaces any earlier REF of the job.
+ *	UNREF: removal of a job's entry, no data.
+ * A record which is incomplete or fails its checksum ends the log, as is
+ * left by a write interrupted by a crash.
+ */
+#define BATCH_STORE_MAGIC	"SLURM_BATCH_STORE_1\n"
+#define BATCH_STORE_MAGIC_SIZE	(sizeof(BATCH_STORE_MAGIC) - 1)
+#define BATCH_STORE_BLOB	1
+#define BATCH_STORE_REF		2
+#define BATCH_STORE_UNREF	3
+#define BATCH_STORE_HDR_SIZE	16
+#define BATCH_STORE_REF_SIZE	(BATCH_STORE_HDR_SIZE + 16)
+#define BATCH_STORE_NONE	((uint64_t) -1)
+
+/* Compact the log once unused records exceed both this size and the size
+ * of the records still in use */
+#define BATCH_STORE_MIN_GC	(1024 * 1024)
+
+typedef struct blob blob_t;
+struct blob {
+	uint64_t offset;	/* offset of the BLOB record in the log */
+	uint32_t sum;		/* checksum of the record */
+	uint32_t size;		/* size of the content */
+	uint32_t ref_cnt;	/* count of jobs using the content */
+	blob_t *hash_next;	/* next blob with the same checksum */
+	blob_t *prev, *next;	/* list of all blobs */
+};
+
+typedef struct store_job store_job_t;
+struct store_job {
+	uint32_t job_id;
+	blob_t *script;
+	blob_t *env;
+	store_job_t *prev, *next;	/* list of all jobs */
+};
+
+/* Content to be stored. It is compared with the blobs having its checksum
+ * without holding store_lock, see batch_store_add() */
+typedef struct blob_req {
+	char *data;
+	uint32_t size;
+	uint32_t sum;
+	uint64_t *cand;		/* offsets of blobs with the same checksum */
+	int cand_cnt;
+	uint64_t match;		/* offset of a blob with the same content, or
+				 * BATCH_STORE_NONE */
+} blob_req_t;
+
+/* A blob or job's entry as of the start of a compaction */
+typedef struct gc_blob {
+	uint64_t offset;	/* in the old log */
+	uint64_t new_offset;	/* in the compacted log */
+	uint32_t size;
+} gc_blob_t;
+
+typedef struct gc_job {
+	uint32_t job_id;
+	uint64_t script;	/* offsets in the old log */
+	uint64_t env;
+} gc_job_t;
+
+/* A compaction. The records up to snap_size are compacted from a snapshot
+ * of the tables, those appended later are copied as they are to
+ * tail_offset onwards. */
+typedef struct gc_state {
+	int old_fd;
+	int new_fd;
+	gc_blob_t *blobs;	/* sorted by offset */
+	uint32_t blob_cnt;
+	gc_job_t *jobs;
+	uint32_t job_cnt;
+	uint32_t gen;		/* store_gen of the old log */
+	uint64_t snap_size;
+	uint64_t tail_offset;
+	uint64_t copied;	/* end of the old log's records copied */
+} gc_state_t;
+
+static pthread_mutex_t store_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *store_file = NULL;
+static int store_fd = -1;
+static uint32_t store_gen = 0;	/* changed when store_fd is replaced */
+static bool store_gc = false;	/* compaction in progress */
+static uint64_t store_size = 0;	/* end of the last record */
+static uint64_t store_live = 0;	/* bytes of records still in use */
+static bool store_dirty = false;	/* written since last sync */
+static id_hash_t *blob_hash = NULL;	/* checksum to first blob_t */
+static id_hash_t *job_hash = NULL;	/* job id to store_job_t */
+static blob_t *blob_list = NULL;
+static store_job_t *store_jobs = NULL;
+
+/* FNV-1a hash */
+static uint32_t _sum_data(uint32_t sum, char *data, uint32_t size)
+{
+	uint32_t i;
+
+	for (i = 0; i < size; i++) {
+		sum ^= (unsigned char) data[i];
+		sum *= 16777619;
+	}
+	return sum;
+}
+
+static uint32_t _rec_sum(uint32_t type, uint32_t job_id, char *data,
+			 uint32_t size)
+{
+	uint32_t hdr[3];
+
+	hdr[0] = htonl(type);
+	hdr[1] = htonl(size);
+	hdr[2] = htonl(job_id);
+	return _sum_data(_sum_data(2166136261U, (char *) hdr, sizeof(hdr)),
+			 data, size);
+}
+
+static void _pack_data(char *data, uint32_t size, Buf buffer)
+{
+	if (remaining_buf(buffer) < size)
+		grow_buf(buffer, size);
+	memcpy(get_buf_data(buffer) + get_buf_offset(buffer), data, size);
+	set_buf_offset(buffer, get_buf_offset(buffer) + size);
+}
+
+/* Append a record to a buffer
+ * RET the record's checksum */
+static uint32_t _pack_rec(Buf buffer, uint32_t type, uint32_t job_id,
+			  char *data, uint32_t size)
+{
+	uint32_t sum = _rec_sum(type, job_id, data, size);
+
+	pack32(type, buffer);
+	pack32(size, buffer);
+	pack32(sum, buffer);
+	pack32(job_id, buffer);
+	if (size)
+		_pack_data(data, size, buffer);
+	return sum;
+}
+
+static void _pack_ref(Buf buffer, uint32_t job_id, uint64_t script,
+		      uint64_t env)
+{
+	uint64_t offset[2];
+
+	offset[0] = HTON_uint64(script);
+	offset[1] = HTON_uint64(env);
+	_pack_rec(buffer, BATCH_STORE_REF, job_id, (char *) offset,
+		  sizeof(offset));
+}
+
+/* RET offset of a blob's record, BATCH_STORE_NONE if no blob */
+static uint64_t _blob_offset(blob_t *blob)
+{
+	return blob ? blob->offset : BATCH_STORE_NONE;
+}
+
+static int _write_all(int fd, char *data, uint32_t size, off_t offset)
+{
+	ssize_t amount;
+
+	while (size > 0) {
+		amount = pwrite(fd, data, size, offset);
+		if (amount < 0) {
+			if (errno == EINTR)
+				continue;
+			return SLURM_ERROR;
+		}
+		data   += amount;
+		size   -= amount;
+		offset += amount;
+	}
+	return SLURM_SUCCESS;
+}
+
+static int _read_all(int fd, char *data, uint32_t size, off_t offset)
+{
+	ssize_t amount;
+
+	while (size > 0) {
+		amount = pread(fd, data, size, offset);
+		if (amount < 0) {
+			if (errno == EINTR)
+				continue;
+			return SLURM_ERROR;
+		}
+		if (amount == 0) {
+			errno = EIO;
+			return SLURM_ERROR;
+		}
+		data   += amount;
+		size   -= amount;
+		offset += amount;
+	}
+	return SLURM_SUCCESS;
+}
+
+/* Append the records in a buffer to the log
+ * NOTE: Caller must hold store_lock */
+static int _append(Buf buffer)
+{
+	if (_write_all(store_fd, get_buf_data(buffer), get_buf_offset(buffer),
+		       store_size) != SLURM_SUCCESS) {
+		error("batch_store: write error on %s: %m", store_file);
+		/* drop any partial record */
+		(void) ftruncate(store_fd, store_size);
+		return SLURM_ERROR;
+	}
+	store_size += get_buf_offset(buffer);
+	store_dirty = true;
+	return SLURM_SUCCESS;
+}
+
+/* Duplicate the log's descriptor. The log is read through it without
+ * holding store_lock, even if batch_store_gc() replaces the log meanwhile.
+ * NOTE: Caller must hold store_lock
+ * RET the descriptor, close when no longer needed, or -1 on error */
+static int _dup_store_fd(void)
+{
+	int fd = dup(store_fd);
+
+	if (fd < 0)
+		error("batch_store: dup error on %s: %m", store_file);
+	return fd;
+}
+
+/* Return the content of the record at offset, xfree when no longer needed */
+static char *_read_blob(int fd, uint64_t offset, uint32_t size)
+{
+	char *data = xmalloc(size + 1);
+
+	if (_read_all(fd, data, size, offset + BATCH_STORE_HDR_SIZE)
+	    != SLURM_SUCCESS) {
+		error("batch_store: read error: %m");
+		xfree(data);
+	}
+	return data;
+}
+
+/* fdatasync() a log
+ * RET SLURM_SUCCESS or SLURM_ERROR */
+static int _sync_fd(int fd, char *file)
+{
+	while (fdatasync(fd) < 0) {
+		if (errno != EINTR) {
+			error("batch_store: fdatasync error on %s: %m", file);
+			return SLURM_ERROR;
+		}
+	}
+	return SLURM_SUCCESS;
+}
+
+/* Sync the directory of the log, so that the log's creation or
+ * replacement by rename() survives a crash
+ * NOTE: Caller must hold store_lock */
+static void _sync_dir(void)
+{
+	char *dir = xstrdup(store_file), *slash = strrchr(dir, '/');
+	int fd;
+
+	if (slash)
+		slash[(slash == dir) ? 1 : 0] = '\0';
+	if ((fd = open(slash ? dir : ".", O_RDONLY)) < 0) {
+		error("batch_store: open(%s): %m", dir);
+	} else {
+		if (fsync(fd) < 0)
+			error("batch_store: fsync error on %s: %m", dir);
+		close(fd);
+	}
+	xfree(dir);
+}
+
+static void _blob_insert(blob_t *blob)
+{
+	/* the new blob heads the chain of blobs with its checksum */
+	blob->hash_next = id_hash_remove(blob_hash, blob->sum);
+	(void) id_hash_add(blob_hash, blob->sum, blob);
+	blob->prev = NULL;
+	blob->next = blob_list;
+	if (blob_list)
+		blob_list->prev = blob;
+	blob_list = blob;
+}
+
+static void _blob_remove(blob_t *blob)
+{
+	blob_t *prev = id_hash_find(blob_hash, blob->sum);
+
+	if (prev == blob) {
+		(void) id_hash_remove(blob_hash, blob->sum);
+		if (blob->hash_next)
+			(void) id_hash_add(blob_hash, blob->sum,
+					   blob->hash_next);
+	} else {
+		while (prev && (prev->hash_next != blob))
+			prev = prev->hash_next;
+		if (prev)
+			prev->hash_next = blob->hash_next;
+	}
+	if (blob->prev)
+		blob->prev->next = blob->next;
+	else
+		blob_list = blob->next;
+	if (blob->next)
+		blob->next->prev = blob->prev;
+	xfree(blob);
+}
+
+/* Find the blob whose record is at offset
+ * RET the blob or NULL if it was removed */
+static blob_t *_blob_at(uint32_t sum, uint64_t offset)
+{
+	blob_t *blob;
+
+	for (blob = id_hash_find(blob_hash, sum); blob;
+	     blob = blob->hash_next) {
+		if (blob->offset == offset)
+			return blob;
+	}
+	return NULL;
+}
+
+/* Note the blobs which may have a request's content
+ * NOTE: Caller must hold store_lock */
+static void _blob_candidates(blob_req_t *req)
+{
+	blob_t *blob;
+
+	req->cand_cnt = 0;
+	req->match = BATCH_STORE_NONE;
+	if (!req->data)
+		return;
+	for (blob = id_hash_find(blob_hash, req->sum); blob;
+	     blob = blob->hash_next) {
+		if ((blob->sum != req->sum) || (blob->size != req->size))
+			continue;
+		xrealloc(req->cand, sizeof(uint64_t) * (req->cand_cnt + 1));
+		req->cand[req->cand_cnt++] = blob->offset;
+	}
+}
+
+/* Compare a request's content with that of its candidate blobs */
+static void _blob_match(int fd, blob_req_t *req)
+{
+	char *content;
+	int i;
+
+	for (i = 0; (i < req->cand_cnt) && (req->match == BATCH_STORE_NONE);
+	     i++) {
+		if (!(content = _read_blob(fd, req->cand[i], req->size)))
+			continue;
+		if (!memcmp(content, req->data, req->size))
+			req->match = req->cand[i];
+		xfree(content);
+	}
+}
+
+static void _blob_ref(blob_t *blob)
+{
+	if (blob && (blob->ref_cnt++ == 0))
+		store_live += BATCH_STORE_HDR_SIZE + blob->size;
+}
+
+/* IN drop - free the blob if no longer used */
+static void _blob_unref(blob_t *blob, bool drop)
+{
+	if (!blob || (blob->ref_cnt == 0) || (--blob->ref_cnt > 0))
+		return;
+	store_live -= BATCH_STORE_HDR_SIZE + blob->size;
+	if (drop)
+		_blob_remove(blob);
+}
+
+static void _job_set(uint32_t job_id, blob_t *script, blob_t *env, bool drop)
+{
+	store_job_t *job = id_hash_find(job_hash, job_id);
+
+	_blob_ref(script);
+	_blob_ref(env);
+	if (job) {
+		_blob_unref(job->script, drop);
+		_blob_unref(job->env, drop);
+	} else {
+		job = xmalloc(sizeof(store_job_t));
+		job->job_id = job_id;
+		job->next = store_jobs;
+		if (store_jobs)
+			store_jobs->prev = job;
+		store_jobs = job;
+		(void) id_hash_add(job_hash, job_id, job);
+		store_live += BATCH_STORE_REF_SIZE;
+	}
+	job->script = script;
+	job->env = env;
+}
+
+static void _job_remove(store_job_t *job, bool drop)
+{
+	(void) id_hash_remove(job_hash, job->job_id);
+	if (job->prev)
+		job->prev->next = job->next;
+	else
+		store_jobs = job->next;
+	if (job->next)
+		job->next->prev = job->prev;
+	_blob_unref(job->script, drop);
+	_blob_unref(job->env, drop);
+	store_live -= BATCH_STORE_REF_SIZE;
+	xfree(job);
+}
+
+static int _blob_offset_cmp(const void *key, const void *elem)
+{
+	uint64_t offset = *(uint64_t *) key;
+	blob_t *blob = *(blob_t **) elem;
+
+	if (offset < blob->offset)
+		return -1;
+	return (offset > blob->offset);
+}
+
+static blob_t *_scan_find(blob_t **blobs, uint32_t blob_cnt, uint64_t offset)
+{
+	blob_t **found;
+
+	if (offset == BATCH_STORE_NONE)
+		return NULL;
+	found = bsearch(&offset, blobs, blob_cnt, sizeof(blob_t *),
+			_blob_offset_cmp);
+	return found ? *found : NULL;
+}
+
+/* Rebuild the store's tables from the records of the log
+ * RET offset of the end of the last good record */
+static uint64_t _scan(char *data, uint64_t data_size)
+{
+	blob_t **blobs = NULL, *blob, *next;
+	uint32_t blob_cnt = 0, blob_size = 0;
+	uint32_t hdr[4], type, size, sum, job_id;
+	uint64_t offset = BATCH_STORE_MAGIC_SIZE, ref[2];
+	store_job_t *job;
+
+	while ((data_size - offset) >= BATCH_STORE_HDR_SIZE) {
+		memcpy(hdr, data + offset, sizeof(hdr));
+		type   = ntohl(hdr[0]);
+		size   = ntohl(hdr[1]);
+		sum    = ntohl(hdr[2]);
+		job_id = ntohl(hdr[3]);
+
+		if ((size > (data_size - offset - BATCH_STORE_HDR_SIZE)) ||
+		    (_rec_sum(type, job_id, data + offset +
+			      BATCH_STORE_HDR_SIZE, size) != sum))
+			break;
+		if (type == BATCH_STORE_BLOB) {
+			blob = xmalloc(sizeof(blob_t));
+			blob->offset = offset;
+			blob->sum = sum;
+			blob->size = size;
+			_blob_insert(blob);
+			if (blob_cnt >= blob_size) {
+				blob_size = MAX(blob_size * 2, 1024);
+				xrealloc(blobs, sizeof(blob_t *) * blob_size);
+			}
+			blobs[blob_cnt++] = blob;
+		} else if ((type == BATCH_STORE_REF) && (size == sizeof(ref))) {
+			memcpy(ref, data + offset + BATCH_STORE_HDR_SIZE,
+			       sizeof(ref));
+			_job_set(job_id,
+				 _scan_find(blobs, blob_cnt,
+					    NTOH_uint64(ref[0])),
+				 _scan_find(blobs, blob_cnt,
+					    NTOH_uint64(ref[1])), false);
+		} else if ((type == BATCH_STORE_UNREF) && (size == 0)) {
+			if ((job = id_hash_find(job_hash, job_id)))
+				_job_remove(job, false);
+		} else
+			break;
+		offset += BATCH_STORE_HDR_SIZE + size;
+	}
+	xfree(blobs);
+
+	for (blob = blob_list; blob; blob = next) {
+		next = blob->next;
+		if (blob->ref_cnt == 0)
+			_blob_remove(blob);
+	}
+	return offset;
+}
+
+/* Read the whole of a file
+ * RET its data, xfree when no longer needed, or NULL on error */
+static char *_read_file(int fd, uint64_t *data_size)
+{
+	struct stat stat_buf;
+	char *data;
+
+	if (fstat(fd, &stat_buf) < 0)
+		return NULL;
+	*data_size = stat_buf.st_size;
+	data = xmalloc(*data_size + 1);
+	if (_read_all(fd, data, *data_size, 0) != SLURM_SUCCESS)
+		xfree(data);
+	return data;
+}
+
+/* Open the log and build the store's tables, if not already done
+ * NOTE: Caller must hold store_lock */
+static int _store_open(void)
+{
+	char *data, *bad_file;
+	uint64_t data_size = 0, good_size;
+
+	if (store_fd >= 0)
+		return SLURM_SUCCESS;
+
+	if (!store_file) {
+		store_file = slurm_get_state_save_location();
+		xstrcat(store_file, "/batch_store");
+	}
+	store_fd = open(store_file, O_RDWR | O_CREAT, 0600);
+	if (store_fd < 0) {
+		error("batch_store: open(%s): %m", store_file);
+		return SLURM_ERROR;
+	}
+	fd_set_close_on_exec(store_fd);
+	if (!(data = _read_file(store_fd, &data_size))) {
+		error("batch_store: read error on %s: %m", store_file);
+		close(store_fd);
+		store_fd = -1;
+		return SLURM_ERROR;
+	}
+
+	blob_hash = id_hash_create(1024);
+	job_hash = id_hash_create(1024);
+	store_size = BATCH_STORE_MAGIC_SIZE;
+	store_live = BATCH_STORE_MAGIC_SIZE;
+
+	if (data_size &&
+	    ((data_size < BATCH_STORE_MAGIC_SIZE) ||
+	     memcmp(data, BATCH_STORE_MAGIC, BATCH_STORE_MAGIC_SIZE))) {
+		bad_file = xstrdup_printf("%s.bad", store_file);
+		error("batch_store: %s is not a batch store, moved to %s",
+		      store_file, bad_file);
+		(void) rename(store_file, bad_file);
+		xfree(bad_file);
+		close(store_fd);
+		store_fd = open(store_file, O_RDWR | O_CREAT | O_TRUNC, 0600);
+		if (store_fd < 0) {
+			error("batch_store: open(%s): %m", store_file);
+			xfree(data);
+			return SLURM_ERROR;
+		}
+		fd_set_close_on_exec(store_fd);
+		data_size = 0;
+	}
+
+	if (data_size == 0) {
+		if (_write_all(store_fd, BATCH_STORE_MAGIC,
+			       BATCH_STORE_MAGIC_SIZE, 0) != SLURM_SUCCESS) {
+			error("batch_store: write error on %s: %m",
+			      store_file);
+			xfree(data);
+			close(store_fd);
+			store_fd = -1;
+			return SLURM_ERROR;
+		}
+		store_dirty = true;
+		_sync_dir();
+	} else {
+		good_size = _scan(data, data_size);
+		if (good_size < data_size) {
+			error("batch_store: ignoring %"PRIu64" bytes of "
+			      "incomplete records at end of %s",
+			      data_size - good_size, store_file);
+			(void) ftruncate(store_fd, good_size);
+		}
+		store_size = good_size;
+		info("batch_store: recovered %u jobs, %"PRIu64" bytes of "
+		     "%"PRIu64" in use", id_hash_count(job_hash), store_live,
+		     store_size);
+	}
+	xfree(data);
+	return SLURM_SUCCESS;
+}
+
+/* Find the blob matching a request or else create one, packing its
+ * record into buffer to be appended to the log at store_size
+ * OUT created - set if the blob is new, add it to the tables with
+ *	_blob_insert() once written
+ * RET the blob, NULL if the request has no content */
+static blob_t *_get_blob(blob_req_t *req, Buf buffer, bool *created)
+{
+	blob_t *blob;
+
+	*created = false;
+	if (!req->data)
+		return NULL;
+	if ((req->match != BATCH_STORE_NONE) &&
+	    (blob = _blob_at(req->sum, req->match)))
+		return blob;
+	blob = xmalloc(sizeof(blob_t));
+	blob->offset = store_size + get_buf_offset(buffer);
+	blob->sum = _pack_rec(buffer, BATCH_STORE_BLOB, 0, req->data,
+			      req->size);
+	blob->size = req->size;
+	*created = true;
+	return blob;
+}
+
+/* Set up a request to store some content, NULL for none */
+static void _blob_req_init(blob_req_t *req, char *data, uint32_t size)
+{
+	memset(req, 0, sizeof(blob_req_t));
+	if (!data)
+		return;
+	req->data = data;
+	req->size = size;
+	req->sum = _rec_sum(BATCH_STORE_BLOB, 0, data, size);
+}
+
+static void _add_new_blob(blob_t *blob, bool created, bool written)
+{
+	if (!created)
+		return;
+	if (written)
+		_blob_insert(blob);
+	else
+		xfree(blob);
+}
+
+extern int batch_store_add(uint32_t job_id, char *script, char **env,
+			   uint32_t env_size)
+{
+	blob_t *script_blob, *env_blob;
+	blob_req_t script_req, env_req;
+	bool script_new, env_new;
+	char *env_data = NULL;
+	uint32_t gen;
+	int fd, i, len, env_data_size = 0, rc = SLURM_SUCCESS;
+	Buf buffer;
+
+	for (i = 0; i < env_size; i++)
+		env_data_size += strlen(env[i]) + 1;
+	if (env_data_size) {
+		env_data = xmalloc(env_data_size);
+		for (i = 0, len = 0; i < env_size; i++) {
+			strcpy(env_data + len, env[i]);
+			len += strlen(env[i]) + 1;
+		}
+	}
+	_blob_req_init(&script_req, script, script ? strlen(script) + 1 : 0);
+	_blob_req_init(&env_req, env_data, env_data_size);
+
+	/* Read the blobs with the same checksums to compare their content
+	 * without holding the lock, again if the log was compacted
+	 * meanwhile */
+	slurm_mutex_lock(&store_lock);
+	while (1) {
+		if (_store_open() != SLURM_SUCCESS) {
+			slurm_mutex_unlock(&store_lock);
+			rc = ESLURM_WRITING_TO_FILE;
+			goto fini;
+		}
+		_blob_candidates(&script_req);
+		_blob_candidates(&env_req);
+		if (!script_req.cand_cnt && !env_req.cand_cnt)
+			break;
+		gen = store_gen;
+		fd = _dup_store_fd();
+		slurm_mutex_unlock(&store_lock);
+		if (fd >= 0) {
+			_blob_match(fd, &script_req);
+			_blob_match(fd, &env_req);
+			close(fd);
+		}
+		slurm_mutex_lock(&store_lock);
+		if (store_gen == gen)
+			break;
+	}
+
+	buffer = init_buf(BUF_SIZE);
+	script_blob = _get_blob(&script_req, buffer, &script_new);
+	env_blob = _get_blob(&env_req, buffer, &env_new);
+	_pack_ref(buffer, job_id, _blob_offset(script_blob),
+		  _blob_offset(env_blob));
+	if (_append(buffer) != SLURM_SUCCESS)
+		rc = ESLURM_WRITING_TO_FILE;
+	_add_new_blob(script_blob, script_new, (rc == SLURM_SUCCESS));
+	_add_new_blob(env_blob, env_new, (rc == SLURM_SUCCESS));
+	if (rc == SLURM_SUCCESS)
+		_job_set(job_id, script_blob, env_blob, true);
+	slurm_mutex_unlock(&store_lock);
+	free_buf(buffer);
+
+fini:	xfree(script_req.cand);
+	xfree(env_req.cand);
+	xfree(env_data);
+	return rc;
+}
+
+extern int batch_store_copy(uint32_t job_id_src, uint32_t job_id_dest)
+{
+	store_job_t *job;
+	int rc = SLURM_ERROR;
+	Buf buffer;
+
+	slurm_mutex_lock(&store_lock);
+	if ((_store_open() == SLURM_SUCCESS) &&
+	    (job = id_hash_find(job_hash, job_id_src))) {
+		buffer = init_buf(BATCH_STORE_REF_SIZE);
+		_pack_ref(buffer, job_id_dest, _blob_offset(job->script),
+			  _blob_offset(job->env));
+		if ((rc = _append(buffer)) == SLURM_SUCCESS)
+			_job_set(job_id_dest, job->script, job->env, true);
+		free_buf(buffer);
+	}
+	slurm_mutex_unlock(&store_lock);
+	return rc;
+}
+
+extern int batch_store_delete(uint32_t job_id)
+{
+	store_job_t *job;
+	int rc = SLURM_ERROR;
+	Buf buffer;
+
+	slurm_mutex_lock(&store_lock);
+	if ((_store_open() == SLURM_SUCCESS) &&
+	    (job = id_hash_find(job_hash, job_id))) {
+		/* If the record is lost, the entry is found again on
+		 * restart and removed by sync_job_files() */
+		buffer = init_buf(BATCH_STORE_HDR_SIZE);
+		_pack_rec(buffer, BATCH_STORE_UNREF, job_id, NULL, 0);
+		(void) _append(buffer);
+		free_buf(buffer);
+		_job_remove(job, true);
+		rc = SLURM_SUCCESS;
+	}
+	slurm_mutex_unlock(&store_lock);
+	return rc;
+}
+
+/* Read a job's script or environment without holding store_lock
+ * OUT data - the content, xfree when no longer needed, or NULL if none
+ * OUT size - size of the content
+ * RET SLURM_SUCCESS or SLURM_ERROR if job_id is not in the store */
+static int _read_job_blob(uint32_t job_id, bool env, char **data,
+			  uint32_t *size)
+{
+	store_job_t *job;
+	blob_t *blob;
+	uint64_t offset = 0;
+	int fd = -1, rc = SLURM_ERROR;
+
+	*data = NULL;
+	*size = 0;
+	slurm_mutex_lock(&store_lock);
+	if ((_store_open() == SLURM_SUCCESS) &&
+	    (job = id_hash_find(job_hash, job_id))) {
+		if ((blob = env ? job->env : job->script)) {
+			offset = blob->offset;
+			*size = blob->size;
+			fd = _dup_store_fd();
+		}
+		rc = SLURM_SUCCESS;
+	}
+	slurm_mutex_unlock(&store_lock);
+
+	if (fd >= 0) {
+		*data = _read_blob(fd, offset, *size);
+		close(fd);
+	}
+	if (!*data)
+		*size = 0;
+	return rc;
+}
+
+extern int batch_store_get_script(uint32_t job_id, char **script)
+{
+	uint32_t size;
+
+	return _read_job_blob(job_id, false, script, &size);
+}
+
+extern int batch_store_get_env(uint32_t job_id, char **env_buf,
+			       uint32_t *env_size, int *buf_size)
+{
+	uint32_t i, size;
+	int rc;
+
+	rc = _read_job_blob(job_id, true, env_buf, &size);
+	*env_size = 0;
+	*buf_size = size;
+	for (i = 0; i < size; i++) {
+		if ((*env_buf)[i] == '\0')
+			(*env_size)++;
+	}
+	return rc;
+}
+
+extern void batch_store_get_job_ids(List job_ids)
+{
+	store_job_t *job;
+	uint32_t *job_id_ptr;
+
+	slurm_mutex_lock(&store_lock);
+	if (_store_open() == SLURM_SUCCESS) {
+		for (job = store_jobs; job; job = job->next) {
+			job_id_ptr = xmalloc(sizeof(uint32_t));
+			*job_id_ptr = job->job_id;
+			list_append(job_ids, job_id_ptr);
+		}
+	}
+	slurm_mutex_unlock(&store_lock);
+}
+
+extern void batch_store_sync(void)
+{
+	int fd = -1;
+
+	/* Sync a duplicate of the descriptor so the store is not locked
+	 * while the data is written */
+	slurm_mutex_lock(&store_lock);
+	if ((store_fd >= 0) && store_dirty) {
+		fd = dup(store_fd);
+		store_dirty = false;
+	}
+	slurm_mutex_unlock(&store_lock);
+
+	if (fd < 0)
+		return;
+	(void) _sync_fd(fd, "batch store");
+	close(fd);
+}
+
+static int _gc_blob_cmp(const void *x, const void *y)
+{
+	uint64_t offset_x = ((gc_blob_t *) x)->offset;
+	uint64_t offset_y = ((gc_blob_t *) y)->offset;
+
+	if (offset_x < offset_y)
+		return -1;
+	return (offset_x > offset_y);
+}
+
+/* Map the offset of a blob in the old log to the compacted log */
+static uint64_t _gc_map(gc_state_t *gc, uint64_t offset)
+{
+	gc_blob_t key, *found;
+
+	if (offset == BATCH_STORE_NONE)
+		return offset;
+	if (offset >= gc->snap_size)
+		return offset - gc->snap_size + gc->tail_offset;
+	key.offset = offset;
+	found = bsearch(&key, gc->blobs, gc->blob_cnt, sizeof(gc_blob_t),
+			_gc_blob_cmp);
+	return found ? found->new_offset : BATCH_STORE_NONE;
+}
+
+/* Copy the blobs and job entries in use to a compaction's snapshot
+ * NOTE: Caller must hold store_lock */
+static void _gc_snapshot(gc_state_t *gc)
+{
+	store_job_t *job;
+	blob_t *blob;
+
+	memset(gc, 0, sizeof(gc_state_t));
+	gc->new_fd = -1;
+	for (blob = blob_list; blob; blob = blob->next)
+		gc->blob_cnt++;
+	for (job = store_jobs; job; job = job->next)
+		gc->job_cnt++;
+	gc->blobs = xmalloc(sizeof(gc_blob_t) * (gc->blob_cnt + 1));
+	gc->jobs = xmalloc(sizeof(gc_job_t) * (gc->job_cnt + 1));
+
+	gc->blob_cnt = 0;
+	for (blob = blob_list; blob; blob = blob->next) {
+		gc->blobs[gc->blob_cnt].offset = blob->offset;
+		gc->blobs[gc->blob_cnt].size = blob->size;
+		gc->blob_cnt++;
+	}
+	qsort(gc->blobs, gc->blob_cnt, sizeof(gc_blob_t), _gc_blob_cmp);
+	gc->job_cnt = 0;
+	for (job = store_jobs; job; job = job->next) {
+		gc->jobs[gc->job_cnt].job_id = job->job_id;
+		gc->jobs[gc->job_cnt].script = _blob_offset(job->script);
+		gc->jobs[gc->job_cnt].env = _blob_offset(job->env);
+		gc->job_cnt++;
+	}
+	gc->gen = store_gen;
+	gc->snap_size = gc->copied = store_size;
+	gc->old_fd = _dup_store_fd();
+}
+
+/* Write the records of a compaction's snapshot to the new log, noting the
+ * new offset of each blob
+ * RET SLURM_SUCCESS or SLURM_ERROR */
+static int _gc_write(gc_state_t *gc, char *new_file)
+{
+	uint64_t written = 0;
+	uint32_t i;
+	char *data;
+	int rc = SLURM_SUCCESS;
+	Buf buffer;
+
+	gc->new_fd = open(new_file, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (gc->new_fd < 0) {
+		error("batch_store: open(%s): %m", new_file);
+		return SLURM_ERROR;
+	}
+	fd_set_close_on_exec(gc->new_fd);
+
+	buffer = init_buf(BATCH_STORE_MIN_GC + BUF_SIZE);
+	_pack_data(BATCH_STORE_MAGIC, BATCH_STORE_MAGIC_SIZE, buffer);
+	for (i = 0; i < gc->blob_cnt; i++) {
+		if (!(data = _read_blob(gc->old_fd, gc->blobs[i].offset,
+					gc->blobs[i].size))) {
+			rc = SLURM_ERROR;
+			break;
+		}
+		gc->blobs[i].new_offset = written + get_buf_offset(buffer);
+		_pack_rec(buffer, BATCH_STORE_BLOB, 0, data,
+			  gc->blobs[i].size);
+		xfree(data);
+		if (get_buf_offset(buffer) < BATCH_STORE_MIN_GC)
+			continue;
+		if ((rc = _write_all(gc->new_fd, get_buf_data(buffer),
+				     get_buf_offset(buffer), written))) {
+			error("batch_store: write error on %s: %m", new_file);
+			break;
+		}
+		written += get_buf_offset(buffer);
+		set_buf_offset(buffer, 0);
+	}
+	if (rc == SLURM_SUCCESS) {
+		for (i = 0; i < gc->job_cnt; i++) {
+			_pack_ref(buffer, gc->jobs[i].job_id,
+				  _gc_map(gc, gc->jobs[i].script),
+				  _gc_map(gc, gc->jobs[i].env));
+		}
+		if ((rc = _write_all(gc->new_fd, get_buf_data(buffer),
+				     get_buf_offset(buffer), written)))
+			error("batch_store: write error on %s: %m", new_file);
+		written += get_buf_offset(buffer);
+	}
+	free_buf(buffer);
+	gc->tail_offset = written;
+	return rc;
+}
+
+/* Copy the records appended to the old log since the snapshot, up to end,
+ * to the new log. The blob offsets of REF records are mapped to the new
+ * log.
+ * RET SLURM_SUCCESS or SLURM_ERROR */
+static int _gc_copy_tail(gc_state_t *gc, uint64_t end)
+{
+	uint32_t hdr[4], type, size, job_id, data_size = end - gc->copied;
+	uint64_t offset, ref[2];
+	char *data;
+	int rc;
+
+	if (data_size == 0)
+		return SLURM_SUCCESS;
+	data = xmalloc(data_size);
+	if (_read_all(gc->old_fd, data, data_size, gc->copied)
+	    != SLURM_SUCCESS) {
+		error("batch_store: read error: %m");
+		xfree(data);
+		return SLURM_ERROR;
+	}
+	for (offset = 0; (data_size - offset) >= BATCH_STORE_HDR_SIZE;
+	     offset += BATCH_STORE_HDR_SIZE + size) {
+		memcpy(hdr, data + offset, sizeof(hdr));
+		type   = ntohl(hdr[0]);
+		size   = ntohl(hdr[1]);
+		job_id = ntohl(hdr[3]);
+		if ((type != BATCH_STORE_REF) || (size != sizeof(ref)))
+			continue;
+		memcpy(ref, data + offset + BATCH_STORE_HDR_SIZE, sizeof(ref));
+		ref[0] = HTON_uint64(_gc_map(gc, NTOH_uint64(ref[0])));
+		ref[1] = HTON_uint64(_gc_map(gc, NTOH_uint64(ref[1])));
+		memcpy(data + offset + BATCH_STORE_HDR_SIZE, ref, sizeof(ref));
+		hdr[2] = htonl(_rec_sum(type, job_id, (char *) ref,
+					sizeof(ref)));
+		memcpy(data + offset, hdr, sizeof(hdr));
+	}
+	rc = _write_all(gc->new_fd, data, data_size,
+			gc->tail_offset + (gc->copied - gc->snap_size));
+	if (rc != SLURM_SUCCESS)
+		error("batch_store: write error: %m");
+	else
+		gc->copied = end;
+	xfree(data);
+	return rc;
+}
+
+/*
+ * The compacted log is written from a snapshot of the tables without
+ * holding store_lock, as are the records appended meanwhile. Only those
+ * appended while that is done, usually none, are copied under the lock
+ * before the new log replaces the old.
+ */
+extern void batch_store_gc(void)
+{
+	gc_state_t gc;
+	uint64_t end, old_size;
+	char *new_file;
+	blob_t *blob;
+	int rc = SLURM_ERROR;
+
+	slurm_mutex_lock(&store_lock);
+	if ((store_fd < 0) || store_gc ||
+	    ((store_size - store_live) <= MAX(store_live, BATCH_STORE_MIN_GC))) {
+		slurm_mutex_unlock(&store_lock);
+		return;
+	}
+	_gc_snapshot(&gc);
+	new_file = xstrdup_printf("%s.new", store_file);
+	store_gc = true;
+	slurm_mutex_unlock(&store_lock);
+
+	if ((gc.old_fd >= 0) && (_gc_write(&gc, new_file) == SLURM_SUCCESS)) {
+		slurm_mutex_lock(&store_lock);
+		end = store_size;
+		slurm_mutex_unlock(&store_lock);
+		if ((_gc_copy_tail(&gc, end) == SLURM_SUCCESS) &&
+		    (_sync_fd(gc.new_fd, new_file) == SLURM_SUCCESS))
+			rc = SLURM_SUCCESS;
+	}
+
+	slurm_mutex_lock(&store_lock);
+	store_gc = false;
+	if ((rc == SLURM_SUCCESS) && (store_gen != gc.gen)) {
+		/* closed by batch_store_fini() meanwhile */
+		rc = SLURM_ERROR;
+	} else if ((rc == SLURM_SUCCESS) && (store_size > gc.copied) &&
+		   ((_gc_copy_tail(&gc, store_size) != SLURM_SUCCESS) ||
+		    (_sync_fd(gc.new_fd, new_file) != SLURM_SUCCESS))) {
+		rc = SLURM_ERROR;
+	}
+	if ((rc == SLURM_SUCCESS) && (rename(new_file, store_file) < 0)) {
+		error("batch_store: rename(%s, %s): %m", new_file, store_file);
+		rc = SLURM_ERROR;
+	}
+	if (rc != SLURM_SUCCESS) {
+		if (gc.new_fd >= 0) {
+			close(gc.new_fd);
+			(void) unlink(new_file);
+		}
+	} else {
+		/* Before any record is appended to the new log */
+		_sync_dir();
+		close(store_fd);
+		store_fd = gc.new_fd;
+		store_gen++;
+		store_dirty = false;
+		for (blob = blob_list; blob; blob = blob->next)
+			blob->offset = _gc_map(&gc, blob->offset);
+		old_size = store_size;
+		store_size = gc.tail_offset + (store_size - gc.snap_size);
+		info("batch_store: compacted %s from %"PRIu64" to %"PRIu64
+		     " bytes, %u jobs", store_file, old_size, store_size,
+		     id_hash_count(job_hash));
+	}
+	slurm_mutex_unlock(&store_lock);
+
+	if (gc.old_fd >= 0)
+		close(gc.old_fd);
+	xfree(gc.blobs);
+	xfree(gc.jobs);
+	xfree(new_file);
+}
+
+extern void batch_store_fini(void)
+{
+	store_job_t *job;
+	blob_t *blob;
+
+	slurm_mutex_lock(&store_lock);
+	while ((job = store_jobs)) {
+		store_jobs = job->next;
+		xfree(job);
+	}
+	while ((blob = blob_list)) {
+		blob_list = blob->next;
+		xfree(blob);
+	}
+	if (blob_hash) {
+		id_hash_destroy(blob_hash);
+		blob_hash = NULL;
+	}
+	if (job_hash) {
+		id_hash_destroy(job_hash);
+		job_hash = NULL;
+	}
+	if (store_fd >= 0) {
+		close(store_fd);
+		store_fd = -1;
+	}
+	xfree(store_file);
+	store_gen++;
+	store_size = store_live = 0;
+	store_dirty = false;
+	slurm_mutex_unlock(&store_lock);
+}
@@ -0,0 +1,123 @@
+/*****************************************************************************\
+ *  batch_store.h - store of batch job scripts and environments
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifndef _HAVE_BATCH_STORE_H
+#define _HAVE_BATCH_STORE_H
+
+#include <inttypes.h>
+
+#include "src/common/list.h"
+
+/*
+ * The scripts and environments of batch jobs are kept in one append-only
+ * log, StateSaveLocation/batch_store, rather than in a job.<id> directory
+ * per job. Scripts and environments are stored once per distinct content
+ * and shared by every job using them (e.g. the tasks of a job array or
+ * resubmissions of the same script), each job's record just refers to
+ * them. The log is compacted by batch_store_gc() once most of it is
+ * records of purged jobs or content no longer used.
+ *
+ * Jobs saved before the store was introduced keep their job.<id>
+ * directories, which are read and removed by job_mgr.c as before.
+ *
+ * All functions lock the store themselves. The log is opened and read the
+ * first time it is used.
+ */
+
+/*
+ * batch_store_add - store a job's script and environment
+ * IN job_id - the job's id, replacing any previous entry
+ * IN script - the script, or NULL for none
+ * IN env - array of environment variables
+ * IN env_size - count of env elements
+ * RET SLURM_SUCCESS or an error code
+ */
+extern int batch_store_add(uint32_t job_id, char *script, char **env,
+			   uint32_t env_size);
+
+/*
+ * batch_store_copy - make a job share another job's script and environment
+ * RET SLURM_SUCCESS or SLURM_ERROR if job_id_src is not in the store
+ */
+extern int batch_store_copy(uint32_t job_id_src, uint32_t job_id_dest);
+
+/*
+ * batch_store_delete - remove a job's entry, its script and environment
+ *	are dropped by the next compaction once no job refers to them
+ * RET SLURM_SUCCESS or SLURM_ERROR if job_id is not in the store
+ */
+extern int batch_store_delete(uint32_t job_id);
+
+/*
+ * batch_store_get_script - return a job's script
+ * OUT script - the script, xfree when no longer needed, or NULL if none
+ * RET SLURM_SUCCESS or SLURM_ERROR if job_id is not in the store
+ */
+extern int batch_store_get_script(uint32_t job_id, char **script);
+
+/*
+ * batch_store_get_env - return a job's environment
+ * OUT env_buf - the environment variables, each terminated by '\0', one
+ *	after another in one buffer, xfree when no longer needed, or NULL if
+ *	the environment is empty
+ * OUT env_size - count of environment variables
+ * OUT buf_size - size of the data in env_buf
+ * RET SLURM_SUCCESS or SLURM_ERROR if job_id is not in the store
+ */
+extern int batch_store_get_env(uint32_t job_id, char **env_buf,
+			       uint32_t *env_size, int *buf_size);
+
+/*
+ * batch_store_get_job_ids - append to a list the id of every job in the
+ *	store, each an xmalloc'ed uint32_t
+ */
+extern void batch_store_get_job_ids(List job_ids);
+
+/*
+ * batch_store_sync - flush the records written since the last call to disk,
+ *	call before saving job state which refers to them
+ */
+extern void batch_store_sync(void);
+
+/*
+ * batch_store_gc - compact the log if most of it is no longer used
+ */
+extern void batch_store_gc(void);
+
+/* batch_store_fini - close the log and free the store's memory */
+extern void batch_store_fini(void);
+
+#endif /* !_HAVE_BATCH_STORE_H */
@@ -49,6 +49,10 @@
 #  include <sys/prctl.h>
 #endif
 
+#if HAVE_SYS_EPOLL_H
+#  include <sys/epoll.h>
+#endif
+
 #include <grp.h>
 #include <errno.h>
 #include <signal.h>
@@ -65,6 +69,7 @@
 #include "src/common/checkpoint.h"
 #include "src/common/daemonize.h"
 #include "src/common/fd.h"
+#include "src/common/forward.h"
 #include "src/common/gres.h"
 #include "src/common/hostlist.h"
 #include "src/common/log.h"
@@ -117,6 +122,8 @@
 #define MIN_CHECKIN_TIME  3	/* Nodes have this number of seconds to
 				 * check-in before we ping them */
 #define SHUTDOWN_WAIT     2	/* Time to wait for backup server shutdown */
+#define RPC_QUEUE_FACTOR  4	/* Accepted connections which may wait for a
+				 * worker, per RPC worker thread */
 
 #if (0)
 /* If defined and FastSchedule=0 in slurm.conf, then report the CPU count that a
@@ -177,7 +184,6 @@ static uint32_t max_server_threads = MAX_SERVER_THREADS;
 static int	new_nice = 0;
 static char	node_name[MAX_SLURM_NAME];
 static int	recover   = DEFAULT_RECOVER;
-static pthread_cond_t server_thread_cond = PTHREAD_COND_INITIALIZER;
 static pid_t	slurmctld_pid;
 static char    *slurm_conf_filename;
 static int      primary = 1 ;
@@ -195,6 +201,7 @@ static int          _accounting_cluster_ready();
 static int          _accounting_mark_all_nodes_down(char *reason);
 static void *       _assoc_cache_mgr(void *no_data);
 static void         _become_slurm_user(void);
+static void         _busy_server_thread(void);
 static void         _default_sigaction(int sig);
 inline static void  _free_server_thread(void);
 static void         _init_config(void);
@@ -207,7 +214,8 @@ static void         _remove_qos(slurmdb_qos_rec_t *rec);
 static void         _update_assoc(slurmdb_association_rec_t *rec);
 static void         _update_qos(slurmdb_qos_rec_t *rec);
 inline static int   _report_locks_set(void);
-static void *       _service_connection(void *arg);
+static void *       _rpc_worker(void *no_data);
+static void         _service_connection(void *arg);
 static void         _set_work_dir(void);
 static int          _shutdown_backup_controller(int wait_time);
 static void *       _slurmctld_background(void *no_data);
@@ -218,12 +226,24 @@ inline static void  _update_cred_key(void);
 static void         _update_nice(void);
 inline static void  _usage(char *prog_name);
 static bool         _valid_controller(void);
-static bool         _wait_for_server_thread(void);
+static bool         _wait_for_rpc_queue_space(void);
 
 typedef struct connection_arg {
 	int newsockfd;
+	struct timeval accept_time;	/* for RPC latency statistics */
 } connection_arg_t;
 
+/* Bounded FIFO of accepted connections waiting for an RPC worker thread */
+static connection_arg_t **rpc_queue = NULL;
+static uint32_t rpc_queue_head = 0;	/* index of oldest entry */
+static uint32_t rpc_queue_size = 0;	/* capacity of rpc_queue */
+static pthread_mutex_t rpc_queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  rpc_queue_add_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  rpc_queue_get_cond = PTHREAD_COND_INITIALIZER;
+
+static void              _rpc_queue_add(connection_arg_t *conn_arg);
+static connection_arg_t *_rpc_queue_remove(void);
+
 time_t last_proc_req_start = 0;
 time_t next_stats_reset = 0;
 
@@ -476,6 +496,10 @@ int main(int argc, char *argv[])
 			if (recover == 0)
 				_accounting_mark_all_nodes_down("cold-start");
 
+			/* Agents share a pool of threads to fan out RPCs
+			 * rather than each starting a thread per subtree */
+			forward_tree_init(MIN(2 * slurmctld_conf.tree_width,
+					      MAX_SERVER_THREADS / 2));
 			primary = 1;
 
 		} else {
@@ -639,6 +663,7 @@ int main(int argc, char *argv[])
 	}
 	if (i >= 10)
 		error("Left %d agent threads active", cnt);
+	forward_tree_fini();
 
 	slurm_sched_fini();	/* Stop all scheduling */
 
@@ -857,7 +882,8 @@ static void _sig_handler(int signal)
 {
 }
 
-/* _slurmctld_rpc_mgr - Read incoming RPCs and create pthread for each */
+/* _slurmctld_rpc_mgr - Accept incoming RPCs and queue them for processing
+ *	by a fixed pool of worker threads */
 static void *_slurmctld_rpc_mgr(void *no_data)
 {
 	slurm_fd_t newsockfd;
@@ -867,9 +893,15 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	char ip[32];
 	pthread_t thread_id_rpc_req;
 	pthread_attr_t thread_attr_rpc_req;
-	int no_thread;
 	int fd_next = 0, i, nports;
+	uint32_t worker_cnt = 0;
+#if HAVE_SYS_EPOLL_H
+	int epoll_fd, nready;
+	struct epoll_event ev, *events;
+#else
+	int max_fd;
 	fd_set rfds;
+#endif
 	connection_arg_t *conn_arg = NULL;
 	/* Locks: Read config */
 	slurmctld_lock_t config_read_lock = {
@@ -916,6 +948,40 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	}
 	unlock_slurmctld(config_read_lock);
 
+#if HAVE_SYS_EPOLL_H
+	if ((epoll_fd = epoll_create(nports)) < 0)
+		fatal("epoll_create: %m");
+	fd_set_close_on_exec(epoll_fd);
+	events = xmalloc(sizeof(struct epoll_event) * nports);
+	for (i=0; i<nports; i++) {
+		memset(&ev, 0, sizeof(struct epoll_event));
+		ev.events = EPOLLIN;
+		ev.data.u32 = i;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sockfd[i], &ev) < 0)
+			fatal("epoll_ctl: %m");
+	}
+#endif
+
+	/* Start the RPC worker pool. This thread is one of the
+	 * max_server_threads, the rest service connections from the queue */
+	slurm_mutex_lock(&rpc_queue_lock);
+	rpc_queue_size = MAX(max_server_threads - 1, 1) * RPC_QUEUE_FACTOR;
+	rpc_queue = xmalloc(sizeof(connection_arg_t *) * rpc_queue_size);
+	rpc_queue_head = 0;
+	slurmctld_diag_stats.rpc_queue_len = 0;
+	slurm_mutex_unlock(&rpc_queue_lock);
+	for (i = 1; i < max_server_threads; i++) {
+		if (pthread_create(&thread_id_rpc_req, &thread_attr_rpc_req,
+				   _rpc_worker, NULL)) {
+			error("pthread_create: %m");
+			break;
+		}
+		worker_cnt++;
+	}
+	slurmctld_diag_stats.rpc_worker_cnt = worker_cnt;
+	debug2("slurmctld started %u RPC worker threads, queue size %u",
+	       worker_cnt, rpc_queue_size);
+
 	/* Prepare to catch SIGUSR1 to interrupt accept().
 	 * This signal is generated by the slurmctld signal
 	 * handler thread upon receipt of SIGABRT, SIGINT,
@@ -927,8 +993,21 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	/*
 	 * Process incoming RPCs until told to shutdown
 	 */
-	while (_wait_for_server_thread()) {
-		int max_fd = -1;
+	while (_wait_for_rpc_queue_space()) {
+#if HAVE_SYS_EPOLL_H
+		nready = epoll_wait(epoll_fd, events, nports, -1);
+		if (nready == -1) {
+			if (errno != EINTR)
+				error("slurm_accept_msg_conn epoll_wait: %m");
+			continue;
+		} else if (nready == 0)
+			continue;
+		/* rotate through ready ports so none is starved,
+		 * others remain ready for the next pass */
+		i = events[fd_next % nready].data.u32;
+		fd_next++;
+#else
+		max_fd = -1;
 		FD_ZERO(&rfds);
 		for (i=0; i<nports; i++) {
 			FD_SET(sockfd[i], &rfds);
@@ -937,7 +1016,6 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 		if (select(max_fd+1, &rfds, NULL, NULL, NULL) == -1) {
 			if (errno != EINTR)
 				error("slurm_accept_msg_conn select: %m");
-			_free_server_thread();
 			continue;
 		}
 		/* find one to process */
@@ -948,6 +1026,7 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 			}
 		}
 		fd_next = (i + 1) % nports;
+#endif
 
 		/*
 		 * accept needed for stream implementation is a no-op in
@@ -958,51 +1037,159 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 		    SLURM_SOCKET_ERROR) {
 			if (errno != EINTR)
 				error("slurm_accept_msg_conn: %m");
-			_free_server_thread();
 			continue;
 		}
 		conn_arg = xmalloc(sizeof(connection_arg_t));
 		conn_arg->newsockfd = newsockfd;
-		if (slurmctld_config.shutdown_time)
-			no_thread = 1;
-		else if (pthread_create(&thread_id_rpc_req,
-					&thread_attr_rpc_req,
-					_service_connection,
-					(void *) conn_arg)) {
-			error("pthread_create: %m");
-			no_thread = 1;
-		} else
-			no_thread = 0;
-
-		if (no_thread) {
+		gettimeofday(&conn_arg->accept_time, NULL);
+		if (worker_cnt == 0) {
 			slurmctld_diag_stats.proc_req_raw++;
-		       	_service_connection((void *) conn_arg);
-	       	}
+			_busy_server_thread();
+			_service_connection((void *) conn_arg);
+		} else
+			_rpc_queue_add(conn_arg);
 	}
 
 	debug3("_slurmctld_rpc_mgr shutting down");
 	slurm_attr_destroy(&thread_attr_rpc_req);
+#if HAVE_SYS_EPOLL_H
+	(void) close(epoll_fd);
+	xfree(events);
+#endif
 	for (i=0; i<nports; i++)
 		(void) slurm_shutdown_msg_engine(sockfd[i]);
 	xfree(sockfd);
+
+	/* Connections still queued are not processed, wake the idle workers
+	 * so they can exit */
+	slurm_mutex_lock(&rpc_queue_lock);
+	while ((conn_arg = _rpc_queue_remove())) {
+		slurm_close_accepted_conn(conn_arg->newsockfd);
+		xfree(conn_arg);
+	}
+	xfree(rpc_queue);
+	rpc_queue_size = 0;
+	pthread_cond_broadcast(&rpc_queue_get_cond);
+	slurm_mutex_unlock(&rpc_queue_lock);
+
 	_free_server_thread();
 	pthread_exit((void *) 0);
 	return NULL;
 }
 
+/* Remove the oldest connection from the RPC queue.
+ * NOTE: Caller must hold rpc_queue_lock
+ * RET connection or NULL if the queue is empty */
+static connection_arg_t *_rpc_queue_remove(void)
+{
+	connection_arg_t *conn_arg;
+
+	if (slurmctld_diag_stats.rpc_queue_len == 0)
+		return NULL;
+	conn_arg = rpc_queue[rpc_queue_head];
+	rpc_queue[rpc_queue_head] = NULL;
+	rpc_queue_head = (rpc_queue_head + 1) % rpc_queue_size;
+	slurmctld_diag_stats.rpc_queue_len--;
+	pthread_cond_signal(&rpc_queue_add_cond);
+	return conn_arg;
+}
+
+/* Append an accepted connection to the RPC queue and wake a worker.
+ * Space must have been reserved with _wait_for_rpc_queue_space() */
+static void _rpc_queue_add(connection_arg_t *conn_arg)
+{
+	uint32_t inx;
+
+	slurm_mutex_lock(&rpc_queue_lock);
+	inx = (rpc_queue_head + slurmctld_diag_stats.rpc_queue_len) %
+	      rpc_queue_size;
+	rpc_queue[inx] = conn_arg;
+	slurmctld_diag_stats.rpc_queue_len++;
+	if (slurmctld_diag_stats.rpc_queue_max <
+	    slurmctld_diag_stats.rpc_queue_len) {
+		slurmctld_diag_stats.rpc_queue_max =
+			slurmctld_diag_stats.rpc_queue_len;
+	}
+	pthread_cond_signal(&rpc_queue_get_cond);
+	slurm_mutex_unlock(&rpc_queue_lock);
+}
+
+/* Don't return until the RPC queue has space for another connection,
+ * RET true unless shutdown in progress */
+static bool _wait_for_rpc_queue_space(void)
+{
+	bool print_it = true;
+	bool rc = true;
+
+	slurm_mutex_lock(&rpc_queue_lock);
+	while (1) {
+		if (slurmctld_config.shutdown_time) {
+			rc = false;
+			break;
+		}
+		if (slurmctld_diag_stats.rpc_queue_len < rpc_queue_size)
+			break;
+		/* wait for a worker to take a connection and retry,
+		 * just a delay and not an error.
+		 * This can happen when the epilog completes
+		 * on a bunch of nodes at the same time, which
+		 * can easily happen for highly parallel jobs. */
+		if (print_it) {
+			static time_t last_print_time = 0;
+			time_t now = time(NULL);
+			if (difftime(now, last_print_time) > 2) {
+				verbose("RPC queue length at limit (%u), "
+					"waiting",
+					slurmctld_diag_stats.rpc_queue_len);
+				last_print_time = now;
+			}
+			print_it = false;
+		}
+		pthread_cond_wait(&rpc_queue_add_cond, &rpc_queue_lock);
+	}
+	slurm_mutex_unlock(&rpc_queue_lock);
+	return rc;
+}
+
+/* _rpc_worker - Service connections from the RPC queue until shutdown */
+static void *_rpc_worker(void *no_data)
+{
+	connection_arg_t *conn_arg;
+
+	while (1) {
+		slurm_mutex_lock(&rpc_queue_lock);
+		while (((conn_arg = _rpc_queue_remove()) == NULL) &&
+		       !slurmctld_config.shutdown_time) {
+			pthread_cond_wait(&rpc_queue_get_cond,
+					  &rpc_queue_lock);
+		}
+		slurm_mutex_unlock(&rpc_queue_lock);
+		if (conn_arg == NULL)
+			break;
+
+		slurmctld_diag_stats.proc_req_threads++;
+		_busy_server_thread();
+		_service_connection((void *) conn_arg);
+	}
+
+	return NULL;
+}
+
 /*
  * _service_connection - service the RPC
  * IN/OUT arg - really just the connection's file descriptor, freed
  *	upon completion
- * RET - NULL
+ * NOTE: Caller must call _busy_server_thread() first
  */
-static void *_service_connection(void *arg)
+static void _service_connection(void *arg)
 {
 	connection_arg_t *conn = (connection_arg_t *) arg;
-	void *return_code = NULL;
 	slurm_msg_t *msg = xmalloc(sizeof(slurm_msg_t));
+	struct timeval end_time;
+	uint16_t msg_type;
 
 	slurm_msg_t_init(msg);
+	(void) g_slurm_auth_thread_usec(true);
 	/*
 	 * slurm_receive_msg sets msg connection fd to accepted fd. This allows
 	 * possibility for slurmctld_req() to close accepted connection.
@@ -1014,6 +1201,7 @@ static void *_service_connection(void *arg)
 		goto cleanup;
 	}
 
+	msg_type = msg->msg_type;
 	if (errno != SLURM_SUCCESS) {
 		if (errno == SLURM_PROTOCOL_VERSION_ERROR) {
 			slurm_send_rc_msg(msg, SLURM_PROTOCOL_VERSION_ERROR);
@@ -1022,6 +1210,10 @@ static void *_service_connection(void *arg)
 	} else {
 		/* process the request */
 		slurmctld_req(msg);
+		gettimeofday(&end_time, NULL);
+		record_rpc_stats(msg_type,
+				 slurm_diff_tv(&conn->accept_time, &end_time),
+				 g_slurm_auth_thread_usec(true));
 	}
 	if ((conn->newsockfd >= 0)
 	    && slurm_close_accepted_conn(conn->newsockfd) < 0)
@@ -1031,50 +1223,16 @@ cleanup:
 	slurm_free_msg(msg);
 	xfree(arg);
 	_free_server_thread();
-	return return_code;
 }
 
-/* Increment slurmctld_config.server_thread_count and don't return
- * until its value is no larger than MAX_SERVER_THREADS,
- * RET true unless shutdown in progress */
-static bool _wait_for_server_thread(void)
+/* Increment slurmctld_config.server_thread_count for a thread which is
+ * about to service an RPC. The size of the worker pool keeps the count
+ * within max_server_threads. */
+static void _busy_server_thread(void)
 {
-	bool print_it = true;
-	bool rc = true;
-
 	slurm_mutex_lock(&slurmctld_config.thread_count_lock);
-	while (1) {
-		if (slurmctld_config.shutdown_time) {
-			rc = false;
-			break;
-		}
-		if (slurmctld_config.server_thread_count < max_server_threads) {
-			slurmctld_config.server_thread_count++;
-			break;
-		} else {
-			/* wait for state change and retry,
-			 * just a delay and not an error.
-			 * This can happen when the epilog completes
-			 * on a bunch of nodes at the same time, which
-			 * can easily happen for highly parallel jobs. */
-			if (print_it) {
-				static time_t last_print_time = 0;
-				time_t now = time(NULL);
-				if (difftime(now, last_print_time) > 2) {
-					verbose("server_thread_count over "
-						"limit (%d), waiting",
-						slurmctld_config.
-						server_thread_count);
-					last_print_time = now;
-				}
-				print_it = false;
-			}
-			pthread_cond_wait(&server_thread_cond,
-					  &slurmctld_config.thread_count_lock);
-		}
-	}
+	slurmctld_config.server_thread_count++;
 	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
-	return rc;
 }
 
 static void _free_server_thread(void)
@@ -1084,7 +1242,6 @@ static void _free_server_thread(void)
 		slurmctld_config.server_thread_count--;
 	else
 		error("slurmctld_config.server_thread_count underflow");
-	pthread_cond_broadcast(&server_thread_cond);
 	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
 }
 
@@ -1727,6 +1884,13 @@ static int _report_locks_set(void)
 int slurmctld_shutdown(void)
 {
 	debug("sched: slurmctld terminating");
+
+	/* wake the RPC manager and idle workers waiting on the RPC queue */
+	slurm_mutex_lock(&rpc_queue_lock);
+	pthread_cond_broadcast(&rpc_queue_add_cond);
+	pthread_cond_broadcast(&rpc_queue_get_cond);
+	slurm_mutex_unlock(&rpc_queue_lock);
+
 	if (slurmctld_config.thread_id_rpc) {
 		pthread_kill(slurmctld_config.thread_id_rpc, SIGUSR1);
 		return SLURM_SUCCESS;
@@ -0,0 +1,258 @@
+/*****************************************************************************\
+ *  info_cache.c - cache of packed job, node and partition records
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <pthread.h>
+#include <string.h>
+
+#include "src/common/log.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/info_cache.h"
+
+static void _free_rec(info_cache_rec_t *cache_rec)
+{
+	if (cache_rec->buffer)
+		free_buf(cache_rec->buffer);
+	xfree(cache_rec->rec_id);
+	xfree(cache_rec->rec_offset);
+	xfree(cache_rec->rec_ptr);
+	xfree(cache_rec);
+}
+
+/* Remove a cache entry, freeing it unless some thread is still using it.
+ * NOTE: Caller must hold cache->mutex */
+static void _remove_rec(info_cache_t *cache, int inx)
+{
+	info_cache_rec_t *cache_rec = cache->rec[inx];
+
+	cache->rec[inx] = NULL;
+	cache_rec->cached = false;
+	if (cache_rec->ref_cnt == 0)
+		_free_rec(cache_rec);
+}
+
+/* Entries packed during the same second as the last update might have
+ * missed it, so they are not reused */
+static bool _rec_current(info_cache_rec_t *cache_rec, time_t last_update,
+			 time_t now)
+{
+	return ((cache_rec->last_update == last_update) &&
+		(cache_rec->pack_time > last_update) &&
+		((now - cache_rec->pack_time) < INFO_CACHE_MAX_AGE));
+}
+
+/*
+ * info_cache_get - find cached records for the given protocol version and
+ *	show_flags which are current as of last_update
+ * RET cache entry, release with info_cache_release(), or NULL if none
+ */
+extern info_cache_rec_t *info_cache_get(info_cache_t *cache,
+					uint16_t protocol_version,
+					uint16_t show_flags,
+					time_t last_update)
+{
+	info_cache_rec_t *cache_rec, *found = NULL;
+	time_t now = time(NULL);
+	int i;
+
+	slurm_mutex_lock(&cache->mutex);
+	for (i = 0; i < INFO_CACHE_SIZE; i++) {
+		cache_rec = cache->rec[i];
+		if (cache_rec == NULL)
+			continue;
+		if (!_rec_current(cache_rec, last_update, now)) {
+			_remove_rec(cache, i);
+			continue;
+		}
+		if ((cache_rec->protocol_version == protocol_version) &&
+		    (cache_rec->show_flags == show_flags)) {
+			cache_rec->ref_cnt++;
+			found = cache_rec;
+		}
+	}
+	slurm_mutex_unlock(&cache->mutex);
+
+	return found;
+}
+
+/*
+ * info_cache_create - create a cache entry to be filled in by calling
+ *	info_cache_mark() before packing each record into its buffer and
+ *	then added to the cache with info_cache_put()
+ * IN rec_cnt - expected record count, the entry grows as needed
+ */
+extern info_cache_rec_t *info_cache_create(uint16_t protocol_version,
+					   uint16_t show_flags,
+					   time_t last_update,
+					   uint32_t rec_cnt)
+{
+	info_cache_rec_t *cache_rec = xmalloc(sizeof(info_cache_rec_t));
+
+	cache_rec->buffer = init_buf(BUF_SIZE);
+	cache_rec->last_update = last_update;
+	cache_rec->pack_time = time(NULL);
+	cache_rec->protocol_version = protocol_version;
+	cache_rec->show_flags = show_flags;
+	cache_rec->rec_size = MAX(rec_cnt, 16) + 1;
+	cache_rec->rec_id = xmalloc(sizeof(uint32_t) * cache_rec->rec_size);
+	cache_rec->rec_offset = xmalloc(sizeof(uint32_t) *
+					cache_rec->rec_size);
+	cache_rec->rec_ptr = xmalloc(sizeof(void *) * cache_rec->rec_size);
+	cache_rec->ref_cnt = 1;
+
+	return cache_rec;
+}
+
+/* info_cache_mark - note the start of the next packed record */
+extern void info_cache_mark(info_cache_rec_t *cache_rec, void *rec_ptr,
+			    uint32_t rec_id)
+{
+	uint32_t inx = cache_rec->rec_cnt;
+
+	if ((inx + 1) >= cache_rec->rec_size) {	/* leave room for end */
+		cache_rec->rec_size *= 2;
+		xrealloc(cache_rec->rec_id,
+			 sizeof(uint32_t) * cache_rec->rec_size);
+		xrealloc(cache_rec->rec_offset,
+			 sizeof(uint32_t) * cache_rec->rec_size);
+		xrealloc(cache_rec->rec_ptr,
+			 sizeof(void *) * cache_rec->rec_size);
+	}
+	cache_rec->rec_id[inx] = rec_id;
+	cache_rec->rec_ptr[inx] = rec_ptr;
+	cache_rec->rec_offset[inx] = get_buf_offset(cache_rec->buffer);
+	cache_rec->rec_cnt++;
+}
+
+/*
+ * info_cache_put - add a filled in entry to the cache, replacing any entry
+ *	for the same protocol version and show_flags or else the oldest one.
+ *	The caller retains its reference to the entry.
+ */
+extern void info_cache_put(info_cache_t *cache, info_cache_rec_t *cache_rec)
+{
+	int i, inx = -1;
+
+	cache_rec->rec_offset[cache_rec->rec_cnt] =
+		get_buf_offset(cache_rec->buffer);
+	if (!_rec_current(cache_rec, cache_rec->last_update, time(NULL)))
+		return;
+
+	slurm_mutex_lock(&cache->mutex);
+	for (i = 0; i < INFO_CACHE_SIZE; i++) {
+		if (cache->rec[i] == NULL) {
+			if (inx == -1)
+				inx = i;
+			continue;
+		}
+		if ((cache->rec[i]->protocol_version ==
+		     cache_rec->protocol_version) &&
+		    (cache->rec[i]->show_flags == cache_rec->show_flags)) {
+			if (cache->rec[i]->pack_time > cache_rec->pack_time) {
+				/* Another thread packed newer records */
+				slurm_mutex_unlock(&cache->mutex);
+				return;
+			}
+			inx = i;
+			break;
+		}
+	}
+	if (inx == -1) {
+		inx = 0;
+		for (i = 1; i < INFO_CACHE_SIZE; i++) {
+			if (cache->rec[i]->pack_time <
+			    cache->rec[inx]->pack_time)
+				inx = i;
+		}
+	}
+	if (cache->rec[inx])
+		_remove_rec(cache, inx);
+	cache->rec[inx] = cache_rec;
+	cache_rec->cached = true;
+	slurm_mutex_unlock(&cache->mutex);
+}
+
+/*
+ * info_cache_copy - copy a record's packed data into a buffer
+ * IN/OUT cursor - index at which to start looking for the record, set to
+ *	the index following it when found. Records are found fastest when
+ *	requested in the order they were packed.
+ * RET true if copied, false if the record is not in the entry
+ */
+extern bool info_cache_copy(info_cache_rec_t *cache_rec, uint32_t *cursor,
+			    void *rec_ptr, uint32_t rec_id, Buf buffer)
+{
+	uint32_t i, start, end;
+
+	for (i = *cursor; i < cache_rec->rec_cnt; i++) {
+		if ((cache_rec->rec_ptr[i] != rec_ptr) ||
+		    (cache_rec->rec_id[i] != rec_id))
+			continue;
+		start = cache_rec->rec_offset[i];
+		end   = cache_rec->rec_offset[i + 1];
+		packmem_array(get_buf_data(cache_rec->buffer) + start,
+			      end - start, buffer);
+		*cursor = i + 1;
+		return true;
+	}
+	return false;
+}
+
+/* info_cache_release - release a reference to a cache entry */
+extern void info_cache_release(info_cache_t *cache,
+			       info_cache_rec_t *cache_rec)
+{
+	slurm_mutex_lock(&cache->mutex);
+	cache_rec->ref_cnt--;
+	if ((cache_rec->ref_cnt == 0) && !cache_rec->cached)
+		_free_rec(cache_rec);
+	slurm_mutex_unlock(&cache->mutex);
+}
+
+/* info_cache_purge - free all cached entries not currently in use */
+extern void info_cache_purge(info_cache_t *cache)
+{
+	int i;
+
+	slurm_mutex_lock(&cache->mutex);
+	for (i = 0; i < INFO_CACHE_SIZE; i++) {
+		if (cache->rec[i])
+			_remove_rec(cache, i);
+	}
+	slurm_mutex_unlock(&cache->mutex);
+}
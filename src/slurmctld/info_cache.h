@@ -0,0 +1,132 @@
+/*****************************************************************************\
+ *  info_cache.h - cache of packed job, node and partition records
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _HAVE_INFO_CACHE_H
+#define _HAVE_INFO_CACHE_H
+
+#include <pthread.h>
+#include <time.h>
+
+#include "src/common/macros.h"
+#include "src/common/pack.h"
+
+/* Maximum number of protocol version and show_flags combinations cached
+ * for each record type */
+#define INFO_CACHE_SIZE 4
+
+/* Seconds for which packed records are reused. A few fields (e.g. node CPU
+ * load, pending job expected start time) change without an update to the
+ * last_*_update time stamps, so they are refreshed at least this often. */
+#define INFO_CACHE_MAX_AGE 10
+
+/*
+ * Records of one type (jobs, nodes or partitions) packed for one protocol
+ * version and set of show_flags. Information requests copy the packed
+ * records of the entries they want to report rather than packing each
+ * record again.
+ */
+typedef struct info_cache_rec {
+	Buf buffer;		/* packed records */
+	time_t last_update;	/* last_*_update value when records packed */
+	time_t pack_time;	/* time packing started */
+	uint16_t protocol_version;
+	uint16_t show_flags;
+	uint32_t rec_cnt;	/* count of packed records */
+	uint32_t rec_size;	/* size of rec_* arrays */
+	uint32_t *rec_id;	/* job ID or node index of each record */
+	uint32_t *rec_offset;	/* buffer offset of each record, the extra
+				 * entry at rec_cnt is the end of the last */
+	void **rec_ptr;		/* record pointer of each packed record */
+	int ref_cnt;		/* number of threads using this entry */
+	bool cached;		/* set if entry is in the cache */
+} info_cache_rec_t;
+
+typedef struct info_cache {
+	pthread_mutex_t mutex;
+	info_cache_rec_t *rec[INFO_CACHE_SIZE];
+} info_cache_t;
+
+#define INFO_CACHE_INITIALIZER	{ PTHREAD_MUTEX_INITIALIZER, { NULL } }
+
+/*
+ * info_cache_get - find cached records for the given protocol version and
+ *	show_flags which are current as of last_update
+ * RET cache entry, release with info_cache_release(), or NULL if none
+ */
+extern info_cache_rec_t *info_cache_get(info_cache_t *cache,
+					uint16_t protocol_version,
+					uint16_t show_flags,
+					time_t last_update);
+
+/*
+ * info_cache_create - create a cache entry to be filled in by calling
+ *	info_cache_mark() before packing each record into its buffer and
+ *	then added to the cache with info_cache_put()
+ * IN rec_cnt - expected record count, the entry grows as needed
+ */
+extern info_cache_rec_t *info_cache_create(uint16_t protocol_version,
+					   uint16_t show_flags,
+					   time_t last_update,
+					   uint32_t rec_cnt);
+
+/* info_cache_mark - note the start of the next packed record */
+extern void info_cache_mark(info_cache_rec_t *cache_rec, void *rec_ptr,
+			    uint32_t rec_id);
+
+/*
+ * info_cache_put - add a filled in entry to the cache, replacing any entry
+ *	for the same protocol version and show_flags or else the oldest one.
+ *	The caller retains its reference to the entry.
+ */
+extern void info_cache_put(info_cache_t *cache, info_cache_rec_t *cache_rec);
+
+/*
+ * info_cache_copy - copy a record's packed data into a buffer
+ * IN/OUT cursor - index at which to start looking for the record, set to
+ *	the index following it when found. Records are found fastest when
+ *	requested in the order they were packed.
+ * RET true if copied, false if the record is not in the entry
+ */
+extern bool info_cache_copy(info_cache_rec_t *cache_rec, uint32_t *cursor,
+			    void *rec_ptr, uint32_t rec_id, Buf buffer);
+
+/* info_cache_release - release a reference to a cache entry */
+extern void info_cache_release(info_cache_t *cache,
+			       info_cache_rec_t *cache_rec);
+
+/* info_cache_purge - free all cached entries not currently in use */
+extern void info_cache_purge(info_cache_t *cache);
+
+#endif /* !_HAVE_INFO_CACHE_H */
@@ -0,0 +1,171 @@
+/*****************************************************************************\
+ *  job_journal.c - records of the job state snapshot and journal
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "src/common/log.h"
+#include "src/slurmctld/job_journal.h"
+
+/* FNV-1a hash of a job's packed state, never 0 as in older journals */
+static uint32_t _job_state_sum(char *data, uint32_t len)
+{
+	uint32_t i, sum = 2166136261U;
+
+	for (i = 0; i < len; i++) {
+		sum ^= (unsigned char) data[i];
+		sum *= 16777619;
+	}
+	return sum ? sum : 1;
+}
+
+/* job_journal_pack_op - pack a record without a job image */
+extern void job_journal_pack_op(uint16_t op, uint32_t job_id, Buf buffer)
+{
+	pack16(op, buffer);
+	pack32(job_id, buffer);
+	pack32((uint32_t) 0, buffer);	/* checksum */
+	pack32((uint32_t) 0, buffer);	/* image length */
+}
+
+/*
+ * job_journal_pack_begin - start a JOB_JOURNAL_SAVE record, the job's image
+ *	is to be packed next
+ * RET offset of the image, to be passed to job_journal_pack_end()
+ */
+extern uint32_t job_journal_pack_begin(uint32_t job_id, Buf buffer)
+{
+	job_journal_pack_op(JOB_JOURNAL_SAVE, job_id, buffer);
+	return get_buf_offset(buffer);
+}
+
+/* job_journal_pack_end - complete a record once its image is packed */
+extern void job_journal_pack_end(uint32_t img_offset, Buf buffer)
+{
+	uint32_t end_offset = get_buf_offset(buffer);
+	uint32_t len = end_offset - img_offset;
+
+	set_buf_offset(buffer, img_offset - (2 * sizeof(uint32_t)));
+	pack32(_job_state_sum(get_buf_data(buffer) + img_offset, len), buffer);
+	pack32(len, buffer);
+	set_buf_offset(buffer, end_offset);
+}
+
+/*
+ * job_journal_scan - check the records of a journal and find the last
+ *	record of each job
+ * IN/OUT buffer - the journal, positioned after its header, left there
+ * IN/OUT hash - if not NULL, job id to last record of the job
+ * IN/OUT job_id_seq - raised to the highest job_id_sequence recorded
+ * RET offset of the end of the last good record
+ */
+extern uint32_t job_journal_scan(Buf buffer, id_hash_t *hash,
+				 uint32_t *job_id_seq)
+{
+	uint32_t start = get_buf_offset(buffer), offset = start;
+	uint32_t job_id, sum, len;
+	uint16_t op;
+	char *rec;
+
+	while (remaining_buf(buffer) > 0) {
+		rec = get_buf_data(buffer) + get_buf_offset(buffer);
+		safe_unpack16(&op, buffer);
+		safe_unpack32(&job_id, buffer);
+		safe_unpack32(&sum, buffer);
+		safe_unpack32(&len, buffer);
+		if (len > remaining_buf(buffer))
+			goto unpack_error;
+		if ((op == JOB_JOURNAL_SAVE) &&
+		    (_job_state_sum(get_buf_data(buffer) +
+				    get_buf_offset(buffer), len) != sum))
+			goto unpack_error;
+		set_buf_offset(buffer, get_buf_offset(buffer) + len);
+
+		if (op == JOB_JOURNAL_SEQ) {
+			if (job_id > *job_id_seq)
+				*job_id_seq = job_id;
+		} else if (hash) {
+			/* a later record of the job replaces the earlier */
+			(void) id_hash_remove(hash, job_id);
+			(void) id_hash_add(hash, job_id, rec);
+		}
+		offset = get_buf_offset(buffer);
+	}
+	set_buf_offset(buffer, start);
+	return offset;
+
+unpack_error:
+	error("Job state journal is incomplete, recovering what was saved");
+	set_buf_offset(buffer, start);
+	return offset;
+}
+
+/*
+ * job_journal_next - read the header of the next record of a snapshot or
+ *	journal
+ * IN/OUT buffer - positioned at the record, left at its job image if the
+ *	image is to be loaded, else moved past the record
+ * IN hash - job id to last record in the journal from job_journal_scan(),
+ *	NULL if there is no journal
+ * IN journal - true if buffer is the journal, false if the snapshot
+ * OUT len - length of the job image
+ * RET 1 if the job image is to be loaded, 0 if the record is superseded or
+ *	has no image, -1 if the record is cut short
+ */
+extern int job_journal_next(Buf buffer, id_hash_t *hash, bool journal,
+			    uint32_t *len)
+{
+	char *rec = get_buf_data(buffer) + get_buf_offset(buffer), *last;
+	uint32_t job_id, sum;
+	uint16_t op;
+
+	safe_unpack16(&op, buffer);
+	safe_unpack32(&job_id, buffer);
+	safe_unpack32(&sum, buffer);
+	safe_unpack32(len, buffer);
+	if (*len > remaining_buf(buffer))
+		goto unpack_error;
+
+	last = hash ? id_hash_find(hash, job_id) : NULL;
+	if ((op != JOB_JOURNAL_SAVE) || (journal ? (last != rec) : !!last)) {
+		set_buf_offset(buffer, get_buf_offset(buffer) + *len);
+		return 0;
+	}
+	return 1;
+
+unpack_error:
+	return -1;
+}
@@ -0,0 +1,99 @@
+/*****************************************************************************\
+ *  job_journal.h - records of the job state snapshot and journal
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _HAVE_JOB_JOURNAL_H
+#define _HAVE_JOB_JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "src/common/id_hash.h"
+#include "src/common/pack.h"
+
+/*
+ * Job state is saved as a snapshot of all jobs in job_state and a journal
+ * of the changes since in job_state.log, see dump_all_job_state(). Both
+ * hold a series of records: a type, a job id, a checksum and the length of
+ * a job image followed by the image. Only the last record of a job in the
+ * journal counts, any earlier record of the job in the journal or the
+ * snapshot is superseded by it. A record cut short or with a bad checksum,
+ * as left by a crash during a write, ends the journal.
+ */
+
+/* Record types */
+#define JOB_JOURNAL_SAVE	1	/* state of a job */
+#define JOB_JOURNAL_PURGE	2	/* job record purged */
+#define JOB_JOURNAL_SEQ		3	/* job_id_sequence in the job id */
+
+/* job_journal_pack_op - pack a record without a job image */
+extern void job_journal_pack_op(uint16_t op, uint32_t job_id, Buf buffer);
+
+/*
+ * job_journal_pack_begin - start a JOB_JOURNAL_SAVE record, the job's image
+ *	is to be packed next
+ * RET offset of the image, to be passed to job_journal_pack_end()
+ */
+extern uint32_t job_journal_pack_begin(uint32_t job_id, Buf buffer);
+
+/* job_journal_pack_end - complete a record once its image is packed */
+extern void job_journal_pack_end(uint32_t img_offset, Buf buffer);
+
+/*
+ * job_journal_scan - check the records of a journal and find the last
+ *	record of each job
+ * IN/OUT buffer - the journal, positioned after its header, left there
+ * IN/OUT hash - if not NULL, job id to last record of the job
+ * IN/OUT job_id_seq - raised to the highest job_id_sequence recorded
+ * RET offset of the end of the last good record
+ */
+extern uint32_t job_journal_scan(Buf buffer, id_hash_t *hash,
+				 uint32_t *job_id_seq);
+
+/*
+ * job_journal_next - read the header of the next record of a snapshot or
+ *	journal
+ * IN/OUT buffer - positioned at the record, left at its job image if the
+ *	image is to be loaded, else moved past the record
+ * IN hash - job id to last record in the journal from job_journal_scan(),
+ *	NULL if there is no journal
+ * IN journal - true if buffer is the journal, false if the snapshot
+ * OUT len - length of the job image
+ * RET 1 if the job image is to be loaded, 0 if the record is superseded or
+ *	has no image, -1 if the record is cut short
+ */
+extern int job_journal_next(Buf buffer, id_hash_t *hash, bool journal,
+			    uint32_t *len);
+
+#endif /* !_HAVE_JOB_JOURNAL_H */
@@ -65,6 +65,7 @@
 #include "src/common/forward.h"
 #include "src/common/gres.h"
 #include "src/common/hostlist.h"
+#include "src/common/id_hash.h"
 #include "src/common/node_select.h"
 #include "src/common/parse_time.h"
 #include "src/common/slurm_accounting_storage.h"
@@ -78,12 +79,17 @@
 
 #include "src/slurmctld/acct_policy.h"
 #include "src/slurmctld/agent.h"
+#include "src/slurmctld/batch_store.h"
 #include "src/slurmctld/front_end.h"
+#include "src/slurmctld/info_cache.h"
+#include "src/slurmctld/job_journal.h"
 #include "src/slurmctld/job_scheduler.h"
 #include "src/slurmctld/job_submit.h"
 #include "src/slurmctld/licenses.h"
 #include "src/slurmctld/locks.h"
+#include "src/slurmctld/node_job_map.h"
 #include "src/slurmctld/node_scheduler.h"
+#include "src/slurmctld/pend_queue.h"
 #include "src/slurmctld/preempt.h"
 #include "src/slurmctld/proc_req.h"
 #include "src/slurmctld/reservation.h"
@@ -98,17 +104,22 @@
 #define STEP_FLAG 0xbbbb
 #define TOP_PRIORITY 0xffff0000	/* large, but leave headroom for higher */
 
-#define JOB_HASH_INX(_job_id)	(_job_id % hash_table_size)
-
 /* Change JOB_STATE_VERSION value when changing the state save format */
-#define JOB_STATE_VERSION      "VER014"
-#define JOB_2_6_STATE_VERSION  "VER014"		/* SLURM version 2.5 */
+#define JOB_STATE_VERSION      "VER015"
+#define JOB_2_6_STATE_VERSION  "VER014"		/* SLURM version 2.6.0pre1 */
 #define JOB_2_5_STATE_VERSION  "VER013"		/* SLURM version 2.5 */
 #define JOB_2_4_STATE_VERSION  "VER012"		/* SLURM version 2.4 */
 #define JOB_2_3_STATE_VERSION  "VER011"		/* SLURM version 2.3 */
 #define JOB_2_2_STATE_VERSION  "VER010"		/* SLURM version 2.2 */
 #define JOB_2_1_STATE_VERSION  "VER009"		/* SLURM version 2.1 */
 
+/* Journal size below which the job state snapshot is not rewritten */
+#define JOB_JOURNAL_MIN_SIZE	(1024 * 1024)	/* min size to compact at */
+
+/* Longest time a running job goes unexamined by job_time_limit(), bounds
+ * the delay for deadlines made earlier without calling job_timer_arm() */
+#define JOB_TIMER_MAX_WAIT	300
+
 #define JOB_CKPT_VERSION      "JOB_CKPT_002"
 #define JOB_2_2_CKPT_VERSION  "JOB_CKPT_002"	/* SLURM version 2.2 */
 #define JOB_2_1_CKPT_VERSION  "JOB_CKPT_001"	/* SLURM version 2.1 */
@@ -120,21 +131,32 @@ time_t last_job_update;		/* time of last update to job records */
 /* Local variables */
 static uint32_t highest_prio = 0;
 static uint32_t lowest_prio  = TOP_PRIORITY;
-static int      hash_table_size = 0;
 static int      job_count = 0;		/* job's in the system */
 static uint32_t job_id_sequence = 0;	/* first job_id to assign new job */
-static struct   job_record **job_hash = NULL;
+static id_hash_t *job_hash = NULL;	/* job_id to job record */
+static info_cache_t job_info_cache = INFO_CACHE_INITIALIZER;
 static bool     wiki_sched = false;
+
+/* Job state snapshot and journal, see dump_all_job_state() */
+static pthread_mutex_t journal_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t *journal_purged = NULL;	/* jobs purged since last save */
+static int      journal_purged_cnt = 0, journal_purged_size = 0;
+static bool     journal_snapshot_needed = true;
+static uint32_t journal_snapshot_id = 0;
+static uint32_t journal_snapshot_size = 0, journal_size = 0;
 static bool     wiki2_sched = false;
 static bool     wiki_sched_test = false;
 
+/* Running jobs keyed on when job_time_limit() next needs to examine them */
+static timer_wheel_t *job_timers = NULL;
+static bool     job_timers_rebuild = true;
+static time_t   job_timers_conf_update = 0, job_timers_resv_update = 0;
+
 /* Local functions */
 static void _add_job_hash(struct job_record *job_ptr);
 static int  _checkpoint_job_record (struct job_record *job_ptr,
 				    char *image_dir);
 static int  _copy_job_desc_files(uint32_t job_id_src, uint32_t job_id_dest);
-static int  _copy_job_desc_to_file(job_desc_msg_t * job_desc,
-				   uint32_t job_id);
 static int  _copy_job_desc_to_job_record(job_desc_msg_t * job_desc,
 					 struct job_record **job_ptr,
 					 bitstr_t ** exc_bitmap,
@@ -152,7 +174,13 @@ static void _dump_job_details(struct job_details *detail_ptr,
 static void _dump_job_state(struct job_record *dump_job_ptr, Buf buffer);
 static int  _find_batch_dir(void *x, void *key);
 static void _get_batch_job_dir_ids(List batch_dirs);
+static info_cache_rec_t *_get_job_info_cache(uint16_t show_flags,
+					     uint16_t protocol_version);
+static void _job_time_check(struct job_record *job_ptr, time_t now,
+			    time_t old, time_t over_run);
 static void _job_timed_out(struct job_record *job_ptr);
+static time_t _job_timer_next(struct job_record *job_ptr, time_t now);
+static void _job_timers_rebuild(time_t now);
 static int  _job_create(job_desc_msg_t * job_specs, int allocate, int will_run,
 			struct job_record **job_rec_ptr, uid_t submit_uid);
 static void _list_delete_job(void *job_entry);
@@ -177,6 +205,9 @@ static void _purge_missing_jobs(int node_inx, time_t now);
 static void _read_data_array_from_file(char *file_name, char ***data,
 				       uint32_t * size,
  				       struct job_record *job_ptr);
+static void _env_array(char *buffer, int data_size, uint32_t rec_cnt,
+		       char *name, char ***data, uint32_t *size,
+		       struct job_record *job_ptr);
 static void _read_data_from_file(char *file_name, char **data);
 static char *_read_job_ckpt_file(char *ckpt_file, int *size_ptr);
 static void _remove_defunct_batch_dirs(List batch_dirs);
@@ -194,9 +225,6 @@ static bool _top_priority(struct job_record *job_ptr);
 static int  _validate_job_desc(job_desc_msg_t * job_desc_msg, int allocate,
 			       uid_t submit_uid, struct part_record *part_ptr);
 static void _validate_job_files(List batch_dirs);
-static int  _write_data_to_file(char *file_name, char *data);
-static int  _write_data_array_to_file(char *file_name, char **data,
-				      uint32_t size);
 static void _xmit_new_end_time(struct job_record *job_ptr);
 
 
@@ -233,6 +261,8 @@ struct job_record *create_job_record(int *error_code)
 	job_ptr->details = detail_ptr;
 	job_ptr->prio_factors = xmalloc(sizeof(priority_factors_object_t));
 	job_ptr->step_list = list_create(NULL);
+	job_ptr->journal_dirty = true;
+	timer_ent_init(&job_ptr->time_limit_ent, job_ptr);
 
 	xassert (detail_ptr->magic = DETAILS_MAGIC); /* set value */
 	detail_ptr->submit_time = time(NULL);
@@ -291,12 +321,16 @@ void delete_job_details(struct job_record *job_entry)
 	xfree(job_entry->details);	/* Must be last */
 }
 
-/* _delete_job_desc_files - delete job descriptor related files */
+/* _delete_job_desc_files - delete job descriptor related files, those of
+ *	jobs saved before batch_store.c was used are in a job.<id> directory */
 static void _delete_job_desc_files(uint32_t job_id)
 {
 	char *dir_name, job_dir[20], *file_name;
 	struct stat sbuf;
 
+	if (batch_store_delete(job_id) == SLURM_SUCCESS)
+		return;
+
 	dir_name = slurm_get_state_save_location();
 
 	sprintf(job_dir, "/job.%d", job_id);
@@ -414,27 +448,69 @@ static slurmdb_qos_rec_t *_determine_and_validate_qos(
 
 
 /*
- * dump_all_job_state - save the state of all jobs to file for checkpoint
+ * _pack_job_journal_rec - pack a job's state as a journal record, its image
+ *	as written by _dump_job_state(), and mark the job saved
+ */
+static void _pack_job_journal_rec(struct job_record *job_ptr, Buf buffer)
+{
+	uint32_t img_offset;
+
+	img_offset = job_journal_pack_begin(job_ptr->job_id, buffer);
+	_dump_job_state(job_ptr, buffer);
+	job_journal_pack_end(img_offset, buffer);
+
+	job_ptr->journal_dirty = false;
+	job_ptr->journal_saved = true;
+	job_ptr->journal_db_index = job_ptr->db_index;
+}
+
+/* Write all of a buffer to a file, RET 0 or errno */
+static int _write_job_state_buf(int fd, Buf buffer, char *file_name)
+{
+	int pos = 0, nwrite = get_buf_offset(buffer), amount;
+	char *data = (char *)get_buf_data(buffer);
+
+	while (nwrite > 0) {
+		amount = write(fd, &data[pos], nwrite);
+		if ((amount < 0) && (errno != EINTR)) {
+			error("Error writing file %s, %m", file_name);
+			return errno;
+		}
+		nwrite -= amount;
+		pos    += amount;
+	}
+	return 0;
+}
+
+/*
+ * _dump_job_snapshot - write the state of all jobs to job_state and start
+ *	an empty journal for it in job_state.log
  *	Changes here should be reflected in load_last_job_id() and
  *	load_all_job_state().
- * RET 0 or error code */
-int dump_all_job_state(void)
+ * RET 0 or error code
+ */
+static int _dump_job_snapshot(void)
 {
 	/* Save high-water mark to avoid buffer growth with copies */
 	static int high_buffer_size = (1024 * 1024);
-	int error_code = 0, log_fd;
-	char *old_file, *new_file, *reg_file;
+	int error_code = 0, log_fd, rc;
+	char *old_file, *new_file, *reg_file, *journal_file;
 	struct stat stat_buf;
 	/* Locks: Read config and job */
 	slurmctld_lock_t job_read_lock =
 		{ READ_LOCK, READ_LOCK, NO_LOCK, NO_LOCK };
 	ListIterator job_iterator;
 	struct job_record *job_ptr;
-	Buf buffer = init_buf(high_buffer_size);
+	Buf buffer = init_buf(high_buffer_size), journal;
 	time_t min_age = 0, now = time(NULL);
+	uint32_t snapshot_id;
 	DEF_TIMERS;
 
 	START_TIMER;
+	/* a new id, the journal of an older snapshot is never replayed
+	 * over this one */
+	snapshot_id = MAX((uint32_t) now, journal_snapshot_id + 1);
+
 	/* write header: version, time */
 	packstr(JOB_STATE_VERSION, buffer);
 	pack_time(now, buffer);
@@ -442,26 +518,36 @@ int dump_all_job_state(void)
 	if (slurmctld_conf.min_job_age > 0)
 		min_age = now  - slurmctld_conf.min_job_age;
 
+	/* write individual job records */
+	lock_slurmctld(job_read_lock);
 	/*
-	 * write header: job id
+	 * write header: job id, snapshot id
 	 * This is needed so that the job id remains persistent even after
 	 * slurmctld is restarted.
 	 */
 	pack32( job_id_sequence, buffer);
+	pack32(snapshot_id, buffer);
 
 	debug3("Writing job id %u to header record of job_state file",
 	       job_id_sequence);
 
-	/* write individual job records */
-	lock_slurmctld(job_read_lock);
+	/* jobs purged before now are not in the snapshot */
+	slurm_mutex_lock(&journal_lock);
+	journal_purged_cnt = 0;
+	slurm_mutex_unlock(&journal_lock);
+
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
 		xassert (job_ptr->magic == JOB_MAGIC);
 		if ((min_age > 0) && (job_ptr->end_time < min_age) &&
-		    (! IS_JOB_COMPLETING(job_ptr)) && IS_JOB_FINISHED(job_ptr))
-			continue;	/* job ready for purging, don't dump */
+		    (! IS_JOB_COMPLETING(job_ptr)) && IS_JOB_FINISHED(job_ptr)) {
+			/* job ready for purging, don't dump */
+			job_ptr->journal_dirty = false;
+			job_ptr->journal_saved = false;
+			continue;
+		}
 
-		_dump_job_state(job_ptr, buffer);
+		_pack_job_journal_rec(job_ptr, buffer);
 	}
 	list_iterator_destroy(job_iterator);
 
@@ -472,6 +558,8 @@ int dump_all_job_state(void)
 	xstrcat(reg_file, "/job_state");
 	new_file = xstrdup(slurmctld_conf.state_save_location);
 	xstrcat(new_file, "/job_state.new");
+	journal_file = xstrdup(slurmctld_conf.state_save_location);
+	xstrcat(journal_file, "/job_state.log");
 	unlock_slurmctld(job_read_lock);
 
 	if (stat(reg_file, &stat_buf) == 0) {
@@ -496,20 +584,9 @@ int dump_all_job_state(void)
 		      new_file);
 		error_code = errno;
 	} else {
-		int pos = 0, nwrite = get_buf_offset(buffer), amount, rc;
-		char *data = (char *)get_buf_data(buffer);
-		high_buffer_size = MAX(nwrite, high_buffer_size);
-		while (nwrite > 0) {
-			amount = write(log_fd, &data[pos], nwrite);
-			if ((amount < 0) && (errno != EINTR)) {
-				error("Error writing file %s, %m", new_file);
-				error_code = errno;
-				break;
-			}
-			nwrite -= amount;
-			pos    += amount;
-		}
-
+		high_buffer_size = MAX(get_buf_offset(buffer),
+				       high_buffer_size);
+		error_code = _write_job_state_buf(log_fd, buffer, new_file);
 		rc = fsync_and_close(log_fd, "job");
 		if (rc && !error_code)
 			error_code = rc;
@@ -527,16 +604,244 @@ int dump_all_job_state(void)
 			       new_file, reg_file);
 		(void) unlink(new_file);
 	}
+
+	/* start the snapshot's journal: version, snapshot id */
+	journal = init_buf(BUF_SIZE);
+	packstr(JOB_STATE_VERSION, journal);
+	pack32(snapshot_id, journal);
+	if (!error_code) {
+		log_fd = creat(journal_file, 0600);
+		if (log_fd < 0) {
+			error("Can't save state, create file %s error %m",
+			      journal_file);
+			error_code = errno;
+		} else {
+			error_code = _write_job_state_buf(log_fd, journal,
+							  journal_file);
+			rc = fsync_and_close(log_fd, "job journal");
+			if (rc && !error_code)
+				error_code = rc;
+		}
+	}
+	if (!error_code) {
+		journal_snapshot_needed = false;
+		journal_snapshot_id = snapshot_id;
+		journal_snapshot_size = get_buf_offset(buffer);
+		journal_size = get_buf_offset(journal);
+	}
 	xfree(old_file);
 	xfree(reg_file);
 	xfree(new_file);
+	xfree(journal_file);
 	unlock_state_files();
 
+	free_buf(journal);
 	free_buf(buffer);
-	END_TIMER2("dump_all_job_state");
+	END_TIMER2("_dump_job_snapshot");
+	return error_code;
+}
+
+/*
+ * _dump_job_journal - append the state of the jobs changed since the last
+ *	save and the ids of the jobs purged since to job_state.log
+ *	Changed jobs are those marked by job_journal_mark() or with a new
+ *	db_index. Only the job read lock is needed to clear their marks as
+ *	marks are only set with the job write lock.
+ * RET 0 or error code
+ */
+static int _dump_job_journal(void)
+{
+	static int high_buffer_size = (1024 * 1024);
+	int error_code = 0, log_fd, rc, i, job_cnt = 0, purge_cnt;
+	char *journal_file;
+	/* Locks: Read config and job */
+	slurmctld_lock_t job_read_lock =
+		{ READ_LOCK, READ_LOCK, NO_LOCK, NO_LOCK };
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	Buf buffer = init_buf(high_buffer_size);
+	DEF_TIMERS;
+
+	START_TIMER;
+	lock_slurmctld(job_read_lock);
+	job_journal_pack_op(JOB_JOURNAL_SEQ, job_id_sequence, buffer);
+
+	slurm_mutex_lock(&journal_lock);
+	purge_cnt = journal_purged_cnt;
+	for (i = 0; i < journal_purged_cnt; i++) {
+		job_journal_pack_op(JOB_JOURNAL_PURGE, journal_purged[i],
+				     buffer);
+	}
+	journal_purged_cnt = 0;
+	slurm_mutex_unlock(&journal_lock);
+
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		xassert (job_ptr->magic == JOB_MAGIC);
+		if (!job_ptr->journal_dirty &&
+		    (job_ptr->journal_db_index == job_ptr->db_index))
+			continue;
+		_pack_job_journal_rec(job_ptr, buffer);
+		job_cnt++;
+	}
+	list_iterator_destroy(job_iterator);
+	journal_file = xstrdup(slurmctld_conf.state_save_location);
+	xstrcat(journal_file, "/job_state.log");
+	unlock_slurmctld(job_read_lock);
+
+	if (job_cnt || purge_cnt) {
+		lock_state_files();
+		log_fd = open(journal_file, O_WRONLY | O_APPEND);
+		if (log_fd < 0) {
+			error("Can't save state, open file %s error %m",
+			      journal_file);
+			error_code = errno;
+		} else {
+			high_buffer_size = MAX(get_buf_offset(buffer),
+					       high_buffer_size);
+			error_code = _write_job_state_buf(log_fd, buffer,
+							  journal_file);
+			rc = fsync_and_close(log_fd, "job journal");
+			if (rc && !error_code)
+				error_code = rc;
+		}
+		unlock_state_files();
+		if (error_code) {
+			/* the jobs were marked saved, save them all */
+			journal_snapshot_needed = true;
+		} else
+			journal_size += get_buf_offset(buffer);
+		debug2("Saved %d changed and %d purged jobs to %s",
+		       job_cnt, purge_cnt, journal_file);
+	}
+	xfree(journal_file);
+
+	free_buf(buffer);
+	END_TIMER2("_dump_job_journal");
+	return error_code;
+}
+
+/*
+ * dump_all_job_state - save the state of all jobs to file for checkpoint
+ *	The state of the jobs changed since the last save is appended to a
+ *	journal of the last snapshot of all jobs, the snapshot is written
+ *	again once the journal grows to half its size.
+ *	Changes here should be reflected in load_last_job_id() and
+ *	load_all_job_state().
+ * RET 0 or error code */
+int dump_all_job_state(void)
+{
+	int error_code;
+
+	/* Saved jobs must find their scripts after a crash */
+	batch_store_sync();
+	if (journal_snapshot_needed ||
+	    (journal_size >= MAX(journal_snapshot_size / 2,
+				 JOB_JOURNAL_MIN_SIZE)))
+		error_code = _dump_job_snapshot();
+	else
+		error_code = _dump_job_journal();
+	batch_store_gc();
 	return error_code;
 }
 
+/* Read the journal of a job state snapshot
+ * IN snapshot_id - id in the snapshot's header
+ * RET the journal positioned after its header or NULL if none */
+static Buf _read_job_journal(uint32_t snapshot_id)
+{
+	int data_allocated, data_read = 0;
+	uint32_t data_size = 0, journal_id = 0, ver_str_len;
+	int state_fd;
+	char *data = NULL, *state_file, *ver_str = NULL;
+	Buf buffer;
+
+	state_file = slurm_get_state_save_location();
+	xstrcat(state_file, "/job_state.log");
+	lock_state_files();
+	state_fd = open(state_file, O_RDONLY);
+	if (state_fd < 0) {
+		debug("No job state journal (%s) to recover", state_file);
+	} else {
+		data_allocated = BUF_SIZE;
+		data = xmalloc(data_allocated);
+		while (1) {
+			data_read = read(state_fd, &data[data_size],
+					 BUF_SIZE);
+			if (data_read < 0) {
+				if (errno == EINTR)
+					continue;
+				else {
+					error("Read error on %s: %m",
+					      state_file);
+					break;
+				}
+			} else if (data_read == 0)	/* eof */
+				break;
+			data_size      += data_read;
+			data_allocated += data_read;
+			xrealloc(data, data_allocated);
+		}
+		close(state_fd);
+	}
+	xfree(state_file);
+	unlock_state_files();
+
+	if (!data)
+		return NULL;
+
+	buffer = create_buf(data, data_size);
+	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
+	if (!ver_str || strcmp(ver_str, JOB_STATE_VERSION))
+		goto unpack_error;
+	xfree(ver_str);
+	safe_unpack32(&journal_id, buffer);
+	if (journal_id != snapshot_id) {
+		debug("Job state journal is not of the job state snapshot");
+		free_buf(buffer);
+		return NULL;
+	}
+	return buffer;
+
+unpack_error:
+	error("Job state journal has an invalid header, ignored");
+	xfree(ver_str);
+	free_buf(buffer);
+	return NULL;
+}
+
+/*
+ * _load_job_journal_rec - load a job's state from a snapshot or journal
+ *	record unless the journal has a later record for the job
+ * IN/OUT buffer - positioned at the record, moved past it
+ * IN hash - job id to last record in the journal
+ * IN journal - true if the record is in the journal, false if in the
+ *	snapshot
+ * OUT loaded - set if a job was loaded
+ * RET SLURM_SUCCESS or error code
+ */
+static int _load_job_journal_rec(Buf buffer, id_hash_t *hash, bool journal,
+				 bool *loaded)
+{
+	uint32_t len, img_offset;
+	int rc;
+
+	*loaded = false;
+	rc = job_journal_next(buffer, hash, journal, &len);
+	if (rc <= 0)
+		return rc ? SLURM_FAILURE : SLURM_SUCCESS;
+	img_offset = get_buf_offset(buffer);
+
+	if (_load_job_state(buffer, SLURM_PROTOCOL_VERSION) != SLURM_SUCCESS)
+		return SLURM_FAILURE;
+	if (get_buf_offset(buffer) != img_offset + len) {
+		error("Job state record length is wrong");
+		return SLURM_FAILURE;
+	}
+	*loaded = true;
+	return SLURM_SUCCESS;
+}
+
 /* Open the job state save file, or backup if necessary.
  * state_file IN - the name of the state save file used
  * RET the file description to read from or error code
@@ -578,12 +883,18 @@ extern int load_all_job_state(void)
 	uint32_t data_size = 0;
 	int state_fd, job_cnt = 0;
 	char *data = NULL, *state_file;
-	Buf buffer;
+	Buf buffer, journal = NULL;
 	time_t buf_time;
-	uint32_t saved_job_id;
+	uint32_t saved_job_id, snapshot_id, journal_end = 0;
 	char *ver_str = NULL;
 	uint32_t ver_str_len;
 	uint16_t protocol_version = (uint16_t)NO_VAL;
+	bool framed = false, loaded;
+	id_hash_t *journal_hash = NULL;
+
+	pend_queue_rebuild();
+	journal_snapshot_needed = true;	/* journal the jobs as loaded */
+	job_timers_rebuild = true;	/* time the jobs as loaded */
 
 	/* read the file */
 	lock_state_files();
@@ -626,6 +937,9 @@ extern int load_all_job_state(void)
 	if (ver_str) {
 		if (!strcmp(ver_str, JOB_STATE_VERSION)) {
 			protocol_version = SLURM_PROTOCOL_VERSION;
+			framed = true;
+		} else if (!strcmp(ver_str, JOB_2_6_STATE_VERSION)) {
+			protocol_version = SLURM_PROTOCOL_VERSION;
 		} else if (!strcmp(ver_str, JOB_2_5_STATE_VERSION)) {
 			protocol_version = SLURM_2_5_PROTOCOL_VERSION;
 		} else if (!strcmp(ver_str, JOB_2_4_STATE_VERSION)) {
@@ -655,14 +969,43 @@ extern int load_all_job_state(void)
 	job_id_sequence = MAX(saved_job_id, job_id_sequence);
 	debug3("Job id in job_state header is %u", saved_job_id);
 
+	if (framed) {
+		/* jobs in the snapshot's journal are loaded from it */
+		safe_unpack32(&snapshot_id, buffer);
+		journal_hash = id_hash_create(0);
+		if ((journal = _read_job_journal(snapshot_id)))
+			journal_end = job_journal_scan(journal, journal_hash,
+						       &job_id_sequence);
+	}
+
 	while (remaining_buf(buffer) > 0) {
-		error_code = _load_job_state(buffer, protocol_version);
+		if (framed) {
+			error_code = _load_job_journal_rec(buffer,
+							   journal_hash,
+							   false, &loaded);
+		} else {
+			error_code = _load_job_state(buffer, protocol_version);
+			loaded = true;
+		}
 		if (error_code != SLURM_SUCCESS)
 			goto unpack_error;
-		job_cnt++;
+		if (loaded)
+			job_cnt++;
+	}
+	while (journal && (get_buf_offset(journal) < journal_end)) {
+		error_code = _load_job_journal_rec(journal, journal_hash,
+						   true, &loaded);
+		if (error_code != SLURM_SUCCESS)
+			goto unpack_error;
+		if (loaded)
+			job_cnt++;
 	}
 	debug3("Set job_id_sequence to %u", job_id_sequence);
 
+	if (journal_hash)
+		id_hash_destroy(journal_hash);
+	if (journal)
+		free_buf(journal);
 	free_buf(buffer);
 	info("Recovered information about %d jobs", job_cnt);
 	return error_code;
@@ -670,6 +1013,10 @@ extern int load_all_job_state(void)
 unpack_error:
 	error("Incomplete job data checkpoint file");
 	info("Recovered information about %d jobs", job_cnt);
+	if (journal_hash)
+		id_hash_destroy(journal_hash);
+	if (journal)
+		free_buf(journal);
 	free_buf(buffer);
 	return SLURM_FAILURE;
 }
@@ -685,8 +1032,9 @@ extern int load_last_job_id( void )
 	uint32_t data_size = 0;
 	int state_fd;
 	char *data = NULL, *state_file;
-	Buf buffer;
+	Buf buffer, journal;
 	time_t buf_time;
+	uint32_t snapshot_id;
 	char *ver_str = NULL;
 	uint32_t ver_str_len;
 
@@ -743,7 +1091,14 @@ extern int load_last_job_id( void )
 	safe_unpack32( &job_id_sequence, buffer);
 	debug3("Job ID in job_state header is %u", job_id_sequence);
 
-	/* Ignore the state for individual jobs stored here */
+	/* Ignore the state for individual jobs stored here, but not the
+	 * job ids used since the snapshot */
+	safe_unpack32(&snapshot_id, buffer);
+	if ((journal = _read_job_journal(snapshot_id))) {
+		(void) job_journal_scan(journal, NULL, &job_id_sequence);
+		free_buf(journal);
+		debug3("Job ID in job_state journal is %u", job_id_sequence);
+	}
 
 	free_buf(buffer);
 	return error_code;
@@ -1888,11 +2243,8 @@ unpack_error:
  */
 void _add_job_hash(struct job_record *job_ptr)
 {
-	int inx;
-
-	inx = JOB_HASH_INX(job_ptr->job_id);
-	job_ptr->job_next = job_hash[inx];
-	job_hash[inx] = job_ptr;
+	if (id_hash_add(job_hash, job_ptr->job_id, job_ptr) != SLURM_SUCCESS)
+		error("_add_job_hash: duplicate job id %u", job_ptr->job_id);
 }
 
 /*
@@ -1904,16 +2256,7 @@ void _add_job_hash(struct job_record *job_ptr)
  */
 struct job_record *find_job_record(uint32_t job_id)
 {
-	struct job_record *job_ptr;
-
-	job_ptr = job_hash[JOB_HASH_INX(job_id)];
-	while (job_ptr) {
-		if (job_ptr->job_id == job_id)
-			return job_ptr;
-		job_ptr = job_ptr->job_next;
-	}
-
-	return NULL;
+	return (struct job_record *) id_hash_find(job_hash, job_id);
 }
 
 /* rebuild a job's partition name list based upon the contents of its
@@ -1946,6 +2289,7 @@ static void _rebuild_part_name_list(struct job_record  *job_ptr)
 		xstrcat(job_ptr->partition, part_ptr->name);
 	}
 	list_iterator_destroy(part_iterator);
+	job_journal_mark(job_ptr);
 	last_job_update = time(NULL);
 }
 
@@ -2013,6 +2357,7 @@ extern int kill_job_by_part_name(char *part_name)
 		}
 		if (IS_JOB_RUNNING(job_ptr) || suspended) {
 			job_count++;
+			job_journal_mark(job_ptr);
 			info("Killing job_id %u on defunct partition %s",
 			     job_ptr->job_id, part_name);
 			job_ptr->job_state = JOB_NODE_FAIL | JOB_COMPLETING;
@@ -2032,6 +2377,7 @@ extern int kill_job_by_part_name(char *part_name)
 						 false);
 		} else if (pending) {
 			job_count++;
+			job_journal_mark(job_ptr);
 			info("Killing job_id %u on defunct partition %s",
 			     job_ptr->job_id, part_name);
 			job_ptr->job_state	= JOB_CANCELLED;
@@ -2092,6 +2438,7 @@ extern int kill_job_by_front_end_name(char *node_name)
 		}
 		if (IS_JOB_COMPLETING(job_ptr)) {
 			job_count++;
+			job_journal_mark(job_ptr);
 			while ((i = bit_ffs(job_ptr->node_bitmap_cg)) >= 0) {
 				bit_clear(job_ptr->node_bitmap_cg, i);
 				job_update_cpu_cnt(job_ptr, i);
@@ -2117,6 +2464,7 @@ extern int kill_job_by_front_end_name(char *node_name)
 			}
 		} else if (IS_JOB_RUNNING(job_ptr) || suspended) {
 			job_count++;
+			job_journal_mark(job_ptr);
 			if (job_ptr->batch_flag && job_ptr->details &&
 				   (job_ptr->details->requeue > 0)) {
 				char requeue_msg[128];
@@ -2174,6 +2522,7 @@ extern int kill_job_by_front_end_name(char *node_name)
 				 * removes the submit we need to add it
 				 * again. */
 				acct_policy_add_job_submit(job_ptr);
+				pend_queue_update(job_ptr);
 			} else {
 				info("Killing job_id %u on failed node %s",
 				     job_ptr->job_id, node_name);
@@ -2279,10 +2628,9 @@ extern bool allocated_session_in_use(job_desc_msg_t *new_alloc)
  */
 extern int kill_running_job_by_node_name(char *node_name)
 {
-	ListIterator job_iterator;
-	struct job_record *job_ptr;
+	struct job_record *job_ptr, **job_array;
 	struct node_record *node_ptr;
-	int bit_position;
+	int bit_position, i, job_map_cnt;
 	int job_count = 0;
 	time_t now = time(NULL);
 
@@ -2291,9 +2639,11 @@ extern int kill_running_job_by_node_name(char *node_name)
 		return 0;
 	bit_position = node_ptr - node_record_table_ptr;
 
-	job_iterator = list_iterator_create(job_list);
-	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+	job_map_cnt = node_job_map_get(bit_position, &job_array);
+	for (i = 0; i < job_map_cnt; i++) {
 		bool suspended = false;
+
+		job_ptr = job_array[i];
 		if ((job_ptr->node_bitmap == NULL) ||
 		    (!bit_test(job_ptr->node_bitmap, bit_position)))
 			continue;	/* job not on this node */
@@ -2312,6 +2662,7 @@ extern int kill_running_job_by_node_name(char *node_name)
 			if (!bit_test(job_ptr->node_bitmap_cg, bit_position))
 				continue;
 			job_count++;
+			job_journal_mark(job_ptr);
 			bit_clear(job_ptr->node_bitmap_cg, bit_position);
 			job_update_cpu_cnt(job_ptr, bit_position);
 			if (job_ptr->node_cnt)
@@ -2334,6 +2685,7 @@ extern int kill_running_job_by_node_name(char *node_name)
 			}
 		} else if (IS_JOB_RUNNING(job_ptr) || suspended) {
 			job_count++;
+			job_journal_mark(job_ptr);
 			if ((job_ptr->details) &&
 			    (job_ptr->kill_on_node_fail == 0) &&
 			    (job_ptr->node_cnt > 1)) {
@@ -2401,6 +2753,7 @@ extern int kill_running_job_by_node_name(char *node_name)
 				 * removes the submit we need to add it
 				 * again. */
 				acct_policy_add_job_submit(job_ptr);
+				pend_queue_update(job_ptr);
 			} else {
 				info("Killing job_id %u on failed node %s",
 				     job_ptr->job_id, node_name);
@@ -2426,7 +2779,7 @@ extern int kill_running_job_by_node_name(char *node_name)
 		}
 
 	}
-	list_iterator_destroy(job_iterator);
+	xfree(job_array);
 	if (job_count)
 		last_job_update = now;
 
@@ -2679,30 +3032,22 @@ int init_job_conf(void)
 }
 
 /*
- * rehash_jobs - Create or rebuild the job hash table.
+ * rehash_jobs - Create the job hash table. Once created, the table grows
+ *	and shrinks with the job count so a change in MaxJobCount needs
+ *	no rebuild.
  * NOTE: run lock_slurmctld before entry: Read config, write job
  */
 extern void rehash_jobs(void)
 {
-	if (job_hash == NULL) {
-		hash_table_size = slurmctld_conf.max_job_cnt;
-		job_hash = (struct job_record **)
-			xmalloc(hash_table_size * sizeof(struct job_record *));
-	} else if (hash_table_size < (slurmctld_conf.max_job_cnt / 2)) {
-		/* If the MaxJobCount grows by too much, the hash table will
-		 * be ineffective without rebuilding. We don't presently bother
-		 * to rebuild the hash table, but cut MaxJobCount back as
-		 * needed. */
-		error ("MaxJobCount reset too high, restart slurmctld");
-		slurmctld_conf.max_job_cnt = hash_table_size;
-	}
+	if (job_hash == NULL)
+		job_hash = id_hash_create(slurmctld_conf.max_job_cnt);
 }
 
 /* Create an exact copy of an existing job record.
  * Assumes the job has no resource allocaiton */
 struct job_record *_job_rec_copy(struct job_record *job_ptr)
 {
-	struct job_record *job_ptr_new = NULL, *save_job_next;
+	struct job_record *job_ptr_new = NULL;
 	struct job_details *job_details, *details_new, *save_details;
 	uint32_t save_job_id;
 	int error_code = SLURM_SUCCESS;
@@ -2722,12 +3067,12 @@ struct job_record *_job_rec_copy(struct job_record *job_ptr)
 	/* Copy most of original job data.
 	 * This could be done in parallel, but performance was worse. */
 	save_job_id   = job_ptr_new->job_id;
-	save_job_next = job_ptr_new->job_next;
 	save_details  = job_ptr_new->details;
 	memcpy(job_ptr_new, job_ptr, sizeof(struct job_record));
 	job_ptr_new->job_id   = save_job_id;
-	job_ptr_new->job_next = save_job_next;
 	job_ptr_new->details  = save_details;
+	timer_ent_init(&job_ptr_new->time_limit_ent, job_ptr_new);
+	job_ptr_new->node_map_bitmap = NULL;
 	job_ptr_new->account = xstrdup(job_ptr->account);
 	job_ptr_new->alias_list = xstrdup(job_ptr->alias_list);
 	job_ptr_new->alloc_node = xstrdup(job_ptr->alloc_node);
@@ -2877,6 +3222,7 @@ static void _create_job_array(struct job_record *job_ptr,
 			break;
 		job_ptr_new->array_job_id  = job_ptr->job_id;
 		job_ptr_new->array_task_id = i;
+		pend_queue_update(job_ptr_new);
 	}
 }
 
@@ -2976,6 +3322,7 @@ extern int job_allocate(job_desc_msg_t * job_specs, int immediate,
 	 */
 	if (job_ptr->priority == NO_VAL)
 		set_job_prio(job_ptr);
+	pend_queue_update(job_ptr);
 
 	if (independent &&
 	    (license_job_test(job_ptr, time(NULL)) != SLURM_SUCCESS))
@@ -3149,6 +3496,7 @@ extern int job_fail(uint32_t job_id)
 				difftime(now, job_ptr->suspend_time);
 		} else
 			job_ptr->end_time       = now;
+		job_journal_mark(job_ptr);
 		last_job_update                 = now;
 		job_ptr->job_state = JOB_FAILED | JOB_COMPLETING;
 		job_ptr->exit_code = 1;
@@ -3243,6 +3591,8 @@ extern int job_signal(uint32_t job_id, uint16_t signal, uint16_t flags,
 	if (IS_JOB_FINISHED(job_ptr))
 		return ESLURM_ALREADY_DONE;
 
+	job_journal_mark(job_ptr);
+
 	/* let node select plugin do any state-dependent signalling actions */
 	select_g_job_signal(job_ptr, signal);
 
@@ -3441,6 +3791,7 @@ extern int job_complete(uint32_t job_id, uid_t uid, bool requeue,
 		/* Since the job completion logger removes the job submit
 		 * information, we need to add it again. */
 		acct_policy_add_job_submit(job_ptr);
+		pend_queue_update(job_ptr);
 
 		info("Requeue JobId=%u due to node failure", job_ptr->job_id);
 	} else if (IS_JOB_PENDING(job_ptr) && job_ptr->details &&
@@ -3484,6 +3835,7 @@ extern int job_complete(uint32_t job_id, uid_t uid, bool requeue,
 		job_completion_logger(job_ptr, false);
 	}
 
+	job_journal_mark(job_ptr);
 	last_job_update = now;
 	if (job_comp_flag) {	/* job was running */
 		build_cg_bitmap(job_ptr);
@@ -4291,8 +4643,10 @@ static int _job_create(job_desc_msg_t * job_desc, int allocate, int will_run,
 
 	if (job_desc->script
 	    &&  (!will_run)) {	/* don't bother with copy if just a test */
-		if ((error_code = _copy_job_desc_to_file(job_desc,
-							 job_ptr->job_id))) {
+		if ((error_code = batch_store_add(job_ptr->job_id,
+						  job_desc->script,
+						  job_desc->environment,
+						  job_desc->env_size))) {
 			error_code = ESLURM_WRITING_TO_FILE;
 			goto cleanup_fail;
 		}
@@ -4494,49 +4848,6 @@ extern int validate_job_create_req(job_desc_msg_t * job_desc)
 	return SLURM_SUCCESS;
 }
 
-/* _copy_job_desc_to_file - copy the job script and environment from the RPC
- *	structure into a file */
-static int
-_copy_job_desc_to_file(job_desc_msg_t * job_desc, uint32_t job_id)
-{
-	int error_code = 0;
-	char *dir_name, job_dir[32], *file_name;
-	DEF_TIMERS;
-
-	START_TIMER;
-	/* Create state_save_location directory */
-	dir_name = slurm_get_state_save_location();
-
-	/* Create job_id specific directory */
-	sprintf(job_dir, "/job.%u", job_id);
-	xstrcat(dir_name, job_dir);
-	if (mkdir(dir_name, 0700)) {
-		error("mkdir(%s) error %m", dir_name);
-		xfree(dir_name);
-		return ESLURM_WRITING_TO_FILE;
-	}
-
-	/* Create environment file, and write data to it */
-	file_name = xstrdup(dir_name);
-	xstrcat(file_name, "/environment");
-	error_code = _write_data_array_to_file(file_name,
-					       job_desc->environment,
-					       job_desc->env_size);
-	xfree(file_name);
-
-	if (error_code == 0) {
-		/* Create script file */
-		file_name = xstrdup(dir_name);
-		xstrcat(file_name, "/script");
-		error_code = _write_data_to_file(file_name, job_desc->script);
-		xfree(file_name);
-	}
-
-	xfree(dir_name);
-	END_TIMER2("_copy_job_desc_to_file");
-	return error_code;
-}
-
 /* _copy_job_desc_files - create copies of a job script and environment files */
 static int
 _copy_job_desc_files(uint32_t job_id_src, uint32_t job_id_dest)
@@ -4545,6 +4856,9 @@ _copy_job_desc_files(uint32_t job_id_src, uint32_t job_id_dest)
 	char *dir_name_src, *dir_name_dest, job_dir[32];
 	char *file_name_src, *file_name_dest;
 
+	if (batch_store_copy(job_id_src, job_id_dest) == SLURM_SUCCESS)
+		return SLURM_SUCCESS;
+
 	/* Create state_save_location directory */
 	dir_name_src  = slurm_get_state_save_location();
 	dir_name_dest = xstrdup(dir_name_src);
@@ -4586,91 +4900,6 @@ _copy_job_desc_files(uint32_t job_id_src, uint32_t job_id_dest)
 	return error_code;
 }
 
-/*
- * Create file with specified name and write the supplied data array to it
- * IN file_name - file to create and write to
- * IN data - array of pointers to strings (e.g. env)
- * IN size - number of elements in data
- */
-static int
-_write_data_array_to_file(char *file_name, char **data, uint32_t size)
-{
-	int fd, i, pos, nwrite, amount;
-
-	fd = creat(file_name, 0600);
-	if (fd < 0) {
-		error("Error creating file %s, %m", file_name);
-		return ESLURM_WRITING_TO_FILE;
-	}
-
-	amount = write(fd, &size, sizeof(uint32_t));
-	if (amount < sizeof(uint32_t)) {
-		error("Error writing file %s, %m", file_name);
-		close(fd);
-		return ESLURM_WRITING_TO_FILE;
-	}
-
-	if (data == NULL) {
-		close(fd);
-		return SLURM_SUCCESS;
-	}
-
-	for (i = 0; i < size; i++) {
-		nwrite = strlen(data[i]) + 1;
-		pos = 0;
-		while (nwrite > 0) {
-			amount = write(fd, &data[i][pos], nwrite);
-			if ((amount < 0) && (errno != EINTR)) {
-				error("Error writing file %s, %m",
-				      file_name);
-				close(fd);
-				return ESLURM_WRITING_TO_FILE;
-			}
-			nwrite -= amount;
-			pos    += amount;
-		}
-	}
-
-	close(fd);
-	return SLURM_SUCCESS;
-}
-
-/*
- * Create file with specified name and write the supplied data array to it
- * IN file_name - file to create and write to
- * IN data - pointer to string
- */
-static int _write_data_to_file(char *file_name, char *data)
-{
-	int fd, pos, nwrite, amount;
-
-	if (data == NULL) {
-		(void) unlink(file_name);
-		return SLURM_SUCCESS;
-	}
-
-	fd = creat(file_name, 0700);
-	if (fd < 0) {
-		error("Error creating file %s, %m", file_name);
-		return ESLURM_WRITING_TO_FILE;
-	}
-
-	nwrite = strlen(data) + 1;
-	pos = 0;
-	while (nwrite > 0) {
-		amount = write(fd, &data[pos], nwrite);
-		if ((amount < 0) && (errno != EINTR)) {
-			error("Error writing file %s, %m", file_name);
-			close(fd);
-			return ESLURM_WRITING_TO_FILE;
-		}
-		nwrite -= amount;
-		pos    += amount;
-	}
-	close(fd);
-	return SLURM_SUCCESS;
-}
-
 /*
  * get_job_env - return the environment variables and their count for a
  *	given job
@@ -4680,7 +4909,19 @@ static int _write_data_to_file(char *file_name, char *data)
  */
 char **get_job_env(struct job_record *job_ptr, uint32_t * env_size)
 {
-	char job_dir[30], *file_name, **environment = NULL;
+	char job_dir[30], *file_name, **environment = NULL, *buffer;
+	uint32_t rec_cnt;
+	int data_size;
+
+	if (batch_store_get_env(job_ptr->job_id, &buffer, &rec_cnt,
+				&data_size) == SLURM_SUCCESS) {
+		*env_size = 0;
+		if (buffer) {
+			_env_array(buffer, data_size, rec_cnt, "batch_store",
+				   &environment, env_size, job_ptr);
+		}
+		return environment;
+	}
 
 	file_name = slurm_get_state_save_location();
 	sprintf(job_dir, "/job.%d/environment", job_ptr->job_id);
@@ -4701,7 +4942,9 @@ char *get_job_script(struct job_record *job_ptr)
 {
 	char *script = NULL;
 
-	if (job_ptr->batch_flag) {
+	if (job_ptr->batch_flag &&
+	    (batch_store_get_script(job_ptr->job_id, &script) !=
+	     SLURM_SUCCESS)) {
 		char *file_name = slurm_get_state_save_location();
 		char job_dir[30];
 
@@ -4728,8 +4971,8 @@ static void
 _read_data_array_from_file(char *file_name, char ***data, uint32_t * size,
 			   struct job_record *job_ptr)
 {
-	int fd, pos, buf_size, amount, i, j;
-	char *buffer, **array_ptr;
+	int fd, pos, buf_size, amount;
+	char *buffer;
 	uint32_t rec_cnt;
 
 	xassert(file_name);
@@ -4780,6 +5023,26 @@ _read_data_array_from_file(char *file_name, char ***data, uint32_t * size,
 	}
 	close(fd);
 
+	_env_array(buffer, pos, rec_cnt, file_name, data, size, job_ptr);
+}
+
+/*
+ * Build an environment array from a buffer of strings
+ * IN buffer - rec_cnt strings, each terminated by '\0', one after another,
+ *	becomes element zero of the array or is freed
+ * IN data_size - size of the data in buffer
+ * IN name - where the data came from, for error messages
+ * OUT data - pointer to array of pointers to strings
+ * OUT size - number of elements in data
+ * IN job_ptr - job, whose supplemental environment variables are added
+ */
+static void _env_array(char *buffer, int data_size, uint32_t rec_cnt,
+		       char *name, char ***data, uint32_t *size,
+		       struct job_record *job_ptr)
+{
+	int pos = data_size, buf_size = data_size, i, j;
+	char **array_ptr;
+
 	/* Allocate extra space for supplemental environment variables
 	 * as set by Moab */
 	if (job_ptr->details->env_cnt) {
@@ -4795,7 +5058,7 @@ _read_data_array_from_file(char *file_name, char ***data, uint32_t * size,
 		array_ptr[i] = &buffer[pos];
 		pos += strlen(&buffer[pos]) + 1;
 		if ((pos > buf_size) && ((i + 1) < rec_cnt)) {
-			error("Bad environment file %s", file_name);
+			error("Bad environment file %s", name);
 			rec_cnt = i;
 			break;
 		}
@@ -5240,118 +5503,241 @@ static bool _valid_pn_min_mem(job_desc_msg_t * job_desc_msg,
 	return false;
 }
 
+/* Return the time at which job_time_limit() next needs to examine a running
+ * job, the earliest of its time limit, warning signal, inactivity limit,
+ * reservation end and step time limits. Times already past are examined in
+ * the next pass. */
+static time_t _job_timer_next(struct job_record *job_ptr, time_t now)
+{
+	time_t next = now + JOB_TIMER_MAX_WAIT, when;
+
+	/* Checked every pass, accounting limits depend upon usage by other
+	 * jobs rather than deadlines of this one */
+	if (IS_JOB_CONFIGURING(job_ptr) ||
+	    (accounting_enforce & ACCOUNTING_ENFORCE_LIMITS))
+		return now;
+
+	if (slurmctld_conf.inactive_limit &&
+	    (job_ptr->batch_flag == 0)    &&
+	    (job_ptr->other_port) &&
+	    (job_ptr->part_ptr) &&
+	    (!(job_ptr->part_ptr->flags & PART_FLAG_ROOT_ONLY))) {
+		when = job_ptr->time_last_active +
+		       (slurmctld_conf.inactive_limit * 4 / 3) +
+		       slurmctld_conf.msg_timeout + 1;
+		next = MIN(next, when);
+	}
+	if (job_ptr->time_limit != INFINITE) {
+		if (slurmctld_conf.over_time_limit == (uint16_t) INFINITE)
+			when = job_ptr->end_time + (365 * 24 * 60 * 60);
+		else
+			when = job_ptr->end_time +
+			       (slurmctld_conf.over_time_limit * 60);
+		next = MIN(next, when);
+		if (job_ptr->warn_time) {
+			when = job_ptr->end_time - job_ptr->warn_time -
+			       PERIODIC_TIMEOUT;
+			next = MIN(next, when);
+		}
+	}
+	/* srun warning of pending timeout */
+	next = MIN(next, job_ptr->end_time - (PERIODIC_TIMEOUT * 2));
+	if ((when = job_resv_check_time(job_ptr)))
+		next = MIN(next, when);
+	if ((when = job_step_time_limit_next(job_ptr)))
+		next = MIN(next, when);
+	return next;
+}
+
+/* Put every running job in a new timer wheel */
+static void _job_timers_rebuild(time_t now)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+
+	timer_wheel_destroy(job_timers);
+	job_timers = timer_wheel_create(now);
+	job_timers_rebuild = false;
+	job_timers_conf_update = slurmctld_conf.last_update;
+	job_timers_resv_update = last_resv_update;
+
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		if (!IS_JOB_RUNNING(job_ptr))
+			continue;
+		job_ptr->time_limit_ent.arg = job_ptr;
+		timer_wheel_add(job_timers, &job_ptr->time_limit_ent,
+				_job_timer_next(job_ptr, now));
+	}
+	list_iterator_destroy(job_iterator);
+}
+
+extern void job_journal_mark(struct job_record *job_ptr)
+{
+	job_ptr->journal_dirty = true;
+}
+
+extern void job_timer_arm(struct job_record *job_ptr)
+{
+	xassert(job_ptr->magic == JOB_MAGIC);
+
+	/* A pending rebuild picks up every running job */
+	if (!job_timers || job_timers_rebuild)
+		return;
+	if (!IS_JOB_RUNNING(job_ptr)) {
+		timer_wheel_del(job_timers, &job_ptr->time_limit_ent);
+		return;
+	}
+	job_ptr->time_limit_ent.arg = job_ptr;
+	timer_wheel_add(job_timers, &job_ptr->time_limit_ent,
+			_job_timer_next(job_ptr, time(NULL)));
+}
+
+/* Test one job against its time limit, warning signal, inactivity limit,
+ * reservation and step time limits */
+static void _job_time_check(struct job_record *job_ptr, time_t now,
+			    time_t old, time_t over_run)
+{
+	int resv_status = 0;
+
+	if (IS_JOB_CONFIGURING(job_ptr)) {
+		if (!IS_JOB_RUNNING(job_ptr) ||
+		    ((bit_overlap(job_ptr->node_bitmap,
+				  power_node_bitmap) == 0) &&
+		     (bit_overlap(job_ptr->node_bitmap,
+				  avail_node_bitmap) == 0))) {
+			debug("Configuration for job %u is complete",
+			      job_ptr->job_id);
+			job_ptr->job_state &= (~JOB_CONFIGURING);
+		}
+	}
+
+	if (!IS_JOB_RUNNING(job_ptr))
+		return;
+
+	resv_status = job_resv_check(job_ptr);
+
+	if (slurmctld_conf.inactive_limit &&
+	    (job_ptr->batch_flag == 0)    &&
+	    (job_ptr->time_last_active <= old) &&
+	    (job_ptr->other_port) &&
+	    (job_ptr->part_ptr) &&
+	    (!(job_ptr->part_ptr->flags & PART_FLAG_ROOT_ONLY))) {
+		/* job inactive, kill it */
+		info("Inactivity time limit reached for JobId=%u",
+		     job_ptr->job_id);
+		_job_timed_out(job_ptr);
+		job_ptr->state_reason = FAIL_INACTIVE_LIMIT;
+		xfree(job_ptr->state_desc);
+		return;
+	}
+	if (job_ptr->time_limit != INFINITE) {
+		if (job_ptr->end_time <= over_run) {
+			job_journal_mark(job_ptr);
+			last_job_update = now;
+			info("Time limit exhausted for JobId=%u",
+			     job_ptr->job_id);
+			_job_timed_out(job_ptr);
+			job_ptr->state_reason = FAIL_TIMEOUT;
+			xfree(job_ptr->state_desc);
+			return;
+		} else if ((job_ptr->warn_time) &&
+			   (job_ptr->warn_time + PERIODIC_TIMEOUT +
+			    now >= job_ptr->end_time)) {
+			debug("Warning signal %u to job %u ",
+			      job_ptr->warn_signal, job_ptr->job_id);
+			(void) job_signal(job_ptr->job_id,
+					  job_ptr->warn_signal, 0, 0,
+					  false);
+			job_ptr->warn_signal = 0;
+			job_ptr->warn_time = 0;
+		}
+	}
+
+	if (resv_status != SLURM_SUCCESS) {
+		job_journal_mark(job_ptr);
+		last_job_update = now;
+		info("Reservation ended for JobId=%u",
+		     job_ptr->job_id);
+		_job_timed_out(job_ptr);
+		job_ptr->state_reason = FAIL_TIMEOUT;
+		xfree(job_ptr->state_desc);
+		return;
+	}
+
+	/* check if any individual job steps have exceeded
+	 * their time limit */
+	if (job_ptr->step_list &&
+	    (list_count(job_ptr->step_list) > 0))
+		check_job_step_time_limit(job_ptr, now);
+
+	acct_policy_job_time_out(job_ptr);
+
+	if (job_ptr->state_reason == FAIL_TIMEOUT) {
+		job_journal_mark(job_ptr);
+		last_job_update = now;
+		_job_timed_out(job_ptr);
+		xfree(job_ptr->state_desc);
+		return;
+	}
+
+	/* Give srun command warning message about pending timeout */
+	if (job_ptr->end_time <= (now + PERIODIC_TIMEOUT * 2))
+		srun_timeout (job_ptr);
+}
+
 /*
  * job_time_limit - terminate jobs which have exceeded their time limit
+ *	Running jobs are held in a timer wheel keyed on the next time each
+ *	needs to be examined (see _job_timer_next()), so a pass examines only
+ *	those jobs with a deadline reached rather than the whole job list.
  * global: job_list - pointer global job list
  *	last_job_update - time of last job table update
  * NOTE: READ lock_slurmctld config before entry
  */
 void job_time_limit(void)
 {
-	ListIterator job_iterator;
 	struct job_record *job_ptr;
+	timer_ent_t *ent;
 	time_t now = time(NULL);
 	time_t old = now - ((slurmctld_conf.inactive_limit * 4 / 3) +
 			    slurmctld_conf.msg_timeout + 1);
 	time_t over_run;
-	int resv_status = 0;
+	uint32_t job_cnt = 0;
 
 	if (slurmctld_conf.over_time_limit == (uint16_t) INFINITE)
 		over_run = now - (365 * 24 * 60 * 60);	/* one year */
 	else
 		over_run = now - (slurmctld_conf.over_time_limit  * 60);
 
+	/* Limits or reservations changed, recalculate every deadline */
+	if (!job_timers || job_timers_rebuild ||
+	    (job_timers_conf_update != slurmctld_conf.last_update) ||
+	    (job_timers_resv_update != last_resv_update))
+		_job_timers_rebuild(now);
+
 	begin_job_resv_check();
-	job_iterator = list_iterator_create(job_list);
-	while ((job_ptr =(struct job_record *) list_next(job_iterator))) {
+	timer_wheel_expire(job_timers, now);
+	while ((ent = timer_wheel_next(job_timers))) {
+		job_ptr = (struct job_record *) ent->arg;
 		xassert (job_ptr->magic == JOB_MAGIC);
+		job_cnt++;
 
-		if (IS_JOB_CONFIGURING(job_ptr)) {
-			if (!IS_JOB_RUNNING(job_ptr) ||
-			    ((bit_overlap(job_ptr->node_bitmap,
-					  power_node_bitmap) == 0) &&
-			     (bit_overlap(job_ptr->node_bitmap,
-					  avail_node_bitmap) == 0))) {
-				debug("Configuration for job %u is complete",
-				      job_ptr->job_id);
-				job_ptr->job_state &= (~JOB_CONFIGURING);
-			}
-		}
-
-		/* This needs to be near the top of the loop, checks every
-		 * running, suspended and pending job */
-		resv_status = job_resv_check(job_ptr);
-
-		if (!IS_JOB_RUNNING(job_ptr))
-			continue;
-
-		if (slurmctld_conf.inactive_limit &&
-		    (job_ptr->batch_flag == 0)    &&
-		    (job_ptr->time_last_active <= old) &&
-		    (job_ptr->other_port) &&
-		    (job_ptr->part_ptr) &&
-		    (!(job_ptr->part_ptr->flags & PART_FLAG_ROOT_ONLY))) {
-			/* job inactive, kill it */
-			info("Inactivity time limit reached for JobId=%u",
-			     job_ptr->job_id);
-			_job_timed_out(job_ptr);
-			job_ptr->state_reason = FAIL_INACTIVE_LIMIT;
-			xfree(job_ptr->state_desc);
-			continue;
-		}
-		if (job_ptr->time_limit != INFINITE) {
-			if (job_ptr->end_time <= over_run) {
-				last_job_update = now;
-				info("Time limit exhausted for JobId=%u",
-				     job_ptr->job_id);
-				_job_timed_out(job_ptr);
-				job_ptr->state_reason = FAIL_TIMEOUT;
-				xfree(job_ptr->state_desc);
-				continue;
-			} else if ((job_ptr->warn_time) &&
-				   (job_ptr->warn_time + PERIODIC_TIMEOUT +
-				    now >= job_ptr->end_time)) {
-				debug("Warning signal %u to job %u ",
-				      job_ptr->warn_signal, job_ptr->job_id);
-				(void) job_signal(job_ptr->job_id,
-						  job_ptr->warn_signal, 0, 0,
-						  false);
-				job_ptr->warn_signal = 0;
-				job_ptr->warn_time = 0;
-			}
-		}
-
-		if (resv_status != SLURM_SUCCESS) {
-			last_job_update = now;
-			info("Reservation ended for JobId=%u",
-			     job_ptr->job_id);
-			_job_timed_out(job_ptr);
-			job_ptr->state_reason = FAIL_TIMEOUT;
-			xfree(job_ptr->state_desc);
-			continue;
-		}
-
-		/* check if any individual job steps have exceeded
-		 * their time limit */
-		if (job_ptr->step_list &&
-		    (list_count(job_ptr->step_list) > 0))
-			check_job_step_time_limit(job_ptr, now);
-
-		acct_policy_job_time_out(job_ptr);
-
-		if (job_ptr->state_reason == FAIL_TIMEOUT) {
-			last_job_update = now;
-			_job_timed_out(job_ptr);
-			xfree(job_ptr->state_desc);
-			continue;
+		_job_time_check(job_ptr, now, old, over_run);
+		if (IS_JOB_RUNNING(job_ptr)) {
+			timer_wheel_add(job_timers, ent,
+					_job_timer_next(job_ptr, now));
 		}
-
-		/* Give srun command warning message about pending timeout */
-		if (job_ptr->end_time <= (now + PERIODIC_TIMEOUT * 2))
-			srun_timeout (job_ptr);
 	}
-	list_iterator_destroy(job_iterator);
 	fini_job_resv_check();
+
+	slurmctld_diag_stats.time_limit_cycle_counter++;
+	slurmctld_diag_stats.time_limit_jobs_last = job_cnt;
+	slurmctld_diag_stats.time_limit_jobs_sum += job_cnt;
+	if (job_cnt > slurmctld_diag_stats.time_limit_jobs_max)
+		slurmctld_diag_stats.time_limit_jobs_max = job_cnt;
+	slurmctld_diag_stats.time_limit_jobs_timed =
+		timer_wheel_count(job_timers);
 }
 
 extern int job_update_cpu_cnt(struct job_record *job_ptr, int node_inx)
@@ -5403,6 +5789,7 @@ static void _job_timed_out(struct job_record *job_ptr)
 	srun_timeout(job_ptr);
 	if (job_ptr->details) {
 		time_t now      = time(NULL);
+		job_journal_mark(job_ptr);
 		job_ptr->end_time           = now;
 		job_ptr->time_last_active   = now;
 		job_ptr->job_state          = JOB_TIMEOUT | JOB_COMPLETING;
@@ -5520,22 +5907,32 @@ static int _validate_job_desc(job_desc_msg_t * job_desc_msg, int allocate,
 static void _list_delete_job(void *job_entry)
 {
 	struct job_record *job_ptr = (struct job_record *) job_entry;
-	struct job_record **job_pptr;
 	int i;
 
 	xassert(job_entry);
 	xassert (job_ptr->magic == JOB_MAGIC);
 	job_ptr->magic = 0;	/* make sure we don't delete record twice */
 
-	/* Remove the record from the hash table */
-	job_pptr = &job_hash[JOB_HASH_INX(job_ptr->job_id)];
-	while ((job_pptr != NULL) &&
-	       ((job_ptr = *job_pptr) != (struct job_record *) job_entry)) {
-		job_pptr = &job_ptr->job_next;
+	if (job_ptr->journal_saved) {	/* journal its removal */
+		slurm_mutex_lock(&journal_lock);
+		if (journal_purged_cnt >= journal_purged_size) {
+			journal_purged_size = MAX(1024,
+						  journal_purged_size * 2);
+			xrealloc(journal_purged,
+				 sizeof(uint32_t) * journal_purged_size);
+		}
+		journal_purged[journal_purged_cnt++] = job_ptr->job_id;
+		slurm_mutex_unlock(&journal_lock);
+	}
+
+	/* Remove the record from the hash table and pending job queue */
+	if (id_hash_find(job_hash, job_ptr->job_id) == job_ptr) {
+		id_hash_remove(job_hash, job_ptr->job_id);
+		pend_queue_remove(job_ptr);
 	}
-	if (job_pptr == NULL)
-		fatal("job hash error");
-	*job_pptr = job_ptr->job_next;
+	if (job_timers)
+		timer_wheel_del(job_timers, &job_ptr->time_limit_ent);
+	node_job_map_remove(job_ptr);
 
 	delete_job_details(job_ptr);
 	xfree(job_ptr->account);
@@ -5644,6 +6041,40 @@ static int _list_find_job_old(void *job_entry, void *key)
 }
 
 
+/* Return packed records of all jobs for the given show_flags and protocol
+ * version, packing them if not already cached. Returns NULL if the records
+ * depend upon the requesting user and can not be shared.
+ * NOTE: Release the records with info_cache_release(&job_info_cache, ...)
+ * NOTE: READ lock_slurmctld job and partition before entry */
+static info_cache_rec_t *_get_job_info_cache(uint16_t show_flags,
+					     uint16_t protocol_version)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	info_cache_rec_t *cache_rec;
+
+	if (show_flags & SHOW_DETAIL2)
+		return NULL;
+
+	cache_rec = info_cache_get(&job_info_cache, protocol_version,
+				   show_flags, last_job_update);
+	if (cache_rec)
+		return cache_rec;
+
+	cache_rec = info_cache_create(protocol_version, show_flags,
+				      last_job_update, list_count(job_list));
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		info_cache_mark(cache_rec, job_ptr, job_ptr->job_id);
+		pack_job(job_ptr, show_flags, cache_rec->buffer,
+			 protocol_version, 0);
+	}
+	list_iterator_destroy(job_iterator);
+	info_cache_put(&job_info_cache, cache_rec);
+
+	return cache_rec;
+}
+
 /*
  * pack_all_jobs - dump all job information for all jobs in
  *	machine independent form (for network transmission)
@@ -5663,14 +6094,20 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 {
 	ListIterator job_iterator;
 	struct job_record *job_ptr;
-	uint32_t jobs_packed = 0, tmp_offset;
+	uint32_t jobs_packed = 0, tmp_offset, cursor = 0;
 	Buf buffer;
 	time_t min_age = 0, now = time(NULL);
+	info_cache_rec_t *cache_rec;
 
 	buffer_ptr[0] = NULL;
 	*buffer_size = 0;
 
-	buffer = init_buf(BUF_SIZE);
+	cache_rec = _get_job_info_cache(show_flags, protocol_version);
+	if (cache_rec)
+		buffer = init_buf(get_buf_offset(cache_rec->buffer) +
+				  BUF_SIZE);
+	else
+		buffer = init_buf(BUF_SIZE);
 
 	/* write message body header : size and time */
 	/* put in a place holder job record count of 0 for now */
@@ -5681,14 +6118,13 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 		min_age = now  - slurmctld_conf.min_job_age;
 
 	/* write individual job records */
-	part_filter_set(uid);
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
 		xassert (job_ptr->magic == JOB_MAGIC);
 
 		if (((show_flags & SHOW_ALL) == 0) && (uid != 0) &&
 		    (job_ptr->part_ptr) &&
-		    (job_ptr->part_ptr->flags & PART_FLAG_HIDDEN))
+		    !part_is_visible(job_ptr->part_ptr, uid))
 			continue;
 
 		if ((slurmctld_conf.private_data & PRIVATE_DATA_JOBS) &&
@@ -5704,11 +6140,17 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 		if ((filter_uid != NO_VAL) && (filter_uid != job_ptr->user_id))
 			continue;
 
-		pack_job(job_ptr, show_flags, buffer, protocol_version, uid);
+		if (!cache_rec ||
+		    !info_cache_copy(cache_rec, &cursor, job_ptr,
+				     job_ptr->job_id, buffer)) {
+			pack_job(job_ptr, show_flags, buffer, protocol_version,
+				 uid);
+		}
 		jobs_packed++;
 	}
-	part_filter_clear();
 	list_iterator_destroy(job_iterator);
+	if (cache_rec)
+		info_cache_release(&job_info_cache, cache_rec);
 
 	/* put the real record count in the message body header */
 	tmp_offset = get_buf_offset(buffer);
@@ -6281,6 +6723,7 @@ void reset_job_bitmaps(void)
 	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
 		xassert (job_ptr->magic == JOB_MAGIC);
 		job_fail = false;
+		job_journal_mark(job_ptr);
 
 		if (job_ptr->partition == NULL) {
 			error("No partition for job_id %u", job_ptr->job_id);
@@ -6380,6 +6823,7 @@ void reset_job_bitmaps(void)
 		}
 	}
 	list_iterator_destroy(job_iterator);
+	node_job_map_rebuild();
 
 	last_job_update = now;
 }
@@ -6508,6 +6952,7 @@ extern void set_job_prio(struct job_record *job_ptr)
 	xassert (job_ptr->magic == JOB_MAGIC);
 	if (IS_JOB_FINISHED(job_ptr))
 		return;
+	job_journal_mark(job_ptr);
 	job_ptr->priority = slurm_sched_initial_priority(lowest_prio,
 							 job_ptr);
 	if ((job_ptr->priority <= 1) ||
@@ -6724,6 +7169,7 @@ int update_job(job_desc_msg_t * job_specs, uid_t uid)
 		      job_specs->job_id);
 		return ESLURM_INVALID_JOB_ID;
 	}
+	job_journal_mark(job_ptr);
 
 	error_code = job_submit_plugin_modify(job_specs, job_ptr,
 					      (uint32_t) uid);
@@ -7870,6 +8316,7 @@ int update_job(job_desc_msg_t * job_specs, uid_t uid)
 				_merge_job_licenses(job_ptr, expand_job_ptr);
 				rebuild_step_bitmaps(expand_job_ptr,
 						     orig_job_node_bitmap);
+				node_job_map_add(expand_job_ptr);
 			}
 			bit_free(orig_job_node_bitmap);
 			job_post_resize_acctg(job_ptr);
@@ -8253,6 +8700,9 @@ fini:
 	if ((error_code == SLURM_SUCCESS) && (job_ptr->priority > 1) &&
 	    strcmp(slurmctld_conf.priority_type, "priority/basic"))
 		set_job_prio(job_ptr);
+	pend_queue_update(job_ptr);
+	/* Time limit, end time or warning signal may be changed */
+	job_timer_arm(job_ptr);
 
 	return error_code;
 }
@@ -8342,6 +8792,7 @@ extern void job_pre_resize_acctg(struct job_record *job_ptr)
 
 	job_ptr->job_state |= JOB_RESIZING;
 	job_ptr->resize_time = time(NULL);
+	job_journal_mark(job_ptr);
 	/* NOTE: job_completion_logger() calls
 	 *	 acct_policy_remove_job_submit() */
 	job_completion_logger(job_ptr, false);
@@ -8514,8 +8965,8 @@ validate_jobs_on_node(slurm_node_registration_status_msg_t *reg_msg)
  * but are not found. */
 static void _purge_missing_jobs(int node_inx, time_t now)
 {
-	ListIterator job_iterator;
-	struct job_record *job_ptr;
+	struct job_record *job_ptr, **job_array;
+	int i, job_cnt;
 	struct node_record *node_ptr = node_record_table_ptr + node_inx;
 	uint16_t batch_start_timeout	= slurm_get_batch_start_timeout();
 	uint16_t msg_timeout		= slurm_get_msg_timeout();
@@ -8530,10 +8981,13 @@ static void _purge_missing_jobs(int node_inx, time_t now)
 	batch_startup_time  = now - batch_start_timeout;
 	batch_startup_time -= msg_timeout;
 
-	job_iterator = list_iterator_create(job_list);
-	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
-		bool job_active = IS_JOB_RUNNING(job_ptr) ||
-				  IS_JOB_SUSPENDED(job_ptr);
+	job_cnt = node_job_map_get(node_inx, &job_array);
+	for (i = 0; i < job_cnt; i++) {
+		bool job_active;
+
+		job_ptr = job_array[i];
+		job_active = IS_JOB_RUNNING(job_ptr) ||
+			     IS_JOB_SUSPENDED(job_ptr);
 
 		if ((!job_active) ||
 		    (!bit_test(job_ptr->node_bitmap, node_inx)))
@@ -8557,7 +9011,7 @@ static void _purge_missing_jobs(int node_inx, time_t now)
 						  now, node_boot_time);
 		}
 	}
-	list_iterator_destroy(job_iterator);
+	xfree(job_array);
 }
 
 static void _notify_srun_missing_step(struct job_record *job_ptr, int node_inx,
@@ -8749,7 +9203,7 @@ int sync_job_files(void)
 }
 
 /* Append to the batch_dirs list the job_id's associated with
- *	every batch job directory in existence
+ *	every batch job directory in existence and every job in batch_store
  * NOTE: READ lock_slurmctld config before entry
  */
 static void _get_batch_job_dir_ids(List batch_dirs)
@@ -8760,6 +9214,8 @@ static void _get_batch_job_dir_ids(List batch_dirs)
 	uint32_t *job_id_ptr;
 	char *endptr;
 
+	batch_store_get_job_ids(batch_dirs);
+
 	xassert(slurmctld_conf.state_save_location);
 	f_dir = opendir(slurmctld_conf.state_save_location);
 	if (!f_dir) {
@@ -9002,6 +9458,7 @@ extern bool job_epilog_complete(uint32_t job_id, char *node_name,
 	step_epilog_complete(job_ptr, node_name);
 	/* nodes_completing is out of date, rebuild when next saved */
 	xfree(job_ptr->nodes_completing);
+	job_journal_mark(job_ptr);
 	if (!IS_JOB_COMPLETING(job_ptr)) {	/* COMPLETED */
 		if (IS_JOB_PENDING(job_ptr) && (job_ptr->batch_flag)) {
 			info("requeue batch job %u", job_ptr->job_id);
@@ -9046,11 +9503,21 @@ extern bool job_epilog_complete(uint32_t job_id, char *node_name,
 /* job_fini - free all memory associated with job records */
 void job_fini (void)
 {
+	info_cache_purge(&job_info_cache);
 	if (job_list) {
 		list_destroy(job_list);
 		job_list = NULL;
 	}
-	xfree(job_hash);
+	id_hash_destroy(job_hash);
+	job_hash = NULL;
+	node_job_map_fini();
+	pend_queue_fini();
+	batch_store_fini();
+	timer_wheel_destroy(job_timers);
+	job_timers = NULL;
+	job_timers_rebuild = true;
+	xfree(journal_purged);
+	journal_purged_cnt = journal_purged_size = 0;
 }
 
 /* log the completion of the specified job */
@@ -9068,6 +9535,7 @@ extern void job_completion_logger(struct job_record  *job_ptr, bool requeue)
 		free_job_resources(&job_ptr->job_resrcs);
 #endif
 	acct_policy_remove_job_submit(job_ptr);
+	job_journal_mark(job_ptr);
 
 	if (!IS_JOB_RESIZING(job_ptr)) {
 		/* Remove configuring state just to make sure it isn't there
@@ -9434,6 +9902,7 @@ static int _suspend_job_nodes(struct job_record *job_ptr, bool indf_susp)
 			node_ptr->last_idle  = now;
 		}
 	}
+	job_journal_mark(job_ptr);
 	last_job_update = last_node_update = now;
 	return rc;
 }
@@ -9482,6 +9951,7 @@ static int _resume_job_nodes(struct job_record *job_ptr, bool indf_susp)
 		node_flags = node_ptr->node_state & NODE_STATE_FLAGS;
 		node_ptr->node_state = NODE_STATE_ALLOCATED | node_flags;
 	}
+	job_journal_mark(job_ptr);
 	last_job_update = last_node_update = time(NULL);
 	return rc;
 }
@@ -9615,6 +10085,7 @@ extern int job_suspend(suspend_msg_t *sus_ptr, uid_t uid,
 				- job_ptr->pre_sus_time;
 		}
 		resume_job_step(job_ptr);
+		job_timer_arm(job_ptr);
 	}
 
 	job_ptr->time_last_active = now;
@@ -9699,6 +10170,7 @@ extern int job_requeue (uid_t uid, uint32_t job_id, slurm_fd_t conn_fd,
 	}
 
 	slurm_sched_requeue(job_ptr, "Job requeued by user/admin");
+	job_journal_mark(job_ptr);
 	last_job_update = now;
 
 	if (IS_JOB_SUSPENDED(job_ptr)) {
@@ -9739,6 +10211,7 @@ extern int job_requeue (uid_t uid, uint32_t job_id, slurm_fd_t conn_fd,
 	/* Since the job completion logger removes the submit we need
 	 * to add it again. */
 	acct_policy_add_job_submit(job_ptr);
+	pend_queue_update(job_ptr);
 
     reply:
 	if (conn_fd >= 0) {
@@ -9848,6 +10321,7 @@ extern int job_hold_by_assoc_id(uint32_t assoc_id)
 		     job_ptr->job_id);
 		xfree(job_ptr->state_desc);
 		job_ptr->state_reason = FAIL_ACCOUNT;
+		job_journal_mark(job_ptr);
 		cnt++;
 	}
 	list_iterator_destroy(job_iterator);
@@ -9899,6 +10373,7 @@ extern int job_hold_by_qos_id(uint32_t qos_id)
 		info("QOS deleted, holding job %u", job_ptr->job_id);
 		xfree(job_ptr->state_desc);
 		job_ptr->state_reason = FAIL_QOS;
+		job_journal_mark(job_ptr);
 		cnt++;
 	}
 	list_iterator_destroy(job_iterator);
@@ -9974,6 +10449,7 @@ extern int update_job_account(char *module, struct job_record *job_ptr,
 	}
 	job_ptr->assoc_id = assoc_rec.id;
 
+	job_journal_mark(job_ptr);
 	last_job_update = time(NULL);
 
 	return SLURM_SUCCESS;
@@ -10038,6 +10514,7 @@ extern int update_job_wckey(char *module, struct job_record *job_ptr,
 		     module, job_ptr->job_id);
 	}
 
+	job_journal_mark(job_ptr);
 	last_job_update = time(NULL);
 
 	return SLURM_SUCCESS;
@@ -10166,6 +10643,7 @@ extern int job_checkpoint(checkpoint_msg_t *ckpt_ptr, uid_t uid,
 				   &resp_data.error_msg);
 		info("checkpoint_op %u of %u.%u complete, rc=%d",
 		     ckpt_ptr->op, ckpt_ptr->job_id, ckpt_ptr->step_id, rc);
+		job_journal_mark(job_ptr);
 		last_job_update = time(NULL);
 	} else {		/* operate on all of a job's steps */
 		int update_rc = -2;
@@ -10199,6 +10677,7 @@ extern int job_checkpoint(checkpoint_msg_t *ckpt_ptr, uid_t uid,
 			rc = MAX(rc, update_rc);
 			xfree(image_dir);
 		}
+		job_journal_mark(job_ptr);
 		if (update_rc != -2)	/* some work done */
 			last_job_update = time(NULL);
 		list_iterator_destroy (step_iterator);
@@ -10611,6 +11090,7 @@ extern int job_restart(checkpoint_msg_t *ckpt_ptr, uid_t uid, slurm_fd_t conn_fd
 		job_ptr->details->restart_dir = image_dir;
 		image_dir = NULL;	/* Nothing left to xfree */
 
+		job_journal_mark(job_ptr);
 		last_job_update = time(NULL);
 	}
 
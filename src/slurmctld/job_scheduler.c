@@ -71,6 +71,7 @@
 #include "src/slurmctld/licenses.h"
 #include "src/slurmctld/locks.h"
 #include "src/slurmctld/node_scheduler.h"
+#include "src/slurmctld/pend_queue.h"
 #include "src/slurmctld/preempt.h"
 #include "src/slurmctld/proc_req.h"
 #include "src/slurmctld/reservation.h"
@@ -135,6 +136,7 @@ static void _job_queue_append(List job_queue, struct job_record *job_ptr,
 	job_queue_rec_t *job_queue_rec;
 
 	job_queue_rec = xmalloc(sizeof(job_queue_rec_t));
+	job_queue_rec->job_id   = job_ptr->job_id;
 	job_queue_rec->job_ptr  = job_ptr;
 	job_queue_rec->part_ptr = part_ptr;
 	list_append(job_queue, job_queue_rec);
@@ -377,6 +379,27 @@ static void do_diag_stats(struct timeval tv1, struct timeval tv2)
 	slurmctld_diag_stats.schedule_cycle_counter++;
 }
 
+/* Record the time between a job becoming eligible and its start */
+static void _start_latency_stats(struct job_record *job_ptr, time_t now)
+{
+	time_t elig_time = 0;
+	uint32_t latency;
+
+	if (job_ptr->details) {
+		elig_time = job_ptr->details->begin_time;
+		if (elig_time == 0)
+			elig_time = job_ptr->details->submit_time;
+	}
+	if ((elig_time == 0) || (elig_time > now))
+		return;
+	latency = (uint32_t) (now - elig_time);
+	slurmctld_diag_stats.schedule_latency_last = latency;
+	slurmctld_diag_stats.schedule_latency_max =
+		MAX(slurmctld_diag_stats.schedule_latency_max, latency);
+	slurmctld_diag_stats.schedule_latency_sum += latency;
+	slurmctld_diag_stats.schedule_latency_cnt++;
+}
+
 
 /*
  * Given that one batch job just completed, attempt to launch a suitable
@@ -547,6 +570,7 @@ next_part:		part_ptr = (struct part_record *)
 			 * very rare. */
 			info("sched: JobId=%u has invalid account",
 			     job_ptr->job_id);
+			job_journal_mark(job_ptr);
 			last_job_update = now;
 			job_ptr->state_reason = FAIL_ACCOUNT;
 			xfree(job_ptr->state_desc);
@@ -618,15 +642,15 @@ send_reply:
  *		  queue on every job submit (0 means to use the system default,
  *		  SchedulerParameters for default_queue_depth)
  * RET count of jobs scheduled
- * Note: We re-build the queue every time. Jobs can not only be added
- *	or removed from the queue, but have their priority or partition
- *	changed with the update_job RPC. In general nodes will be in priority
- *	order (by submit time), so the sorting should be pretty fast.
+ * Note: Jobs are taken in priority order from the persistent pending job
+ *	queue (see pend_queue.h), which is kept current as jobs are added,
+ *	changed and removed. Tests of a job's ability to run now depend upon
+ *	the time and the state of other jobs, so they are made as each job
+ *	is taken from the queue.
  */
 extern int schedule(uint32_t job_limit)
 {
 	ListIterator job_iterator = NULL, part_iterator = NULL;
-	List job_queue = NULL;
 	int error_code, failed_part_cnt = 0, job_cnt = 0, i;
 	uint32_t job_depth = 0;
 	job_queue_rec_t *job_queue_rec;
@@ -744,8 +768,8 @@ extern int schedule(uint32_t job_limit)
 	 * If we are doing FIFO scheduling, use the job records right off the
 	 * job list.
 	 *
-	 * If a job is submitted to multiple partitions then build_job_queue()
-	 * will return a separate record for each job:partition pair.
+	 * If a job is submitted to multiple partitions then the pending job
+	 * queue holds a separate record for each job:partition pair.
 	 *
 	 * In both cases, we test each partition associated with the job.
 	 */
@@ -753,8 +777,8 @@ extern int schedule(uint32_t job_limit)
 		slurmctld_diag_stats.schedule_queue_len = list_count(job_list);
 		job_iterator = list_iterator_create(job_list);
 	} else {
-		job_queue = build_job_queue(false);
-		slurmctld_diag_stats.schedule_queue_len = list_count(job_queue);
+		pend_queue_sync();
+		slurmctld_diag_stats.schedule_queue_len = pend_queue_count();
 	}
 	while (1) {
 		if (fifo_sched) {
@@ -786,16 +810,21 @@ next_part:			part_ptr = (struct part_record *)
 					continue;
 			}
 		} else {
-			job_queue_rec = list_pop_bottom(job_queue,
-							sort_job_queue2);
+			job_queue_rec = pend_queue_pop();
 			if (!job_queue_rec)
 				break;
 			job_ptr  = job_queue_rec->job_ptr;
 			part_ptr = job_queue_rec->part_ptr;
-			xfree(job_queue_rec);
-			if (!IS_JOB_PENDING(job_ptr))
-				continue;  /* started in other partition */
+			if (!_job_runnable_test1(job_ptr, false))
+				continue;  /* including started in other part */
 			job_ptr->part_ptr = part_ptr;
+			if (job_ptr->part_ptr_list) {
+				if (job_limits_check(&job_ptr) !=
+				    WAIT_NO_REASON)
+					continue;
+			} else if (!_job_runnable_test2(job_ptr)) {
+				continue;
+			}
 		}
 		if ((time(NULL) - sched_start) >= sched_timeout) {
 			debug("sched: loop taking too long, breaking out");
@@ -912,6 +941,7 @@ next_part:			part_ptr = (struct part_record *)
 			 * very rare. */
 			info("sched: JobId=%u has invalid account",
 			     job_ptr->job_id);
+			job_journal_mark(job_ptr);
 			last_job_update = time(NULL);
 			job_ptr->state_reason = FAIL_ACCOUNT;
 			xfree(job_ptr->state_desc);
@@ -976,6 +1006,7 @@ next_part:			part_ptr = (struct part_record *)
 			/* job initiated */
 			debug3("sched: JobId=%u initiated", job_ptr->job_id);
 			last_job_update = now;
+			_start_latency_stats(job_ptr, now);
 #ifdef HAVE_BG
 			select_g_select_jobinfo_get(job_ptr->select_jobinfo,
 						    SELECT_JOBDATA_IONODES,
@@ -1013,6 +1044,7 @@ next_part:			part_ptr = (struct part_record *)
 			info("sched: schedule: JobId=%u non-runnable: %s",
 			     job_ptr->job_id, slurm_strerror(error_code));
 			if (!wiki_sched) {
+				job_journal_mark(job_ptr);
 				last_job_update = now;
 				job_ptr->job_state = JOB_FAILED;
 				job_ptr->exit_code = 1;
@@ -1035,8 +1067,11 @@ next_part:			part_ptr = (struct part_record *)
 		if (part_iterator)
 			list_iterator_destroy(part_iterator);
 	} else {
-		FREE_NULL_LIST(job_queue);
+		pend_queue_restore();
 	}
+	i = pend_queue_maint_time();
+	slurmctld_diag_stats.schedule_queue_maint_last = i;
+	slurmctld_diag_stats.schedule_queue_maint_sum += i;
 	unlock_slurmctld(job_write_lock);
 	END_TIMER2("schedule");
 
@@ -47,11 +47,36 @@
 
 #include <errno.h>
 #include <string.h>
+#include <sys/time.h>
 #include <sys/types.h>
 
+#include "src/common/timers.h"
+#include "src/common/xmalloc.h"
 #include "src/slurmctld/locks.h"
 #include "src/slurmctld/slurmctld.h"
 
+/* Maximum number of distinct functions for which lock statistics are kept */
+#define LOCK_CALLER_MAX 256
+
+/* Index into lock_type_stats[] for a data type and lock level */
+#define lock_stat_inx(data_type, level) \
+	((data_type) * 2 + (((level) == WRITE_LOCK) ? 1 : 0))
+
+typedef struct lock_stats {
+	uint32_t cnt;		/* count of locks granted */
+	uint64_t wait_time;	/* usec spent waiting for the lock */
+	uint64_t wait_max;	/* longest usec waiting for the lock */
+	uint64_t hold_time;	/* usec spent holding the lock */
+	uint64_t hold_max;	/* longest usec holding the lock */
+} lock_stats_t;
+
+/* Per thread record of when each data type was locked and by whom, used
+ * to compute hold times in unlock_slurmctld() */
+typedef struct lock_thread_rec {
+	struct timeval lock_time[ENTITY_COUNT];
+	int caller_inx[ENTITY_COUNT];	/* -1 if not locked by this thread */
+} lock_thread_rec_t;
+
 static pthread_mutex_t locks_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t locks_cond = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t state_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -59,6 +84,23 @@ static pthread_mutex_t state_mutex = PTHREAD_MUTEX_INITIALIZER;
 static slurmctld_lock_flags_t slurmctld_locks;
 static int kill_thread = 0;
 
+static pthread_mutex_t lock_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static lock_stats_t lock_type_stats[ENTITY_COUNT * 2];
+static const char *lock_caller_name[LOCK_CALLER_MAX];
+static lock_stats_t lock_caller_stats[LOCK_CALLER_MAX];
+static int lock_caller_cnt = 0;
+
+static pthread_once_t lock_thread_once = PTHREAD_ONCE_INIT;
+static pthread_key_t lock_thread_key;
+
+static int  _caller_inx(const char *caller);
+static lock_thread_rec_t *_get_thread_rec(void);
+static void _lock_thread_key_create(void);
+static void _record_hold(slurmctld_lock_t lock_levels);
+static void _record_wait(slurmctld_lock_t lock_levels, const char *caller,
+			 uint64_t *wait_usec, struct timeval *now);
+static void _update_stats(lock_stats_t *stats, uint64_t wait_usec,
+			  uint64_t hold_usec);
 static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock);
 static void _wr_rdunlock(lock_datatype_t datatype);
 static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock);
@@ -72,35 +114,49 @@ void init_locks(void)
 	memset((void *) &slurmctld_locks, 0, sizeof(slurmctld_locks));
 }
 
-/* lock_slurmctld - Issue the required lock requests in a well defined order */
-extern void lock_slurmctld(slurmctld_lock_t lock_levels)
+/* Lock one data type at the requested level, return usec spent waiting */
+static uint64_t _lock_entity(lock_datatype_t datatype, lock_level_t level)
 {
-	if (lock_levels.config == READ_LOCK)
-		(void) _wr_rdlock(CONFIG_LOCK, true);
-	else if (lock_levels.config == WRITE_LOCK)
-		(void) _wr_wrlock(CONFIG_LOCK, true);
+	struct timeval tv1, tv2;
 
-	if (lock_levels.job == READ_LOCK)
-		(void) _wr_rdlock(JOB_LOCK, true);
-	else if (lock_levels.job == WRITE_LOCK)
-		(void) _wr_wrlock(JOB_LOCK, true);
+	if (level == NO_LOCK)
+		return 0;
 
-	if (lock_levels.node == READ_LOCK)
-		(void) _wr_rdlock(NODE_LOCK, true);
-	else if (lock_levels.node == WRITE_LOCK)
-		(void) _wr_wrlock(NODE_LOCK, true);
+	gettimeofday(&tv1, NULL);
+	if (level == READ_LOCK)
+		(void) _wr_rdlock(datatype, true);
+	else
+		(void) _wr_wrlock(datatype, true);
+	gettimeofday(&tv2, NULL);
+	return (uint64_t) slurm_diff_tv(&tv1, &tv2);
+}
 
-	if (lock_levels.partition == READ_LOCK)
-		(void) _wr_rdlock(PART_LOCK, true);
-	else if (lock_levels.partition == WRITE_LOCK)
-		(void) _wr_wrlock(PART_LOCK, true);
+/* lock_slurmctld_caller - Issue the required lock requests in a well defined
+ *	order, recording statistics for the named caller */
+extern void lock_slurmctld_caller(slurmctld_lock_t lock_levels,
+				  const char *caller)
+{
+	uint64_t wait_usec[ENTITY_COUNT];
+	struct timeval now;
+
+	wait_usec[CONFIG_LOCK] = _lock_entity(CONFIG_LOCK, lock_levels.config);
+	wait_usec[JOB_LOCK]    = _lock_entity(JOB_LOCK, lock_levels.job);
+	wait_usec[NODE_LOCK]   = _lock_entity(NODE_LOCK, lock_levels.node);
+	wait_usec[PART_LOCK]   = _lock_entity(PART_LOCK,
+					      lock_levels.partition);
+
+	gettimeofday(&now, NULL);
+	_record_wait(lock_levels, caller, wait_usec, &now);
 }
 
-/* try_lock_slurmctld - equivalent to lock_slurmctld() except 
+/* try_lock_slurmctld_caller - equivalent to lock_slurmctld_caller() except
  * RET 0 on success or -1 if the locks are currently not available */
-extern int try_lock_slurmctld (slurmctld_lock_t lock_levels)
+extern int try_lock_slurmctld_caller(slurmctld_lock_t lock_levels,
+				     const char *caller)
 {
 	bool success = true;
+	uint64_t wait_usec[ENTITY_COUNT] = { 0, 0, 0, 0 };
+	struct timeval now;
 
 	if (lock_levels.config == READ_LOCK)
 		success = _wr_rdlock(CONFIG_LOCK, false);
@@ -157,6 +213,8 @@ extern int try_lock_slurmctld (slurmctld_lock_t lock_levels)
 		return -1;
 	}
 
+	gettimeofday(&now, NULL);
+	_record_wait(lock_levels, caller, wait_usec, &now);
 	return 0;
 }
 
@@ -164,6 +222,8 @@ extern int try_lock_slurmctld (slurmctld_lock_t lock_levels)
  *	defined order */
 extern void unlock_slurmctld(slurmctld_lock_t lock_levels)
 {
+	_record_hold(lock_levels);
+
 	if (lock_levels.partition == READ_LOCK)
 		_wr_rdunlock(PART_LOCK);
 	else if (lock_levels.partition == WRITE_LOCK)
@@ -255,6 +315,185 @@ static void _wr_wrunlock(lock_datatype_t datatype)
 	slurm_mutex_unlock(&locks_mutex);
 }
 
+static void _lock_thread_rec_free(void *arg)
+{
+	xfree(arg);
+}
+
+static void _lock_thread_key_create(void)
+{
+	if (pthread_key_create(&lock_thread_key, _lock_thread_rec_free))
+		error("pthread_key_create: %m");
+}
+
+/* Return the calling thread's lock record, creating it as needed */
+static lock_thread_rec_t *_get_thread_rec(void)
+{
+	lock_thread_rec_t *thread_rec;
+	int i;
+
+	(void) pthread_once(&lock_thread_once, _lock_thread_key_create);
+	thread_rec = pthread_getspecific(lock_thread_key);
+	if (thread_rec == NULL) {
+		thread_rec = xmalloc(sizeof(lock_thread_rec_t));
+		for (i = 0; i < ENTITY_COUNT; i++)
+			thread_rec->caller_inx[i] = -1;
+		(void) pthread_setspecific(lock_thread_key, thread_rec);
+	}
+	return thread_rec;
+}
+
+/* Return the index of a caller in lock_caller_stats[], adding it as needed.
+ * Names are compared by address since they are all __func__ strings.
+ * NOTE: Caller must hold lock_stats_mutex
+ * RET index or -1 if the table is full */
+static int _caller_inx(const char *caller)
+{
+	int i;
+
+	if (caller == NULL)
+		return -1;
+	for (i = 0; i < lock_caller_cnt; i++) {
+		if (lock_caller_name[i] == caller)
+			return i;
+	}
+	if (lock_caller_cnt >= LOCK_CALLER_MAX)
+		return -1;
+	lock_caller_name[lock_caller_cnt] = caller;
+	memset(&lock_caller_stats[lock_caller_cnt], 0, sizeof(lock_stats_t));
+	return lock_caller_cnt++;
+}
+
+static void _update_stats(lock_stats_t *stats, uint64_t wait_usec,
+			  uint64_t hold_usec)
+{
+	stats->wait_time += wait_usec;
+	if (stats->wait_max < wait_usec)
+		stats->wait_max = wait_usec;
+	stats->hold_time += hold_usec;
+	if (stats->hold_max < hold_usec)
+		stats->hold_max = hold_usec;
+}
+
+/* Record the time spent acquiring a set of locks and note when they were
+ * acquired so that unlock_slurmctld() can compute hold times */
+static void _record_wait(slurmctld_lock_t lock_levels, const char *caller,
+			 uint64_t *wait_usec, struct timeval *now)
+{
+	lock_thread_rec_t *thread_rec = _get_thread_rec();
+	lock_level_t level[ENTITY_COUNT];
+	uint64_t caller_wait = 0;
+	int i, inx;
+
+	level[CONFIG_LOCK] = lock_levels.config;
+	level[JOB_LOCK]    = lock_levels.job;
+	level[NODE_LOCK]   = lock_levels.node;
+	level[PART_LOCK]   = lock_levels.partition;
+
+	slurm_mutex_lock(&lock_stats_mutex);
+	inx = _caller_inx(caller);
+	for (i = 0; i < ENTITY_COUNT; i++) {
+		if (level[i] == NO_LOCK)
+			continue;
+		lock_type_stats[lock_stat_inx(i, level[i])].cnt++;
+		_update_stats(&lock_type_stats[lock_stat_inx(i, level[i])],
+			      wait_usec[i], 0);
+		caller_wait += wait_usec[i];
+		thread_rec->lock_time[i] = *now;
+		thread_rec->caller_inx[i] = inx;
+	}
+	if (inx >= 0) {
+		lock_caller_stats[inx].cnt++;
+		_update_stats(&lock_caller_stats[inx], caller_wait, 0);
+	}
+	slurm_mutex_unlock(&lock_stats_mutex);
+}
+
+/* Record the time for which a set of locks about to be released were held.
+ * The caller is charged with the longest hold of any lock in the set. */
+static void _record_hold(slurmctld_lock_t lock_levels)
+{
+	lock_thread_rec_t *thread_rec = _get_thread_rec();
+	lock_level_t level[ENTITY_COUNT];
+	struct timeval now;
+	uint64_t hold_usec, caller_hold = 0;
+	int i, inx = -1;
+
+	level[CONFIG_LOCK] = lock_levels.config;
+	level[JOB_LOCK]    = lock_levels.job;
+	level[NODE_LOCK]   = lock_levels.node;
+	level[PART_LOCK]   = lock_levels.partition;
+
+	gettimeofday(&now, NULL);
+	slurm_mutex_lock(&lock_stats_mutex);
+	for (i = 0; i < ENTITY_COUNT; i++) {
+		if ((level[i] == NO_LOCK) ||
+		    (thread_rec->lock_time[i].tv_sec == 0))
+			continue;
+		hold_usec = slurm_diff_tv(&thread_rec->lock_time[i], &now);
+		_update_stats(&lock_type_stats[lock_stat_inx(i, level[i])],
+			      0, hold_usec);
+		if (caller_hold < hold_usec)
+			caller_hold = hold_usec;
+		if (thread_rec->caller_inx[i] >= 0)
+			inx = thread_rec->caller_inx[i];
+		thread_rec->lock_time[i].tv_sec = 0;
+		thread_rec->caller_inx[i] = -1;
+	}
+	if (inx >= 0)
+		_update_stats(&lock_caller_stats[inx], 0, caller_hold);
+	slurm_mutex_unlock(&lock_stats_mutex);
+}
+
+/* pack_lock_stats - Pack lock wait and hold time statistics for sdiag */
+extern void pack_lock_stats(Buf buffer)
+{
+	uint32_t cnt[LOCK_CALLER_MAX];
+	uint64_t wait_time[LOCK_CALLER_MAX], wait_max[LOCK_CALLER_MAX];
+	uint64_t hold_time[LOCK_CALLER_MAX], hold_max[LOCK_CALLER_MAX];
+	char *name[LOCK_CALLER_MAX];
+	int i;
+
+	slurm_mutex_lock(&lock_stats_mutex);
+	for (i = 0; i < ENTITY_COUNT * 2; i++) {
+		cnt[i]       = lock_type_stats[i].cnt;
+		wait_time[i] = lock_type_stats[i].wait_time;
+		wait_max[i]  = lock_type_stats[i].wait_max;
+		hold_time[i] = lock_type_stats[i].hold_time;
+		hold_max[i]  = lock_type_stats[i].hold_max;
+	}
+	pack32_array(cnt, ENTITY_COUNT * 2, buffer);
+	pack64_array(wait_time, ENTITY_COUNT * 2, buffer);
+	pack64_array(wait_max,  ENTITY_COUNT * 2, buffer);
+	pack64_array(hold_time, ENTITY_COUNT * 2, buffer);
+	pack64_array(hold_max,  ENTITY_COUNT * 2, buffer);
+
+	for (i = 0; i < lock_caller_cnt; i++) {
+		name[i]      = (char *) lock_caller_name[i];
+		cnt[i]       = lock_caller_stats[i].cnt;
+		wait_time[i] = lock_caller_stats[i].wait_time;
+		wait_max[i]  = lock_caller_stats[i].wait_max;
+		hold_time[i] = lock_caller_stats[i].hold_time;
+		hold_max[i]  = lock_caller_stats[i].hold_max;
+	}
+	packstr_array(name, lock_caller_cnt, buffer);
+	pack32_array(cnt, lock_caller_cnt, buffer);
+	pack64_array(wait_time, lock_caller_cnt, buffer);
+	pack64_array(wait_max,  lock_caller_cnt, buffer);
+	pack64_array(hold_time, lock_caller_cnt, buffer);
+	pack64_array(hold_max,  lock_caller_cnt, buffer);
+	slurm_mutex_unlock(&lock_stats_mutex);
+}
+
+/* reset_lock_stats - Clear lock wait and hold time statistics */
+extern void reset_lock_stats(void)
+{
+	slurm_mutex_lock(&lock_stats_mutex);
+	memset(lock_type_stats, 0, sizeof(lock_type_stats));
+	memset(lock_caller_stats, 0, sizeof(lock_caller_stats));
+	slurm_mutex_unlock(&lock_stats_mutex);
+}
+
 /* get_lock_values - Get the current value of all locks
  * OUT lock_flags - a copy of the current lock values */
 void get_lock_values(slurmctld_lock_flags_t * lock_flags)
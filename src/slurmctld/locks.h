@@ -87,6 +87,8 @@
 #ifndef _SLURMCTLD_LOCKS_H
 #define _SLURMCTLD_LOCKS_H
 
+#include "src/common/pack.h"
+
 /* levels of locking required for each data structure */
 typedef enum {
 	NO_LOCK,
@@ -136,12 +138,25 @@ extern void init_locks ( void );
 /* kill_locked_threads - Kill all threads waiting on semaphores */
 extern void kill_locked_threads ( void );
 
-/* lock_slurmctld - Issue the required lock requests in a well defined order */
-extern void lock_slurmctld (slurmctld_lock_t lock_levels);
+/* lock_slurmctld - Issue the required lock requests in a well defined order.
+ * The calling function's name is recorded for lock statistics. */
+#define lock_slurmctld(lock_levels) \
+	lock_slurmctld_caller(lock_levels, __func__)
+extern void lock_slurmctld_caller (slurmctld_lock_t lock_levels,
+				   const char *caller);
 
 /* try_lock_slurmctld - equivalent to lock_slurmctld() except 
  * RET 0 on success or -1 if the locks are currently not available */
-extern int try_lock_slurmctld (slurmctld_lock_t lock_levels);
+#define try_lock_slurmctld(lock_levels) \
+	try_lock_slurmctld_caller(lock_levels, __func__)
+extern int try_lock_slurmctld_caller (slurmctld_lock_t lock_levels,
+				      const char *caller);
+
+/* pack_lock_stats - Pack lock wait and hold time statistics for sdiag */
+extern void pack_lock_stats (Buf buffer);
+
+/* reset_lock_stats - Clear lock wait and hold time statistics */
+extern void reset_lock_stats ( void );
 
 /* unlock_slurmctld - Issue the required unlock requests in a well
  *	defined order */
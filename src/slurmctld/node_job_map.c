@@ -0,0 +1,247 @@
+/*****************************************************************************\
+ *  node_job_map.c - index of the jobs allocated each node
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+
+#include "src/common/bitstring.h"
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/node_conf.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/node_job_map.h"
+
+typedef struct node_jobs {
+	struct job_record **job_array;	/* jobs indexed under the node, in
+					 * the order they were added */
+	int job_cnt;
+	int job_size;
+} node_jobs_t;
+
+static node_jobs_t *node_jobs = NULL;	/* one per node record */
+static int node_jobs_cnt = 0;
+
+static void _alloc_map(void)
+{
+	node_jobs_cnt = node_record_count;
+	node_jobs = xmalloc(sizeof(node_jobs_t) * MAX(node_jobs_cnt, 1));
+}
+
+static void _free_map(void)
+{
+	int i;
+
+	for (i = 0; i < node_jobs_cnt; i++)
+		xfree(node_jobs[i].job_array);
+	xfree(node_jobs);
+	node_jobs_cnt = 0;
+}
+
+/* Return true if the job may have work on the node: it is running or
+ * suspended there, or still completing there */
+static bool _job_on_node(struct job_record *job_ptr, int node_inx)
+{
+	bool on_node = false;
+
+	if (!IS_JOB_RUNNING(job_ptr) && !IS_JOB_SUSPENDED(job_ptr) &&
+	    !IS_JOB_COMPLETING(job_ptr))
+		return false;
+	if (job_ptr->node_bitmap &&
+	    (node_inx < bit_size(job_ptr->node_bitmap)))
+		on_node = bit_test(job_ptr->node_bitmap, node_inx);
+	if (!on_node && IS_JOB_COMPLETING(job_ptr) && job_ptr->node_bitmap_cg &&
+	    (node_inx < bit_size(job_ptr->node_bitmap_cg)))
+		on_node = bit_test(job_ptr->node_bitmap_cg, node_inx);
+	return on_node;
+}
+
+static void _node_add(int node_inx, struct job_record *job_ptr)
+{
+	node_jobs_t *node_jobs_ptr = &node_jobs[node_inx];
+
+	if (node_jobs_ptr->job_cnt >= node_jobs_ptr->job_size) {
+		node_jobs_ptr->job_size = MAX(4, node_jobs_ptr->job_size * 2);
+		xrealloc(node_jobs_ptr->job_array, sizeof(struct job_record *) *
+			 node_jobs_ptr->job_size);
+	}
+	node_jobs_ptr->job_array[node_jobs_ptr->job_cnt++] = job_ptr;
+}
+
+static void _node_del(int node_inx, struct job_record *job_ptr)
+{
+	node_jobs_t *node_jobs_ptr = &node_jobs[node_inx];
+	int i;
+
+	for (i = 0; i < node_jobs_ptr->job_cnt; i++) {
+		if (node_jobs_ptr->job_array[i] != job_ptr)
+			continue;
+		node_jobs_ptr->job_cnt--;
+		memmove(&node_jobs_ptr->job_array[i],
+			&node_jobs_ptr->job_array[i + 1],
+			sizeof(struct job_record *) *
+			(node_jobs_ptr->job_cnt - i));
+		return;
+	}
+	error("node_job_map: job %u missing from node %d",
+	      job_ptr->job_id, node_inx);
+}
+
+/*
+ * node_job_map_add - index a job under each node in its node_bitmap, called
+ *	as nodes are allocated to the job. Any entries for nodes no longer in
+ *	node_bitmap are kept until next looked up.
+ */
+extern void node_job_map_add(struct job_record *job_ptr)
+{
+	int i, i_first, i_last;
+
+	if (!job_ptr->node_bitmap)
+		return;
+	if (!node_jobs)
+		_alloc_map();
+	if (bit_size(job_ptr->node_bitmap) != node_jobs_cnt) {
+		error("node_job_map: node_bitmap of job %u is of size %d, "
+		      "not %d", job_ptr->job_id,
+		      bit_size(job_ptr->node_bitmap), node_jobs_cnt);
+		return;
+	}
+	if (!job_ptr->node_map_bitmap)
+		job_ptr->node_map_bitmap = bit_alloc(node_jobs_cnt);
+
+	i_first = bit_ffs(job_ptr->node_bitmap);
+	if (i_first < 0)
+		return;
+	i_last = bit_fls(job_ptr->node_bitmap);
+	for (i = i_first; i <= i_last; i++) {
+		if (!bit_test(job_ptr->node_bitmap, i) ||
+		    bit_test(job_ptr->node_map_bitmap, i))
+			continue;
+		_node_add(i, job_ptr);
+		bit_set(job_ptr->node_map_bitmap, i);
+	}
+}
+
+/* node_job_map_remove - remove all of a job's entries, called as the job
+ *	record is purged */
+extern void node_job_map_remove(struct job_record *job_ptr)
+{
+	int i, i_first, i_last;
+
+	if (!job_ptr->node_map_bitmap)
+		return;
+	i_first = bit_ffs(job_ptr->node_map_bitmap);
+	if (node_jobs && (i_first >= 0)) {
+		i_last = MIN(bit_fls(job_ptr->node_map_bitmap),
+			     node_jobs_cnt - 1);
+		for (i = i_first; i <= i_last; i++) {
+			if (bit_test(job_ptr->node_map_bitmap, i))
+				_node_del(i, job_ptr);
+		}
+	}
+	FREE_NULL_BITMAP(job_ptr->node_map_bitmap);
+}
+
+/*
+ * node_job_map_rebuild - rebuild the map from the job list, called after job
+ *	state has been recovered or the node table rebuilt
+ */
+extern void node_job_map_rebuild(void)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+
+	_free_map();
+	_alloc_map();
+	if (!job_list)
+		return;
+
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		FREE_NULL_BITMAP(job_ptr->node_map_bitmap);
+		if (IS_JOB_RUNNING(job_ptr) || IS_JOB_SUSPENDED(job_ptr) ||
+		    IS_JOB_COMPLETING(job_ptr))
+			node_job_map_add(job_ptr);
+	}
+	list_iterator_destroy(job_iterator);
+}
+
+/*
+ * node_job_map_get - find the jobs running, suspended or completing on a node
+ * IN node_inx - index of the node in node_record_table_ptr
+ * OUT job_array - array of the jobs, oldest allocation first, must be
+ *	xfreed by the caller. Changes to the jobs' state while the array is
+ *	in use do not change the array.
+ * RET count of jobs in job_array
+ */
+extern int node_job_map_get(int node_inx, struct job_record ***job_array)
+{
+	node_jobs_t *node_jobs_ptr;
+	struct job_record *job_ptr;
+	int i, j;
+
+	*job_array = NULL;
+	if ((node_inx < 0) || (node_inx >= node_jobs_cnt))
+		return 0;
+
+	/* Drop the entries of jobs which have left the node */
+	node_jobs_ptr = &node_jobs[node_inx];
+	for (i = 0, j = 0; i < node_jobs_ptr->job_cnt; i++) {
+		job_ptr = node_jobs_ptr->job_array[i];
+		if (_job_on_node(job_ptr, node_inx))
+			node_jobs_ptr->job_array[j++] = job_ptr;
+		else
+			bit_clear(job_ptr->node_map_bitmap, node_inx);
+	}
+	node_jobs_ptr->job_cnt = j;
+
+	if (node_jobs_ptr->job_cnt) {
+		*job_array = xmalloc(sizeof(struct job_record *) *
+				     node_jobs_ptr->job_cnt);
+		memcpy(*job_array, node_jobs_ptr->job_array,
+		       sizeof(struct job_record *) * node_jobs_ptr->job_cnt);
+	}
+	return node_jobs_ptr->job_cnt;
+}
+
+/* node_job_map_fini - free all memory, called at slurmctld shutdown after
+ *	the job list has been freed */
+extern void node_job_map_fini(void)
+{
+	_free_map();
+}
@@ -0,0 +1,86 @@
+/*****************************************************************************\
+ *  node_job_map.h - index of the jobs allocated each node
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+
+#ifndef _HAVE_NODE_JOB_MAP_H
+#define _HAVE_NODE_JOB_MAP_H
+
+#include "src/slurmctld/slurmctld.h"
+
+/*
+ * The node to job map lists, for each node, the jobs which have been
+ * allocated it, so node registration and node failure handling can find the
+ * jobs on a node without a walk of the whole job list. Jobs are added as
+ * nodes are allocated to them and removed as they are purged. Entries for
+ * jobs which have since left a node (completed, requeued or had the node
+ * removed from their allocation) are dropped as the node's jobs are next
+ * looked up, so the map can hold more jobs than are on a node but never
+ * fewer. A job's steps are found through its step_list.
+ *
+ * All functions must be called with the job write lock set.
+ */
+
+/*
+ * node_job_map_add - index a job under each node in its node_bitmap, called
+ *	as nodes are allocated to the job. Any entries for nodes no longer in
+ *	node_bitmap are kept until next looked up.
+ */
+extern void node_job_map_add(struct job_record *job_ptr);
+
+/* node_job_map_remove - remove all of a job's entries, called as the job
+ *	record is purged */
+extern void node_job_map_remove(struct job_record *job_ptr);
+
+/*
+ * node_job_map_rebuild - rebuild the map from the job list, called after job
+ *	state has been recovered or the node table rebuilt
+ */
+extern void node_job_map_rebuild(void);
+
+/*
+ * node_job_map_get - find the jobs running, suspended or completing on a node
+ * IN node_inx - index of the node in node_record_table_ptr
+ * OUT job_array - array of the jobs, oldest allocation first, must be
+ *	xfreed by the caller. Changes to the jobs' state while the array is
+ *	in use do not change the array.
+ * RET count of jobs in job_array
+ */
+extern int node_job_map_get(int node_inx, struct job_record ***job_array);
+
+/* node_job_map_fini - free all memory, called at slurmctld shutdown after
+ *	the job list has been freed */
+extern void node_job_map_fini(void);
+
+#endif /* !_HAVE_NODE_JOB_MAP_H */
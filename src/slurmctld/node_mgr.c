@@ -68,6 +68,7 @@
 #include "src/common/slurm_acct_gather_energy.h"
 #include "src/slurmctld/agent.h"
 #include "src/slurmctld/front_end.h"
+#include "src/slurmctld/info_cache.h"
 #include "src/slurmctld/locks.h"
 #include "src/slurmctld/ping_nodes.h"
 #include "src/slurmctld/proc_req.h"
@@ -104,13 +105,16 @@ bool load_2_4_state         = false;    /* There was a bug in 2.4.0
 					 * correctly in the job.
 					 */
 
+static info_cache_t node_info_cache = INFO_CACHE_INITIALIZER;
+
 static void 	_dump_node_state (struct node_record *dump_node_ptr,
 				  Buf buffer);
 static front_end_record_t * _front_end_reg(
 				slurm_node_registration_status_msg_t *reg_msg);
 static void 	_make_node_down(struct node_record *node_ptr,
 				time_t event_time);
-static bool	_node_is_hidden(struct node_record *node_ptr);
+static info_cache_rec_t *_get_node_info_cache(uint16_t protocol_version);
+static bool	_node_is_hidden(struct node_record *node_ptr, uid_t uid);
 static int	_open_node_state_file(char **state_file);
 static void 	_pack_node (struct node_record *dump_node_ptr, Buf buffer,
 			    uint16_t protocol_version);
@@ -639,13 +643,13 @@ int list_compare_config (void *config_entry1, void *config_entry2)
 }
 
 
-static bool _node_is_hidden(struct node_record *node_ptr)
+static bool _node_is_hidden(struct node_record *node_ptr, uid_t uid)
 {
 	int i;
 	bool shown = false;
 
 	for (i=0; i<node_ptr->part_cnt; i++) {
-		if (!(node_ptr->part_pptr[i]->flags & PART_FLAG_HIDDEN)) {
+		if (part_is_visible(node_ptr->part_pptr[i], uid)) {
 			shown = true;
 			break;
 		}
@@ -656,6 +660,33 @@ static bool _node_is_hidden(struct node_record *node_ptr)
 	return true;
 }
 
+/* Return packed records of all nodes for the given protocol version,
+ * packing them if not already cached.
+ * NOTE: Release the records with info_cache_release(&node_info_cache, ...)
+ * NOTE: READ lock_slurmctld node before entry */
+static info_cache_rec_t *_get_node_info_cache(uint16_t protocol_version)
+{
+	struct node_record *node_ptr;
+	info_cache_rec_t *cache_rec;
+	int inx;
+
+	cache_rec = info_cache_get(&node_info_cache, protocol_version, 0,
+				   last_node_update);
+	if (cache_rec)
+		return cache_rec;
+
+	cache_rec = info_cache_create(protocol_version, 0, last_node_update,
+				      node_record_count);
+	for (inx = 0, node_ptr = node_record_table_ptr;
+	     inx < node_record_count; inx++, node_ptr++) {
+		info_cache_mark(cache_rec, node_ptr, inx);
+		_pack_node(node_ptr, cache_rec->buffer, protocol_version);
+	}
+	info_cache_put(&node_info_cache, cache_rec);
+
+	return cache_rec;
+}
+
 /*
  * pack_all_node - dump all configuration and node information for all nodes
  *	in machine independent form (for network transmission)
@@ -667,18 +698,19 @@ static bool _node_is_hidden(struct node_record *node_ptr)
  * global: node_record_table_ptr - pointer to global node table
  * NOTE: the caller must xfree the buffer at *buffer_ptr
  * NOTE: change slurm_load_node() in api/node_info.c when data format changes
- * NOTE: READ lock_slurmctld config before entry
+ * NOTE: READ lock_slurmctld config and partition before entry
  */
 extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 			   uint16_t show_flags, uid_t uid,
 			   uint16_t protocol_version)
 {
 	int inx;
-	uint32_t nodes_packed, tmp_offset, node_scaling;
+	uint32_t nodes_packed, tmp_offset, node_scaling, cursor = 0;
 	Buf buffer;
 	time_t now = time(NULL);
 	struct node_record *node_ptr = node_record_table_ptr;
 	bool hidden;
+	info_cache_rec_t *cache_rec;
 
 	buffer_ptr[0] = NULL;
 	*buffer_size = 0;
@@ -696,7 +728,7 @@ extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 		pack_time(now, buffer);
 
 		/* write node records */
-		part_filter_set(uid);
+		cache_rec = _get_node_info_cache(protocol_version);
 		for (inx = 0; inx < node_record_count; inx++, node_ptr++) {
 			xassert (node_ptr->magic == NODE_MAGIC);
 			xassert (node_ptr->config_ptr->magic ==
@@ -708,7 +740,7 @@ extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 			 * with it. */
 			hidden = false;
 			if (((show_flags & SHOW_ALL) == 0) && (uid != 0) &&
-			    (_node_is_hidden(node_ptr)))
+			    (_node_is_hidden(node_ptr, uid)))
 				hidden = true;
 			else if (IS_NODE_FUTURE(node_ptr) &&
 				 !IS_NODE_MAINT(node_ptr)) /* reboot req sent */
@@ -725,11 +757,12 @@ extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 				node_ptr->name = NULL;
 				_pack_node(node_ptr, buffer, protocol_version);
 				node_ptr->name = orig_name;
-			} else
+			} else if (!info_cache_copy(cache_rec, &cursor,
+						    node_ptr, inx, buffer))
 				_pack_node(node_ptr, buffer, protocol_version);
 			nodes_packed++;
 		}
-		part_filter_clear();
+		info_cache_release(&node_info_cache, cache_rec);
 	} else {
 		error("select_g_select_jobinfo_pack: protocol_version "
 		      "%hu not supported", protocol_version);
@@ -757,7 +790,7 @@ extern void pack_all_node (char **buffer_ptr, int *buffer_size,
  * global: node_record_table_ptr - pointer to global node table
  * NOTE: the caller must xfree the buffer at *buffer_ptr
  * NOTE: change slurm_load_node() in api/node_info.c when data format changes
- * NOTE: READ lock_slurmctld config before entry
+ * NOTE: READ lock_slurmctld config and partition before entry
  */
 extern void pack_one_node (char **buffer_ptr, int *buffer_size,
 			   uint16_t show_flags, uid_t uid, char *node_name,
@@ -785,7 +818,6 @@ extern void pack_one_node (char **buffer_ptr, int *buffer_size,
 		pack_time(now, buffer);
 
 		/* write node records */
-		part_filter_set(uid);
 		if (node_name)
 			node_ptr = find_node_record(node_name);
 		else
@@ -793,7 +825,7 @@ extern void pack_one_node (char **buffer_ptr, int *buffer_size,
 		if (node_ptr) {
 			hidden = false;
 			if (((show_flags & SHOW_ALL) == 0) && (uid != 0) &&
-			    (_node_is_hidden(node_ptr)))
+			    (_node_is_hidden(node_ptr, uid)))
 				hidden = true;
 			else if (IS_NODE_FUTURE(node_ptr) &&
 				 !IS_NODE_MAINT(node_ptr)) /* reboot req sent */
@@ -810,7 +842,6 @@ extern void pack_one_node (char **buffer_ptr, int *buffer_size,
 				nodes_packed++;
 			}
 		}
-		part_filter_clear();
 	} else {
 		error("select_g_select_jobinfo_pack: protocol_version "
 		      "%hu not supported", protocol_version);
@@ -2878,6 +2909,7 @@ void make_node_idle(struct node_record *node_ptr,
 	xassert(node_ptr);
 	if (node_bitmap && (bit_test(node_bitmap, inx))) {
 		/* Not a replay */
+		job_journal_mark(job_ptr);
 		last_job_update = now;
 		bit_clear(node_bitmap, inx);
 
@@ -3052,6 +3084,7 @@ extern int send_nodes_to_accounting(time_t event_time)
 /* node_fini - free all memory associated with node records */
 extern void node_fini (void)
 {
+	info_cache_purge(&node_info_cache);
 	FREE_NULL_BITMAP(avail_node_bitmap);
 	FREE_NULL_BITMAP(cg_node_bitmap);
 	FREE_NULL_BITMAP(idle_node_bitmap);
@@ -77,6 +77,7 @@
 #include "src/slurmctld/front_end.h"
 #include "src/slurmctld/job_scheduler.h"
 #include "src/slurmctld/licenses.h"
+#include "src/slurmctld/node_job_map.h"
 #include "src/slurmctld/node_scheduler.h"
 #include "src/slurmctld/preempt.h"
 #include "src/slurmctld/proc_req.h"
@@ -299,6 +300,7 @@ extern void allocate_nodes(struct job_record *job_ptr)
 		}
 		make_node_alloc(node_ptr, job_ptr);
 	}
+	node_job_map_add(job_ptr);
 
 	last_node_update = time(NULL);
 	license_job_get(job_ptr);
@@ -377,6 +379,7 @@ extern void deallocate_nodes(struct job_record *job_ptr, bool timeout,
 			select_serial = 1;
 	}
 
+	job_journal_mark(job_ptr);
 	license_job_return(job_ptr);
 	acct_policy_job_fini(job_ptr);
 	if (slurm_sched_freealloc(job_ptr) != SLURM_SUCCESS)
@@ -1574,6 +1577,7 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 	xfree(job_ptr->nodes);
 
 	job_ptr->node_bitmap = select_bitmap;
+	job_journal_mark(job_ptr);
 
 	/* we need to have these times set to know when the endtime
 	 * is for the job when we place it
@@ -1629,6 +1633,7 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 	if (configuring
 	    || bit_overlap(job_ptr->node_bitmap, power_node_bitmap))
 		job_ptr->job_state |= JOB_CONFIGURING;
+	job_timer_arm(job_ptr);
 	if (select_g_select_nodeinfo_set(job_ptr) != SLURM_SUCCESS) {
 		error("select_g_select_nodeinfo_set(%u): %m", job_ptr->job_id);
 		/* not critical ... by now */
@@ -2445,6 +2450,7 @@ extern void re_kill_job(struct job_record *job_ptr)
 	xassert(job_ptr);
 	xassert(job_ptr->details);
 
+	job_journal_mark(job_ptr);
 	kill_hostlist = hostlist_create("");
 
 	agent_args = xmalloc(sizeof(agent_arg_t));
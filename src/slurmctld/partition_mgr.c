@@ -62,6 +62,7 @@
 #include "src/common/xstring.h"
 
 #include "src/slurmctld/groups.h"
+#include "src/slurmctld/info_cache.h"
 #include "src/slurmctld/locks.h"
 #include "src/slurmctld/proc_req.h"
 #include "src/slurmctld/reservation.h"
@@ -83,11 +84,14 @@ struct part_record *default_part_loc = NULL; /* default partition location */
 time_t last_part_update;	/* time of last update to partition records */
 uint16_t part_max_priority = 0;         /* max priority in all partitions */
 
+static info_cache_t part_info_cache = INFO_CACHE_INITIALIZER;
+
 static int    _build_part_bitmap(struct part_record *part_ptr);
 static int    _delete_part_record(char *name);
 static void   _dump_part_state(struct part_record *part_ptr,
 			       Buf buffer);
 static uid_t *_get_groups_members(char *group_names);
+static info_cache_rec_t *_get_part_info_cache(uint16_t protocol_version);
 static time_t _get_group_tlm(void);
 static void   _list_delete_part(void *part_entry);
 static int    _open_part_state_file(char **state_file);
@@ -382,11 +386,14 @@ int dump_all_part_state(void)
  */
 static void _dump_part_state(struct part_record *part_ptr, Buf buffer)
 {
+	uint16_t flags;
+
 	xassert(part_ptr);
+	flags = part_ptr->flags;
 	if (default_part_loc == part_ptr)
-		part_ptr->flags |= PART_FLAG_DEFAULT;
+		flags |= PART_FLAG_DEFAULT;
 	else
-		part_ptr->flags &= (~PART_FLAG_DEFAULT);
+		flags &= (~PART_FLAG_DEFAULT);
 
 	packstr(part_ptr->name,          buffer);
 	pack32(part_ptr->grace_time,	 buffer);
@@ -395,7 +402,7 @@ static void _dump_part_state(struct part_record *part_ptr, Buf buffer)
 	pack32(part_ptr->max_nodes_orig, buffer);
 	pack32(part_ptr->min_nodes_orig, buffer);
 
-	pack16(part_ptr->flags,          buffer);
+	pack16(flags,                    buffer);
 	pack16(part_ptr->max_share,      buffer);
 	pack16(part_ptr->preempt_mode,   buffer);
 	pack16(part_ptr->priority,       buffer);
@@ -840,40 +847,46 @@ int list_find_part(void *part_entry, void *key)
 	return 0;
 }
 
-/* part_filter_set - Set the partition's hidden flag based upon a user's
- * group access. This must be followed by a call to part_filter_clear() */
-extern void part_filter_set(uid_t uid)
+/* part_is_visible - should the partition be visible to the specified user
+ *	based upon its hidden flag and the user's group access.
+ * NOTE: This does not modify the partition record, so only a READ lock on
+ *	partitions is required */
+extern bool part_is_visible(struct part_record *part_ptr, uid_t uid)
 {
-	struct part_record *part_ptr;
-	ListIterator part_iterator;
-
-	part_iterator = list_iterator_create(part_list);
-	while ((part_ptr = (struct part_record *) list_next(part_iterator))) {
-		if (part_ptr->flags & PART_FLAG_HIDDEN)
-			continue;
-		if (validate_group (part_ptr, uid) == 0) {
-			part_ptr->flags |= PART_FLAG_HIDDEN;
-			part_ptr->flags |= PART_FLAG_HIDDEN_CLR;
-		}
-	}
-	list_iterator_destroy(part_iterator);
+	xassert(part_ptr);
+	if (part_ptr->flags & PART_FLAG_HIDDEN)
+		return false;
+	if (validate_group(part_ptr, uid) == 0)
+		return false;
+	return true;
 }
 
-/* part_filter_clear - Clear the partition's hidden flag based upon a user's
- * group access. This must follow a call to part_filter_set() */
-extern void part_filter_clear(void)
+/* Return packed records of all partitions for the given protocol version,
+ * packing them if not already cached.
+ * NOTE: Release the records with info_cache_release(&part_info_cache, ...)
+ * NOTE: READ lock_slurmctld partition before entry */
+static info_cache_rec_t *_get_part_info_cache(uint16_t protocol_version)
 {
-	struct part_record *part_ptr;
 	ListIterator part_iterator;
+	struct part_record *part_ptr;
+	info_cache_rec_t *cache_rec;
+
+	cache_rec = info_cache_get(&part_info_cache, protocol_version, 0,
+				   last_part_update);
+	if (cache_rec)
+		return cache_rec;
 
+	cache_rec = info_cache_create(protocol_version, 0, last_part_update,
+				      list_count(part_list));
 	part_iterator = list_iterator_create(part_list);
 	while ((part_ptr = (struct part_record *) list_next(part_iterator))) {
-		if (part_ptr->flags & PART_FLAG_HIDDEN_CLR) {
-			part_ptr->flags &= (~PART_FLAG_HIDDEN);
-			part_ptr->flags &= (~PART_FLAG_HIDDEN_CLR);
-		}
+		info_cache_mark(cache_rec, part_ptr, 0);
+		pack_part(part_ptr, cache_rec->buffer, protocol_version);
 	}
 	list_iterator_destroy(part_iterator);
+	info_cache_put(&part_info_cache, cache_rec);
+
+	return cache_rec;
 }
 
 /*
@@ -893,15 +906,17 @@ extern void pack_all_part(char **buffer_ptr, int *buffer_size,
 {
 	ListIterator part_iterator;
 	struct part_record *part_ptr;
-	uint32_t parts_packed;
+	uint32_t parts_packed, cursor = 0;
 	int tmp_offset;
 	Buf buffer;
 	time_t now = time(NULL);
+	info_cache_rec_t *cache_rec;
 
 	buffer_ptr[0] = NULL;
 	*buffer_size = 0;
 
 	buffer = init_buf(BUF_SIZE);
+	cache_rec = _get_part_info_cache(protocol_version);
 
 	/* write header: version and time */
 	parts_packed = 0;
@@ -913,13 +928,14 @@ extern void pack_all_part(char **buffer_ptr, int *buffer_size,
 	while ((part_ptr = (struct part_record *) list_next(part_iterator))) {
 		xassert (part_ptr->magic == PART_MAGIC);
 		if (((show_flags & SHOW_ALL) == 0) && (uid != 0) &&
-		    ((part_ptr->flags & PART_FLAG_HIDDEN)
-		     || (validate_group (part_ptr, uid) == 0)))
+		    !part_is_visible(part_ptr, uid))
 			continue;
-		pack_part(part_ptr, buffer, protocol_version);
+		if (!info_cache_copy(cache_rec, &cursor, part_ptr, 0, buffer))
+			pack_part(part_ptr, buffer, protocol_version);
 		parts_packed++;
 	}
 	list_iterator_destroy(part_iterator);
+	info_cache_release(&part_info_cache, cache_rec);
 
 	/* put the real record count in the message body header */
 	tmp_offset = get_buf_offset(buffer);
@@ -946,12 +962,14 @@ void pack_part(struct part_record *part_ptr, Buf buffer,
 	       uint16_t protocol_version)
 {
 	uint32_t altered;
+	uint16_t flags;
 
 	if (protocol_version >= SLURM_2_6_PROTOCOL_VERSION) {
+		flags = part_ptr->flags;
 		if (default_part_loc == part_ptr)
-			part_ptr->flags |= PART_FLAG_DEFAULT;
+			flags |= PART_FLAG_DEFAULT;
 		else
-			part_ptr->flags &= (~PART_FLAG_DEFAULT);
+			flags &= (~PART_FLAG_DEFAULT);
 
 		packstr(part_ptr->name, buffer);
 		pack32(part_ptr->grace_time, buffer);
@@ -966,7 +984,7 @@ void pack_part(struct part_record *part_ptr, Buf buffer,
 		pack32(part_ptr->def_mem_per_cpu, buffer);
 		pack32(part_ptr->max_mem_per_cpu, buffer);
 
-		pack16(part_ptr->flags,      buffer);
+		pack16(flags,      buffer);
 		pack16(part_ptr->max_share,  buffer);
 		pack16(part_ptr->preempt_mode, buffer);
 		pack16(part_ptr->priority,   buffer);
@@ -979,10 +997,11 @@ void pack_part(struct part_record *part_ptr, Buf buffer,
 		packstr(part_ptr->nodes, buffer);
 		pack_bit_fmt(part_ptr->node_bitmap, buffer);
 	} else if (protocol_version >= SLURM_2_4_PROTOCOL_VERSION) {
+		flags = part_ptr->flags;
 		if (default_part_loc == part_ptr)
-			part_ptr->flags |= PART_FLAG_DEFAULT;
+			flags |= PART_FLAG_DEFAULT;
 		else
-			part_ptr->flags &= (~PART_FLAG_DEFAULT);
+			flags &= (~PART_FLAG_DEFAULT);
 
 		packstr(part_ptr->name, buffer);
 		pack32(part_ptr->grace_time, buffer);
@@ -996,7 +1015,7 @@ void pack_part(struct part_record *part_ptr, Buf buffer,
 		pack32(part_ptr->total_cpus, buffer);
 		pack32(part_ptr->def_mem_per_cpu, buffer);
 		pack32(part_ptr->max_mem_per_cpu, buffer);
-		pack16(part_ptr->flags,      buffer);
+		pack16(flags,      buffer);
 		pack16(part_ptr->max_share,  buffer);
 		pack16(part_ptr->preempt_mode, buffer);
 		pack16(part_ptr->priority,   buffer);
@@ -1501,6 +1520,7 @@ static int _uid_list_size(uid_t * uid_list_ptr)
 /* part_fini - free all memory associated with partition records */
 void part_fini (void)
 {
+	info_cache_purge(&part_info_cache);
 	if (part_list) {
 		list_destroy(part_list);
 		part_list = NULL;
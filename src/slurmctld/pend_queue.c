@@ -0,0 +1,672 @@
+/*****************************************************************************\
+ *  pend_queue.c - persistent priority ordered queue of pending jobs
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <sys/time.h>
+
+#include "src/common/id_hash.h"
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/timers.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/pend_queue.h"
+#include "src/slurmctld/preempt.h"
+
+typedef struct pend_rec pend_rec_t;
+struct pend_rec {
+	job_queue_rec_t job_queue_rec;	/* what pend_queue_pop() returns */
+	uint32_t priority;	/* job's priority in this partition, as
+				 * when the record was last positioned */
+	bool has_resv;		/* job had a reservation, likewise */
+	int part_inx;		/* index into job's part_ptr_list and
+				 * priority_array, -1 if no list */
+	int heap_inx;		/* index into heap, -1 if not yet added */
+	bool defunct;		/* removed during a scheduling pass, to be
+				 * freed by pend_queue_restore() */
+	bool fixing;		/* on the fix list */
+	pend_rec_t *next;	/* job's record for its next partition */
+};
+
+/*
+ * A scheduling pass walks the heap in order without taking records out of
+ * it. The walk keeps a second, small heap of the records whose parents have
+ * been visited; visiting a record adds its children. The main heap is not
+ * changed during a pass: records added, removed or found out of position
+ * are put on the fix list and dealt with by pend_queue_restore(), so only
+ * records of jobs which changed cost any heap operations.
+ */
+typedef struct walk_ent {
+	pend_rec_t *rec;
+	uint32_t priority;	/* keys to visit the record by */
+	bool has_resv;
+	bool expanded;		/* children already added to the walk */
+} walk_ent_t;
+
+static pend_rec_t **heap = NULL;	/* binary heap, best record first */
+static int heap_cnt = 0, heap_size = 0;
+static walk_ent_t *walk = NULL;		/* records next to visit this pass */
+static int walk_cnt = 0, walk_size = 0;
+static pend_rec_t **fix = NULL;		/* records to add, remove or move */
+static int fix_cnt = 0, fix_size = 0;
+static pend_rec_t **popped = NULL;	/* records popped this pass */
+static int popped_cnt = 0, popped_size = 0;
+static id_hash_t *job_recs = NULL;	/* job_id -> job's first record */
+
+static bool rebuild = true;
+static bool walking = false;		/* scheduling pass in progress */
+static bool preemption_enabled = false;
+static time_t conf_update = 0, part_update = 0, verify_time = 0;
+static uint32_t maint_usec = 0;
+
+static void _maint_time(struct timeval *tv1)
+{
+	struct timeval tv2;
+
+	gettimeofday(&tv2, NULL);
+	maint_usec += slurm_diff_tv(tv1, &tv2);
+}
+
+/* Return true if job 1 is to be tested before job 2, matching the order of
+ * sort_job_queue2() with ties broken by job ID */
+static bool _keys_before(job_queue_rec_t *job1, bool has_resv1,
+			 uint32_t priority1, job_queue_rec_t *job2,
+			 bool has_resv2, uint32_t priority2)
+{
+	if (preemption_enabled) {
+		if (slurm_job_preempt_check(job1, job2))
+			return true;
+		if (slurm_job_preempt_check(job2, job1))
+			return false;
+	}
+	if (has_resv1 != has_resv2)
+		return has_resv1;
+	if (priority1 != priority2)
+		return (priority1 > priority2);
+	return (job1->job_id < job2->job_id);
+}
+
+static bool _rec_before(pend_rec_t *rec1, pend_rec_t *rec2)
+{
+	return _keys_before(&rec1->job_queue_rec, rec1->has_resv,
+			    rec1->priority, &rec2->job_queue_rec,
+			    rec2->has_resv, rec2->priority);
+}
+
+static bool _ent_before(walk_ent_t *ent1, walk_ent_t *ent2)
+{
+	return _keys_before(&ent1->rec->job_queue_rec, ent1->has_resv,
+			    ent1->priority, &ent2->rec->job_queue_rec,
+			    ent2->has_resv, ent2->priority);
+}
+
+static uint32_t _job_part_prio(struct job_record *job_ptr, int part_inx)
+{
+	if ((part_inx >= 0) && job_ptr->priority_array)
+		return job_ptr->priority_array[part_inx];
+	return job_ptr->priority;
+}
+
+static bool _job_queued(struct job_record *job_ptr)
+{
+	return (IS_JOB_PENDING(job_ptr) && (job_ptr->priority != 0));
+}
+
+/* Return true if a record's keys no longer match its job */
+static bool _rec_stale(pend_rec_t *rec)
+{
+	struct job_record *job_ptr = rec->job_queue_rec.job_ptr;
+
+	return ((rec->priority != _job_part_prio(job_ptr, rec->part_inx)) ||
+		(rec->has_resv != (job_ptr->resv_id != 0)));
+}
+
+static void _heap_set(int inx, pend_rec_t *rec)
+{
+	heap[inx] = rec;
+	rec->heap_inx = inx;
+}
+
+static void _heap_up(int inx)
+{
+	pend_rec_t *rec = heap[inx];
+	int parent;
+
+	while (inx > 0) {
+		parent = (inx - 1) / 2;
+		if (!_rec_before(rec, heap[parent]))
+			break;
+		_heap_set(inx, heap[parent]);
+		inx = parent;
+	}
+	_heap_set(inx, rec);
+}
+
+static void _heap_down(int inx)
+{
+	pend_rec_t *rec = heap[inx];
+	int child;
+
+	while ((child = (inx * 2) + 1) < heap_cnt) {
+		if (((child + 1) < heap_cnt) &&
+		    _rec_before(heap[child + 1], heap[child]))
+			child++;
+		if (!_rec_before(heap[child], rec))
+			break;
+		_heap_set(inx, heap[child]);
+		inx = child;
+	}
+	_heap_set(inx, rec);
+}
+
+/* Move the record at inx after a change to its keys */
+static void _heap_fix(int inx)
+{
+	if ((inx > 0) && _rec_before(heap[inx], heap[(inx - 1) / 2]))
+		_heap_up(inx);
+	else
+		_heap_down(inx);
+}
+
+static void _heap_add(pend_rec_t *rec)
+{
+	if (heap_cnt >= heap_size) {
+		heap_size = MAX(heap_size * 2, 1024);
+		xrealloc(heap, sizeof(pend_rec_t *) * heap_size);
+	}
+	_heap_set(heap_cnt++, rec);
+	_heap_up(rec->heap_inx);
+}
+
+static void _heap_del(pend_rec_t *rec)
+{
+	int inx = rec->heap_inx;
+
+	rec->heap_inx = -1;
+	if (--heap_cnt == inx)
+		return;
+	_heap_set(inx, heap[heap_cnt]);
+	_heap_fix(inx);
+}
+
+static void _walk_push(pend_rec_t *rec, uint32_t priority, bool has_resv,
+		       bool expanded)
+{
+	walk_ent_t ent;
+	int inx, parent;
+
+	if (walk_cnt >= walk_size) {
+		walk_size = MAX(walk_size * 2, 256);
+		xrealloc(walk, sizeof(walk_ent_t) * walk_size);
+	}
+	ent.rec = rec;
+	ent.priority = priority;
+	ent.has_resv = has_resv;
+	ent.expanded = expanded;
+	for (inx = walk_cnt++; inx > 0; inx = parent) {
+		parent = (inx - 1) / 2;
+		if (!_ent_before(&ent, &walk[parent]))
+			break;
+		walk[inx] = walk[parent];
+	}
+	walk[inx] = ent;
+}
+
+static void _walk_pop(walk_ent_t *ent)
+{
+	walk_ent_t last;
+	int inx = 0, child;
+
+	*ent = walk[0];
+	last = walk[--walk_cnt];
+	while ((child = (inx * 2) + 1) < walk_cnt) {
+		if (((child + 1) < walk_cnt) &&
+		    _ent_before(&walk[child + 1], &walk[child]))
+			child++;
+		if (!_ent_before(&walk[child], &last))
+			break;
+		walk[inx] = walk[child];
+		inx = child;
+	}
+	if (walk_cnt)
+		walk[inx] = last;
+}
+
+static void _walk_push_heap(int inx)
+{
+	if (inx < heap_cnt) {
+		_walk_push(heap[inx], heap[inx]->priority, heap[inx]->has_resv,
+			   false);
+	}
+}
+
+static void _fix_add(pend_rec_t *rec)
+{
+	if (rec->fixing)
+		return;
+	if (fix_cnt >= fix_size) {
+		fix_size = MAX(fix_size * 2, 256);
+		xrealloc(fix, sizeof(pend_rec_t *) * fix_size);
+	}
+	rec->fixing = true;
+	fix[fix_cnt++] = rec;
+}
+
+static void _set_rec_keys(pend_rec_t *rec)
+{
+	struct job_record *job_ptr = rec->job_queue_rec.job_ptr;
+
+	rec->priority = _job_part_prio(job_ptr, rec->part_inx);
+	rec->has_resv = (job_ptr->resv_id != 0);
+}
+
+static pend_rec_t *_rec_create(struct job_record *job_ptr,
+			       struct part_record *part_ptr, int part_inx)
+{
+	pend_rec_t *rec = xmalloc(sizeof(pend_rec_t));
+
+	rec->job_queue_rec.job_id   = job_ptr->job_id;
+	rec->job_queue_rec.job_ptr  = job_ptr;
+	rec->job_queue_rec.part_ptr = part_ptr;
+	rec->part_inx = part_inx;
+	rec->heap_inx = -1;
+	_set_rec_keys(rec);
+	if (walking)
+		_fix_add(rec);
+	else
+		_heap_add(rec);
+	return rec;
+}
+
+/* Add records for a job in each of its partitions */
+static void _queue_job(struct job_record *job_ptr)
+{
+	pend_rec_t *rec, *first = NULL, **last = &first;
+	struct part_record *part_ptr;
+	ListIterator part_iterator;
+	int part_inx = 0;
+
+	if (!_job_queued(job_ptr))
+		return;
+
+	if (job_ptr->part_ptr_list) {
+		part_iterator = list_iterator_create(job_ptr->part_ptr_list);
+		while ((part_ptr = (struct part_record *)
+				   list_next(part_iterator))) {
+			rec = _rec_create(job_ptr, part_ptr, part_inx++);
+			*last = rec;
+			last = &rec->next;
+		}
+		list_iterator_destroy(part_iterator);
+	} else {
+		if (job_ptr->part_ptr == NULL) {
+			part_ptr = find_part_record(job_ptr->partition);
+			if (part_ptr == NULL) {
+				error("Could not find partition %s "
+				      "for job %u", job_ptr->partition,
+				      job_ptr->job_id);
+				return;
+			}
+			job_ptr->part_ptr = part_ptr;
+			error("partition pointer reset for job %u, "
+			      "part %s", job_ptr->job_id,
+			      job_ptr->partition);
+		}
+		first = _rec_create(job_ptr, job_ptr->part_ptr, -1);
+	}
+	if (first &&
+	    (id_hash_add(job_recs, job_ptr->job_id, first) != SLURM_SUCCESS))
+		error("sched: job %u queued twice", job_ptr->job_id);
+}
+
+/* Remove all records of a job. During a scheduling pass the records are
+ * left for pend_queue_restore() to take out of the heap and free. */
+static void _unqueue_job(uint32_t job_id)
+{
+	pend_rec_t *rec, *next;
+
+	for (rec = id_hash_remove(job_recs, job_id); rec; rec = next) {
+		next = rec->next;
+		if (walking) {
+			rec->defunct = true;
+			_fix_add(rec);
+		} else {
+			_heap_del(rec);
+			xfree(rec);
+		}
+	}
+}
+
+/* Return true if a job's records match its current state */
+static bool _job_recs_current(struct job_record *job_ptr, pend_rec_t *rec)
+{
+	struct part_record *part_ptr;
+	ListIterator part_iterator;
+	bool current = true;
+
+	if (!job_ptr->part_ptr_list) {
+		return (rec && (rec->next == NULL) &&
+			(rec->job_queue_rec.part_ptr == job_ptr->part_ptr) &&
+			(rec->priority == job_ptr->priority) &&
+			(rec->has_resv == (job_ptr->resv_id != 0)));
+	}
+
+	part_iterator = list_iterator_create(job_ptr->part_ptr_list);
+	while ((part_ptr = (struct part_record *) list_next(part_iterator))) {
+		if (!rec || (rec->job_queue_rec.part_ptr != part_ptr) ||
+		    _rec_stale(rec)) {
+			current = false;
+			break;
+		}
+		rec = rec->next;
+	}
+	list_iterator_destroy(part_iterator);
+	return (current && (rec == NULL));
+}
+
+/* Remove and free every record */
+static void _clear_queue(void)
+{
+	int i;
+
+	for (i = 0; i < heap_cnt; i++)
+		xfree(heap[i]);
+	heap_cnt = 0;
+	for (i = 0; i < fix_cnt; i++) {
+		if (fix[i]->heap_inx < 0)	/* others freed above */
+			xfree(fix[i]);
+	}
+	fix_cnt = walk_cnt = popped_cnt = 0;
+	if (job_recs)
+		id_hash_destroy(job_recs);
+	job_recs = NULL;
+}
+
+static void _rebuild_queue(void)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+
+	_clear_queue();
+	job_recs = id_hash_create(list_count(job_list));
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator)))
+		_queue_job(job_ptr);
+	list_iterator_destroy(job_iterator);
+	debug2("sched: pending job queue rebuilt with %d records", heap_cnt);
+}
+
+/* Correct the records of any job whose state or priority was changed
+ * without a call to pend_queue_update() */
+static void _verify_queue(void)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	pend_rec_t *rec;
+	int fixed = 0;
+
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		rec = id_hash_find(job_recs, job_ptr->job_id);
+		if (_job_queued(job_ptr)) {
+			if (_job_recs_current(job_ptr, rec))
+				continue;
+		} else if (rec == NULL) {
+			continue;
+		}
+		_unqueue_job(job_ptr->job_id);
+		_queue_job(job_ptr);
+		fixed++;
+	}
+	list_iterator_destroy(job_iterator);
+	if (fixed) {
+		debug("sched: pending job queue records corrected for %d jobs",
+		      fixed);
+	}
+}
+
+/*
+ * pend_queue_update - (re)queue a job after a change to its state, priority,
+ *	partitions or reservation. If the job's records no longer match it
+ *	they are removed and, if it is pending and not held, new records
+ *	added.
+ */
+extern void pend_queue_update(struct job_record *job_ptr)
+{
+	struct timeval tv1;
+	pend_rec_t *rec;
+
+	if (rebuild)	/* queue is built from scratch before next use */
+		return;
+	gettimeofday(&tv1, NULL);
+	rec = id_hash_find(job_recs, job_ptr->job_id);
+	if (_job_queued(job_ptr) ? !_job_recs_current(job_ptr, rec) :
+				   (rec != NULL)) {
+		_unqueue_job(job_ptr->job_id);
+		_queue_job(job_ptr);
+	}
+	_maint_time(&tv1);
+}
+
+/* pend_queue_remove - remove a job's records, called as the job is purged */
+extern void pend_queue_remove(struct job_record *job_ptr)
+{
+	struct timeval tv1;
+
+	if (rebuild)
+		return;
+	gettimeofday(&tv1, NULL);
+	_unqueue_job(job_ptr->job_id);
+	_maint_time(&tv1);
+}
+
+/* pend_queue_rebuild - rebuild the whole queue before its next use, for
+ *	example after job state has been recovered */
+extern void pend_queue_rebuild(void)
+{
+	if (!walking)	/* else cleared by pend_queue_restore() */
+		_clear_queue();
+	rebuild = true;
+}
+
+/*
+ * pend_queue_sync - prepare the queue for a scheduling pass. The queue is
+ *	rebuilt if so requested or partitions or configuration changed, and
+ *	verified against the job list every PEND_QUEUE_VERIFY_INTERVAL.
+ */
+extern void pend_queue_sync(void)
+{
+	struct timeval tv1;
+	time_t now = time(NULL);
+
+	gettimeofday(&tv1, NULL);
+	if (conf_update != slurmctld_conf.last_update) {
+		preemption_enabled = slurm_preemption_enabled();
+		conf_update = slurmctld_conf.last_update;
+		rebuild = true;
+	}
+	if (part_update != last_part_update) {
+		part_update = last_part_update;
+		rebuild = true;
+	}
+	if (rebuild) {
+		_rebuild_queue();
+		rebuild = false;
+		verify_time = now;
+	} else if ((now - verify_time) >= PEND_QUEUE_VERIFY_INTERVAL) {
+		_verify_queue();
+		verify_time = now;
+	}
+	_maint_time(&tv1);
+}
+
+/*
+ * pend_queue_pop - return the next record of the scheduling pass, in
+ *	priority order. Records of jobs no longer pending are skipped.
+ *	Records are not taken out of the queue; jobs queued during the pass
+ *	are first returned in the next pass.
+ * RET the record or NULL at the end of the queue. The record remains owned
+ *	by the queue and is valid until pend_queue_restore() is called.
+ */
+extern job_queue_rec_t *pend_queue_pop(void)
+{
+	struct job_record *job_ptr;
+	walk_ent_t ent;
+	pend_rec_t *rec;
+
+	if (rebuild)
+		return NULL;
+	if (!walking) {
+		walking = true;
+		_walk_push_heap(0);
+	}
+	while (walk_cnt) {
+		_walk_pop(&ent);
+		rec = ent.rec;
+		if (!ent.expanded) {
+			_walk_push_heap((rec->heap_inx * 2) + 1);
+			_walk_push_heap((rec->heap_inx * 2) + 2);
+		}
+		if (rec->defunct)
+			continue;
+		job_ptr = rec->job_queue_rec.job_ptr;
+		if (!_job_queued(job_ptr)) {
+			_unqueue_job(job_ptr->job_id);
+			continue;
+		}
+		if (!ent.expanded && _rec_stale(rec)) {
+			/* Changed without pend_queue_update(), visit it
+			 * at its new position and move it afterwards */
+			_fix_add(rec);
+			_walk_push(rec, _job_part_prio(job_ptr, rec->part_inx),
+				   (job_ptr->resv_id != 0), true);
+			continue;
+		}
+
+		if (popped_cnt >= popped_size) {
+			popped_size = MAX(popped_size * 2, 256);
+			xrealloc(popped, sizeof(pend_rec_t *) * popped_size);
+		}
+		popped[popped_cnt++] = rec;
+		return &rec->job_queue_rec;
+	}
+	return NULL;
+}
+
+/*
+ * pend_queue_restore - end a scheduling pass. Records of jobs started or
+ *	otherwise changed during the pass are removed or moved, records of
+ *	jobs queued during the pass are added. Other records are untouched.
+ */
+extern void pend_queue_restore(void)
+{
+	struct job_record *job_ptr;
+	struct timeval tv1;
+	pend_rec_t *rec;
+	int i;
+
+	if (!walking)
+		return;
+	gettimeofday(&tv1, NULL);
+	for (i = 0; i < popped_cnt; i++) {
+		rec = popped[i];
+		if (rec->defunct)
+			continue;
+		job_ptr = rec->job_queue_rec.job_ptr;
+		if (!_job_queued(job_ptr))
+			_unqueue_job(job_ptr->job_id);
+		else if (_rec_stale(rec))
+			_fix_add(rec);
+	}
+	popped_cnt = walk_cnt = 0;
+	walking = false;
+
+	if (rebuild) {
+		_clear_queue();
+		_maint_time(&tv1);
+		return;
+	}
+	/* Apply one change at a time so the heap is valid for each */
+	for (i = 0; i < fix_cnt; i++) {
+		rec = fix[i];
+		rec->fixing = false;
+		if (rec->defunct) {
+			if (rec->heap_inx >= 0)
+				_heap_del(rec);
+			xfree(rec);
+		} else if (rec->heap_inx < 0) {
+			_set_rec_keys(rec);
+			_heap_add(rec);
+		} else {
+			_set_rec_keys(rec);
+			_heap_fix(rec->heap_inx);
+		}
+	}
+	fix_cnt = 0;
+	_maint_time(&tv1);
+}
+
+/* pend_queue_count - return the number of records in the queue */
+extern uint32_t pend_queue_count(void)
+{
+	return (uint32_t) heap_cnt;
+}
+
+/*
+ * pend_queue_maint_time - return the microseconds spent maintaining the
+ *	queue (updates, removals, syncs and restores) since the last call
+ */
+extern uint32_t pend_queue_maint_time(void)
+{
+	uint32_t usec = maint_usec;
+
+	maint_usec = 0;
+	return usec;
+}
+
+/* pend_queue_fini - free all memory, called at slurmctld shutdown */
+extern void pend_queue_fini(void)
+{
+	_clear_queue();
+	walking = false;
+	heap_size = walk_size = fix_size = popped_size = 0;
+	xfree(heap);
+	xfree(walk);
+	xfree(fix);
+	xfree(popped);
+	rebuild = true;
+}
@@ -0,0 +1,111 @@
+/*****************************************************************************\
+ *  pend_queue.h - persistent priority ordered queue of pending jobs
+ *****************************************************************************
+ *  Copyright (C) 2013 SchedMD LLC
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://www.schedmd.com/slurmdocs/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _HAVE_PEND_QUEUE_H
+#define _HAVE_PEND_QUEUE_H
+
+#include "src/slurmctld/job_scheduler.h"
+#include "src/slurmctld/slurmctld.h"
+
+/* Seconds between walks of the job list which verify the queue's contents.
+ * This is only a safety net for job state or priority changes made without
+ * a call to pend_queue_update(). */
+#define PEND_QUEUE_VERIFY_INTERVAL 60
+
+/*
+ * The pending job queue holds one record for each pending job and partition
+ * it could run in, ordered as by sort_job_queue2(). It is kept up to date as
+ * jobs are submitted, changed and purged rather than being rebuilt for each
+ * scheduling pass, so the main scheduler can take the next job to test in
+ * O(log n) time. A pass walks the queue without taking records out of it,
+ * only records of jobs changed during the pass are moved when it ends.
+ * Held jobs (priority zero) are not queued.
+ *
+ * All functions must be called with the job write lock and partition read
+ * lock set.
+ */
+
+/*
+ * pend_queue_update - (re)queue a job after a change to its state, priority,
+ *	partitions or reservation. If the job's records no longer match it
+ *	they are removed and, if it is pending and not held, new records
+ *	added.
+ */
+extern void pend_queue_update(struct job_record *job_ptr);
+
+/* pend_queue_remove - remove a job's records, called as the job is purged */
+extern void pend_queue_remove(struct job_record *job_ptr);
+
+/* pend_queue_rebuild - rebuild the whole queue before its next use, for
+ *	example after job state has been recovered */
+extern void pend_queue_rebuild(void);
+
+/*
+ * pend_queue_sync - prepare the queue for a scheduling pass. The queue is
+ *	rebuilt if so requested or partitions or configuration changed, and
+ *	verified against the job list every PEND_QUEUE_VERIFY_INTERVAL.
+ */
+extern void pend_queue_sync(void);
+
+/*
+ * pend_queue_pop - return the next record of the scheduling pass, in
+ *	priority order. Records of jobs no longer pending are skipped.
+ *	Records are not taken out of the queue; jobs queued during the pass
+ *	are first returned in the next pass.
+ * RET the record or NULL at the end of the queue. The record remains owned
+ *	by the queue and is valid until pend_queue_restore() is called.
+ */
+extern job_queue_rec_t *pend_queue_pop(void);
+
+/*
+ * pend_queue_restore - end a scheduling pass. Records of jobs started or
+ *	otherwise changed during the pass are removed or moved, records of
+ *	jobs queued during the pass are added. Other records are untouched.
+ */
+extern void pend_queue_restore(void);
+
+/* pend_queue_count - return the number of records in the queue */
+extern uint32_t pend_queue_count(void);
+
+/*
+ * pend_queue_maint_time - return the microseconds spent maintaining the
+ *	queue (updates, removals, syncs and restores) since the last call
+ */
+extern uint32_t pend_queue_maint_time(void);
+
+/* pend_queue_fini - free all memory, called at slurmctld shutdown */
+extern void pend_queue_fini(void);
+
+#endif /* !_HAVE_PEND_QUEUE_H */
@@ -83,6 +83,8 @@ static void _preempt_signal(struct job_record *job_ptr, uint32_t grace_time)
 
 	job_ptr->preempt_time = time(NULL);
 	job_ptr->end_time = job_ptr->preempt_time + (time_t)grace_time;
+	job_journal_mark(job_ptr);
+	job_timer_arm(job_ptr);
 }
 /* *********************************************************************** */
 /*  TAG(                    slurm_job_check_grace                       )  */
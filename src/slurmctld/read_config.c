@@ -1573,6 +1573,7 @@ static int _sync_nodes_to_active_job(struct job_record *job_ptr)
 			time_t now = time(NULL);
 			info("Killing job %u on DOWN node %s",
 			     job_ptr->job_id, node_ptr->name);
+			job_journal_mark(job_ptr);
 			job_ptr->job_state = JOB_NODE_FAIL | JOB_COMPLETING;
 			build_cg_bitmap(job_ptr);
 			job_ptr->end_time = MIN(job_ptr->end_time, now);
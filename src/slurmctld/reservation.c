@@ -3704,11 +3704,36 @@ extern time_t find_resv_end(time_t start_time)
 	return end_time;
 }
 
-/* Begin scan of all jobs for valid reservations */
-extern void begin_job_resv_check(void)
+/*
+ * Determine the time of the first recurring reservation to end. Once it
+ * has ended, job_test_resv() and license_job_test() advance its times,
+ * which requires a write lock on nodes.
+ * RET the reservation end time or zero of none found
+ */
+extern time_t find_resv_advance(void)
 {
 	ListIterator iter;
 	slurmctld_resv_t *resv_ptr;
+	time_t end_time = 0;
+
+	if (!resv_list)
+		return end_time;
+
+	iter = list_iterator_create(resv_list);
+	while ((resv_ptr = (slurmctld_resv_t *) list_next(iter))) {
+		if (!(resv_ptr->flags &
+		      (RESERVE_FLAG_DAILY | RESERVE_FLAG_WEEKLY)))
+			continue;
+		if ((end_time == 0) || (resv_ptr->end_time < end_time))
+			end_time = resv_ptr->end_time;
+	}
+	list_iterator_destroy(iter);
+	return end_time;
+}
+
+/* Begin scan of all jobs for valid reservations */
+extern void begin_job_resv_check(void)
+{
 	slurm_ctl_conf_t *conf;
 
 	if (!resv_list)
@@ -3721,13 +3746,6 @@ extern void begin_job_resv_check(void)
 		resv_over_run = ONE_YEAR;
 	else
 		resv_over_run *= 60;
-
-	iter = list_iterator_create(resv_list);
-	while ((resv_ptr = (slurmctld_resv_t *) list_next(iter))) {
-		resv_ptr->job_pend_cnt = 0;
-		resv_ptr->job_run_cnt  = 0;
-	}
-	list_iterator_destroy(iter);
 }
 
 /* Test a particular job for valid reservation
@@ -3737,29 +3755,62 @@ extern void begin_job_resv_check(void)
  */
 extern int job_resv_check(struct job_record *job_ptr)
 {
-	bool run_flag = false;
-
 	if (!job_ptr->resv_name)
 		return SLURM_SUCCESS;
 
-	if (IS_JOB_RUNNING(job_ptr) || IS_JOB_SUSPENDED(job_ptr))
-		run_flag = true;
-	else if (IS_JOB_PENDING(job_ptr))
-		run_flag = false;
-	else
+	if (!IS_JOB_RUNNING(job_ptr) && !IS_JOB_SUSPENDED(job_ptr) &&
+	    !IS_JOB_PENDING(job_ptr))
 		return SLURM_SUCCESS;
 
 	xassert(job_ptr->resv_ptr->magic == RESV_MAGIC);
-	if (run_flag)
-		job_ptr->resv_ptr->job_run_cnt++;
-	else
-		job_ptr->resv_ptr->job_pend_cnt++;
-
 	if ((job_ptr->resv_ptr->end_time + resv_over_run) < time(NULL))
 		return ESLURM_INVALID_TIME_VALUE;
 	return SLURM_SUCCESS;
 }
 
+/* Return the time at which job_resv_check() will first report a job's
+ *	reservation as terminated or zero if the job has no reservation */
+extern time_t job_resv_check_time(struct job_record *job_ptr)
+{
+	time_t over_run;
+
+	if (!job_ptr->resv_name || !job_ptr->resv_ptr)
+		return (time_t) 0;
+
+	if (slurmctld_conf.resv_over_run == (uint16_t) INFINITE)
+		over_run = ONE_YEAR;
+	else
+		over_run = slurmctld_conf.resv_over_run * 60;
+	return job_ptr->resv_ptr->end_time + over_run + 1;
+}
+
+/* Count the pending and running jobs of every reservation */
+static void _count_resv_jobs(void)
+{
+	ListIterator iter;
+	slurmctld_resv_t *resv_ptr;
+	struct job_record *job_ptr;
+
+	iter = list_iterator_create(resv_list);
+	while ((resv_ptr = (slurmctld_resv_t *) list_next(iter))) {
+		resv_ptr->job_pend_cnt = 0;
+		resv_ptr->job_run_cnt  = 0;
+	}
+	list_iterator_destroy(iter);
+
+	iter = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(iter))) {
+		if (!job_ptr->resv_name || !job_ptr->resv_ptr)
+			continue;
+		xassert(job_ptr->resv_ptr->magic == RESV_MAGIC);
+		if (IS_JOB_RUNNING(job_ptr) || IS_JOB_SUSPENDED(job_ptr))
+			job_ptr->resv_ptr->job_run_cnt++;
+		else if (IS_JOB_PENDING(job_ptr))
+			job_ptr->resv_ptr->job_pend_cnt++;
+	}
+	list_iterator_destroy(iter);
+}
+
 /* Advance a expired reservation's time stamps one day or one week
  * as appropriate. */
 static void _advance_resv_time(slurmctld_resv_t *resv_ptr)
@@ -3885,6 +3936,7 @@ extern void fini_job_resv_check(void)
 	ListIterator iter;
 	slurmctld_resv_t *resv_ptr;
 	time_t now = time(NULL);
+	bool counted = false;
 
 	if (!resv_list)
 		return;
@@ -3898,11 +3950,17 @@ extern void fini_job_resv_check(void)
 			continue;
 		}
 		_advance_resv_time(resv_ptr);
-		if ((resv_ptr->job_pend_cnt   == 0) &&
-		    (resv_ptr->job_run_cnt    == 0) &&
-		    (resv_ptr->maint_set_node == 0) &&
-		    ((resv_ptr->flags & RESERVE_FLAG_DAILY ) == 0) &&
-		    ((resv_ptr->flags & RESERVE_FLAG_WEEKLY) == 0)) {
+		if ((resv_ptr->maint_set_node != 0) ||
+		    (resv_ptr->flags & RESERVE_FLAG_DAILY) ||
+		    (resv_ptr->flags & RESERVE_FLAG_WEEKLY))
+			continue;
+		/* Only scan the jobs when a reservation may be purged */
+		if (!counted) {
+			_count_resv_jobs();
+			counted = true;
+		}
+		if ((resv_ptr->job_pend_cnt == 0) &&
+		    (resv_ptr->job_run_cnt  == 0)) {
 			debug("Purging vestigial reservation record %s",
 			      resv_ptr->name);
 			_clear_job_resv(resv_ptr);
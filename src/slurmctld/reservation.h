@@ -150,6 +150,14 @@ extern int job_test_resv(struct job_record *job_ptr, time_t *when,
  */
 extern time_t find_resv_end(time_t start_time);
 
+/*
+ * Determine the time of the first recurring reservation to end. Once it
+ * has ended, job_test_resv() and license_job_test() advance its times,
+ * which requires a write lock on nodes.
+ * RET the reservation end time or zero of none found
+ */
+extern time_t find_resv_advance(void);
+
 /*
  * Determine if a job can start now based only upon its reservations
  *	specification, if any
@@ -173,6 +181,10 @@ extern void begin_job_resv_check(void);
  */
 extern int job_resv_check(struct job_record *job_ptr);
 
+/* Return the time at which job_resv_check() will first report a job's
+ *	reservation as terminated or zero if the job has no reservation */
+extern time_t job_resv_check_time(struct job_record *job_ptr);
+
 /* Finish scan of all jobs for valid reservations
  *
  * Purge vestigial reservation records.
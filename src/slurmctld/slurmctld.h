@@ -79,6 +79,7 @@
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_protocol_defs.h"
 #include "src/common/switch.h"
+#include "src/common/timer_wheel.h"
 #include "src/common/timers.h"
 #include "src/common/xmalloc.h"
 
@@ -185,6 +186,14 @@ typedef struct diag_stats {
 	uint32_t schedule_cycle_counter;
 	uint32_t schedule_cycle_depth;
 	uint32_t schedule_queue_len;
+	uint32_t schedule_queue_maint_last; /* usec maintaining pending job
+					 * queue in last cycle */
+	uint32_t schedule_queue_maint_sum;
+	uint32_t schedule_latency_last;	/* seconds from eligible to start
+					 * of last job started */
+	uint32_t schedule_latency_max;
+	uint32_t schedule_latency_sum;
+	uint32_t schedule_latency_cnt;
 
 	uint32_t jobs_submitted;
 	uint32_t jobs_started;
@@ -206,6 +215,18 @@ typedef struct diag_stats {
 	uint32_t bf_queue_len_sum;
 	time_t   bf_when_last_cycle;
 	uint32_t bf_active;
+	uint32_t bf_last_test_rate;	/* jobs tested per second in last
+					 * backfill cycle */
+
+	uint32_t rpc_queue_len;		/* connections waiting for a worker */
+	uint32_t rpc_queue_max;		/* high water mark of rpc_queue_len */
+	uint32_t rpc_worker_cnt;	/* threads in the RPC worker pool */
+
+	uint32_t time_limit_cycle_counter; /* job_time_limit() passes */
+	uint32_t time_limit_jobs_last;	/* jobs examined in last pass */
+	uint32_t time_limit_jobs_max;
+	uint32_t time_limit_jobs_sum;
+	uint32_t time_limit_jobs_timed;	/* running jobs in the timer wheel */
 } diag_stats_t;
 
 extern diag_stats_t slurmctld_diag_stats;
@@ -525,9 +546,12 @@ struct job_record {
 					 * to be passed to slurmdbd */
 	uint32_t group_id;		/* group submitted under */
 	uint32_t job_id;		/* job ID */
-	struct job_record *job_next;	/* next entry with same hash index */
 	job_resources_t *job_resrcs;	/* details of allocated cores */
 	uint16_t job_state;	        /* state of the job */
+	uint32_t journal_db_index;	/* db_index when last saved */
+	bool journal_dirty;		/* changed since last saved, see
+					 * job_journal_mark() */
+	bool journal_saved;		/* state saved, so journal its purge */
 	uint16_t kill_on_node_fail;	/* 1 if job should be killed on
 					 * node failure */
 	char *licenses;			/* licenses required by the job */
@@ -557,6 +581,8 @@ struct job_record {
 					 * job */
 	bitstr_t *node_bitmap;		/* bitmap of nodes allocated to job */
 	bitstr_t *node_bitmap_cg;	/* bitmap of nodes completing job */
+	bitstr_t *node_map_bitmap;	/* nodes under which the job is
+					 * indexed, see node_job_map.c */
 	uint32_t node_cnt;		/* count of nodes currently
 					 * allocated to job */
 	char *nodes_completing;		/* nodes still in completing state
@@ -608,6 +634,8 @@ struct job_record {
 	uint32_t time_min;		/* minimum time_limit minutes or
 					 * INFINITE,
 					 * zero implies same as time_limit */
+	timer_ent_t time_limit_ent;	/* entry in job_time_limit()'s timer
+					 * wheel, see job_timer_arm() */
 	time_t tot_sus_time;		/* total time in suspend state */
 	uint32_t total_cpus;		/* number of allocated cpus,
 					 * for accounting */
@@ -820,7 +848,9 @@ extern List depended_list_copy(List depend_list_src);
  */
 extern int drain_nodes ( char *nodes, char *reason, uint32_t reason_uid );
 
-/* dump_all_job_state - save the state of all jobs to file
+/* dump_all_job_state - save the state of all jobs to file, either as a
+ *	snapshot of all jobs or by appending the jobs changed since the last
+ *	save to the snapshot's journal
  * RET 0 or error code */
 extern int dump_all_job_state ( void );
 
@@ -1242,11 +1272,29 @@ extern int job_step_signal(uint32_t job_id, uint32_t step_id,
 
 /*
  * job_time_limit - terminate jobs which have exceeded their time limit
+ *	Only running jobs whose timer has expired are examined.
  * global: job_list - pointer global job list
  *	last_job_update - time of last job table update
  */
 extern void job_time_limit (void);
 
+/*
+ * job_timer_arm - set the time at which job_time_limit() next examines a
+ *	job, call after starting or resuming a job or after making any of its
+ *	time limit, warning signal or step time limit deadlines earlier.
+ *	Later deadlines need no call, the job is examined and its timer reset.
+ * IN job_ptr - job to be timed, removed from the timer if not running
+ */
+extern void job_timer_arm(struct job_record *job_ptr);
+
+/*
+ * job_journal_mark - note a change to a job's saved state, the next
+ *	dump_all_job_state() writes the job to the job state journal.
+ *	Call with the job write lock set. A change of db_index needs no call.
+ * IN job_ptr - the changed job
+ */
+extern void job_journal_mark(struct job_record *job_ptr);
+
 /*
  * job_update_cpu_cnt - when job is completing remove allocated cpus
  *                      from count.
@@ -1264,6 +1312,14 @@ extern int job_update_cpu_cnt(struct job_record *job_ptr, int node_inx);
  */
 extern void check_job_step_time_limit (struct job_record *job_ptr, time_t now);
 
+/*
+ * job_step_time_limit_next - return the earliest time at which
+ *	check_job_step_time_limit() will find a step over its time limit
+ * IN job_ptr - pointer to job containing steps to check
+ * RET the time or zero if no running step has a time limit
+ */
+extern time_t job_step_time_limit_next(struct job_record *job_ptr);
+
 /*
  * kill_job_by_part_name - Given a partition name, deallocate resource for
  *	its jobs and kill them
@@ -1457,7 +1513,7 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
  * global: node_record_table_ptr - pointer to global node table
  * NOTE: the caller must xfree the buffer at *buffer_ptr
  * NOTE: change slurm_load_node() in api/node_info.c when data format changes
- * NOTE: READ lock_slurmctld config before entry
+ * NOTE: READ lock_slurmctld config and partition before entry
  */
 extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 			   uint16_t show_flags, uid_t uid,
@@ -1554,23 +1610,20 @@ extern int pack_one_job(char **buffer_ptr, int *buffer_size,
  * global: node_record_table_ptr - pointer to global node table
  * NOTE: the caller must xfree the buffer at *buffer_ptr
  * NOTE: change slurm_load_node() in api/node_info.c when data format changes
- * NOTE: READ lock_slurmctld config before entry
+ * NOTE: READ lock_slurmctld config and partition before entry
  */
 extern void pack_one_node (char **buffer_ptr, int *buffer_size,
 			   uint16_t show_flags, uid_t uid, char *node_name,
 			   uint16_t protocol_version);
 
-/* part_filter_clear - Clear the partition's hidden flag based upon a user's
- * group access. This must follow a call to part_filter_set() */
-extern void part_filter_clear(void);
-
-/* part_filter_set - Set the partition's hidden flag based upon a user's
- * group access. This must be followed by a call to part_filter_clear() */
-extern void part_filter_set(uid_t uid);
-
 /* part_fini - free all memory associated with partition records */
 extern void part_fini (void);
 
+/* part_is_visible - should the partition be visible to the specified user
+ *	based upon its hidden flag and the user's group access.
+ * NOTE: READ lock_slurmctld partition before entry */
+extern bool part_is_visible(struct part_record *part_ptr, uid_t uid);
+
 /*
  * Create a copy of a job's part_list *partition list
  * IN part_list_src - a job's part_list
@@ -1602,6 +1655,15 @@ extern bool partition_in_use(char *part_name);
  */
 void purge_old_job(void);
 
+/*
+ * record_rpc_stats - Record the completion of one RPC for sdiag
+ * IN msg_type - message type of the RPC
+ * IN usec - microseconds from accepting the connection to completion
+ * IN auth_usec - microseconds of that spent creating and verifying
+ *	authentication credentials
+ */
+extern void record_rpc_stats(uint16_t msg_type, long usec, uint64_t auth_usec);
+
 /*
  * rehash_jobs - Create or rebuild the job hash table.
  * NOTE: run lock_slurmctld before entry: Read config, write job
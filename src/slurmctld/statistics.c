@@ -40,18 +40,82 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 
 #include "src/slurmctld/agent.h"
+#include "src/slurmctld/locks.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/common/pack.h"
 #include "src/common/xstring.h"
 #include "src/common/list.h"
 
+/* Number of distinct message types for which RPC statistics are kept */
+#define RPC_TYPE_STATS_MAX	100
+
 extern int retry_list_size(void);
 
 extern time_t last_proc_req_start;
 
+static pthread_mutex_t rpc_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t rpc_type_size = 0;
+static uint16_t rpc_type_id[RPC_TYPE_STATS_MAX];
+static uint32_t rpc_type_cnt[RPC_TYPE_STATS_MAX];
+static uint64_t rpc_type_time[RPC_TYPE_STATS_MAX];
+static uint64_t rpc_type_time_max[RPC_TYPE_STATS_MAX];
+static uint64_t rpc_type_auth_time[RPC_TYPE_STATS_MAX];
+
+/* Record the completion of one RPC for sdiag */
+extern void record_rpc_stats(uint16_t msg_type, long usec, uint64_t auth_usec)
+{
+	uint32_t i;
+
+	if (usec < 0)
+		usec = 0;
+
+	slurm_mutex_lock(&rpc_stats_mutex);
+	for (i = 0; i < rpc_type_size; i++) {
+		if (rpc_type_id[i] == msg_type)
+			break;
+	}
+	if (i == rpc_type_size) {
+		if (rpc_type_size >= RPC_TYPE_STATS_MAX) {
+			slurm_mutex_unlock(&rpc_stats_mutex);
+			return;
+		}
+		rpc_type_id[i] = msg_type;
+		rpc_type_cnt[i] = 0;
+		rpc_type_time[i] = 0;
+		rpc_type_time_max[i] = 0;
+		rpc_type_auth_time[i] = 0;
+		rpc_type_size++;
+	}
+	rpc_type_cnt[i]++;
+	rpc_type_time[i] += usec;
+	if (rpc_type_time_max[i] < usec)
+		rpc_type_time_max[i] = usec;
+	rpc_type_auth_time[i] += auth_usec;
+	slurm_mutex_unlock(&rpc_stats_mutex);
+}
+
+static void _pack_rpc_stats(Buf buffer)
+{
+	slurm_mutex_lock(&rpc_stats_mutex);
+	pack16_array(rpc_type_id, rpc_type_size, buffer);
+	pack32_array(rpc_type_cnt, rpc_type_size, buffer);
+	pack64_array(rpc_type_time, rpc_type_size, buffer);
+	pack64_array(rpc_type_time_max, rpc_type_size, buffer);
+	pack64_array(rpc_type_auth_time, rpc_type_size, buffer);
+	slurm_mutex_unlock(&rpc_stats_mutex);
+}
+
+static void _reset_rpc_stats(void)
+{
+	slurm_mutex_lock(&rpc_stats_mutex);
+	rpc_type_size = 0;
+	slurm_mutex_unlock(&rpc_stats_mutex);
+}
+
 /* Pack all scheduling statistics */
 extern void pack_all_stat(int resp, char **buffer_ptr, int *buffer_size,
 			  uint16_t protocol_version)
@@ -66,7 +130,90 @@ extern void pack_all_stat(int resp, char **buffer_ptr, int *buffer_size,
 	
 	buffer = init_buf(BUF_SIZE);
 	
-	if (protocol_version >= SLURM_2_4_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_2_6_PROTOCOL_VERSION) {
+		parts_packed = resp;
+		pack32(parts_packed, buffer);
+	
+		if (resp) {
+			pack_time(now, buffer);
+			debug("pack_all_stat: time = %u",
+			      (uint32_t) last_proc_req_start);
+			pack_time(last_proc_req_start, buffer);
+			
+			debug("pack_all_stat: server_thread_count = %u",
+			      slurmctld_config.server_thread_count);
+			pack32(slurmctld_config.server_thread_count, buffer);
+			
+			agent_queue_size = retry_list_size();
+			pack32(agent_queue_size, buffer);
+			
+			pack32(slurmctld_diag_stats.jobs_submitted, buffer);
+			pack32(slurmctld_diag_stats.jobs_started, buffer);
+			pack32(slurmctld_diag_stats.jobs_completed, buffer);
+			pack32(slurmctld_diag_stats.jobs_canceled, buffer);
+			pack32(slurmctld_diag_stats.jobs_failed, buffer);
+
+			pack32(slurmctld_diag_stats.schedule_cycle_max,
+			       buffer);
+			pack32(slurmctld_diag_stats.schedule_cycle_last,
+			       buffer);
+			pack32(slurmctld_diag_stats.schedule_cycle_sum,
+			       buffer);
+			pack32(slurmctld_diag_stats.schedule_cycle_counter,
+			       buffer);
+			pack32(slurmctld_diag_stats.schedule_cycle_depth,
+			       buffer);
+			pack32(slurmctld_diag_stats.schedule_queue_len, buffer);
+			pack32(slurmctld_diag_stats.schedule_queue_maint_last,
+			       buffer);
+			pack32(slurmctld_diag_stats.schedule_queue_maint_sum,
+			       buffer);
+			pack32(slurmctld_diag_stats.schedule_latency_last,
+			       buffer);
+			pack32(slurmctld_diag_stats.schedule_latency_max,
+			       buffer);
+			pack32(slurmctld_diag_stats.schedule_latency_sum,
+			       buffer);
+			pack32(slurmctld_diag_stats.schedule_latency_cnt,
+			       buffer);
+		
+			pack32(slurmctld_diag_stats.backfilled_jobs, buffer);
+			pack32(slurmctld_diag_stats.last_backfilled_jobs,
+			       buffer);
+			pack32(slurmctld_diag_stats.bf_cycle_counter, buffer);
+			pack32(slurmctld_diag_stats.bf_cycle_sum, buffer);
+			pack32(slurmctld_diag_stats.bf_cycle_last, buffer);
+			pack32(slurmctld_diag_stats.bf_last_depth, buffer);
+			pack32(slurmctld_diag_stats.bf_last_depth_try, buffer);
+
+			pack32(slurmctld_diag_stats.bf_queue_len, buffer);
+			pack32(slurmctld_diag_stats.bf_cycle_max, buffer);
+			pack_time(slurmctld_diag_stats.bf_when_last_cycle,
+				  buffer);
+			pack32(slurmctld_diag_stats.bf_depth_sum, buffer);
+			pack32(slurmctld_diag_stats.bf_depth_try_sum, buffer);
+			pack32(slurmctld_diag_stats.bf_queue_len_sum, buffer);
+			pack32(slurmctld_diag_stats.bf_active,	 buffer);
+			pack32(slurmctld_diag_stats.bf_last_test_rate, buffer);
+
+			pack32(slurmctld_diag_stats.rpc_queue_len, buffer);
+			pack32(slurmctld_diag_stats.rpc_queue_max, buffer);
+			pack32(slurmctld_diag_stats.rpc_worker_cnt, buffer);
+
+			pack32(slurmctld_diag_stats.time_limit_cycle_counter,
+			       buffer);
+			pack32(slurmctld_diag_stats.time_limit_jobs_last,
+			       buffer);
+			pack32(slurmctld_diag_stats.time_limit_jobs_max,
+			       buffer);
+			pack32(slurmctld_diag_stats.time_limit_jobs_sum,
+			       buffer);
+			pack32(slurmctld_diag_stats.time_limit_jobs_timed,
+			       buffer);
+			_pack_rpc_stats(buffer);
+			pack_lock_stats(buffer);
+		}
+	} else if (protocol_version >= SLURM_2_4_PROTOCOL_VERSION) {
 		parts_packed = resp;
 		pack32(parts_packed, buffer);
 	
@@ -135,6 +282,10 @@ extern void reset_stats(int level)
 	slurmctld_diag_stats.schedule_cycle_sum = 0;
 	slurmctld_diag_stats.schedule_cycle_counter = 0;
 	slurmctld_diag_stats.schedule_cycle_depth = 0;
+	slurmctld_diag_stats.schedule_queue_maint_sum = 0;
+	slurmctld_diag_stats.schedule_latency_max = 0;
+	slurmctld_diag_stats.schedule_latency_sum = 0;
+	slurmctld_diag_stats.schedule_latency_cnt = 0;
 	slurmctld_diag_stats.jobs_submitted = 0;
 	slurmctld_diag_stats.jobs_started = 0;
 	slurmctld_diag_stats.jobs_completed = 0;
@@ -157,4 +308,14 @@ extern void reset_stats(int level)
 	slurmctld_diag_stats.bf_last_depth = 0;
 	slurmctld_diag_stats.bf_last_depth_try = 0;
 	slurmctld_diag_stats.bf_active = 0;
+	slurmctld_diag_stats.bf_last_test_rate = 0;
+
+	slurmctld_diag_stats.rpc_queue_max =
+		slurmctld_diag_stats.rpc_queue_len;
+
+	slurmctld_diag_stats.time_limit_cycle_counter = 0;
+	slurmctld_diag_stats.time_limit_jobs_max = 0;
+	slurmctld_diag_stats.time_limit_jobs_sum = 0;
+	_reset_rpc_stats();
+	reset_lock_stats();
 }
@@ -173,6 +173,7 @@ static struct step_record * _create_step_record(struct job_record *job_ptr)
 
 	step_ptr = (struct step_record *) xmalloc(sizeof(struct step_record));
 
+	job_journal_mark(job_ptr);
 	last_job_update = time(NULL);
 	step_ptr->job_ptr    = job_ptr;
 	step_ptr->exit_code  = NO_VAL;
@@ -218,6 +219,7 @@ extern void delete_step_records (struct job_record *job_ptr)
 	xassert(job_ptr);
 	step_iterator = list_iterator_create (job_ptr->step_list);
 
+	job_journal_mark(job_ptr);
 	last_job_update = time(NULL);
 	while ((step_ptr = (struct step_record *) list_next (step_iterator))) {
 		list_remove (step_iterator);
@@ -280,6 +282,7 @@ delete_step_record (struct job_record *job_ptr, uint32_t step_id)
 		return error_code;
 
 	step_iterator = list_iterator_create (job_ptr->step_list);
+	job_journal_mark(job_ptr);
 	last_job_update = time(NULL);
 	while ((step_ptr = (struct step_record *) list_next (step_iterator))) {
 		if (step_ptr->step_id == step_id) {
@@ -599,6 +602,7 @@ int job_step_complete(uint32_t job_id, uint32_t step_id, uid_t uid,
 	gres_plugin_step_dealloc(step_ptr->gres_list, job_ptr->gres_list,
 				 job_id, step_id);
 
+	job_journal_mark(job_ptr);
 	last_job_update = time(NULL);
 	error_code = delete_step_record(job_ptr, step_id);
 	if (error_code == ENOENT) {
@@ -819,6 +823,7 @@ _pick_step_nodes (struct job_record  *job_ptr,
 			}
 		}
 		job_ptr->job_state &= (~JOB_CONFIGURING);
+		job_journal_mark(job_ptr);
 		debug("Configuration for job %u complete", job_ptr->job_id);
 	}
 
@@ -2079,6 +2084,7 @@ step_create(job_step_create_request_msg_t *step_specs,
 			return ESLURM_INVALID_TIME_LIMIT;
 		}
 		step_ptr->time_limit = step_specs->time_limit;
+		job_timer_arm(job_ptr);
 	}
 
 	/* a batch script does not need switch info */
@@ -2452,8 +2458,6 @@ extern int pack_ctld_job_step_info_response_msg(
 	pack_time(now, buffer);
 	pack32(steps_packed, buffer);	/* steps_packed placeholder */
 
-	part_filter_set(uid);
-
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = list_next(job_iterator))) {
 		if ((job_id != NO_VAL) && (job_id != job_ptr->job_id) &&
@@ -2462,7 +2466,7 @@ extern int pack_ctld_job_step_info_response_msg(
 
 		if (((show_flags & SHOW_ALL) == 0) &&
 		    (job_ptr->part_ptr) &&
-		    (job_ptr->part_ptr->flags & PART_FLAG_HIDDEN))
+		    !part_is_visible(job_ptr->part_ptr, uid))
 			continue;
 
 		if ((slurmctld_conf.private_data & PRIVATE_DATA_JOBS) &&
@@ -2489,8 +2493,6 @@ extern int pack_ctld_job_step_info_response_msg(
 	if (list_count(job_list) && !valid_job && !steps_packed)
 		error_code = ESLURM_INVALID_JOB_ID;
 
-	part_filter_clear();
-
 	/* put the real record count in the message body header */
 	tmp_offset = get_buf_offset(buffer);
 	set_buf_offset(buffer, 0);
@@ -2601,6 +2603,7 @@ extern int job_step_checkpoint(checkpoint_msg_t *ckpt_ptr,
 				   ckpt_ptr->image_dir, &resp_data.event_time,
 				   &resp_data.error_code,
 				   &resp_data.error_msg);
+		job_journal_mark(job_ptr);
 		last_job_update = time(NULL);
 	}
 
@@ -2667,6 +2670,7 @@ extern int job_step_checkpoint_comp(checkpoint_comp_msg_t *ckpt_ptr,
 	} else {
 		rc = checkpoint_comp((void *)step_ptr, ckpt_ptr->begin_time,
 			ckpt_ptr->error_code, ckpt_ptr->error_msg);
+		job_journal_mark(job_ptr);
 		last_job_update = time(NULL);
 	}
 
@@ -2726,6 +2730,7 @@ extern int job_step_checkpoint_task_comp(checkpoint_task_comp_msg_t *ckpt_ptr,
 		rc = checkpoint_task_comp((void *)step_ptr,
 			ckpt_ptr->task_id, ckpt_ptr->begin_time,
 			ckpt_ptr->error_code, ckpt_ptr->error_msg);
+		job_journal_mark(job_ptr);
 		last_job_update = time(NULL);
 	}
 
@@ -3402,6 +3407,7 @@ extern void step_checkpoint(void)
 			job_checkpoint(&ckpt_req, getuid(), -1,
 				       (uint16_t)NO_VAL);
 			job_ptr->ckpt_time = now;
+			job_journal_mark(job_ptr);
 			last_job_update = now;
 			continue; /* ignore periodic step ckpt */
 		}
@@ -3428,6 +3434,7 @@ extern void step_checkpoint(void)
 				continue;
 
 			step_ptr->ckpt_time = now;
+			job_journal_mark(job_ptr);
 			last_job_update = now;
 			image_dir = xstrdup(step_ptr->ckpt_dir);
 			xstrfmtcat(image_dir, "/%u.%u", job_ptr->job_id,
@@ -3552,6 +3559,33 @@ check_job_step_time_limit (struct job_record *job_ptr, time_t now)
 	list_iterator_destroy (step_iterator);
 }
 
+extern time_t job_step_time_limit_next(struct job_record *job_ptr)
+{
+	ListIterator step_iterator;
+	struct step_record *step_ptr;
+	time_t when, next = (time_t) 0;
+
+	xassert(job_ptr);
+
+	if ((job_ptr->job_state != JOB_RUNNING) || !job_ptr->step_list)
+		return next;
+
+	step_iterator = list_iterator_create (job_ptr->step_list);
+	while ((step_ptr = (struct step_record *) list_next (step_iterator))) {
+		if (step_ptr->state != JOB_RUNNING)
+			continue;
+		if (step_ptr->time_limit == INFINITE ||
+		    step_ptr->time_limit == NO_VAL)
+			continue;
+		when = step_ptr->start_time + step_ptr->tot_sus_time +
+		       ((time_t) step_ptr->time_limit * 60);
+		if ((next == 0) || (when < next))
+			next = when;
+	}
+	list_iterator_destroy (step_iterator);
+	return next;
+}
+
 /* Return true if memory is a reserved resources, false otherwise */
 static bool _is_mem_resv(void)
 {
@@ -3615,8 +3649,11 @@ extern int update_step(step_update_request_msg_t *req, uid_t uid)
 		} else
 			return ESLURM_INVALID_JOB_ID;
 	}
-	if (mod_cnt)
+	if (mod_cnt) {
+		job_journal_mark(job_ptr);
 		last_job_update = time(NULL);
+		job_timer_arm(job_ptr);
+	}
 
 	return SLURM_SUCCESS;
 }
@@ -50,12 +50,16 @@
 #include <stdlib.h>
 #include <sys/param.h>		/* MAXPATHLEN */
 #include <sys/poll.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/un.h>
 #include <utime.h>
 #include <grp.h>
+#ifdef HAVE_ZLIB_H
+#  include <zlib.h>
+#endif
 
 #include "src/common/cpu_frequency.h"
 #include "src/common/env.h"
@@ -187,7 +191,7 @@ static int  _waiter_complete (uint32_t jobid);
 
 static bool _steps_completed_now(uint32_t jobid);
 static int  _valid_sbcast_cred(file_bcast_msg_t *req, uid_t req_uid,
-			       uint16_t block_no);
+			       uint16_t block_no, uint32_t *job_id);
 static void _wait_state_completed(uint32_t jobid, int max_delay);
 static long _get_job_uid(uint32_t jobid);
 
@@ -230,6 +234,25 @@ static pthread_mutex_t suspend_mutex = PTHREAD_MUTEX_INITIALIZER;
 static uint32_t job_suspend_array[NUM_PARALLEL_SUSPEND];
 static int job_suspend_size = 0;
 
+/* Files being written by sbcast are held open between blocks, so that
+ * blocks other than the first and last are written without forking a
+ * process as the user. A file is known by its job and name. Files left
+ * idle for FILE_BCAST_TIMEOUT seconds, as by an sbcast which was killed,
+ * are closed by a timer thread, which runs while any file is open. */
+#define FILE_BCAST_TIMEOUT 300
+typedef struct file_bcast_info {
+	uint32_t job_id;	/* job of the sbcast credential */
+	char *fname;		/* destination file */
+	uid_t uid;		/* user who opened it */
+	int fd;			/* open for writing by that user */
+	int use_cnt;		/* count of RPCs writing to fd */
+	time_t last_update;	/* time of last use */
+} file_bcast_info_t;
+static pthread_mutex_t file_bcast_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  file_bcast_cond  = PTHREAD_COND_INITIALIZER;
+static List file_bcast_list = NULL;
+static bool file_bcast_timer = false;	/* timer thread running */
+
 void
 slurmd_req(slurm_msg_t *msg)
 {
@@ -249,6 +272,13 @@ slurmd_req(slurm_msg_t *msg)
 			job_limits_loaded = false;
 		}
 		slurm_mutex_unlock(&job_limits_mutex);
+		slurm_mutex_lock(&file_bcast_mutex);
+		if (file_bcast_list) {
+			list_destroy(file_bcast_list);
+			file_bcast_list = NULL;
+			pthread_cond_broadcast(&file_bcast_cond);
+		}
+		slurm_mutex_unlock(&file_bcast_mutex);
 		return;
 	}
 
@@ -2621,17 +2651,18 @@ _get_grouplist(uid_t my_uid, gid_t my_gid, int *ngroups, gid_t **groups)
 /* Validate sbcast credential.
  * NOTE: We can only perform the full credential validation once with
  * Munge without generating a credential replay error
+ * OUT job_id - the credential's job
  * RET SLURM_SUCCESS or an error code */
 static int
-_valid_sbcast_cred(file_bcast_msg_t *req, uid_t req_uid, uint16_t block_no)
+_valid_sbcast_cred(file_bcast_msg_t *req, uid_t req_uid, uint16_t block_no,
+		   uint32_t *job_id)
 {
 	int rc = SLURM_SUCCESS;
-	uint32_t job_id;
 	char *nodes = NULL;
 	hostset_t hset = NULL;
 
 	rc = extract_sbcast_cred(conf->vctx, req->cred, block_no,
-				 &job_id, &nodes);
+				 job_id, &nodes);
 	if (rc != 0) {
 		error("Security violation: Invalid sbcast_cred from uid %d",
 		      req_uid);
@@ -2655,16 +2686,302 @@ _valid_sbcast_cred(file_bcast_msg_t *req, uid_t req_uid, uint16_t block_no)
 	return rc;
 }
 
+static void _file_bcast_info_free(void *x)
+{
+	file_bcast_info_t *file_info = (file_bcast_info_t *) x;
+
+	if (file_info->fd >= 0)
+		close(file_info->fd);
+	xfree(file_info->fname);
+	xfree(file_info);
+}
+
+static int _file_bcast_match(void *x, void *key)
+{
+	file_bcast_info_t *file_info = (file_bcast_info_t *) x;
+	file_bcast_info_t *match = (file_bcast_info_t *) key;
+
+	return ((file_info->job_id == match->job_id) &&
+		!strcmp(file_info->fname, match->fname));
+}
+
+/* Close files left idle for FILE_BCAST_TIMEOUT seconds. The thread exits
+ * once no file is held open. */
+static void *_file_bcast_timer(void *x)
+{
+	file_bcast_info_t *file_info;
+	ListIterator iter;
+	struct timespec abs_time;
+	time_t now, idle_end, next_time;
+
+	slurm_mutex_lock(&file_bcast_mutex);
+	while (file_bcast_list && list_count(file_bcast_list)) {
+		now = time(NULL);
+		next_time = now + FILE_BCAST_TIMEOUT;
+		iter = list_iterator_create(file_bcast_list);
+		while ((file_info = list_next(iter))) {
+			if (file_info->use_cnt)
+				continue;
+			idle_end = file_info->last_update + FILE_BCAST_TIMEOUT;
+			if (idle_end <= now) {
+				debug("sbcast: closing idle file %s of job %u",
+				      file_info->fname, file_info->job_id);
+				list_delete_item(iter);
+			} else if (idle_end < next_time)
+				next_time = idle_end;
+		}
+		list_iterator_destroy(iter);
+		if (!list_count(file_bcast_list))
+			break;
+		abs_time.tv_sec  = next_time;
+		abs_time.tv_nsec = 0;
+		pthread_cond_timedwait(&file_bcast_cond, &file_bcast_mutex,
+				       &abs_time);
+	}
+	file_bcast_timer = false;
+	slurm_mutex_unlock(&file_bcast_mutex);
+	return NULL;
+}
+
+/* Start the timer thread unless it is running,
+ * call with file_bcast_mutex locked */
+static void _file_bcast_timer_start(void)
+{
+	pthread_attr_t attr;
+	pthread_t id;
+
+	if (file_bcast_timer)
+		return;
+	slurm_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (pthread_create(&id, &attr, &_file_bcast_timer, NULL))
+		error("sbcast: pthread_create: %m");
+	else
+		file_bcast_timer = true;
+	slurm_attr_destroy(&attr);
+}
+
+/* Find the open file being written by sbcast for a job.
+ * Release it with _file_bcast_release().
+ * RET file's record or NULL if not open by this user */
+static file_bcast_info_t *_file_bcast_find(uint32_t job_id, uid_t uid,
+					   char *fname)
+{
+	file_bcast_info_t *file_info = NULL, key;
+
+	key.job_id = job_id;
+	key.fname = fname;
+	slurm_mutex_lock(&file_bcast_mutex);
+	if (file_bcast_list)
+		file_info = list_find_first(file_bcast_list,
+					    _file_bcast_match, &key);
+	if (file_info && (file_info->uid != uid))
+		file_info = NULL;
+	if (file_info) {
+		file_info->use_cnt++;
+		file_info->last_update = time(NULL);
+	}
+	slurm_mutex_unlock(&file_bcast_mutex);
+
+	return file_info;
+}
+
+static void _file_bcast_release(file_bcast_info_t *file_info)
+{
+	slurm_mutex_lock(&file_bcast_mutex);
+	file_info->use_cnt--;
+	file_info->last_update = time(NULL);
+	slurm_mutex_unlock(&file_bcast_mutex);
+}
+
+/* Hold open a file being written by a user with sbcast for a job,
+ * replacing any earlier record of it unless that is in use. Consumes fd. */
+static void _file_bcast_add(uint32_t job_id, uid_t uid, char *fname, int fd)
+{
+	file_bcast_info_t *file_info, key;
+
+	fd_set_close_on_exec(fd);
+
+	key.job_id = job_id;
+	key.fname = fname;
+	slurm_mutex_lock(&file_bcast_mutex);
+	if (!file_bcast_list)
+		file_bcast_list = list_create(_file_bcast_info_free);
+	file_info = list_find_first(file_bcast_list, _file_bcast_match, &key);
+
+	if (file_info && file_info->use_cnt) {
+		close(fd);
+	} else if (file_info) {
+		close(file_info->fd);
+		file_info->uid = uid;
+		file_info->fd = fd;
+		file_info->last_update = time(NULL);
+	} else {
+		file_info = xmalloc(sizeof(file_bcast_info_t));
+		file_info->job_id = job_id;
+		file_info->fname = xstrdup(fname);
+		file_info->uid = uid;
+		file_info->fd = fd;
+		file_info->last_update = time(NULL);
+		list_append(file_bcast_list, file_info);
+		_file_bcast_timer_start();
+	}
+	slurm_mutex_unlock(&file_bcast_mutex);
+}
+
+/* Close a file once its last block has been written */
+static void _file_bcast_close(uint32_t job_id, char *fname)
+{
+	file_bcast_info_t *file_info, key;
+
+	key.job_id = job_id;
+	key.fname = fname;
+	slurm_mutex_lock(&file_bcast_mutex);
+	if (file_bcast_list &&
+	    (file_info = list_find_first(file_bcast_list, _file_bcast_match,
+					 &key)) &&
+	    (file_info->use_cnt == 0))
+		list_delete_all(file_bcast_list, _file_bcast_match, &key);
+	slurm_mutex_unlock(&file_bcast_mutex);
+}
+
+/* Pass an open file descriptor over a unix socket */
+static int _file_bcast_send_fd(int sock, int fd)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char ctl[CMSG_SPACE(sizeof(int))];
+	char c = 0;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(ctl, 0, sizeof(ctl));
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctl;
+	msg.msg_controllen = sizeof(ctl);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	if (sendmsg(sock, &msg, 0) != 1)
+		return -1;
+	return 0;
+}
+
+/* Receive a file descriptor sent by _file_bcast_send_fd()
+ * RET file descriptor or -1 if none was sent */
+static int _file_bcast_recv_fd(int sock)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char ctl[CMSG_SPACE(sizeof(int))];
+	char c;
+	int fd = -1;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctl;
+	msg.msg_controllen = sizeof(ctl);
+
+	if (recvmsg(sock, &msg, MSG_DONTWAIT) != 1)
+		return -1;
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg && (cmsg->cmsg_level == SOL_SOCKET) &&
+	    (cmsg->cmsg_type == SCM_RIGHTS))
+		memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	return fd;
+}
+
+/* Replace a compressed block's data with its uncompressed form */
+static int _file_bcast_uncompress(file_bcast_msg_t *req)
+{
+#ifdef HAVE_ZLIB_H
+	uLongf len;
+	char *block;
+
+	if (req->compress == FILE_BCAST_COMPRESS_NONE)
+		return SLURM_SUCCESS;
+	if ((req->compress != FILE_BCAST_COMPRESS_ZLIB) ||
+	    (req->uncomp_len > FILE_BCAST_MAX_UNCOMP_LEN)) {
+		error("sbcast: invalid compressed block for `%s`",
+		      req->fname);
+		return ESLURM_NOT_SUPPORTED;
+	}
+
+	len = req->uncomp_len;
+	block = xmalloc(len);
+	if ((uncompress((Bytef *) block, &len, (Bytef *) req->block,
+			req->block_len) != Z_OK) ||
+	    (len != req->uncomp_len)) {
+		error("sbcast: can't uncompress block %u of `%s`",
+		      req->block_no, req->fname);
+		xfree(block);
+		return SLURM_ERROR;
+	}
+	xfree(req->block);
+	req->block = block;
+	req->block_len = len;
+	req->compress = FILE_BCAST_COMPRESS_NONE;
+	return SLURM_SUCCESS;
+#else
+	if (req->compress == FILE_BCAST_COMPRESS_NONE)
+		return SLURM_SUCCESS;
+	error("sbcast: compression not supported, `%s` not written",
+	      req->fname);
+	return ESLURM_NOT_SUPPORTED;
+#endif
+}
+
+/* Write a block's data at its offset into the file */
+static int _file_bcast_write(int fd, file_bcast_msg_t *req, uid_t req_uid)
+{
+	uint32_t offset = 0;
+	ssize_t inx;
+
+	while (req->block_len - offset) {
+		if (req->block_offset == FILE_BCAST_APPEND) {
+			inx = write(fd, &req->block[offset],
+				    (req->block_len - offset));
+		} else {
+			inx = pwrite(fd, &req->block[offset],
+				     (req->block_len - offset),
+				     (off_t) (req->block_offset + offset));
+		}
+		if (inx == -1) {
+			if ((errno == EINTR) || (errno == EAGAIN))
+				continue;
+			error("sbcast: uid:%u can't write `%s`: %s",
+			      req_uid, req->fname, strerror(errno));
+			return errno;
+		}
+		offset += inx;
+	}
+	return SLURM_SUCCESS;
+}
+
 static int
 _rpc_file_bcast(slurm_msg_t *msg)
 {
 	file_bcast_msg_t *req = msg->data;
-	int fd, flags, offset, inx, rc;
+	file_bcast_info_t *file_info;
+	int fd, flags, rc;
 	int ngroups = 16;
+	int sock[2] = { -1, -1 };
 	gid_t *groups;
 	uid_t req_uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
 	gid_t req_gid = g_slurm_auth_get_gid(msg->auth_cred, NULL);
 	pid_t child;
+	uint32_t job_id;
+	bool keep_open;
 
 #if 0
 	info("last_block=%u force=%u modes=%o",
@@ -2680,27 +2997,68 @@ _rpc_file_bcast(slurm_msg_t *msg)
 #endif
 
 	if (!_slurm_authorized_user(req_uid)) {
-		rc = _valid_sbcast_cred(req, req_uid, req->block_no);
+		rc = _valid_sbcast_cred(req, req_uid, req->block_no, &job_id);
 		if (rc != SLURM_SUCCESS)
 			return rc;
+	} else
+		job_id = get_sbcast_cred_jobid(req->cred);
+
+	if ((req->block_no == 1) || req->last_block) {
+		info("sbcast req_uid=%u fname=%s block_no=%u",
+		     req_uid, req->fname, req->block_no);
+	} else {
+		debug("sbcast req_uid=%u fname=%s block_no=%u",
+		      req_uid, req->fname, req->block_no);
 	}
 
-	info("sbcast req_uid=%u fname=%s block_no=%u",
-	     req_uid, req->fname, req->block_no);
+	if ((rc = _file_bcast_uncompress(req)) != SLURM_SUCCESS)
+		return rc;
+
+	/* Blocks written at an offset into a file which is already open
+	 * need no process running as the user */
+	keep_open = ((req->block_offset != FILE_BCAST_APPEND) &&
+		     !req->last_block);
+	if (keep_open && (req->block_no > 1) &&
+	    (file_info = _file_bcast_find(job_id, req_uid, req->fname))) {
+		rc = _file_bcast_write(file_info->fd, req, req_uid);
+		_file_bcast_release(file_info);
+		return rc;
+	}
 
 	if ((rc = _get_grouplist(req_uid, req_gid, &ngroups, &groups)) < 0) {
 		error("sbcast: getgrouplist(%u): %m", req_uid);
 		return rc;
 	}
 
+	if (keep_open && (socketpair(AF_UNIX, SOCK_STREAM, 0, sock) < 0)) {
+		error("sbcast: socketpair: %m");
+		keep_open = false;
+	}
+
 	child = fork();
 	if (child == -1) {
 		error("sbcast: fork failure");
-		return errno;
+		rc = errno;
+		if (keep_open) {
+			close(sock[0]);
+			close(sock[1]);
+		}
+		xfree(groups);
+		return rc;
 	} else if (child > 0) {
 		waitpid(child, &rc, 0);
 		xfree(groups);
-		return WEXITSTATUS(rc);
+		rc = WEXITSTATUS(rc);
+		if (keep_open) {
+			close(sock[1]);
+			if ((rc == SLURM_SUCCESS) &&
+			    ((fd = _file_bcast_recv_fd(sock[0])) >= 0))
+				_file_bcast_add(job_id, req_uid, req->fname,
+						fd);
+			close(sock[0]);
+		} else if (req->last_block)
+			_file_bcast_close(job_id, req->fname);
+		return rc;
 	}
 
 	/* The child actually performs the I/O and exits with
@@ -2739,7 +3097,7 @@ _rpc_file_bcast(slurm_msg_t *msg)
 			flags |= O_TRUNC;
 		else
 			flags |= O_EXCL;
-	} else
+	} else if (req->block_offset == FILE_BCAST_APPEND)
 		flags |= O_APPEND;
 
 	fd = open(req->fname, flags, 0700);
@@ -2749,19 +3107,9 @@ _rpc_file_bcast(slurm_msg_t *msg)
 		exit(errno);
 	}
 
-	offset = 0;
-	while (req->block_len - offset) {
-		inx = write(fd, &req->block[offset],
-			    (req->block_len - offset));
-		if (inx == -1) {
-			if ((errno == EINTR) || (errno == EAGAIN))
-				continue;
-			error("sbcast: uid:%u can't write `%s`: %s",
-			      req_uid, req->fname, strerror(errno));
-			close(fd);
-			exit(errno);
-		}
-		offset += inx;
+	if ((rc = _file_bcast_write(fd, req, req_uid)) != SLURM_SUCCESS) {
+		close(fd);
+		exit(rc);
 	}
 	if (req->last_block && fchmod(fd, (req->modes & 0777))) {
 		error("sbcast: uid:%u can't chmod `%s`: %s",
@@ -2771,6 +3119,11 @@ _rpc_file_bcast(slurm_msg_t *msg)
 		error("sbcast: uid:%u can't chown `%s`: %s",
 		      req_uid, req->fname, strerror(errno));
 	}
+	/* hand the open file to slurmd for the following blocks */
+	if (keep_open && _file_bcast_send_fd(sock[1], fd)) {
+		debug("sbcast: uid:%u can't pass `%s` to slurmd: %s",
+		      req_uid, req->fname, strerror(errno));
+	}
 	close(fd);
 	fd = 0;
 	if (req->last_block && req->atime) {
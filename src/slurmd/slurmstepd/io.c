@@ -68,6 +68,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
@@ -95,6 +96,9 @@
 /**********************************************************************
  * IO client socket declarations
  **********************************************************************/
+#define CLIENT_WRITE_MAX_IOV	64
+#define CLIENT_WRITE_MAX_BYTES	(64 * 1024)
+
 static bool _client_readable(eio_obj_t *);
 static bool _client_writable(eio_obj_t *);
 static int  _client_read(eio_obj_t *, List);
@@ -441,14 +445,22 @@ _client_read(eio_obj_t *obj, List objs)
 }
 
 /*
- * Write outgoing packed messages to the client socket.
+ * Write outgoing packed messages to the client socket.  The message in
+ * progress and those queued behind it, typically the output of several
+ * tasks, are sent with a single writev() of at most CLIENT_WRITE_MAX_IOV
+ * messages and CLIENT_WRITE_MAX_BYTES bytes.  Nothing is held back to
+ * fill a batch: a batch is whatever has queued since the socket was last
+ * writable, so a lone message goes out as soon as it is built.
  */
 static int
 _client_write(eio_obj_t *obj, List objs)
 {
 	struct client_io_info *client = (struct client_io_info *) obj->arg;
-	void *buf;
-	int n;
+	struct iovec iov[CLIENT_WRITE_MAX_IOV];
+	struct io_buf *msg;
+	ListIterator msgs;
+	int iovcnt, bytes;
+	ssize_t n;
 
 	xassert(client->magic == CLIENT_IO_MAGIC);
 
@@ -471,13 +483,29 @@ _client_write(eio_obj_t *obj, List objs)
 
 	debug5("  client->out_remaining = %d", client->out_remaining);
 
+	iov[0].iov_base = client->out_msg->data +
+		(client->out_msg->length - client->out_remaining);
+	iov[0].iov_len = client->out_remaining;
+	iovcnt = 1;
+	bytes = client->out_remaining;
+	if (!list_is_empty(client->msg_queue)) {
+		msgs = list_iterator_create(client->msg_queue);
+		while ((iovcnt < CLIENT_WRITE_MAX_IOV) &&
+		       (bytes < CLIENT_WRITE_MAX_BYTES) &&
+		       (msg = list_next(msgs))) {
+			iov[iovcnt].iov_base = msg->data;
+			iov[iovcnt].iov_len = msg->length;
+			bytes += msg->length;
+			iovcnt++;
+		}
+		list_iterator_destroy(msgs);
+	}
+
 	/*
-	 * Write message to socket.
+	 * Write messages to socket.
 	 */
-	buf = client->out_msg->data +
-		(client->out_msg->length - client->out_remaining);
 again:
-	if ((n = write(obj->fd, buf, client->out_remaining)) < 0) {
+	if ((n = writev(obj->fd, iov, iovcnt)) < 0) {
 		if (errno == EINTR) {
 			goto again;
 		} else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
@@ -489,17 +517,24 @@ again:
 			return SLURM_SUCCESS;
 		}
 	}
-	if (n < client->out_remaining) {
-		error("Only wrote %d of %d bytes to socket", 
-		      n, client->out_remaining);
-	} else
-		debug5("Wrote %d bytes to socket", n);
-	client->out_remaining -= n;
-	if (client->out_remaining > 0)
-		return SLURM_SUCCESS;
+	debug5("Wrote %zd of %d bytes in %d messages to socket",
+	       n, bytes, iovcnt);
 
-	_free_outgoing_msg(client->out_msg, client->job);
-	client->out_msg = NULL;
+	/*
+	 * Free the messages written in full, leaving any partly written
+	 * one in client->out_msg.  Freeing a message may build new ones,
+	 * but those are appended to the queue behind the ones sent here.
+	 */
+	while (n >= client->out_remaining) {
+		n -= client->out_remaining;
+		_free_outgoing_msg(client->out_msg, client->job);
+		client->out_msg = NULL;
+		if (n == 0)
+			return SLURM_SUCCESS;
+		client->out_msg = list_dequeue(client->msg_queue);
+		client->out_remaining = client->out_msg->length;
+	}
+	client->out_remaining -= n;
 
 	return SLURM_SUCCESS;
 }
@@ -1746,6 +1746,9 @@ end_it:
 	slurmdbd_free_init_msg(init_msg);
 	*out_buffer = make_dbd_rc_msg(slurmdbd_conn->rpc_version,
 				      rc, comment, DBD_INIT);
+	/* Older clients ignore this, newer ones only ask for jobs a page
+	 * at a time when it is there */
+	pack16((uint16_t) SLURMDBD_VERSION, *out_buffer);
 
 	return rc;
 }
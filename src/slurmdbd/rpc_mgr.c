@@ -52,6 +52,7 @@
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_accounting_storage.h"
 #include "src/common/slurmdbd_defs.h"
+#include "src/common/timers.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xsignal.h"
 #include "src/slurmdbd/proc_req.h"
@@ -59,7 +60,15 @@
 #include "src/slurmdbd/rpc_mgr.h"
 #include "src/slurmdbd/slurmdbd.h"
 
-#define MAX_THREAD_COUNT 100
+/* Number of worker threads servicing requests. Connections are watched by
+ * the rpc_mgr thread while idle and only occupy a worker while a request is
+ * being processed. One more worker is reserved for slurmctld connections,
+ * so slow user queries can not hold up job and node accounting. */
+#define MAX_THREAD_COUNT 32
+
+/* Maximum number of requests processed from one connection before the
+ * worker moves on, so a busy client can not starve the others */
+#define MAX_CONN_MSGS    16
 
 /*
  *  Maximum message size. Messages larger than this value (in bytes)
@@ -67,21 +76,65 @@
  */
 #define MAX_MSG_SIZE     (16*1024*1024)
 
+/* RPC response time histogram, bucket upper bounds in usec */
+#define RPC_HIST_CNT     6
+#define RPC_TYPE_CNT     (DBD_MODIFY_JOB - DBD_INIT + 1)
+
+typedef struct {
+	slurmdbd_conn_t *conn;
+	bool first;		/* no message processed yet */
+	uint32_t uid;		/* user who initiated the connection */
+} rpc_conn_t;
+
+typedef struct {
+	uint32_t cnt;
+	uint64_t time_sum;	/* usec */
+	uint32_t time_max;	/* usec */
+	uint32_t hist[RPC_HIST_CNT];
+} rpc_stats_t;
+
 /* Local functions */
+static void   _add_idle_conn(rpc_conn_t *rpc_conn);
+static void   _close_conn(rpc_conn_t *rpc_conn);
+static bool   _fd_ready(slurm_fd_t fd);
 static bool   _fd_readable(slurm_fd_t fd);
 static void   _free_server_thread(pthread_t my_tid);
+static void   _record_rpc(uint16_t msg_type, long delta_t);
+static void * _rpc_worker(void *ctld_only);
 static int    _send_resp(slurm_fd_t fd, Buf buffer);
-static void * _service_connection(void *arg);
+static bool   _service_connection(rpc_conn_t *rpc_conn);
+static int    _service_msg(rpc_conn_t *rpc_conn);
 static void   _sig_handler(int signal);
 static int    _tot_wait (struct timeval *start_time);
-static int    _wait_for_server_thread(void);
 static void   _wait_for_thread_fini(void);
 
 /* Local variables */
-static pthread_t       master_thread_id = 0, slave_thread_id[MAX_THREAD_COUNT];
+static pthread_t       master_thread_id = 0;
+static pthread_t       slave_thread_id[MAX_THREAD_COUNT + 1];
 static int             thread_count = 0;
 static pthread_mutex_t thread_count_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t  thread_count_cond = PTHREAD_COND_INITIALIZER;
+
+/* Connections waiting for a request, only used by the rpc_mgr thread */
+static rpc_conn_t    **idle_conn = NULL;
+static int             idle_conn_cnt = 0, idle_conn_size = 0;
+
+/* Connections with a request to process and connections returned by the
+ * workers once serviced. A byte written to wake_fd[1] tells the rpc_mgr
+ * thread to collect the latter. slurmctld connections are queued on
+ * ctld_ready_list, which all workers serve first. */
+static List            ready_list = NULL, return_list = NULL;
+static List            ctld_ready_list = NULL;
+static pthread_mutex_t worker_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  worker_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  ctld_cond = PTHREAD_COND_INITIALIZER;
+static int             wake_fd[2] = { -1, -1 };
+
+static const uint32_t  rpc_hist_max[RPC_HIST_CNT - 1] =
+	{ 1000, 10000, 100000, 1000000, 10000000 };
+static const char     *rpc_hist_name[RPC_HIST_CNT] =
+	{ "<1ms", "<10ms", "<100ms", "<1s", "<10s", ">=10s" };
+static rpc_stats_t     rpc_stats[RPC_TYPE_CNT];
+static pthread_mutex_t rpc_stats_lock = PTHREAD_MUTEX_INITIALIZER;
 
 
 /* Process incoming RPCs. Meant to execute as a pthread */
@@ -89,9 +142,12 @@ extern void *rpc_mgr(void *no_data)
 {
 	pthread_attr_t thread_attr_rpc_req;
 	slurm_fd_t sockfd, newsockfd;
-	int i, retry_cnt, sigarray[] = {SIGUSR1, 0};
+	int i, j, nfds, ufds_size = 0, sigarray[] = {SIGUSR1, 0};
 	slurm_addr_t cli_addr;
 	slurmdbd_conn_t *conn_arg = NULL;
+	rpc_conn_t *rpc_conn;
+	struct pollfd *ufds = NULL;
+	char buf[64];
 
 	slurm_mutex_lock(&thread_count_lock);
 	master_thread_id = pthread_self();
@@ -111,7 +167,19 @@ extern void *rpc_mgr(void *no_data)
 	    == SLURM_SOCKET_ERROR)
 		fatal("slurm_init_msg_engine_port error %m");
 
-	/* Prepare to catch SIGUSR1 to interrupt accept().
+	if (pipe(wake_fd))
+		fatal("pipe: %m");
+	for (i = 0; i < 2; i++) {
+		fd_set_nonblocking(wake_fd[i]);
+		fd_set_close_on_exec(wake_fd[i]);
+	}
+	slurm_mutex_lock(&worker_lock);
+	ready_list  = list_create(NULL);
+	ctld_ready_list = list_create(NULL);
+	return_list = list_create(NULL);
+	slurm_mutex_unlock(&worker_lock);
+
+	/* Prepare to catch SIGUSR1 to interrupt poll().
 	 * This signal is generated by the slurmdbd signal
 	 * handler thread upon receipt of SIGABRT, SIGINT,
 	 * or SIGTERM. That thread does all processing of
@@ -119,10 +187,76 @@ extern void *rpc_mgr(void *no_data)
 	xsignal(SIGUSR1, _sig_handler);
 	xsignal_unblock(sigarray);
 
+	slurm_mutex_lock(&thread_count_lock);
+	for (i = 0; i <= MAX_THREAD_COUNT; i++) {
+		/* The last worker only serves slurmctld connections */
+		if (pthread_create(&slave_thread_id[i], &thread_attr_rpc_req,
+				   _rpc_worker, (i == MAX_THREAD_COUNT) ?
+				   (void *) &thread_count : NULL)) {
+			error("pthread_create: %m");
+			slave_thread_id[i] = (pthread_t) 0;
+			break;
+		}
+		thread_count++;
+	}
+	if (thread_count == 0)
+		fatal("Unable to start any RPC worker threads");
+	debug2("rpc_mgr started %d worker threads", thread_count);
+	slurm_mutex_unlock(&thread_count_lock);
+
 	/*
 	 * Process incoming RPCs until told to shutdown
 	 */
-	while ((i = _wait_for_server_thread()) >= 0) {
+	while (!shutdown_time) {
+		nfds = idle_conn_cnt + 2;
+		if (nfds > ufds_size) {
+			ufds_size = nfds * 2;
+			xrealloc(ufds, sizeof(struct pollfd) * ufds_size);
+		}
+		ufds[0].fd = sockfd;
+		ufds[0].events = POLLIN;
+		ufds[1].fd = wake_fd[0];
+		ufds[1].events = POLLIN;
+		for (i = 0; i < idle_conn_cnt; i++) {
+			ufds[i + 2].fd = idle_conn[i]->conn->newsockfd;
+			ufds[i + 2].events = POLLIN;
+		}
+		if (poll(ufds, nfds, -1) == -1) {
+			if (errno != EINTR)
+				error("poll: %m");
+			continue;
+		}
+		if (shutdown_time)
+			break;
+		if (ufds[1].revents) {
+			while (read(wake_fd[0], buf, sizeof(buf)) > 0)
+				;
+		}
+
+		/* Hand connections with a request (or a hangup, which the
+		 * worker will discover) to the workers */
+		slurm_mutex_lock(&worker_lock);
+		for (i = 0, j = 0; i < idle_conn_cnt; i++) {
+			if (ufds[i + 2].revents) {
+				if (idle_conn[i]->conn->ctld_port) {
+					list_append(ctld_ready_list,
+						    idle_conn[i]);
+					pthread_cond_signal(&ctld_cond);
+				} else
+					list_append(ready_list, idle_conn[i]);
+				pthread_cond_signal(&worker_cond);
+			} else
+				idle_conn[j++] = idle_conn[i];
+		}
+		idle_conn_cnt = j;
+
+		/* Watch again the connections the workers are done with */
+		while ((rpc_conn = list_dequeue(return_list)))
+			_add_idle_conn(rpc_conn);
+		slurm_mutex_unlock(&worker_lock);
+
+		if ((ufds[0].revents & POLLIN) == 0)
+			continue;
 		/*
 		 * accept needed for stream implementation is a no-op in
 		 * message implementation that just passes sockfd to newsockfd
@@ -130,7 +264,6 @@ extern void *rpc_mgr(void *no_data)
 		if ((newsockfd = slurm_accept_msg_conn(sockfd,
 						       &cli_addr)) ==
 		    SLURM_SOCKET_ERROR) {
-			_free_server_thread((pthread_t) 0);
 			if (errno != EINTR)
 				error("slurm_accept_msg_conn: %m");
 			continue;
@@ -141,27 +274,45 @@ extern void *rpc_mgr(void *no_data)
 		conn_arg->newsockfd = newsockfd;
 		slurm_get_ip_str(&cli_addr, &conn_arg->orig_port,
 				 conn_arg->ip, sizeof(conn_arg->ip));
-		retry_cnt = 0;
-		while (pthread_create(&slave_thread_id[i],
-				      &thread_attr_rpc_req,
-				      _service_connection,
-				      (void *) conn_arg)) {
-			if (retry_cnt > 0) {
-				error("pthread_create failure, "
-				      "aborting RPC: %m");
-				close(newsockfd);
-				break;
-			}
-			error("pthread_create failure: %m");
-			retry_cnt++;
-			usleep(1000);	/* retry in 1 msec */
-		}
+		debug2("Opened connection %d from %s",
+		       newsockfd, conn_arg->ip);
+		rpc_conn = xmalloc(sizeof(rpc_conn_t));
+		rpc_conn->conn  = conn_arg;
+		rpc_conn->first = true;
+		rpc_conn->uid   = NO_VAL;
+		_add_idle_conn(rpc_conn);
 	}
 
 	debug3("rpc_mgr shutting down");
 	slurm_attr_destroy(&thread_attr_rpc_req);
 	(void) slurm_shutdown_msg_engine(sockfd);
+	slurm_mutex_lock(&worker_lock);
+	pthread_cond_broadcast(&worker_cond);
+	pthread_cond_broadcast(&ctld_cond);
+	slurm_mutex_unlock(&worker_lock);
 	_wait_for_thread_fini();
+
+	/* Close the connections no worker is holding */
+	for (i = 0; i < idle_conn_cnt; i++)
+		_close_conn(idle_conn[i]);
+	idle_conn_cnt = 0;
+	xfree(idle_conn);
+	slurm_mutex_lock(&worker_lock);
+	while ((rpc_conn = list_dequeue(ready_list)))
+		_close_conn(rpc_conn);
+	while ((rpc_conn = list_dequeue(ctld_ready_list)))
+		_close_conn(rpc_conn);
+	while ((rpc_conn = list_dequeue(return_list)))
+		_close_conn(rpc_conn);
+	list_destroy(ready_list);
+	list_destroy(ctld_ready_list);
+	list_destroy(return_list);
+	ready_list = ctld_ready_list = return_list = NULL;
+	slurm_mutex_unlock(&worker_lock);
+	(void) close(wake_fd[0]);
+	(void) close(wake_fd[1]);
+	xfree(ufds);
+
 	pthread_exit((void *) 0);
 	return NULL;
 }
@@ -174,79 +325,216 @@ extern void rpc_mgr_wake(void)
 	slurm_mutex_lock(&thread_count_lock);
 	if (master_thread_id)
 		pthread_kill(master_thread_id, SIGUSR1);
-	for (i=0; i<MAX_THREAD_COUNT; i++) {
+	for (i=0; i<=MAX_THREAD_COUNT; i++) {
 		if (slave_thread_id[i])
 			pthread_kill(slave_thread_id[i], SIGUSR1);
 	}
 	slurm_mutex_unlock(&thread_count_lock);
+
+	slurm_mutex_lock(&worker_lock);
+	pthread_cond_broadcast(&worker_cond);
+	pthread_cond_broadcast(&ctld_cond);
+	slurm_mutex_unlock(&worker_lock);
+}
+
+/* Log the count and response time distribution of each RPC type processed */
+extern void rpc_mgr_log_stats(void)
+{
+	rpc_stats_t *stats;
+	char hist_str[256];
+	int i, j, len;
+
+	slurm_mutex_lock(&rpc_stats_lock);
+	for (i = 0; i < RPC_TYPE_CNT; i++) {
+		stats = &rpc_stats[i];
+		if (stats->cnt == 0)
+			continue;
+		hist_str[0] = '\0';
+		for (j = 0, len = 0; j < RPC_HIST_CNT; j++) {
+			len += snprintf(hist_str + len, sizeof(hist_str) - len,
+					" %s:%u", rpc_hist_name[j],
+					stats->hist[j]);
+		}
+		info("RPC %s count:%u ave_time:%"PRIu64" max_time:%u%s",
+		     slurmdbd_msg_type_2_str(DBD_INIT + i, 1), stats->cnt,
+		     stats->time_sum / stats->cnt, stats->time_max,
+		     hist_str);
+	}
+	slurm_mutex_unlock(&rpc_stats_lock);
+}
+
+/* Add a connection to those watched for requests by the rpc_mgr thread */
+static void _add_idle_conn(rpc_conn_t *rpc_conn)
+{
+	if (idle_conn_cnt >= idle_conn_size) {
+		idle_conn_size = MAX(idle_conn_size * 2, 64);
+		xrealloc(idle_conn, sizeof(rpc_conn_t *) * idle_conn_size);
+	}
+	idle_conn[idle_conn_cnt++] = rpc_conn;
+}
+
+/* Add an RPC's response time (usec) to the statistics for its type */
+static void _record_rpc(uint16_t msg_type, long delta_t)
+{
+	rpc_stats_t *stats;
+	int i;
+
+	if ((msg_type < DBD_INIT) || (msg_type >= DBD_INIT + RPC_TYPE_CNT))
+		return;
+	if (delta_t < 0)
+		delta_t = 0;
+	for (i = 0; i < RPC_HIST_CNT - 1; i++) {
+		if (delta_t < rpc_hist_max[i])
+			break;
+	}
+
+	slurm_mutex_lock(&rpc_stats_lock);
+	stats = &rpc_stats[msg_type - DBD_INIT];
+	stats->cnt++;
+	stats->time_sum += delta_t;
+	if (stats->time_max < delta_t)
+		stats->time_max = delta_t;
+	stats->hist[i]++;
+	slurm_mutex_unlock(&rpc_stats_lock);
 }
 
-static void * _service_connection(void *arg)
+/* _rpc_worker - Service connections with pending requests until shutdown
+ * IN ctld_only - if not NULL, only service slurmctld connections */
+static void *_rpc_worker(void *ctld_only)
 {
-	slurmdbd_conn_t *conn = (slurmdbd_conn_t *) arg;
-	uint32_t nw_size = 0, msg_size = 0, uid = NO_VAL;
+	rpc_conn_t *rpc_conn;
+	char wake = 0;
+
+	while (1) {
+		slurm_mutex_lock(&worker_lock);
+		while (1) {
+			rpc_conn = list_dequeue(ctld_ready_list);
+			if (!rpc_conn && !ctld_only)
+				rpc_conn = list_dequeue(ready_list);
+			if (rpc_conn || shutdown_time)
+				break;
+			pthread_cond_wait(ctld_only ? &ctld_cond : &worker_cond,
+					  &worker_lock);
+		}
+		slurm_mutex_unlock(&worker_lock);
+		if (!rpc_conn)
+			break;
+
+		if (!_service_connection(rpc_conn)) {
+			_close_conn(rpc_conn);
+			continue;
+		}
+		slurm_mutex_lock(&worker_lock);
+		list_append(return_list, rpc_conn);
+		slurm_mutex_unlock(&worker_lock);
+		/* A full pipe already has a wake up pending */
+		if ((write(wake_fd[1], &wake, 1) < 0) && (errno != EAGAIN))
+			error("rpc_mgr wake write: %m");
+	}
+
+	_free_server_thread(pthread_self());
+	return NULL;
+}
+
+/* Process the requests waiting on a connection
+ * RET true if the connection remains open, false if it should be closed */
+static bool _service_connection(rpc_conn_t *rpc_conn)
+{
+	int i;
+
+	for (i = 0; i < MAX_CONN_MSGS; i++) {
+		/* Clients such as slurmctld send several messages without
+		 * waiting for replies, process those already here */
+		if (i && !_fd_ready(rpc_conn->conn->newsockfd))
+			break;
+		if (_service_msg(rpc_conn) != SLURM_SUCCESS)
+			return false;
+	}
+	return true;
+}
+
+/* Read one message from a connection, process it and send the response
+ * RET SLURM_SUCCESS or SLURM_ERROR if the connection should be closed */
+static int _service_msg(rpc_conn_t *rpc_conn)
+{
+	slurmdbd_conn_t *conn = rpc_conn->conn;
+	uint32_t nw_size = 0, msg_size = 0;
+	uint16_t nw_type;
 	char *msg = NULL;
 	ssize_t msg_read = 0, offset = 0;
-	bool fini = false, first = true;
+	bool fini = false;
 	Buf buffer = NULL;
+	struct timeval tstart, tend;
 	int rc = SLURM_SUCCESS;
 
-	debug2("Opened connection %d from %s", conn->newsockfd, conn->ip);
+	if (!_fd_readable(conn->newsockfd))
+		return SLURM_ERROR;	/* problem with this socket */
+	msg_read = read(conn->newsockfd, &nw_size, sizeof(nw_size));
+	if (msg_read == 0)	/* EOF */
+		return SLURM_ERROR;
+	if (msg_read != sizeof(nw_size)) {
+		error("Could not read msg_size from "
+		      "connection %d(%s) uid(%d)",
+		      conn->newsockfd, conn->ip, rpc_conn->uid);
+		return SLURM_ERROR;
+	}
+	msg_size = ntohl(nw_size);
+	if ((msg_size < 2) || (msg_size > MAX_MSG_SIZE)) {
+		error("Invalid msg_size (%u) from "
+		      "connection %d(%s) uid(%d)",
+		      msg_size, conn->newsockfd, conn->ip, rpc_conn->uid);
+		return SLURM_ERROR;
+	}
 
-	while (!fini) {
+	msg = xmalloc(msg_size);
+	while (msg_size > offset) {
 		if (!_fd_readable(conn->newsockfd))
 			break;		/* problem with this socket */
-		msg_read = read(conn->newsockfd, &nw_size, sizeof(nw_size));
-		if (msg_read == 0)	/* EOF */
-			break;
-		if (msg_read != sizeof(nw_size)) {
-			error("Could not read msg_size from "
-			      "connection %d(%s) uid(%d)",
-			      conn->newsockfd, conn->ip, uid);
+		msg_read = read(conn->newsockfd, (msg + offset),
+				(msg_size - offset));
+		if (msg_read <= 0) {
+			error("read(%d): %m", conn->newsockfd);
 			break;
 		}
-		msg_size = ntohl(nw_size);
-		if ((msg_size < 2) || (msg_size > MAX_MSG_SIZE)) {
-			error("Invalid msg_size (%u) from "
+		offset += msg_read;
+	}
+	gettimeofday(&tstart, NULL);
+	if (msg_size == offset) {
+		rc = proc_req(conn, msg, msg_size, rpc_conn->first, &buffer,
+			      &rpc_conn->uid);
+		rpc_conn->first = false;
+		if (rc != SLURM_SUCCESS && rc != ACCOUNTING_FIRST_REG) {
+			error("Processing last message from "
 			      "connection %d(%s) uid(%d)",
-			      msg_size, conn->newsockfd, conn->ip, uid);
-			break;
-		}
-
-		msg = xmalloc(msg_size);
-		offset = 0;
-		while (msg_size > offset) {
-			if (!_fd_readable(conn->newsockfd))
-				break;		/* problem with this socket */
-			msg_read = read(conn->newsockfd, (msg + offset),
-					(msg_size - offset));
-			if (msg_read <= 0) {
-				error("read(%d): %m", conn->newsockfd);
-				break;
-			}
-			offset += msg_read;
-		}
-		if (msg_size == offset) {
-			rc = proc_req(
-				conn, msg, msg_size, first, &buffer, &uid);
-			first = false;
-			if (rc != SLURM_SUCCESS && rc != ACCOUNTING_FIRST_REG) {
-				error("Processing last message from "
-				      "connection %d(%s) uid(%d)",
-				      conn->newsockfd, conn->ip, uid);
-				if (rc == ESLURM_ACCESS_DENIED
-				    || rc == SLURM_PROTOCOL_VERSION_ERROR)
-					fini = true;
-			}
-		} else {
-			buffer = make_dbd_rc_msg(conn->rpc_version,
-						 SLURM_ERROR, "Bad offset", 0);
-			fini = true;
+			      conn->newsockfd, conn->ip, rpc_conn->uid);
+			if (rc == ESLURM_ACCESS_DENIED
+			    || rc == SLURM_PROTOCOL_VERSION_ERROR)
+				fini = true;
 		}
+	} else {
+		buffer = make_dbd_rc_msg(conn->rpc_version,
+					 SLURM_ERROR, "Bad offset", 0);
+		fini = true;
+	}
 
-		rc = _send_resp(conn->newsockfd, buffer);
-		xfree(msg);
+	if (_send_resp(conn->newsockfd, buffer) != SLURM_SUCCESS)
+		fini = true;
+	if (msg_size == offset) {
+		gettimeofday(&tend, NULL);
+		memcpy(&nw_type, msg, sizeof(nw_type));
+		_record_rpc(ntohs(nw_type), slurm_diff_tv(&tstart, &tend));
 	}
+	xfree(msg);
+
+	if (fini)
+		return SLURM_ERROR;
+	return SLURM_SUCCESS;
+}
+
+/* Close a connection and release its database connection */
+static void _close_conn(rpc_conn_t *rpc_conn)
+{
+	slurmdbd_conn_t *conn = rpc_conn->conn;
 
 	if (conn->ctld_port && !shutdown_time) {
 		slurmdb_cluster_rec_t cluster_rec;
@@ -263,12 +551,12 @@ static void * _service_connection(void *arg)
 	if (slurm_close_accepted_conn(conn->newsockfd) < 0)
 		error("close(%d): %m(%s)",  conn->newsockfd, conn->ip);
 	else
-		debug2("Closed connection %d uid(%d)", conn->newsockfd, uid);
+		debug2("Closed connection %d uid(%d)", conn->newsockfd,
+		       rpc_conn->uid);
 
 	xfree(conn->cluster_name);
 	xfree(conn);
-	_free_server_thread(pthread_self());
-	return NULL;
+	xfree(rpc_conn);
 }
 
 /* Return a buffer containing a DBD_RC (return code) message
@@ -335,16 +623,34 @@ static int _tot_wait (struct timeval *start_time)
 	return msec_delay;
 }
 
-/* Wait until a file is readable, return false if can not be read */
+/* Return true if a file has input (or an error) to be read without waiting */
+static bool _fd_ready(slurm_fd_t fd)
+{
+	struct pollfd ufds;
+
+	ufds.fd     = fd;
+	ufds.events = POLLIN;
+	if (poll(&ufds, 1, 0) <= 0)
+		return false;
+	return (ufds.revents != 0);
+}
+
+/* Wait until a file is readable,
+ * RET false if can not be read within MessageTimeout, so a stalled client
+ * can not hold a worker thread */
 static bool _fd_readable(slurm_fd_t fd)
 {
 	struct pollfd ufds;
-	int rc;
+	int msg_timeout = slurmdbd_conf->msg_timeout * 1000;
+	int rc, time_left;
+	struct timeval tstart;
 
 	ufds.fd     = fd;
 	ufds.events = POLLIN;
+	gettimeofday(&tstart, NULL);
 	while (1) {
-		rc = poll(&ufds, 1, -1);
+		time_left = msg_timeout - _tot_wait(&tstart);
+		rc = poll(&ufds, 1, MAX(time_left, 0));
 		if (shutdown_time)
 			return false;
 		if (rc == -1) {
@@ -353,6 +659,10 @@ static bool _fd_readable(slurm_fd_t fd)
 			error("poll: %m");
 			return false;
 		}
+		if (rc == 0) {
+			error("Read timeout on connection %d", fd);
+			return false;
+		}
 		if ((ufds.revents & POLLHUP) &&
 		    ((ufds.revents & POLLIN) == 0)) {
 			debug3("Read connection %d closed", fd);
@@ -434,58 +744,6 @@ extern bool fd_writeable(slurm_fd_t fd)
 	return true;
 }
 
-/* Increment thread_count and don't return until its value is no larger
- *	than MAX_THREAD_COUNT,
- * RET index of free index in slave_pthread_id or -1 to exit */
-static int _wait_for_server_thread(void)
-{
-	bool print_it = true;
-	int i, rc = -1;
-
-	slurm_mutex_lock(&thread_count_lock);
-	while (1) {
-		if (shutdown_time)
-			break;
-
-		if (thread_count < MAX_THREAD_COUNT) {
-			thread_count++;
-			for (i=0; i<MAX_THREAD_COUNT; i++) {
-				if (slave_thread_id[i])
-					continue;
-				rc = i;
-				break;
-			}
-			if (rc == -1) {
-				/* thread_count and slave_thread_id
-				 * out of sync */
-				fatal("No free slave_thread_id");
-			}
-			break;
-		} else {
-			/* wait for state change and retry,
-			 * just a delay and not an error.
-			 * This can happen when the epilog completes
-			 * on a bunch of nodes at the same time, which
-			 * can easily happen for highly parallel jobs. */
-			if (print_it) {
-				static time_t last_print_time = 0;
-				time_t now = time(NULL);
-				if (difftime(now, last_print_time) > 2) {
-					verbose("thread_count over "
-						"limit (%d), waiting",
-						thread_count);
-					last_print_time = now;
-				}
-				print_it = false;
-			}
-			pthread_cond_wait(&thread_count_cond,
-			                  &thread_count_lock);
-		}
-	}
-	slurm_mutex_unlock(&thread_count_lock);
-	return rc;
-}
-
 /* my_tid IN - Thread ID of spawned thread, 0 if no thread spawned */
 static void _free_server_thread(pthread_t my_tid)
 {
@@ -498,17 +756,16 @@ static void _free_server_thread(pthread_t my_tid)
 		error("thread_count underflow");
 
 	if (my_tid) {
-		for (i=0; i<MAX_THREAD_COUNT; i++) {
+		for (i=0; i<=MAX_THREAD_COUNT; i++) {
 			if (slave_thread_id[i] != my_tid)
 				continue;
 			slave_thread_id[i] = (pthread_t) 0;
 			break;
 		}
-		if (i >= MAX_THREAD_COUNT)
+		if (i > MAX_THREAD_COUNT)
 			error("Could not find slave_thread_id");
 	}
 
-	pthread_cond_broadcast(&thread_count_cond);
 	slurm_mutex_unlock(&thread_count_lock);
 }
 
@@ -524,7 +781,7 @@ static void _wait_for_thread_fini(void)
 
 	/* Interupt any hung I/O */
 	slurm_mutex_lock(&thread_count_lock);
-	for (j=0; j<MAX_THREAD_COUNT; j++) {
+	for (j=0; j<=MAX_THREAD_COUNT; j++) {
 		if (slave_thread_id[j] == 0)
 			continue;
 		pthread_kill(slave_thread_id[j], SIGUSR1);
@@ -537,7 +794,7 @@ static void _wait_for_thread_fini(void)
 			return;
 
 		slurm_mutex_lock(&thread_count_lock);
-		for (j=0; j<MAX_THREAD_COUNT; j++) {
+		for (j=0; j<=MAX_THREAD_COUNT; j++) {
 			if (slave_thread_id[j] == 0)
 				continue;
 			info("rpc_mgr sending SIGKILL to thread %lu",
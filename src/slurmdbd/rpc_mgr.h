@@ -55,4 +55,7 @@ extern void *rpc_mgr(void *no_data);
 /* Wake up the RPC manager so that it can exit */
 extern void rpc_mgr_wake(void);
 
+/* Log the count and response time distribution of each RPC type processed */
+extern void rpc_mgr_log_stats(void);
+
 #endif /* !_RPC_MGR_H */
@@ -623,7 +623,7 @@ static int _send_slurmctld_register_req(slurmdb_cluster_rec_t *cluster_rec)
 static void *_signal_handler(void *no_data)
 {
 	int rc, sig;
-	int sig_array[] = {SIGINT, SIGTERM, SIGHUP, SIGABRT, 0};
+	int sig_array[] = {SIGINT, SIGTERM, SIGHUP, SIGABRT, SIGUSR2, 0};
 	sigset_t set;
 
 	(void) pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
@@ -634,6 +634,7 @@ static void *_signal_handler(void *no_data)
 	_default_sigaction(SIGTERM);
 	_default_sigaction(SIGHUP);
 	_default_sigaction(SIGABRT);
+	_default_sigaction(SIGUSR2);
 
 	while (1) {
 		xsignal_sigset_create(sig_array, &set);
@@ -647,6 +648,10 @@ static void *_signal_handler(void *no_data)
 			assoc_mgr_set_missing_uids();
 			_update_logging(false);
 			break;
+		case SIGUSR2:	/* kill -12 */
+			info("Logging RPC statistics (SIGUSR2)");
+			rpc_mgr_log_stats();
+			break;
 		case SIGINT:	/* kill -2  or <CTRL-C> */
 		case SIGTERM:	/* kill -15 */
 			info("Terminate signal (SIGINT or SIGTERM) received");
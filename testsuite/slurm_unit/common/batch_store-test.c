@@ -0,0 +1,248 @@
+/* Test of src/slurmctld/batch_store.c
+ *
+ * Scripts and environments are stored, shared, read back after the log is
+ * reopened, including a log cut short as by a crash during a write, and
+ * compacted while another thread keeps adding and removing jobs.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "slurm/slurm_errno.h"
+#include "src/common/list.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmctld/batch_store.h"
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define BIG_CNT		200	/* jobs with big scripts, to be compacted */
+#define BIG_SIZE	16384
+#define KEPT_CNT	10	/* of the big jobs, kept through compaction */
+#define BUSY_CNT	2000	/* jobs added while compacting */
+#define BUSY_SIZE	4096
+#define BUSY_JOB_ID	100000
+#define REF_SIZE	32	/* size of a job entry record */
+
+static char *store_name = NULL;
+static volatile bool busy_done = false;
+static int busy_errors = 0;
+
+/* Script of a job, xfree when no longer needed */
+static char *_script(uint32_t job_id, int size)
+{
+	char *script = xmalloc(size + 1);
+
+	memset(script, 'a' + (job_id % 26), size);
+	snprintf(script, size, "#!/bin/sh\n# job %u\n", job_id);
+	script[strlen(script)] = '#';
+	return script;
+}
+
+/* Test that a job has the script of job content_id */
+static bool _script_is(uint32_t job_id, uint32_t content_id, int size)
+{
+	char *script = NULL, *expect = _script(content_id, size);
+	bool rc;
+
+	rc = ((batch_store_get_script(job_id, &script) == SLURM_SUCCESS) &&
+	      script && !strcmp(script, expect));
+	xfree(script);
+	xfree(expect);
+	return rc;
+}
+
+static off_t _store_size(void)
+{
+	struct stat stat_buf;
+
+	if (stat(store_name, &stat_buf) < 0)
+		return -1;
+	return stat_buf.st_size;
+}
+
+/* Add and delete jobs while the main thread compacts the log. One job in
+ * four is kept. */
+static void *_busy(void *arg)
+{
+	char *script;
+	uint32_t job_id;
+
+	for (job_id = BUSY_JOB_ID; job_id < BUSY_JOB_ID + BUSY_CNT;
+	     job_id++) {
+		script = _script(job_id, BUSY_SIZE);
+		if (batch_store_add(job_id, script, NULL, 0) != SLURM_SUCCESS)
+			busy_errors++;
+		xfree(script);
+		if ((job_id % 4) &&
+		    (batch_store_delete(job_id) != SLURM_SUCCESS))
+			busy_errors++;
+	}
+	busy_done = true;
+	return NULL;
+}
+
+static bool _busy_ok(void)
+{
+	uint32_t job_id;
+	char *script;
+
+	for (job_id = BUSY_JOB_ID; job_id < BUSY_JOB_ID + BUSY_CNT;
+	     job_id++) {
+		if (job_id % 4) {
+			if (batch_store_get_script(job_id, &script)
+			    != SLURM_ERROR)
+				return false;
+		} else if (!_script_is(job_id, job_id, BUSY_SIZE))
+			return false;
+	}
+	return true;
+}
+
+int
+main(int argc, char *argv[])
+{
+	char dir[] = "/tmp/batch_store-test.XXXXXX";
+	char *conf_name = NULL, *script, *env_buf = NULL;
+	char *env[] = { "A=1", "B=22", "C=333" };
+	uint32_t env_size = 0, job_id;
+	int buf_size = 0;
+	off_t size, big_size;
+	List job_ids;
+	pthread_t tid;
+	FILE *fp;
+	bool ok;
+
+	if (!mkdtemp(dir)) {
+		fail("create test directory");
+		return 1;
+	}
+	xstrfmtcat(conf_name, "%s/slurm.conf", dir);
+	if (!(fp = fopen(conf_name, "w"))) {
+		fail("write slurm.conf");
+		return 1;
+	}
+	fprintf(fp, "ClusterName=test\n"
+		"ControlMachine=localhost\n"
+		"PluginDir=%s\n"
+		"StateSaveLocation=%s\n", dir, dir);
+	fclose(fp);
+	setenv("SLURM_CONF", conf_name, 1);
+	xstrfmtcat(store_name, "%s/batch_store", dir);
+
+	note("Testing scripts and environments");
+	script = _script(1, 100);
+	TEST(batch_store_add(1, script, env, 3) == SLURM_SUCCESS, "add job");
+	xfree(script);
+	TEST(_script_is(1, 1, 100), "script");
+	TEST((batch_store_get_env(1, &env_buf, &env_size, &buf_size)
+	      == SLURM_SUCCESS) && (env_size == 3) && (buf_size == 15) &&
+	     !memcmp(env_buf, "A=1\0B=22\0C=333", 15), "environment");
+	xfree(env_buf);
+	TEST(batch_store_add(2, NULL, NULL, 0) == SLURM_SUCCESS,
+	     "add job without script");
+	TEST((batch_store_get_script(2, &script) == SLURM_SUCCESS) &&
+	     (script == NULL), "no script");
+	TEST((batch_store_get_env(2, &env_buf, &env_size, &buf_size)
+	      == SLURM_SUCCESS) && !env_buf && !env_size && !buf_size,
+	     "no environment");
+	TEST(batch_store_get_script(3, &script) == SLURM_ERROR,
+	     "unknown job");
+
+	note("Testing shared content");
+	size = _store_size();
+	script = _script(1, 100);
+	TEST(batch_store_add(3, script, env, 3) == SLURM_SUCCESS,
+	     "add job with the same content");
+	xfree(script);
+	TEST(_store_size() - size == REF_SIZE, "only a job entry written");
+	TEST(batch_store_copy(3, 4) == SLURM_SUCCESS, "copy job");
+	TEST(_script_is(4, 1, 100), "copied script");
+	TEST(batch_store_copy(5, 6) == SLURM_ERROR, "copy unknown job");
+	TEST(batch_store_delete(1) == SLURM_SUCCESS, "delete job");
+	TEST(_script_is(3, 1, 100), "content still shared");
+	TEST(batch_store_delete(1) == SLURM_ERROR, "delete deleted job");
+
+	note("Testing a reopened log");
+	batch_store_sync();
+	batch_store_fini();
+	job_ids = list_create(slurm_destroy_uint32_ptr);
+	batch_store_get_job_ids(job_ids);
+	TEST(list_count(job_ids) == 3, "jobs recovered");
+	list_destroy(job_ids);
+	TEST(_script_is(3, 1, 100) && _script_is(4, 1, 100), "scripts recovered");
+	TEST(batch_store_get_script(1, &script) == SLURM_ERROR,
+	     "deleted job not recovered");
+
+	note("Testing a log cut short");
+	script = _script(5, 100);
+	TEST(batch_store_add(5, script, NULL, 0) == SLURM_SUCCESS,
+	     "add job");
+	xfree(script);
+	batch_store_fini();
+	size = _store_size() - 5;
+	TEST(truncate(store_name, size) == 0, "cut log");
+	TEST(batch_store_get_script(5, &script) == SLURM_ERROR,
+	     "cut job not recovered");
+	TEST(_store_size() == size - (REF_SIZE - 5), "cut record dropped");
+	TEST(_script_is(3, 1, 100) && _script_is(4, 1, 100),
+	     "jobs before cut recovered");
+
+	note("Testing compaction");
+	for (job_id = 10; job_id < 10 + BIG_CNT; job_id++) {
+		script = _script(job_id, BIG_SIZE);
+		(void) batch_store_add(job_id, script, NULL, 0);
+		xfree(script);
+	}
+	for (job_id = 10 + KEPT_CNT; job_id < 10 + BIG_CNT; job_id++)
+		(void) batch_store_delete(job_id);
+	big_size = _store_size();
+	batch_store_gc();
+	TEST(_store_size() < big_size / 2, "log compacted");
+	for (job_id = 10, ok = true; job_id < 10 + KEPT_CNT; job_id++)
+		ok = ok && _script_is(job_id, job_id, BIG_SIZE);
+	TEST(ok && _script_is(3, 1, 100), "kept jobs read");
+
+	note("Testing compaction while jobs are added");
+	size = _store_size();
+	pthread_create(&tid, NULL, _busy, NULL);
+	while (!busy_done)
+		batch_store_gc();
+	pthread_join(tid, NULL);
+	batch_store_gc();
+	TEST(busy_errors == 0, "jobs added and deleted");
+	/* Three jobs in four were deleted, without compaction the log would
+	 * have grown by more than the size of their scripts */
+	TEST(_store_size() - size < BUSY_CNT * BUSY_SIZE * 3 / 4,
+	     "log compacted");
+	for (job_id = 10, ok = true; job_id < 10 + KEPT_CNT; job_id++)
+		ok = ok && _script_is(job_id, job_id, BIG_SIZE);
+	TEST(ok && _script_is(3, 1, 100), "kept jobs read");
+	TEST(_busy_ok(), "jobs added while compacting read");
+	batch_store_fini();
+	for (job_id = 10, ok = true; job_id < 10 + KEPT_CNT; job_id++)
+		ok = ok && _script_is(job_id, job_id, BIG_SIZE);
+	TEST(ok && _script_is(3, 1, 100), "kept jobs recovered");
+	TEST(_busy_ok(), "jobs added while compacting recovered");
+	batch_store_fini();
+
+	unlink(store_name);
+	unlink(conf_name);
+	rmdir(dir);
+	xfree(store_name);
+	xfree(conf_name);
+	totals();
+	return failed;
+}
@@ -0,0 +1,259 @@
+/* Benchmark of src/common/bitstring.c search and count functions.
+ *
+ * Compares the library functions against bit at a time reference versions
+ * (equivalent to the original implementations) for bitmaps of 10k to 1M
+ * bits, verifying that both return the same results.
+ *
+ * Usage: bitstring-bench [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <src/common/bitstring.h>
+
+static long _usec_since(struct timeval *start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) * 1000000 +
+	       (now.tv_usec - start->tv_usec);
+}
+
+static bitoff_t _ref_ffc(bitstr_t *b)
+{
+	bitoff_t bit;
+
+	for (bit = 0; bit < bit_size(b); bit++) {
+		if (!bit_test(b, bit))
+			return bit;
+	}
+	return -1;
+}
+
+static bitoff_t _ref_ffs(bitstr_t *b)
+{
+	bitoff_t bit;
+
+	for (bit = 0; bit < bit_size(b); bit++) {
+		if (bit_test(b, bit))
+			return bit;
+	}
+	return -1;
+}
+
+static bitoff_t _ref_fls(bitstr_t *b)
+{
+	bitoff_t bit;
+
+	for (bit = bit_size(b) - 1; bit >= 0; bit--) {
+		if (bit_test(b, bit))
+			return bit;
+	}
+	return -1;
+}
+
+static bitoff_t _ref_nffc(bitstr_t *b, int n)
+{
+	bitoff_t bit;
+	int cnt = 0;
+
+	for (bit = 0; bit < bit_size(b); bit++) {
+		if (bit_test(b, bit)) {
+			cnt = 0;
+		} else if (++cnt >= n) {
+			return bit - (cnt - 1);
+		}
+	}
+	return -1;
+}
+
+static bitoff_t _ref_noc(bitstr_t *b, int n, int seed)
+{
+	bitoff_t bit;
+	int cnt = 0;
+
+	if ((seed + n) >= bit_size(b))
+		seed = bit_size(b);
+	for (bit = seed; bit < bit_size(b); bit++) {
+		if (bit_test(b, bit)) {
+			cnt = 0;
+		} else if (++cnt >= n) {
+			return bit - (cnt - 1);
+		}
+	}
+	cnt = 0;
+	for (bit = 0; bit < bit_size(b); bit++) {
+		if (bit_test(b, bit)) {
+			if (bit >= seed)
+				break;
+			cnt = 0;
+		} else if (++cnt >= n) {
+			return bit - (cnt - 1);
+		}
+	}
+	return -1;
+}
+
+static int _ref_set_count(bitstr_t *b)
+{
+	bitoff_t bit;
+	int count = 0;
+
+	for (bit = 0; bit < bit_size(b); bit++) {
+		if (bit_test(b, bit))
+			count++;
+	}
+	return count;
+}
+
+static int _ref_overlap(bitstr_t *b1, bitstr_t *b2)
+{
+	bitoff_t bit;
+	int count = 0;
+
+	for (bit = 0; bit < bit_size(b1); bit++) {
+		if (bit_test(b1, bit) && bit_test(b2, bit))
+			count++;
+	}
+	return count;
+}
+
+static int _ref_super_set(bitstr_t *b1, bitstr_t *b2)
+{
+	bitoff_t bit;
+
+	for (bit = 0; bit < bit_size(b1); bit++) {
+		if (bit_test(b1, bit) && !bit_test(b2, bit))
+			return 0;
+	}
+	return 1;
+}
+
+static void _ref_and(bitstr_t *b1, bitstr_t *b2)
+{
+	bitoff_t bit;
+
+	for (bit = 0; bit < bit_size(b1); bit++) {
+		if (!bit_test(b2, bit))
+			bit_clear(b1, bit);
+	}
+}
+
+/* Build a bitmap of nbits with bits set at the given density (percent) in
+ * runs of up to run_len bits */
+static bitstr_t *_random_bitmap(bitoff_t nbits, int density, int run_len)
+{
+	bitstr_t *b = bit_alloc(nbits);
+	bitoff_t bit, end;
+
+	for (bit = 0; bit < nbits; ) {
+		end = bit + 1 + (random() % run_len);
+		if (end > nbits)
+			end = nbits;
+		if ((random() % 100) < density)
+			bit_nset(b, bit, end - 1);
+		bit = end;
+	}
+	return b;
+}
+
+static int errors = 0;
+
+#define CHECK(_name, _new, _ref) do {					\
+	long _n = (long) (_new), _r = (long) (_ref);			\
+	if (_n != _r) {							\
+		printf("ERROR: %s returned %ld, expected %ld\n",	\
+		       _name, _n, _r);					\
+		errors++;						\
+	}								\
+} while (0)
+
+#define TIME(_name, _iters, _expr, _ref_expr) do {			\
+	struct timeval _tv;						\
+	long _new_usec, _ref_usec;					\
+	int _i;								\
+	gettimeofday(&_tv, NULL);					\
+	for (_i = 0; _i < (_iters); _i++)				\
+		(void) (_expr);						\
+	_new_usec = _usec_since(&_tv);					\
+	gettimeofday(&_tv, NULL);					\
+	for (_i = 0; _i < (_iters); _i++)				\
+		(void) (_ref_expr);					\
+	_ref_usec = _usec_since(&_tv);					\
+	printf("  %-14s %10.2f %10.2f %8.1fx\n", _name,		\
+	       (double) _new_usec / (_iters),				\
+	       (double) _ref_usec / (_iters),				\
+	       _new_usec ? (double) _ref_usec / _new_usec : 0.0);	\
+} while (0)
+
+static void _bench(bitoff_t nbits, int density, int iters)
+{
+	bitstr_t *b1 = _random_bitmap(nbits, density, 64);
+	bitstr_t *b2 = _random_bitmap(nbits, density, 64);
+	bitstr_t *full = bit_alloc(nbits), *tmp1, *tmp2;
+	int n = 32, seed = nbits / 2;
+
+	bit_nset(full, 0, nbits - 2);	/* only the last bit clear */
+
+	CHECK("bit_ffc", bit_ffc(full), _ref_ffc(full));
+	CHECK("bit_ffs", bit_ffs(b1), _ref_ffs(b1));
+	CHECK("bit_fls", bit_fls(b1), _ref_fls(b1));
+	CHECK("bit_nffc", bit_nffc(b1, n), _ref_nffc(b1, n));
+	CHECK("bit_noc", bit_noc(b1, n, seed), _ref_noc(b1, n, seed));
+	CHECK("bit_set_count", bit_set_count(b1), _ref_set_count(b1));
+	CHECK("bit_overlap", bit_overlap(b1, b2), _ref_overlap(b1, b2));
+	CHECK("bit_super_set", bit_super_set(b1, b2),
+	      _ref_super_set(b1, b2));
+	tmp1 = bit_copy(b1);
+	tmp2 = bit_copy(b1);
+	bit_and(tmp1, b2);
+	_ref_and(tmp2, b2);
+	CHECK("bit_and", bit_equal(tmp1, tmp2), 1);
+	bit_free(tmp2);
+
+	printf("%d bits, %d%% set (usec per call)\n", (int) nbits, density);
+	printf("  %-14s %10s %10s %9s\n", "function", "new", "reference",
+	       "speedup");
+	TIME("bit_ffc", iters, bit_ffc(full), _ref_ffc(full));
+	TIME("bit_ffs", iters, bit_ffs(b1), _ref_ffs(b1));
+	TIME("bit_fls", iters, bit_fls(b1), _ref_fls(b1));
+	TIME("bit_nffc", iters, bit_nffc(b1, n), _ref_nffc(b1, n));
+	TIME("bit_noc", iters, bit_noc(b1, n, seed), _ref_noc(b1, n, seed));
+	TIME("bit_set_count", iters, bit_set_count(b1), _ref_set_count(b1));
+	TIME("bit_overlap", iters, bit_overlap(b1, b2), _ref_overlap(b1, b2));
+	TIME("bit_super_set", iters, bit_super_set(b1, full),
+	     _ref_super_set(b1, full));
+	TIME("bit_and", iters, (bit_and(tmp1, b2), 0),
+	     (_ref_and(tmp1, b2), 0));
+
+	bit_free(b1);
+	bit_free(b2);
+	bit_free(full);
+	bit_free(tmp1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	bitoff_t sizes[] = { 10000, 100000, 1000000 };
+	int densities[] = { 5, 50, 95 };
+	int i, j, iters = 20;
+
+	if (argc > 1)
+		iters = atoi(argv[1]);
+	if (iters < 1)
+		iters = 1;
+	srandom(1);
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		for (j = 0; j < sizeof(densities) / sizeof(densities[0]);
+		     j++) {
+			_bench(sizes[i], densities[j], iters);
+		}
+	}
+
+	if (errors)
+		printf("%d ERRORS\n", errors);
+	return errors ? 1 : 0;
+}
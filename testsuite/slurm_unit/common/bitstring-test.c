@@ -179,6 +179,99 @@ main(int argc, char *argv[])
 		bit_free(bs);
 	}
 
+	note("Testing word boundaries");
+	{
+		bitstr_t *bs = bit_alloc(1000);
+		bitstr_t *bs2 = bit_alloc(1000);
+
+		bit_nset(bs, 0, 639);
+		TEST(bit_ffc(bs) == 640, "ffc after full words");
+		TEST(bit_ffs(bs) == 0, "ffs");
+		TEST(bit_fls(bs) == 639, "fls");
+		TEST(bit_set_count(bs) == 640, "set count");
+		TEST(bit_nffc(bs, 360) == 640, "nffc to end");
+		TEST(bit_nffc(bs, 361) == -1, "nffc too long");
+		TEST(bit_noc(bs, 10, 700) == 700, "noc at seed");
+		TEST(bit_noc(bs, 10, 995) == 640, "noc wraps");
+
+		/* bits beyond the end of the bitstring are not counted */
+		bit_not(bs);
+		TEST(bit_set_count(bs) == 360, "set count after not");
+		TEST(bit_ffs(bs) == 640, "ffs after not");
+		TEST(bit_fls(bs) == 999, "fls after not");
+		bit_nset(bs, 0, 999);
+		TEST(bit_ffc(bs) == -1, "ffc of full bitstring");
+
+		bit_nset(bs2, 63, 64);
+		bit_set(bs2, 999);
+		TEST(bit_overlap(bs, bs2) == 3, "overlap");
+		TEST(bit_super_set(bs2, bs) == 1, "super set");
+		bit_clear(bs, 64);
+		TEST(bit_super_set(bs2, bs) == 0, "not super set");
+		TEST(bit_overlap(bs, bs2) == 2, "overlap");
+
+		bit_nclear(bs, 0, 999);
+		bit_set(bs, 5);
+		bit_set(bs, 500);
+		bit_set(bs, 800);
+		TEST(bit_noc(bs, 600, 100) == -1, "noc no room");
+		TEST(bit_noc(bs, 250, 300) == 501, "noc after seed");
+		TEST(bit_noc(bs, 300, 300) == 6, "noc before seed");
+		TEST(bit_noc(bs, 495, 300) == -1, "noc blocked at seed");
+		TEST(bit_nffc(bs, 494) == 6, "nffc after set bit");
+		TEST(bit_nffc(bs, 495) == -1, "nffc no room");
+
+		bit_free(bs);
+		bit_free(bs2);
+	}
+
+	note("Testing widths at and around word sizes");
+	{
+		bitoff_t widths[] = { 1, 31, 32, 33, 63, 64, 65, 127, 128, 129 };
+		bitoff_t w;
+		int i;
+
+		for (i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+			bitstr_t *bs = bit_alloc(widths[i]);
+			bitstr_t *bs2 = bit_alloc(widths[i]);
+
+			w = widths[i];
+			TEST(bit_ffs(bs) == -1 && bit_fls(bs) == -1,
+			     "ffs/fls of empty bitstring");
+			TEST(bit_ffc(bs) == 0, "ffc of empty bitstring");
+			TEST(w == 1 || bit_nffc(bs, w - 1) == 0,
+			     "nffc of all but one bit");
+			TEST(bit_noc(bs, w, w - 1) == 0, "noc of whole width");
+
+			bit_set(bs, w - 1);
+			TEST(bit_ffs(bs) == w - 1 && bit_fls(bs) == w - 1,
+			     "ffs/fls of last bit");
+			TEST(bit_nffs(bs, 1) == w - 1, "nffs of last bit");
+			TEST(bit_set_count(bs) == 1, "set count of last bit");
+			TEST(bit_noc(bs, w, 0) == -1, "noc blocked by last bit");
+			TEST(w == 1 || bit_noc(bs, w - 1, w - 1) == 0,
+			     "noc before last bit");
+
+			/* bits beyond the width are not counted */
+			bit_not(bs);
+			TEST(bit_set_count(bs) == w - 1, "set count after not");
+			TEST(w == 1 || bit_fls(bs) == w - 2, "fls after not");
+			TEST(bit_ffc(bs) == w - 1, "ffc after not");
+			bit_set(bs, w - 1);
+			TEST(bit_ffc(bs) == -1, "ffc of full bitstring");
+			TEST(bit_set_count(bs) == w, "set count of full");
+
+			bit_set(bs2, w - 1);
+			TEST(bit_overlap(bs, bs2) == 1, "overlap at last bit");
+			TEST(bit_super_set(bs2, bs) == 1, "super set");
+			bit_and(bs2, bs);
+			TEST(bit_set_count(bs2) == 1, "and keeps last bit");
+
+			bit_free(bs);
+			bit_free(bs2);
+		}
+	}
+
 	note("Testing bit_unfmt");
 	{
 		bitstr_t *bs = bit_alloc(1024);
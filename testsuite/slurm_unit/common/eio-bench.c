@@ -0,0 +1,140 @@
+/* Benchmark of the poll() and epoll back ends of src/common/eio.c.
+ *
+ * Registers 10 to 10000 sockets, both ends of socket pairs, as eio objects
+ * and passes a token around them: the read handler of one end of a pair
+ * consumes a byte and writes one into the next pair, so every pass of the
+ * event loop finds one ready object among all of the idle ones, as for a
+ * large step's I/O connections. Reports the cost of a pass for each back
+ * end.
+ *
+ * Usage: eio-bench [passes]
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <src/common/eio.h>
+#include <src/common/fd.h>
+#include <src/common/xmalloc.h>
+
+static int *write_fd = NULL;	/* end of each pair written to */
+static int pair_cnt = 0;
+static int hops = 0, max_hops = 0;
+
+static double _secs_since(struct timeval *start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) +
+	       (now.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static bool _readable(eio_obj_t *obj)
+{
+	return (hops < max_hops);
+}
+
+static int _read(eio_obj_t *obj, List objs)
+{
+	int inx = (int) (long) obj->arg;
+	char c;
+
+	if (read(obj->fd, &c, 1) != 1)
+		return SLURM_SUCCESS;
+	if (++hops < max_hops) {
+		inx = (inx + 1) % pair_cnt;
+		if (write(write_fd[inx], &c, 1) != 1)
+			exit(1);
+	}
+	return SLURM_SUCCESS;
+}
+
+static struct io_operations ops = {
+	.readable = &_readable,
+	.handle_read = &_read,
+};
+
+static double _bench(int cnt, int passes, bool use_poll)
+{
+	eio_handle_t *eio = eio_handle_create();
+	int *read_fd;
+	struct timeval tv;
+	double secs;
+	int i, sv[2];
+
+	pair_cnt = cnt / 2;
+	read_fd = xmalloc(sizeof(int) * pair_cnt);
+	write_fd = xmalloc(sizeof(int) * pair_cnt);
+	for (i = 0; i < pair_cnt; i++) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+			perror("socketpair");
+			exit(1);
+		}
+		fd_set_nonblocking(sv[0]);
+		fd_set_nonblocking(sv[1]);
+		read_fd[i] = sv[0];
+		write_fd[i] = sv[1];
+		eio_new_initial_obj(eio, eio_obj_create(sv[0], &ops,
+							(void *) (long) i));
+		/* never written to, only watched */
+		eio_new_initial_obj(eio, eio_obj_create(sv[1], &ops,
+							(void *) (long) i));
+	}
+	if (use_poll)
+		eio_handle_use_poll(eio);
+
+	hops = 0;
+	max_hops = passes;
+	if (write(write_fd[0], "x", 1) != 1)
+		exit(1);
+	gettimeofday(&tv, NULL);
+	eio_handle_mainloop(eio);
+	secs = _secs_since(&tv);
+
+	eio_handle_destroy(eio);
+	for (i = 0; i < pair_cnt; i++) {
+		close(read_fd[i]);
+		close(write_fd[i]);
+	}
+	xfree(read_fd);
+	xfree(write_fd);
+	return secs * 1000000 / passes;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int obj_cnts[] = { 10, 100, 1000, 10000 };
+	int passes = 20000;
+	struct rlimit rlim;
+	int i;
+
+	if (argc > 1)
+		passes = atoi(argv[1]);
+	if (passes < 1)
+		passes = 1;
+
+	if (getrlimit(RLIMIT_NOFILE, &rlim) == 0) {
+		rlim.rlim_cur = rlim.rlim_max;
+		(void) setrlimit(RLIMIT_NOFILE, &rlim);
+	}
+
+	for (i = 0; i < sizeof(obj_cnts) / sizeof(obj_cnts[0]); i++) {
+		if ((obj_cnts[i] + 16) > rlim.rlim_cur) {
+			printf("%5d objects: skipped, open file limit %lu\n",
+			       obj_cnts[i], (unsigned long) rlim.rlim_cur);
+			continue;
+		}
+		printf("%5d objects  poll %8.2f usec/pass  ", obj_cnts[i],
+		       _bench(obj_cnts[i], passes, true));
+		printf("epoll %8.2f usec/pass\n",
+		       _bench(obj_cnts[i], passes, false));
+		fflush(stdout);
+	}
+	return 0;
+}
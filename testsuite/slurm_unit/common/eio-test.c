@@ -0,0 +1,289 @@
+/* Test of src/common/eio.c
+ *
+ * Each case is run with the epoll and the poll() back ends, which must
+ * dispatch the same events: data and end of file on sockets, hangup of a
+ * pipe, objects added and removed while the main loop runs, including one
+ * given the fd number of an object just closed, and regular files.
+ */
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <src/common/eio.h>
+#include <src/common/xmalloc.h>
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+typedef struct {
+	char buf[64];		/* data read */
+	int len;		/* bytes in buf */
+	int closes;		/* calls to handle_close */
+	int writes;		/* calls to handle_write */
+	int write_max;		/* writable for this many calls */
+} test_obj_t;
+
+static bool _readable(eio_obj_t *obj)
+{
+	return !obj->shutdown;
+}
+
+static int _read(eio_obj_t *obj, List objs)
+{
+	test_obj_t *t = obj->arg;
+	int n;
+
+	n = read(obj->fd, t->buf + t->len, sizeof(t->buf) - t->len - 1);
+	if (n > 0) {
+		t->len += n;
+		return SLURM_SUCCESS;
+	}
+	obj->shutdown = true;
+	return SLURM_SUCCESS;
+}
+
+static int _close(eio_obj_t *obj, List objs)
+{
+	test_obj_t *t = obj->arg;
+
+	t->closes++;
+	obj->shutdown = true;
+	return SLURM_SUCCESS;
+}
+
+static bool _writable(eio_obj_t *obj)
+{
+	test_obj_t *t = obj->arg;
+
+	return (t->writes < t->write_max);
+}
+
+static int _write(eio_obj_t *obj, List objs)
+{
+	test_obj_t *t = obj->arg;
+
+	if (write(obj->fd, "w", 1) == 1)
+		t->writes++;
+	return SLURM_SUCCESS;
+}
+
+static struct io_operations read_ops = {
+	.readable = &_readable,
+	.handle_read = &_read,
+};
+
+static struct io_operations pipe_ops = {
+	.readable = &_readable,
+	.handle_read = &_read,
+	.handle_close = &_close,
+};
+
+static struct io_operations write_ops = {
+	.writable = &_writable,
+	.handle_write = &_write,
+};
+
+static test_obj_t reused;	/* object given a closed object's fd */
+static int reused_fd = -1;
+static bool reuse_first;	/* put it ahead of the closed object */
+
+/* Read to end of file, then close the fd and add an object for a new pipe,
+ * which gets the lowest free fd number: that just closed */
+static int _read_reuse(eio_obj_t *obj, List objs)
+{
+	eio_obj_t *new_obj;
+	int pfd[2];
+
+	_read(obj, objs);
+	if (!obj->shutdown)
+		return SLURM_SUCCESS;
+	close(obj->fd);
+	obj->fd = -1;
+	if (pipe(pfd) < 0)
+		return SLURM_ERROR;
+	if (write(pfd[1], "new", 3) != 3)
+		return SLURM_ERROR;
+	close(pfd[1]);
+	reused_fd = pfd[0];
+	new_obj = eio_obj_create(pfd[0], &pipe_ops, &reused);
+	if (reuse_first)
+		list_prepend(objs, new_obj);
+	else
+		list_append(objs, new_obj);
+	return SLURM_SUCCESS;
+}
+
+static struct io_operations reuse_ops = {
+	.readable = &_readable,
+	.handle_read = &_read_reuse,
+};
+
+static eio_handle_t *_create(bool use_poll)
+{
+	eio_handle_t *eio = eio_handle_create();
+
+	if (use_poll)
+		eio_handle_use_poll(eio);
+	return eio;
+}
+
+static bool _is(test_obj_t *t, char *data)
+{
+	t->buf[t->len] = '\0';
+	return !strcmp(t->buf, data);
+}
+
+static void _test_sockets(bool use_poll)
+{
+	eio_handle_t *eio = _create(use_poll);
+	test_obj_t a, b, idle;
+	int sa[2], sb[2], si[2];
+
+	memset(&a, 0, sizeof(a));
+	memset(&b, 0, sizeof(b));
+	memset(&idle, 0, sizeof(idle));
+	if ((socketpair(AF_UNIX, SOCK_STREAM, 0, sa) < 0) ||
+	    (socketpair(AF_UNIX, SOCK_STREAM, 0, sb) < 0) ||
+	    (socketpair(AF_UNIX, SOCK_STREAM, 0, si) < 0)) {
+		fail("socketpair");
+		return;
+	}
+	eio_new_initial_obj(eio, eio_obj_create(sa[0], &read_ops, &a));
+	eio_new_initial_obj(eio, eio_obj_create(sb[0], &read_ops, &b));
+	eio_new_initial_obj(eio, eio_obj_create(si[0], &read_ops, &idle));
+	if ((write(sa[1], "abc", 3) != 3) || (write(sb[1], "de", 2) != 2)) {
+		fail("write");
+		return;
+	}
+	close(sa[1]);
+	close(sb[1]);
+	close(si[1]);	/* end of file without data */
+
+	TEST(eio_handle_mainloop(eio) == 0, "main loop ends");
+	TEST(_is(&a, "abc") && _is(&b, "de"), "data read");
+	TEST(_is(&idle, ""), "end of file without data");
+	eio_handle_destroy(eio);
+	close(sa[0]);
+	close(sb[0]);
+	close(si[0]);
+}
+
+static void _test_hangup(bool use_poll)
+{
+	eio_handle_t *eio = _create(use_poll);
+	test_obj_t a, b;
+	int pa[2], pb[2];
+
+	memset(&a, 0, sizeof(a));
+	memset(&b, 0, sizeof(b));
+	if ((pipe(pa) < 0) || (pipe(pb) < 0)) {
+		fail("pipe");
+		return;
+	}
+	eio_new_initial_obj(eio, eio_obj_create(pa[0], &pipe_ops, &a));
+	eio_new_initial_obj(eio, eio_obj_create(pb[0], &pipe_ops, &b));
+	if (write(pb[1], "xy", 2) != 2) {
+		fail("write");
+		return;
+	}
+	close(pa[1]);
+	close(pb[1]);
+
+	TEST(eio_handle_mainloop(eio) == 0, "main loop ends");
+	TEST((a.closes == 1) && _is(&a, ""), "hangup without data");
+	TEST((b.closes == 1) && _is(&b, "xy"), "hangup after data read");
+	eio_handle_destroy(eio);
+	close(pa[0]);
+	close(pb[0]);
+}
+
+static void _test_reuse(bool use_poll, bool first)
+{
+	eio_handle_t *eio = _create(use_poll);
+	test_obj_t a;
+	int pa[2];
+
+	memset(&a, 0, sizeof(a));
+	memset(&reused, 0, sizeof(reused));
+	reuse_first = first;
+	if (pipe(pa) < 0) {
+		fail("pipe");
+		return;
+	}
+	eio_new_initial_obj(eio, eio_obj_create(pa[0], &reuse_ops, &a));
+	if (write(pa[1], "old", 3) != 3) {
+		fail("write");
+		return;
+	}
+	close(pa[1]);
+
+	TEST(eio_handle_mainloop(eio) == 0, "main loop ends");
+	TEST(_is(&a, "old"), "data read before close");
+	TEST(_is(&reused, "new") && (reused.closes == 1),
+	     "data read from reused fd");
+	eio_handle_destroy(eio);
+	close(reused_fd);
+}
+
+static void _test_file_and_write(bool use_poll)
+{
+	eio_handle_t *eio = _create(use_poll);
+	char name[] = "/tmp/eio-test.XXXXXX", out[16];
+	test_obj_t file, w;
+	int fd, sw[2];
+
+	memset(&file, 0, sizeof(file));
+	memset(&w, 0, sizeof(w));
+	w.write_max = 5;
+	if (((fd = mkstemp(name)) < 0) ||
+	    (socketpair(AF_UNIX, SOCK_STREAM, 0, sw) < 0)) {
+		fail("mkstemp or socketpair");
+		return;
+	}
+	unlink(name);
+	if ((write(fd, "file", 4) != 4) || (lseek(fd, 0, SEEK_SET) != 0)) {
+		fail("write");
+		return;
+	}
+	eio_new_initial_obj(eio, eio_obj_create(fd, &read_ops, &file));
+	eio_new_initial_obj(eio, eio_obj_create(sw[0], &write_ops, &w));
+
+	TEST(eio_handle_mainloop(eio) == 0, "main loop ends");
+	TEST(_is(&file, "file"), "regular file read");
+	TEST((w.writes == 5) && (read(sw[1], out, sizeof(out)) == 5),
+	     "written until not writable");
+	eio_handle_destroy(eio);
+	close(fd);
+	close(sw[0]);
+	close(sw[1]);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int i;
+
+	alarm(60);	/* a missed event leaves the main loop waiting */
+	for (i = 0; i < 2; i++) {
+		bool use_poll = (i == 1);
+
+		note(use_poll ? "Testing poll" : "Testing epoll");
+		_test_sockets(use_poll);
+		_test_hangup(use_poll);
+		_test_reuse(use_poll, false);
+		_test_reuse(use_poll, true);
+		_test_file_and_write(use_poll);
+	}
+
+	totals();
+	return failed;
+}
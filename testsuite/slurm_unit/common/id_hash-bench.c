@@ -0,0 +1,147 @@
+/* Benchmark of src/common/id_hash.c as used for the slurmctld job table.
+ *
+ * Measures lookups per second of job IDs at 10k, 100k and 1M jobs for the
+ * id_hash table and for the previous fixed size chained hash table (sized
+ * at the default MaxJobCount of 10000), along with insert and job turnover
+ * (remove oldest, add newest) rates for id_hash.
+ *
+ * Usage: id_hash-bench [lookups]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <src/common/id_hash.h>
+#include <src/common/xmalloc.h>
+
+#define FIRST_JOB_ID	1000
+#define OLD_HASH_SIZE	10000
+
+typedef struct job_rec {
+	uint32_t job_id;
+	struct job_rec *job_next;	/* for the chained table */
+} job_rec_t;
+
+static job_rec_t **old_hash = NULL;
+
+static double _secs_since(struct timeval *start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) +
+	       (now.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static void _old_add(job_rec_t *job_ptr)
+{
+	int inx = job_ptr->job_id % OLD_HASH_SIZE;
+
+	job_ptr->job_next = old_hash[inx];
+	old_hash[inx] = job_ptr;
+}
+
+static job_rec_t *_old_find(uint32_t job_id)
+{
+	job_rec_t *job_ptr = old_hash[job_id % OLD_HASH_SIZE];
+
+	while (job_ptr) {
+		if (job_ptr->job_id == job_id)
+			return job_ptr;
+		job_ptr = job_ptr->job_next;
+	}
+	return NULL;
+}
+
+static int _bench(uint32_t job_cnt, uint32_t lookups)
+{
+	job_rec_t *jobs = xmalloc(sizeof(job_rec_t) * job_cnt * 2);
+	uint32_t *keys = xmalloc(sizeof(uint32_t) * lookups);
+	id_hash_t *hash = id_hash_create(OLD_HASH_SIZE);
+	struct timeval tv;
+	double secs;
+	uint32_t i, found = 0;
+	int errors = 0;
+
+	old_hash = xmalloc(sizeof(job_rec_t *) * OLD_HASH_SIZE);
+	for (i = 0; i < job_cnt * 2; i++)
+		jobs[i].job_id = FIRST_JOB_ID + i;
+	for (i = 0; i < lookups; i++)
+		keys[i] = FIRST_JOB_ID + (random() % job_cnt);
+
+	printf("%u jobs\n", job_cnt);
+
+	gettimeofday(&tv, NULL);
+	for (i = 0; i < job_cnt; i++)
+		id_hash_add(hash, jobs[i].job_id, &jobs[i]);
+	secs = _secs_since(&tv);
+	printf("  id_hash inserts     %12.0f per second\n", job_cnt / secs);
+	for (i = 0; i < job_cnt; i++)
+		_old_add(&jobs[i]);
+
+	gettimeofday(&tv, NULL);
+	for (i = 0; i < lookups; i++) {
+		if (id_hash_find(hash, keys[i]))
+			found++;
+	}
+	secs = _secs_since(&tv);
+	printf("  id_hash lookups     %12.0f per second\n", lookups / secs);
+	if (found != lookups) {
+		printf("ERROR: id_hash found %u of %u\n", found, lookups);
+		errors++;
+	}
+
+	found = 0;
+	gettimeofday(&tv, NULL);
+	for (i = 0; i < lookups; i++) {
+		if (_old_find(keys[i]))
+			found++;
+	}
+	secs = _secs_since(&tv);
+	printf("  chained lookups     %12.0f per second\n", lookups / secs);
+	if (found != lookups) {
+		printf("ERROR: chained table found %u of %u\n", found, lookups);
+		errors++;
+	}
+
+	/* Job turnover: purge the oldest job and add a new one */
+	gettimeofday(&tv, NULL);
+	for (i = 0; i < job_cnt; i++) {
+		if (id_hash_remove(hash, jobs[i].job_id) != &jobs[i])
+			errors++;
+		id_hash_add(hash, jobs[job_cnt + i].job_id, &jobs[job_cnt + i]);
+	}
+	secs = _secs_since(&tv);
+	printf("  id_hash turnover    %12.0f per second\n", job_cnt / secs);
+	if (id_hash_count(hash) != job_cnt) {
+		printf("ERROR: id_hash count %u, expected %u\n",
+		       id_hash_count(hash), job_cnt);
+		errors++;
+	}
+
+	id_hash_destroy(hash);
+	xfree(old_hash);
+	xfree(jobs);
+	xfree(keys);
+	return errors;
+}
+
+int
+main(int argc, char *argv[])
+{
+	uint32_t job_cnts[] = { 10000, 100000, 1000000 };
+	uint32_t lookups = 1000000;
+	int i, errors = 0;
+
+	if (argc > 1)
+		lookups = atoi(argv[1]);
+	if (lookups < 1)
+		lookups = 1;
+	srandom(1);
+
+	for (i = 0; i < sizeof(job_cnts) / sizeof(job_cnts[0]); i++)
+		errors += _bench(job_cnts[i], lookups);
+
+	if (errors)
+		printf("%d ERRORS\n", errors);
+	return errors ? 1 : 0;
+}
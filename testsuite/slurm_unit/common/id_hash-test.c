@@ -0,0 +1,131 @@
+/* Test of src/common/id_hash.c
+ */
+#include <stdlib.h>
+#include <slurm/slurm_errno.h>
+#include <src/common/id_hash.h>
+#include <src/common/xmalloc.h>
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define MAX_ID 50000
+
+/* Return 1 if every id in [0, MAX_ID) maps to shadow[id] */
+static int _verify(id_hash_t *hash, void **shadow)
+{
+	uint32_t id, count = 0;
+
+	for (id = 0; id < MAX_ID; id++) {
+		if (id_hash_find(hash, id) != shadow[id])
+			return 0;
+		if (shadow[id])
+			count++;
+	}
+	return (id_hash_count(hash) == count);
+}
+
+int
+main(int argc, char *argv[])
+{
+	note("Testing basic operations");
+	{
+		id_hash_t *hash = id_hash_create(0);
+		int a, b;
+
+		TEST(id_hash_find(hash, 1) == NULL, "find in empty table");
+		id_hash_add(hash, 1, &a);
+		id_hash_add(hash, 17, &b);
+		TEST(id_hash_find(hash, 1) == &a, "find");
+		TEST(id_hash_find(hash, 17) == &b, "find");
+		TEST(id_hash_count(hash) == 2, "count");
+		TEST(id_hash_add(hash, 1, &b) == SLURM_ERROR,
+		     "duplicate id rejected");
+		TEST(id_hash_find(hash, 1) == &a, "find after duplicate");
+		TEST(id_hash_count(hash) == 2, "count after duplicate");
+		TEST(id_hash_remove(hash, 1) == &a, "remove");
+		TEST(id_hash_remove(hash, 1) == NULL, "remove missing");
+		TEST(id_hash_find(hash, 17) == &b, "find after remove");
+		TEST(id_hash_count(hash) == 1, "count after remove");
+		id_hash_destroy(hash);
+	}
+
+	note("Testing sequential ids with growth and shrinkage");
+	{
+		id_hash_t *hash = id_hash_create(16);
+		void **shadow = xmalloc(sizeof(void *) * MAX_ID);
+		uint32_t id;
+		int ok = 1;
+
+		for (id = 0; id < 40000; id++) {
+			shadow[id] = &shadow[id];
+			if (id_hash_add(hash, id, shadow[id]) != SLURM_SUCCESS)
+				ok = 0;
+			/* ids added earlier may still be in the old table */
+			if ((id >= 7) &&
+			    (id_hash_add(hash, id - 7, shadow) != SLURM_ERROR))
+				ok = 0;
+			if (((id % 997) == 0) && !_verify(hash, shadow))
+				ok = 0;
+		}
+		TEST(ok, "verify while growing");
+		TEST(_verify(hash, shadow), "verify after growing");
+		for (id = 0, ok = 1; id < 39990; id++) {
+			if (id_hash_remove(hash, id) != shadow[id])
+				ok = 0;
+			shadow[id] = NULL;
+			if (((id % 997) == 0) && !_verify(hash, shadow))
+				ok = 0;
+		}
+		TEST(ok, "verify while shrinking");
+		TEST(_verify(hash, shadow), "verify after shrinking");
+		id_hash_destroy(hash);
+		xfree(shadow);
+	}
+
+	note("Testing random operations");
+	{
+		id_hash_t *hash = id_hash_create(100);
+		void **shadow = xmalloc(sizeof(void *) * MAX_ID);
+		uint32_t id;
+		int i, rc, remove_pct, round, ok = 1;
+
+		srandom(1);
+		/* Alternate between filling and draining the table so that
+		 * operations overlap incremental resizes in both directions */
+		for (round = 0; round < 8; round++) {
+			remove_pct = (round & 1) ? 90 : 10;
+			for (i = 0; i < 100000; i++) {
+				id = random() % MAX_ID;
+				if ((random() % 100) < remove_pct) {
+					if (id_hash_remove(hash, id) !=
+					    shadow[id])
+						ok = 0;
+					shadow[id] = NULL;
+				} else {
+					rc = shadow[id] ? SLURM_ERROR :
+							  SLURM_SUCCESS;
+					if (id_hash_add(hash, id, &shadow[id])
+					    != rc)
+						ok = 0;
+					shadow[id] = &shadow[id];
+				}
+				if ((i % 9973) == 0 && !_verify(hash, shadow))
+					ok = 0;
+			}
+		}
+		TEST(ok, "verify during random operations");
+		TEST(_verify(hash, shadow), "verify after random operations");
+		id_hash_destroy(hash);
+		xfree(shadow);
+	}
+
+	totals();
+	return failed;
+}
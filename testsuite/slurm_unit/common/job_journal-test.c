@@ -0,0 +1,161 @@
+/* Test of src/slurmctld/job_journal.c
+ *
+ * A snapshot and journal of job records are replayed as by
+ * load_all_job_state(), including journals cut short or corrupted as by a
+ * crash during a write.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <slurm/slurm_errno.h>
+#include <src/common/id_hash.h>
+#include <src/common/pack.h>
+#include <src/common/xmalloc.h>
+#include <src/slurmctld/job_journal.h>
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define MAX_JOB 8
+
+static char *loaded[MAX_JOB];	/* state loaded for each job */
+static int load_cnt;
+static uint32_t job_id_seq;
+static uint32_t snapshot_size;
+
+static void _pack_save(uint32_t job_id, char *state, Buf buffer)
+{
+	uint32_t img_offset = job_journal_pack_begin(job_id, buffer);
+
+	pack32(job_id, buffer);
+	packstr(state, buffer);
+	job_journal_pack_end(img_offset, buffer);
+}
+
+/* Load the records of a snapshot or journal up to end, RET 0 on success */
+static int _load(Buf buffer, uint32_t end, id_hash_t *hash, bool journal)
+{
+	uint32_t job_id, len, state_len;
+	char *state;
+	int rc;
+
+	while (get_buf_offset(buffer) < end) {
+		rc = job_journal_next(buffer, hash, journal, &len);
+		if (rc < 0)
+			return -1;
+		if (rc == 0)
+			continue;
+		if ((unpack32(&job_id, buffer) != SLURM_SUCCESS) ||
+		    (job_id >= MAX_JOB) ||
+		    (unpackstr_xmalloc(&state, &state_len, buffer)
+		     != SLURM_SUCCESS))
+			return -1;
+		xfree(loaded[job_id]);
+		loaded[job_id] = state;
+		load_cnt++;
+	}
+	return 0;
+}
+
+/* Replay a snapshot and the first journal_size bytes of a journal,
+ * RET 0 on success */
+static int _replay(Buf snapshot, Buf journal, uint32_t journal_size)
+{
+	id_hash_t *hash = id_hash_create(0);
+	Buf log = NULL;
+	uint32_t end = 0;
+	int i, rc;
+
+	for (i = 0; i < MAX_JOB; i++)
+		xfree(loaded[i]);
+	load_cnt = 0;
+	job_id_seq = 0;
+	set_buf_offset(snapshot, 0);
+	if (journal) {
+		log = create_buf(xmalloc(journal_size), journal_size);
+		memcpy(get_buf_data(log), get_buf_data(journal), journal_size);
+		end = job_journal_scan(log, hash, &job_id_seq);
+	}
+	rc = _load(snapshot, snapshot_size, hash, false);
+	if ((rc == 0) && log)
+		rc = _load(log, end, hash, true);
+	if (log)
+		free_buf(log);
+	id_hash_destroy(hash);
+	return rc;
+}
+
+static bool _is(uint32_t job_id, char *state)
+{
+	if (!state)
+		return (loaded[job_id] == NULL);
+	return (loaded[job_id] && !strcmp(loaded[job_id], state));
+}
+
+int
+main(int argc, char *argv[])
+{
+	Buf snapshot = init_buf(1024), journal = init_buf(1024);
+	uint32_t rec4_offset, rec5_offset, full_size;
+
+	_pack_save(1, "1a", snapshot);
+	_pack_save(2, "2a", snapshot);
+	_pack_save(3, "3a", snapshot);
+	snapshot_size = get_buf_offset(snapshot);
+
+	job_journal_pack_op(JOB_JOURNAL_SEQ, 40, journal);
+	_pack_save(2, "2b", journal);
+	job_journal_pack_op(JOB_JOURNAL_PURGE, 3, journal);
+	rec4_offset = get_buf_offset(journal);
+	_pack_save(4, "4a", journal);
+	_pack_save(2, "2c", journal);
+	rec5_offset = get_buf_offset(journal);
+	_pack_save(5, "5a", journal);
+	full_size = get_buf_offset(journal);
+
+	note("Testing a snapshot without a journal");
+	TEST(_replay(snapshot, NULL, 0) == 0, "replay");
+	TEST(_is(1, "1a") && _is(2, "2a") && _is(3, "3a"), "snapshot loaded");
+	TEST(load_cnt == 3, "each job loaded once");
+
+	note("Testing replay of a complete journal");
+	TEST(_replay(snapshot, journal, full_size) == 0, "replay");
+	TEST(_is(1, "1a"), "unchanged job from snapshot");
+	TEST(_is(2, "2c"), "last of several journal records");
+	TEST(_is(3, NULL), "purged job not loaded");
+	TEST(_is(4, "4a") && _is(5, "5a"), "new jobs from journal");
+	TEST(load_cnt == 4, "each job loaded once");
+	TEST(job_id_seq == 40, "job id sequence");
+
+	note("Testing a journal cut short in a record");
+	TEST(_replay(snapshot, journal, full_size - 3) == 0, "replay");
+	TEST(_is(5, NULL), "cut record not loaded");
+	TEST(_is(2, "2c") && _is(4, "4a"), "records before cut loaded");
+	TEST(_replay(snapshot, journal, rec5_offset + 5) == 0,
+	     "replay cut in header");
+	TEST(_is(5, NULL) && _is(2, "2c"), "cut header ignored");
+
+	note("Testing a journal with a bad checksum");
+	get_buf_data(journal)[full_size - 1] ^= 0x5a;
+	get_buf_data(journal)[rec4_offset + 20] ^= 0x5a;
+	TEST(_replay(snapshot, journal, full_size) == 0, "replay");
+	TEST(_is(4, NULL), "corrupt record not loaded");
+	TEST(_is(2, "2b"), "records after corrupt record not loaded");
+	TEST(_is(3, NULL) && _is(1, "1a"), "records before corrupt loaded");
+	TEST(job_id_seq == 40, "job id sequence");
+
+	note("Testing an empty journal");
+	TEST(_replay(snapshot, journal, 0) == 0, "replay");
+	TEST(_is(1, "1a") && _is(2, "2a") && _is(3, "3a"), "snapshot loaded");
+
+	free_buf(snapshot);
+	free_buf(journal);
+	totals();
+	return failed;
+}
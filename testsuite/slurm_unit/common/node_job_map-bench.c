@@ -0,0 +1,182 @@
+/* Benchmark of src/slurmctld/node_job_map.c.
+ *
+ * Builds a job list for 1000 to 16000 nodes, with a quarter of the jobs
+ * running on 1 to 8 nodes each and the rest pending or completed, then
+ * has every node register in turn, as after a slurmctld restart or network
+ * outage. For each registration the jobs which should be on the node are
+ * found both by a walk of the job list, as _purge_missing_jobs() did, and
+ * from the node to job map. Between storms a tenth of the running jobs
+ * complete and as many new jobs start, so stale map entries are pruned as
+ * they would be. Reports the cost of a registration for each method and
+ * compares the jobs found.
+ *
+ * Usage: node_job_map-bench [storms]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <src/common/bitstring.h>
+#include <src/common/list.h>
+#include <src/common/xmalloc.h>
+#include <src/slurmctld/node_job_map.h>
+#include <src/slurmctld/slurmctld.h>
+
+#define MAX_JOB_NODES 8
+
+List job_list = NULL;	/* referenced by node_job_map_rebuild() */
+
+static double _secs_since(struct timeval *start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) +
+	       (now.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static void _job_free(void *x)
+{
+	struct job_record *job_ptr = (struct job_record *) x;
+
+	node_job_map_remove(job_ptr);
+	FREE_NULL_BITMAP(job_ptr->node_bitmap);
+	xfree(job_ptr);
+}
+
+/* Allocate a job a random block of nodes */
+static void _job_start(struct job_record *job_ptr, int node_cnt)
+{
+	int first = random() % node_cnt;
+	int cnt = (random() % MAX_JOB_NODES) + 1;
+
+	FREE_NULL_BITMAP(job_ptr->node_bitmap);
+	job_ptr->node_bitmap = bit_alloc(node_cnt);
+	bit_nset(job_ptr->node_bitmap, first, MIN(first + cnt, node_cnt) - 1);
+	job_ptr->job_state = JOB_RUNNING;
+}
+
+/* Jobs on a node found by a walk of the job list */
+static int _old_find(int node_inx)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	int cnt = 0;
+
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		if ((!IS_JOB_RUNNING(job_ptr) && !IS_JOB_SUSPENDED(job_ptr)) ||
+		    !bit_test(job_ptr->node_bitmap, node_inx))
+			continue;
+		cnt++;
+	}
+	list_iterator_destroy(job_iterator);
+	return cnt;
+}
+
+/* Jobs on a node found from the node to job map */
+static int _new_find(int node_inx)
+{
+	struct job_record *job_ptr, **job_array;
+	int i, job_cnt, cnt = 0;
+
+	job_cnt = node_job_map_get(node_inx, &job_array);
+	for (i = 0; i < job_cnt; i++) {
+		job_ptr = job_array[i];
+		if ((!IS_JOB_RUNNING(job_ptr) && !IS_JOB_SUSPENDED(job_ptr)) ||
+		    !bit_test(job_ptr->node_bitmap, node_inx))
+			continue;
+		cnt++;
+	}
+	xfree(job_array);
+	return cnt;
+}
+
+static int _bench(int node_cnt, int storms)
+{
+	struct job_record **running;
+	struct job_record *job_ptr;
+	struct timeval tv;
+	double old_secs = 0.0, new_secs = 0.0;
+	int job_cnt = node_cnt * 4, run_cnt = 0;
+	int i, s, old_total, new_total, errors = 0;
+
+	node_record_count = node_cnt;
+	job_list = list_create(_job_free);
+	running = xmalloc(sizeof(struct job_record *) * job_cnt);
+	for (i = 0; i < job_cnt; i++) {
+		job_ptr = xmalloc(sizeof(struct job_record));
+		job_ptr->job_id = i + 1;
+		if ((i % 4) == 0) {
+			_job_start(job_ptr, node_cnt);
+			running[run_cnt++] = job_ptr;
+		} else if ((i % 4) == 1) {
+			_job_start(job_ptr, node_cnt);
+			job_ptr->job_state = JOB_COMPLETE;
+		} else
+			job_ptr->job_state = JOB_PENDING;
+		list_append(job_list, job_ptr);
+	}
+	node_job_map_rebuild();
+
+	for (s = 0; s < storms; s++) {
+		old_total = new_total = 0;
+		gettimeofday(&tv, NULL);
+		for (i = 0; i < node_cnt; i++)
+			old_total += _old_find(i);
+		old_secs += _secs_since(&tv);
+
+		gettimeofday(&tv, NULL);
+		for (i = 0; i < node_cnt; i++)
+			new_total += _new_find(i);
+		new_secs += _secs_since(&tv);
+
+		if (old_total != new_total) {
+			printf("ERROR: storm %d found %d jobs by list walk, "
+			       "%d from map\n", s, old_total, new_total);
+			errors++;
+		}
+
+		/* Churn: a tenth of running jobs end, as many start */
+		for (i = 0; i < run_cnt / 10; i++) {
+			job_ptr = running[random() % run_cnt];
+			job_ptr->job_state = JOB_COMPLETE;
+			job_ptr = running[random() % run_cnt];
+			_job_start(job_ptr, node_cnt);
+			node_job_map_add(job_ptr);
+		}
+	}
+
+	printf("%5d nodes %6d jobs  list walk %9.2f usec/registration  "
+	       "node_job_map %6.2f usec/registration\n", node_cnt, job_cnt,
+	       old_secs * 1000000 / (storms * node_cnt),
+	       new_secs * 1000000 / (storms * node_cnt));
+	fflush(stdout);
+
+	list_destroy(job_list);
+	job_list = NULL;
+	node_job_map_fini();
+	xfree(running);
+	return errors;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int node_cnts[] = { 1000, 4000, 16000 };
+	int storms = 5;
+	int i, errors = 0;
+
+	if (argc > 1)
+		storms = atoi(argv[1]);
+	if (storms < 1)
+		storms = 1;
+
+	srandom(1);
+	for (i = 0; i < sizeof(node_cnts) / sizeof(node_cnts[0]); i++)
+		errors += _bench(node_cnts[i], storms);
+
+	if (errors)
+		printf("%d ERRORS\n", errors);
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,471 @@
+/* Benchmark of the KVS of the mpi/pmi2 plugin.
+ *
+ * Simulates a fence of 1000 to 100000 ranks, each putting one key, as MPICH
+ * does for its business cards, or 16, as libraries publishing an address
+ * per network component do: the pairs are collected with
+ * temp_kvs_add(), as the stepds of the fence tree do, then the message sent
+ * is put into the hash, as every stepd does with the fence response, and
+ * every key is got back. Reports the cost for the previous fixed-size hash
+ * with a linearly grown fence buffer and for
+ * src/plugins/mpi/pmi2/kvs.c, the best of BENCH_ROUNDS alternated runs of
+ * each after one not counted, so that both allocate from a heap the other
+ * has freed. The values got by both are checked.
+ *
+ * Then, with direct get, the ranks of every node put their keys, which
+ * are sent to the stepds owning them. On the first node, the 16 ranks each
+ * get their own keys and the keys of one rank elsewhere, fetched from a
+ * stub of the owners. Reports the bytes that node sends to the owners of
+ * its pairs, receives as the owner of others, and sends and receives
+ * fetching values, against the size of the broadcast fence response.
+ *
+ * Usage: pmi2_kvs-bench [ranks [keys_per_rank]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+/* before other slurm headers, for the names of slurm_xlator.h */
+#include <src/plugins/mpi/pmi2/kvs.h>
+#include <src/plugins/mpi/pmi2/setup.h>
+
+#include <src/common/pack.h>
+#include <src/common/xmalloc.h>
+#include <src/common/xstring.h>
+
+#define LOCAL_RANKS 16
+#define BENCH_ROUNDS 3
+#define OLD_TASKS_PER_BUCKET 8
+#define OLD_TEMP_KVS_SIZE_INC 2048
+
+/* what kvs.c needs of the rest of the plugin */
+pmi2_job_info_t job_info;
+pmi2_tree_info_t tree_info;
+static char *sent_msg = NULL;
+static uint32_t sent_len = 0;
+static uint32_t owner_bytes = 0, owned_bytes = 0, fetch_bytes = 0;
+static Buf owned_buf = NULL;	/* pairs sent to the first node as owner */
+/* the response of the owner of the key last got */
+static char *resp_key = NULL, *resp_val = NULL;
+
+static char *_old_get(char *key);
+
+bool in_stepd(void)
+{
+	return true;
+}
+
+static int _sent(uint32_t len, char *msg)
+{
+	xfree(sent_msg);
+	sent_msg = xmalloc(len);
+	memcpy(sent_msg, msg, len);
+	sent_len = len;
+	return SLURM_SUCCESS;
+}
+
+int tree_msg_to_srun(uint32_t len, char *msg)
+{
+	return _sent(len, msg);
+}
+
+/* the stepds owning keys with direct get, answering from the pairs put
+ * into the old hash, and the fence tree otherwise */
+int tree_msg_to_stepds(char *nodelist, uint32_t len, char *msg)
+{
+	Buf buf = create_buf(xmalloc(len), len), resp;
+	uint32_t nodeid, temp32;
+	uint16_t cmd;
+	char *key;
+
+	memcpy(get_buf_data(buf), msg, len);
+	unpack16(&cmd, buf);
+	/* with the length and uid slurmd writes before each message */
+	if (cmd == TREE_CMD_KVS_PUT) {
+		if (!strcmp(nodelist, "node00000")) {
+			owned_bytes += len + 2 * sizeof(uint32_t);
+			grow_buf(owned_buf, remaining_buf(buf));
+			memcpy(get_buf_data(owned_buf) +
+			       get_buf_offset(owned_buf),
+			       get_buf_data(buf) + get_buf_offset(buf),
+			       remaining_buf(buf));
+			set_buf_offset(owned_buf, get_buf_offset(owned_buf) +
+				       remaining_buf(buf));
+		} else if (job_info.nodeid == 0)
+			owner_bytes += len + 2 * sizeof(uint32_t);
+	} else if (cmd == TREE_CMD_KVS_GET) {
+		fetch_bytes += len + 2 * sizeof(uint32_t);
+		unpack32(&nodeid, buf);
+		unpackmem_ptr(&key, &temp32, buf);
+		resp = init_buf(1024);
+		pack16((uint16_t)TREE_CMD_KVS_GET_RESP, resp);
+		packstr(key, resp);
+		packstr(_old_get(key), resp);
+		fetch_bytes += get_buf_offset(resp) + 2 * sizeof(uint32_t);
+		free_buf(resp);
+		xfree(resp_key);
+		xfree(resp_val);
+		resp_key = xstrdup(key);
+		resp_val = xstrdup(_old_get(key));
+	} else {
+		_sent(len, msg);
+	}
+	free_buf(buf);
+	return SLURM_SUCCESS;
+}
+
+/* a task, taking the response to its get */
+static char *got_val = NULL;
+static int got_cnt = 0;
+
+static int _got(int fd, int lrank, char *val)
+{
+	xfree(got_val);
+	got_val = xstrdup(val);
+	got_cnt++;
+	return SLURM_SUCCESS;
+}
+
+/* get key as a task does, RET 0 if val is got */
+static int _task_get(char *key, char *val)
+{
+	got_cnt = 0;
+	kvs_get_async(key, 0, 0, _got);
+	if (resp_key) {
+		/* the agent reading the owner's response */
+		kvs_get_resp(resp_key, resp_val);
+		xfree(resp_key);
+		xfree(resp_val);
+	}
+	return ((got_cnt == 1) && got_val && !strcmp(got_val, val)) ? 0 : 1;
+}
+
+/* the KVS as it was before */
+typedef struct old_bucket {
+	char **pairs;
+	uint32_t count;
+	uint32_t size;
+} old_bucket_t;
+
+static old_bucket_t *old_hash = NULL;
+static uint32_t old_hash_size = 0;
+static char *old_temp_buf = NULL;
+static int old_temp_cnt = 0, old_temp_size = 0;
+
+static uint32_t _old_hash(char *key)
+{
+	int len, i;
+	uint32_t hash = 0;
+	uint8_t shift;
+
+	len = strlen(key);
+	for (i = 0; i < len; i ++) {
+		shift = (uint8_t)(hash >> 24);
+		hash = (hash << 8) | (uint32_t)(shift ^ (uint8_t)key[i]);
+	}
+	return hash;
+}
+
+static void _old_temp_add(char *key, char *val)
+{
+	Buf buf;
+	uint32_t size;
+
+	buf = init_buf(1024 + 1024 + 2 * sizeof(uint32_t));
+	packstr(key, buf);
+	packstr(val, buf);
+	size = get_buf_offset(buf);
+	if (old_temp_cnt + size > old_temp_size) {
+		old_temp_size += OLD_TEMP_KVS_SIZE_INC;
+		xrealloc(old_temp_buf, old_temp_size);
+	}
+	memcpy(&old_temp_buf[old_temp_cnt], get_buf_data(buf), size);
+	old_temp_cnt += size;
+	free_buf(buf);
+}
+
+/* with the logging of kvs.c, which costs a lock even when not logged */
+static void _old_put(char *key, char *val)
+{
+	old_bucket_t *bucket;
+	int i;
+
+	debug3("mpi/pmi2: in kvs_put");
+	bucket = &old_hash[_old_hash(key) % old_hash_size];
+	for (i = 0; i < bucket->count; i ++) {
+		if (! strcmp(key, bucket->pairs[i * 2])) {
+			xfree(bucket->pairs[i * 2 + 1]);
+			bucket->pairs[i * 2 + 1] = xstrdup(val);
+			return;
+		}
+	}
+	if (bucket->count * 2 >= bucket->size) {
+		bucket->size += (OLD_TASKS_PER_BUCKET * 2);
+		xrealloc(bucket->pairs, bucket->size * sizeof(char *));
+	}
+	i = bucket->count;
+	bucket->pairs[i * 2] = xstrdup(key);
+	bucket->pairs[i * 2 + 1] = xstrdup(val);
+	bucket->count ++;
+	debug3("mpi/pmi2: put kvs %s=%s", key, val);
+}
+
+static char *_old_get(char *key)
+{
+	old_bucket_t *bucket;
+	char *val = NULL;
+	int i;
+
+	debug3("mpi/pmi2: in kvs_get, key=%s", key);
+	bucket = &old_hash[_old_hash(key) % old_hash_size];
+	for (i = 0; i < bucket->count; i ++) {
+		if (! strcmp(key, bucket->pairs[i * 2])) {
+			val = bucket->pairs[i * 2 + 1];
+			break;
+		}
+	}
+	debug3("mpi/pmi2: out kvs_get, val=%s", val);
+	return val;
+}
+
+static void _old_clear(void)
+{
+	int i, j;
+
+	for (i = 0; i < old_hash_size; i ++) {
+		for (j = 0; j < old_hash[i].count * 2; j ++)
+			xfree(old_hash[i].pairs[j]);
+		xfree(old_hash[i].pairs);
+	}
+	xfree(old_hash);
+	xfree(old_temp_buf);
+	old_temp_cnt = old_temp_size = 0;
+}
+
+static double _secs_since(struct timeval *start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) +
+	       (now.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static int keys_per_rank = 1;
+
+static void _key_val(int pair, char *key, char *val)
+{
+	int rank = pair / keys_per_rank;
+
+	if (keys_per_rank == 1)
+		sprintf(key, "P%d-businesscard", rank);
+	else
+		sprintf(key, "P%d-component%d", rank, pair % keys_per_rank);
+	sprintf(val, "description#node%05d$port#%d$ifname#10.1.%d.%d$",
+		rank / 16, 40000 + pair, (rank / 256) % 256, rank % 256);
+}
+
+/* the pairs of a fence message, past the header put by temp_kvs_init() */
+static Buf _fence_pairs(char *msg, uint32_t len)
+{
+	Buf buf = create_buf(xmalloc(len), len);
+	uint32_t temp32;
+	uint16_t cmd;
+	char *node;
+
+	memcpy(get_buf_data(buf), msg, len);
+	unpack16(&cmd, buf);
+	unpack32(&temp32, buf);
+	unpackmem_ptr(&node, &temp32, buf);
+	unpack32(&temp32, buf);
+	return buf;
+}
+
+/* the previous KVS, RET count of values not got back */
+static int _bench_old(int pairs, double *fence, double *get)
+{
+	char key[64], val[128], *got;
+	struct timeval tv;
+	int i, errors = 0;
+	Buf buf;
+
+	old_hash_size = (job_info.ntasks + OLD_TASKS_PER_BUCKET - 1) /
+			OLD_TASKS_PER_BUCKET;
+	old_hash = xmalloc(old_hash_size * sizeof(old_bucket_t));
+	gettimeofday(&tv, NULL);
+	for (i = 0; i < pairs; i++) {
+		_key_val(i, key, val);
+		_old_temp_add(key, val);
+	}
+	/* sent and received as by kvs.c below */
+	_sent(old_temp_cnt, old_temp_buf);
+	buf = create_buf(xmalloc(sent_len), sent_len);
+	memcpy(get_buf_data(buf), sent_msg, sent_len);
+	while (remaining_buf(buf) > 0) {
+		char *k, *v;
+		uint32_t temp32;
+		unpackmem_ptr(&k, &temp32, buf);
+		unpackmem_ptr(&v, &temp32, buf);
+		_old_put(k, v);
+	}
+	free_buf(buf);
+	*fence = _secs_since(&tv);
+	gettimeofday(&tv, NULL);
+	for (i = 0; i < pairs; i++) {
+		_key_val(i, key, val);
+		got = _old_get(key);
+		if (!got || strcmp(got, val))
+			errors++;
+	}
+	*get = _secs_since(&tv);
+	return errors;
+}
+
+/* kvs.c, RET count of values not got back */
+static int _bench_new(int pairs, double *fence, double *get)
+{
+	char key[64], val[128], *got;
+	struct timeval tv;
+	int i, errors = 0;
+	Buf buf;
+
+	temp_kvs_init();
+	kvs_init();
+	gettimeofday(&tv, NULL);
+	for (i = 0; i < pairs; i++) {
+		_key_val(i, key, val);
+		temp_kvs_add(key, val);
+	}
+	temp_kvs_send();
+	buf = _fence_pairs(sent_msg, sent_len);
+	kvs_put_buf(buf);
+	free_buf(buf);
+	*fence = _secs_since(&tv);
+	gettimeofday(&tv, NULL);
+	for (i = 0; i < pairs; i++) {
+		_key_val(i, key, val);
+		got = kvs_get(key);
+		if (!got || strcmp(got, val))
+			errors++;
+	}
+	*get = _secs_since(&tv);
+	kvs_clear();
+	return errors;
+}
+
+static int _bench(int ranks, int keys)
+{
+	char key[64], val[128], *nodelist = NULL;
+	double old_fence = 0, old_get = 0, new_fence = 0, new_get = 0;
+	double fence, get;
+	uint32_t bcast_len;
+	int i, k, n, peer, pairs, round, errors = 0;
+	Buf buf;
+
+	job_info.ntasks = ranks;
+	job_info.nnodes = (ranks + LOCAL_RANKS - 1) / LOCAL_RANKS;
+	job_info.nodeid = 0;
+	keys_per_rank = keys;
+	pairs = ranks * keys;
+
+	for (round = 0; round <= BENCH_ROUNDS; round++) {
+		errors += _bench_old(pairs, &fence, &get);
+		if ((round == 1) || (fence < old_fence))
+			old_fence = fence;
+		if ((round == 1) || (get < old_get))
+			old_get = get;
+		if (round < BENCH_ROUNDS)
+			_old_clear();
+		errors += _bench_new(pairs, &fence, &get);
+		if ((round == 1) || (fence < new_fence))
+			new_fence = fence;
+		if ((round == 1) || (get < new_get))
+			new_get = get;
+	}
+	bcast_len = sent_len;
+
+	/* direct get, the old hash standing for the owners' */
+	job_info.kvs_direct_get = 1;
+	xstrfmtcat(nodelist, "node[00000-%05d]", job_info.nnodes - 1);
+	job_info.step_nodelist = nodelist;
+	owner_bytes = owned_bytes = fetch_bytes = 0;
+	owned_buf = init_buf(1024);
+	/* the other nodes, keeping what they send to the first */
+	temp_kvs_init();
+	kvs_init();
+	for (n = 1; n < job_info.nnodes; n++) {
+		job_info.nodeid = n;
+		for (i = n * LOCAL_RANKS * keys;
+		     (i < (n + 1) * LOCAL_RANKS * keys) && (i < pairs); i++) {
+			_key_val(i, key, val);
+			temp_kvs_add(key, val);
+		}
+		temp_kvs_send();
+	}
+	kvs_clear();
+	job_info.nodeid = 0;
+	temp_kvs_init();
+	kvs_init();
+	for (i = 0; i < LOCAL_RANKS * keys; i++) {
+		_key_val(i, key, val);
+		temp_kvs_add(key, val);
+	}
+	temp_kvs_send();
+	buf = create_buf(xmalloc(get_buf_offset(owned_buf)),
+			 get_buf_offset(owned_buf));
+	memcpy(get_buf_data(buf), get_buf_data(owned_buf),
+	       get_buf_offset(owned_buf));
+	free_buf(owned_buf);
+	kvs_put_buf(buf);
+	free_buf(buf);
+	for (i = 0; i < LOCAL_RANKS; i++) {
+		peer = (ranks / 2 + i * 7919) % ranks;
+		for (k = 0; k < keys; k++) {
+			_key_val(i * keys + k, key, val);
+			errors += _task_get(key, val);
+			_key_val(peer * keys + k, key, val);
+			errors += _task_get(key, val);
+		}
+	}
+	kvs_clear();
+	job_info.kvs_direct_get = 0;
+	job_info.step_nodelist = NULL;
+	xfree(nodelist);
+	_old_clear();
+
+	printf("%6d ranks %2d keys  previous fence %8.1f msec get %6.3f usec"
+	       "  kvs.c fence %8.1f msec get %6.3f usec\n", ranks, keys,
+	       old_fence * 1000, old_get * 1000000 / pairs,
+	       new_fence * 1000, new_get * 1000000 / pairs);
+	printf("%25s bytes of a node: broadcast %9u  direct get to owners "
+	       "%6u as owner %6u fetched %6u\n", "", bcast_len, owner_bytes,
+	       owned_bytes, fetch_bytes);
+	fflush(stdout);
+	return errors;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int rank_cnts[] = { 1000, 10000, 100000 };
+	int key_cnts[] = { 1, 16 };
+	int i, k, errors = 0;
+
+	memset(&job_info, 0, sizeof(job_info));
+	memset(&tree_info, 0, sizeof(tree_info));
+	tree_info.this_node = "node00000";
+
+	if (argc > 1) {
+		errors = _bench(atoi(argv[1]), (argc > 2) ? atoi(argv[2]) : 1);
+	} else {
+		for (k = 0; k < sizeof(key_cnts) / sizeof(key_cnts[0]); k++) {
+			for (i = 0;
+			     i < sizeof(rank_cnts) / sizeof(rank_cnts[0]); i++)
+				errors += _bench(rank_cnts[i], key_cnts[k]);
+		}
+	}
+
+	if (errors)
+		printf("%d ERRORS\n", errors);
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,353 @@
+/* Benchmark of the jobacct_gather/linux process sampler.
+ *
+ * Starts 16 to 1024 sleeping processes, as tasks each with three children,
+ * and reports the cost of a poll of the tasks' usage for the previous
+ * method (fopen and fscanf of every stat file, a /proc/<pid>/status read
+ * per process and a recursive search for each task's descendants) and for
+ * src/plugins/jobacct_gather/linux/proc_sampler.c, both for a proctrack
+ * container's list of pids and for a scan of all of /proc. The totals
+ * found by the two methods are compared.
+ *
+ * Usage: proc_sampler-bench [polls]
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <src/common/list.h>
+#include <src/common/xmalloc.h>
+#include <src/plugins/jobacct_gather/linux/proc_sampler.h>
+
+#define CHILDREN_PER_TASK 3
+
+typedef struct prec {	/* process record, as used before proc_sampler */
+	pid_t	pid;
+	pid_t	ppid;
+	int	usec;
+	int	ssec;
+	int	pages;
+	int	rss;
+	int	vsize;
+	int	last_cpu;
+} prec_t;
+
+static double _secs_since(struct timeval *start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) +
+	       (now.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static void _old_destroy_prec(void *object)
+{
+	xfree(object);
+}
+
+static int _old_is_a_lwp(uint32_t pid)
+{
+	FILE *status_fp = NULL;
+	char proc_status_file[256];
+	uint32_t tgid;
+	int rc;
+
+	snprintf(proc_status_file, 256, "/proc/%d/status", pid);
+	if ((status_fp = fopen(proc_status_file, "r")) == NULL)
+		return -1;
+	do {
+		rc = fscanf(status_fp,
+			    "Name:\t%*s\n%*[ \ta-zA-Z0-9:()]\nTgid:\t%d\n",
+			    &tgid);
+	} while (rc < 0 && errno == EINTR);
+	fclose(status_fp);
+	if (rc != 1)
+		return -1;
+	return (tgid != pid);
+}
+
+static int _old_get_process_data_line(int in, prec_t *prec)
+{
+	char sbuf[256], *tmp;
+	int num_read, nvals;
+	char cmd[40], state[1];
+	int ppid, pgrp, session, tty_nr, tpgid;
+	long unsigned flags, minflt, cminflt, majflt, cmajflt;
+	long unsigned utime, stime, starttime, vsize;
+	long int cutime, cstime, priority, nice, timeout, itrealvalue, rss;
+	long unsigned f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13;
+	int exit_signal, last_cpu;
+
+	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
+	if (num_read <= 0)
+		return 0;
+	sbuf[num_read] = '\0';
+
+	tmp = strrchr(sbuf, ')');
+	*tmp = '\0';
+	nvals = sscanf(sbuf, "%d (%39c", &prec->pid, cmd);
+	if (nvals < 2)
+		return 0;
+
+	nvals = sscanf(tmp + 2,
+		       "%c %d %d %d %d %d "
+		       "%lu %lu %lu %lu %lu "
+		       "%lu %lu %ld %ld %ld %ld "
+		       "%ld %ld %lu %lu %ld "
+		       "%lu %lu %lu %lu %lu "
+		       "%lu %lu %lu %lu %lu "
+		       "%lu %lu %lu %d %d ",
+		       state, &ppid, &pgrp, &session, &tty_nr, &tpgid,
+		       &flags, &minflt, &cminflt, &majflt, &cmajflt,
+		       &utime, &stime, &cutime, &cstime, &priority, &nice,
+		       &timeout, &itrealvalue, &starttime, &vsize, &rss,
+		       &f1, &f2, &f3, &f4, &f5 ,&f6, &f7, &f8, &f9, &f10, &f11,
+		       &f12, &f13, &exit_signal, &last_cpu);
+	if ((nvals < 37) || (rss < 0))
+		return 0;
+	if (_old_is_a_lwp(prec->pid) > 0)
+		return 0;
+
+	prec->ppid  = ppid;
+	prec->pages = majflt;
+	prec->usec  = utime;
+	prec->ssec  = stime;
+	prec->vsize = vsize / 1024;
+	prec->rss   = rss * getpagesize() / 1024;
+	prec->last_cpu = last_cpu;
+	return 1;
+}
+
+static void _old_read(List prec_list, char *proc_stat_file)
+{
+	FILE *stat_fp;
+	prec_t *prec;
+	int fd;
+
+	if ((stat_fp = fopen(proc_stat_file, "r")) == NULL)
+		return;
+	fd = fileno(stat_fp);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	prec = xmalloc(sizeof(prec_t));
+	if (_old_get_process_data_line(fd, prec))
+		list_append(prec_list, prec);
+	else
+		xfree(prec);
+	fclose(stat_fp);
+}
+
+static void _old_get_offspring_data(List prec_list, prec_t *ancestor,
+				    pid_t pid, int *cnt)
+{
+	ListIterator itr;
+	prec_t *prec = NULL;
+
+	itr = list_iterator_create(prec_list);
+	while ((prec = list_next(itr))) {
+		if (prec->ppid == pid) {
+			_old_get_offspring_data(prec_list, ancestor, prec->pid,
+						cnt);
+			ancestor->usec += prec->usec;
+			ancestor->ssec += prec->ssec;
+			ancestor->pages += prec->pages;
+			ancestor->rss += prec->rss;
+			ancestor->vsize += prec->vsize;
+			(*cnt)++;
+		}
+	}
+	list_iterator_destroy(itr);
+}
+
+/* One poll as done before proc_sampler, totals returned in rss and cnt */
+static void _old_poll(pid_t *pids, int npids, pid_t *tasks, int ntasks,
+		      uint32_t *rss, int *cnt)
+{
+	List prec_list = list_create(_old_destroy_prec);
+	char proc_stat_file[256];
+	struct dirent *ent;
+	ListIterator itr;
+	prec_t *prec;
+	DIR *dir;
+	int i;
+
+	if (pids) {
+		for (i = 0; i < npids; i++) {
+			snprintf(proc_stat_file, 256, "/proc/%d/stat", pids[i]);
+			_old_read(prec_list, proc_stat_file);
+		}
+	} else if ((dir = opendir("/proc"))) {
+		while ((ent = readdir(dir))) {
+			if ((ent->d_name[0] < '0') || (ent->d_name[0] > '9'))
+				continue;
+			snprintf(proc_stat_file, 256, "/proc/%s/stat",
+				 ent->d_name);
+			_old_read(prec_list, proc_stat_file);
+		}
+		closedir(dir);
+	}
+
+	for (i = 0; i < ntasks; i++) {
+		rss[i] = 0;
+		cnt[i] = 0;
+		itr = list_iterator_create(prec_list);
+		while ((prec = list_next(itr))) {
+			if (prec->pid != tasks[i])
+				continue;
+			cnt[i] = 1;
+			_old_get_offspring_data(prec_list, prec, prec->pid,
+						&cnt[i]);
+			rss[i] = prec->rss;
+			break;
+		}
+		list_iterator_destroy(itr);
+	}
+	list_destroy(prec_list);
+}
+
+static void _new_poll(proc_sampler_t *ps, pid_t *pids, int npids,
+		      pid_t *tasks, int ntasks, uint32_t *rss, int *cnt)
+{
+	proc_rec_t total;
+	int i;
+
+	proc_sampler_poll(ps, pids, npids);
+	for (i = 0; i < ntasks; i++) {
+		cnt[i] = proc_sampler_sum(ps, tasks[i], &total);
+		rss[i] = total.rss;
+	}
+}
+
+/* Start ntasks tasks each with CHILDREN_PER_TASK children, all sleeping.
+ * RET count of processes, their pids in pids, task pids first */
+static int _spawn(int ntasks, pid_t *pids)
+{
+	int fd[2], i, j, n = ntasks;
+	pid_t child;
+
+	if (pipe(fd))
+		exit(1);
+	for (i = 0; i < ntasks; i++) {
+		if ((pids[i] = fork()) < 0) {
+			perror("fork");
+			exit(1);
+		}
+		if (pids[i] > 0)
+			continue;
+		close(fd[0]);
+		for (j = 0; j < CHILDREN_PER_TASK; j++) {
+			if ((child = fork()) == 0) {
+				close(fd[1]);
+				pause();
+				_exit(0);
+			}
+			if (write(fd[1], &child, sizeof(child)) < 0)
+				_exit(1);
+		}
+		close(fd[1]);
+		pause();
+		_exit(0);
+	}
+	close(fd[1]);
+	for (i = 0; i < ntasks * CHILDREN_PER_TASK; i++) {
+		if (read(fd[0], &pids[n], sizeof(pid_t)) != sizeof(pid_t))
+			break;
+		n++;
+	}
+	close(fd[0]);
+	return n;
+}
+
+static int _bench(int ntasks, int polls)
+{
+	pid_t *pids = xmalloc(sizeof(pid_t) * ntasks * (CHILDREN_PER_TASK + 1));
+	uint32_t *old_rss = xmalloc(sizeof(uint32_t) * ntasks);
+	uint32_t *new_rss = xmalloc(sizeof(uint32_t) * ntasks);
+	int *old_cnt = xmalloc(sizeof(int) * ntasks);
+	int *new_cnt = xmalloc(sizeof(int) * ntasks);
+	proc_sampler_t *ps;
+	struct timeval tv;
+	double old_secs, new_secs;
+	int npids, i, p, scan, errors = 0;
+
+	npids = _spawn(ntasks, pids);
+	printf("%d processes\n", npids);
+	fflush(stdout);
+
+	for (scan = 0; scan < 2; scan++) {
+		pid_t *list = scan ? NULL : pids;
+
+		gettimeofday(&tv, NULL);
+		for (p = 0; p < polls; p++) {
+			_old_poll(list, npids, pids, ntasks, old_rss,
+				  old_cnt);
+		}
+		old_secs = _secs_since(&tv);
+
+		ps = proc_sampler_create();
+		gettimeofday(&tv, NULL);
+		for (p = 0; p < polls; p++) {
+			_new_poll(ps, list, npids, pids, ntasks, new_rss,
+				  new_cnt);
+		}
+		new_secs = _secs_since(&tv);
+		proc_sampler_destroy(ps);
+
+		printf("  %s previous %10.1f usec/poll  "
+		       "proc_sampler %10.1f usec/poll\n",
+		       scan ? "/proc scan" : "pid list  ",
+		       old_secs * 1000000 / polls,
+		       new_secs * 1000000 / polls);
+
+		for (i = 0; i < ntasks; i++) {
+			if ((new_cnt[i] != CHILDREN_PER_TASK + 1) ||
+			    (new_cnt[i] != old_cnt[i]) ||
+			    (new_rss[i] != old_rss[i])) {
+				printf("ERROR: task %d processes %d/%d "
+				       "rss %u/%u\n", (int) pids[i],
+				       old_cnt[i], new_cnt[i],
+				       old_rss[i], new_rss[i]);
+				errors++;
+			}
+		}
+	}
+
+	for (i = 0; i < npids; i++)
+		kill(pids[i], SIGKILL);
+	for (i = 0; i < ntasks; i++)
+		waitpid(pids[i], NULL, 0);
+
+	xfree(pids);
+	xfree(old_rss);
+	xfree(new_rss);
+	xfree(old_cnt);
+	xfree(new_cnt);
+	return errors;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int task_cnts[] = { 4, 16, 64, 256 };
+	int polls = 20;
+	int i, errors = 0;
+
+	if (argc > 1)
+		polls = atoi(argv[1]);
+	if (polls < 1)
+		polls = 1;
+
+	for (i = 0; i < sizeof(task_cnts) / sizeof(task_cnts[0]); i++)
+		errors += _bench(task_cnts[i], polls);
+
+	if (errors)
+		printf("%d ERRORS\n", errors);
+	return errors ? 1 : 0;
+}
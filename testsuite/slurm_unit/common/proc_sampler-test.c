@@ -0,0 +1,202 @@
+/* Test of src/plugins/jobacct_gather/linux/proc_sampler.c
+ *
+ * A tree of processes A -> (B -> D, C) is sampled from all of /proc and
+ * from a list of pids. The tree must follow processes which exit or are
+ * given a new parent, threads must not be counted, and stat files must be
+ * held open only for the processes of the step.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <src/plugins/jobacct_gather/linux/proc_sampler.h>
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+enum { PROC_A, PROC_B, PROC_C, PROC_D, PROC_CNT };
+
+static int hold[2];	/* processes wait for the write end to close */
+static int report[2];	/* processes write their role and pid */
+static pid_t pid[PROC_CNT];
+static pid_t thread_tid = 0;
+
+static pid_t _fork_role(int role, void (*body)(void))
+{
+	pid_t child = fork();
+	int msg[2];
+	char c;
+
+	if (child != 0)
+		return child;
+	close(hold[1]);
+	msg[0] = role;
+	msg[1] = (int) getpid();
+	if (write(report[1], msg, sizeof(msg)) != sizeof(msg))
+		_exit(1);
+	if (body)
+		body();
+	(void) read(hold[0], &c, 1);
+	_exit(0);
+}
+
+static void _body_b(void)
+{
+	_fork_role(PROC_D, NULL);
+}
+
+static void _body_a(void)
+{
+	/* children exit without waiting to be reaped */
+	signal(SIGCHLD, SIG_IGN);
+	_fork_role(PROC_B, _body_b);
+	_fork_role(PROC_C, NULL);
+}
+
+static void *_thread(void *arg)
+{
+	char c;
+
+	thread_tid = (pid_t) syscall(SYS_gettid);
+	(void) read(hold[0], &c, 1);
+	return NULL;
+}
+
+/* Kill a process and wait for it to be gone, RET 0 on success */
+static int _kill(pid_t victim)
+{
+	int i;
+
+	kill(victim, SIGKILL);
+	for (i = 0; i < 500; i++) {
+		if ((kill(victim, 0) < 0) && (errno == ESRCH))
+			return 0;
+		usleep(10000);
+	}
+	return -1;
+}
+
+static int _count(proc_sampler_t *ps, pid_t base)
+{
+	proc_rec_t total;
+
+	return proc_sampler_sum(ps, base, &total);
+}
+
+static bool _held_open(proc_sampler_t *ps, pid_t p)
+{
+	proc_rec_t *rec = proc_sampler_find(ps, p);
+
+	return (rec && (rec->fd >= 0) &&
+		(fcntl(rec->fd, F_GETFD) & FD_CLOEXEC));
+}
+
+static bool _closed(proc_sampler_t *ps, pid_t p)
+{
+	proc_rec_t *rec = proc_sampler_find(ps, p);
+
+	return (rec && (rec->fd < 0));
+}
+
+int
+main(int argc, char *argv[])
+{
+	proc_sampler_t *ps;
+	proc_rec_t *rec;
+	pid_t list[PROC_CNT];
+	pthread_t tid;
+	int i, msg[2];
+
+	if ((pipe(hold) < 0) || (pipe(report) < 0)) {
+		fail("pipe");
+		return 1;
+	}
+	alarm(60);
+	pthread_create(&tid, NULL, _thread, NULL);
+	_fork_role(PROC_A, _body_a);
+	for (i = 0; i < PROC_CNT; i++) {
+		if (read(report[0], msg, sizeof(msg)) != sizeof(msg)) {
+			fail("process tree created");
+			return 1;
+		}
+		pid[msg[0]] = (pid_t) msg[1];
+	}
+	while (!thread_tid)
+		usleep(1000);
+
+	note("Testing a tree sampled from /proc");
+	ps = proc_sampler_create();
+	TEST(proc_sampler_poll(ps, NULL, 0) >= PROC_CNT + 1, "poll");
+	rec = proc_sampler_find(ps, pid[PROC_D]);
+	TEST(rec && rec->parent &&
+	     (rec->parent == proc_sampler_find(ps, pid[PROC_B])),
+	     "child linked to parent");
+	rec = proc_sampler_find(ps, pid[PROC_A]);
+	TEST(rec && (rec->parent == proc_sampler_find(ps, getpid())),
+	     "tree linked to its parent");
+	TEST(proc_sampler_find(ps, thread_tid) == NULL, "thread not listed");
+	TEST(_count(ps, pid[PROC_B]) == 2, "sum of subtree");
+	TEST(_count(ps, pid[PROC_A]) == 4, "sum of tree");
+	TEST(_count(ps, getpid()) == 5, "sum from test process");
+	TEST(_closed(ps, pid[PROC_A]), "stat file not held before a sum");
+
+	TEST(proc_sampler_poll(ps, NULL, 0) >= PROC_CNT + 1, "poll again");
+	TEST(_held_open(ps, pid[PROC_A]) && _held_open(ps, pid[PROC_D]),
+	     "stat files of counted processes held open");
+	TEST(_closed(ps, getppid()) && _closed(ps, 1),
+	     "stat files of other processes not held open");
+	TEST(_count(ps, pid[PROC_A]) == 4, "sum unchanged");
+
+	note("Testing a process which exits");
+	TEST(_kill(pid[PROC_B]) == 0, "kill B");
+	TEST(proc_sampler_poll(ps, NULL, 0) >= PROC_CNT, "poll");
+	TEST(proc_sampler_find(ps, pid[PROC_B]) == NULL, "exited not found");
+	rec = proc_sampler_find(ps, pid[PROC_D]);
+	TEST(rec && (rec->ppid != pid[PROC_B]) &&
+	     (rec->parent != proc_sampler_find(ps, pid[PROC_A])),
+	     "orphan given a new parent");
+	TEST(_count(ps, pid[PROC_A]) == 2, "orphan not in tree");
+	TEST(proc_sampler_poll(ps, NULL, 0) >= PROC_CNT, "poll again");
+	TEST(_closed(ps, pid[PROC_D]), "orphan's stat file closed");
+	proc_sampler_destroy(ps);
+
+	note("Testing a list of pids");
+	ps = proc_sampler_create();
+	list[0] = pid[PROC_A];
+	list[1] = pid[PROC_C];
+	list[2] = pid[PROC_D];
+	list[3] = thread_tid;
+	TEST(proc_sampler_poll(ps, list, 4) == 4, "poll");
+	rec = proc_sampler_find(ps, thread_tid);
+	TEST(rec && rec->lwp, "thread found as such");
+	TEST(_count(ps, thread_tid) == 0, "thread not counted");
+	TEST(_count(ps, pid[PROC_A]) == 2, "sum of listed tree");
+	TEST(_held_open(ps, pid[PROC_A]) && _held_open(ps, pid[PROC_D]),
+	     "stat files of listed processes held open");
+	TEST(_kill(pid[PROC_C]) == 0, "kill C");
+	TEST(proc_sampler_poll(ps, list, 4) == 3, "poll after exit");
+	TEST(proc_sampler_find(ps, pid[PROC_C]) == NULL, "exited not found");
+	TEST(_count(ps, pid[PROC_A]) == 1, "sum after exit");
+	proc_sampler_destroy(ps);
+
+	close(hold[1]);
+	pthread_join(tid, NULL);
+	waitpid(pid[PROC_A], NULL, 0);
+	_kill(pid[PROC_D]);
+
+	totals();
+	return failed;
+}
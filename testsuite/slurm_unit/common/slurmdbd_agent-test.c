@@ -0,0 +1,325 @@
+/* Test of the SlurmDBD agent in src/common/slurmdbd_defs.c
+ *
+ * A fake SlurmDBD takes two batches of messages, then stops reading in
+ * the middle of a third so that sending it fails. The messages of the
+ * batches sent before the failure must not be sent again. The version
+ * the fake SlurmDBD reports on reconnecting must be recorded.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "slurm/slurm_errno.h"
+#include "src/common/list.h"
+#include "src/common/pack.h"
+#include "src/common/slurmdbd_defs.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define MSG_CNT		4000	/* four batches */
+#define MSG_PAD		8192	/* so a batch can not fit in socket buffers */
+#define HELD_BATCHES	2	/* batches taken before stalling */
+
+static pthread_mutex_t srv_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  srv_cond = PTHREAD_COND_INITIALIZER;
+static int listen_fd = -1;
+static int conn_cnt = 0, recv_cnt = 0, dup_cnt = 0;
+static char seen[MSG_CNT];
+
+static void _no_op(void)
+{
+}
+
+static int _read_all(int fd, void *buf, size_t len)
+{
+	char *ptr = buf;
+	ssize_t rd;
+
+	while (len) {
+		rd = read(fd, ptr, len);
+		if (rd <= 0)
+			return -1;
+		ptr += rd;
+		len -= rd;
+	}
+	return 0;
+}
+
+static int _write_all(int fd, void *buf, size_t len)
+{
+	char *ptr = buf;
+	ssize_t wr;
+
+	while (len) {
+		wr = write(fd, ptr, len);
+		if (wr <= 0)
+			return -1;
+		ptr += wr;
+		len -= wr;
+	}
+	return 0;
+}
+
+static Buf _srv_recv(int fd, uint32_t msg_size)
+{
+	char *msg;
+
+	if ((msg_size == 0) &&
+	    (_read_all(fd, &msg_size, sizeof(msg_size)) < 0))
+		return NULL;
+	msg_size = ntohl(msg_size);
+	msg = xmalloc(msg_size);
+	if (_read_all(fd, msg, msg_size) < 0) {
+		xfree(msg);
+		return NULL;
+	}
+	return create_buf(msg, msg_size);
+}
+
+static void _srv_send(int fd, Buf buffer)
+{
+	uint32_t nw_size = htonl(get_buf_offset(buffer));
+
+	(void) _write_all(fd, &nw_size, sizeof(nw_size));
+	(void) _write_all(fd, get_buf_data(buffer), get_buf_offset(buffer));
+	free_buf(buffer);
+}
+
+static Buf _pack_rc(uint16_t sent_type)
+{
+	dbd_rc_msg_t msg;
+	Buf buffer = init_buf(64);
+
+	memset(&msg, 0, sizeof(dbd_rc_msg_t));
+	msg.sent_type = sent_type;
+	pack16((uint16_t) DBD_RC, buffer);
+	slurmdbd_pack_rc_msg(&msg, SLURMDBD_VERSION, buffer);
+	return buffer;
+}
+
+/* Record one DBD_NODE_STATE message, its cpu_count is its sequence */
+static void _record(Buf buffer)
+{
+	dbd_node_state_msg_t *msg;
+	uint16_t msg_type;
+
+	set_buf_offset(buffer, 0);
+	if ((unpack16(&msg_type, buffer) != SLURM_SUCCESS) ||
+	    (msg_type != DBD_NODE_STATE) ||
+	    (slurmdbd_unpack_node_state_msg(&msg, SLURMDBD_VERSION, buffer)
+	     != SLURM_SUCCESS))
+		return;
+	pthread_mutex_lock(&srv_lock);
+	if (msg->cpu_count < MSG_CNT) {
+		if (seen[msg->cpu_count]++)
+			dup_cnt++;
+		else
+			recv_cnt++;
+	}
+	pthread_cond_broadcast(&srv_cond);
+	pthread_mutex_unlock(&srv_lock);
+	slurmdbd_free_node_state_msg(msg);
+}
+
+/* Record the messages of a DBD_SEND_MULT_MSG and return the reply */
+static Buf _record_mult(Buf buffer)
+{
+	dbd_list_msg_t *list_msg, reply_msg;
+	slurmdbd_msg_t reply;
+	ListIterator itr;
+	Buf msg_buf, reply_buf;
+
+	if (slurmdbd_unpack_list_msg(&list_msg, SLURMDBD_VERSION,
+				     DBD_SEND_MULT_MSG, buffer)
+	    != SLURM_SUCCESS)
+		return NULL;
+	memset(&reply_msg, 0, sizeof(dbd_list_msg_t));
+	reply_msg.my_list = list_create(slurmdbd_free_buffer);
+	itr = list_iterator_create(list_msg->my_list);
+	while ((msg_buf = list_next(itr))) {
+		_record(msg_buf);
+		list_append(reply_msg.my_list, _pack_rc(DBD_NODE_STATE));
+	}
+	list_iterator_destroy(itr);
+	slurmdbd_free_list_msg(list_msg);
+
+	reply.msg_type = DBD_GOT_MULT_MSG;
+	reply.data = &reply_msg;
+	reply_buf = pack_slurmdbd_msg(&reply, SLURMDBD_VERSION);
+	list_destroy(reply_msg.my_list);
+	return reply_buf;
+}
+
+/* Fake SlurmDBD. On its first connection, hold the replies to the first
+ * HELD_BATCHES batches until the next one has started, then send them
+ * and stop reading. */
+static void *_server(void *arg)
+{
+	Buf buffer, held[HELD_BATCHES];
+	int fd, old_fd = -1, held_cnt, conn;
+	uint16_t msg_type;
+	uint32_t next_size;
+
+	while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+		if (old_fd >= 0)
+			close(old_fd);
+		pthread_mutex_lock(&srv_lock);
+		conn = conn_cnt++;
+		pthread_mutex_unlock(&srv_lock);
+		held_cnt = 0;
+		while ((buffer = _srv_recv(fd, 0))) {
+			Buf reply = NULL;
+
+			if (unpack16(&msg_type, buffer) != SLURM_SUCCESS)
+				msg_type = 0;
+			if (msg_type == DBD_INIT) {
+				/* Report a version only on reconnecting, as
+				 * a slurmdbd that was upgraded meanwhile */
+				reply = _pack_rc(DBD_INIT);
+				if (conn > 0)
+					pack16((uint16_t) SLURMDBD_VERSION,
+					       reply);
+			} else if (msg_type == DBD_SEND_MULT_MSG) {
+				reply = _record_mult(buffer);
+			} else if (msg_type == DBD_NODE_STATE) {
+				_record(buffer);
+				reply = _pack_rc(DBD_NODE_STATE);
+			}
+			free_buf(buffer);
+			if (!reply)
+				break;
+			if ((conn > 0) || (msg_type != DBD_SEND_MULT_MSG)) {
+				_srv_send(fd, reply);
+				continue;
+			}
+			held[held_cnt++] = reply;
+			if (held_cnt < HELD_BATCHES)
+				continue;
+			/* Wait for the next batch to start, reply to
+			 * those held and stall the sender */
+			(void) _read_all(fd, &next_size, sizeof(next_size));
+			for (held_cnt = 0; held_cnt < HELD_BATCHES; held_cnt++)
+				_srv_send(fd, held[held_cnt]);
+			break;
+		}
+		if (conn == 0)
+			old_fd = fd;	/* keep the stalled connection open */
+		else
+			close(fd);
+	}
+	return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+	slurm_trigger_callbacks_t callbacks = {
+		_no_op, _no_op, _no_op, _no_op, _no_op };
+	char dir[] = "/tmp/slurmdbd_agent-test.XXXXXX";
+	char cwd[1024], *conf_name = NULL, *state_name = NULL, *pad;
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	dbd_node_state_msg_t node_msg;
+	slurmdbd_msg_t req;
+	struct timespec abs_time;
+	pthread_t tid;
+	FILE *fp;
+	int i, rcvbuf = 65536;
+	uint16_t version;
+
+	signal(SIGPIPE, SIG_IGN);
+	if (!mkdtemp(dir) || !getcwd(cwd, sizeof(cwd))) {
+		fail("create test directory");
+		return 1;
+	}
+
+	/* Bind now, but only listen once the messages are queued */
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(listen_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if ((bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) ||
+	    (getsockname(listen_fd, (struct sockaddr *) &addr, &addr_len) < 0)){
+		fail("bind fake SlurmDBD socket");
+		return 1;
+	}
+
+	xstrfmtcat(conf_name, "%s/slurm.conf", dir);
+	if (!(fp = fopen(conf_name, "w"))) {
+		fail("write slurm.conf");
+		return 1;
+	}
+	fprintf(fp, "ClusterName=test\n"
+		"ControlMachine=localhost\n"
+		"AuthType=auth/none\n"
+		"PluginDir=%s/../../../src/plugins/auth/none/.libs\n"
+		"StateSaveLocation=%s\n"
+		"AccountingStorageType=accounting_storage/slurmdbd\n"
+		"AccountingStorageHost=localhost\n"
+		"AccountingStoragePort=%hu\n",
+		cwd, dir, ntohs(addr.sin_port));
+	fclose(fp);
+	setenv("SLURM_CONF", conf_name, 1);
+
+	note("Queueing messages while the SlurmDBD is down");
+	pad = xmalloc(MSG_PAD + 1);
+	memset(pad, 'x', MSG_PAD);
+	memset(&node_msg, 0, sizeof(dbd_node_state_msg_t));
+	node_msg.hostlist = "node";
+	node_msg.reason = pad;
+	req.msg_type = DBD_NODE_STATE;
+	req.data = &node_msg;
+	TEST(slurm_open_slurmdbd_conn(NULL, &callbacks, false)
+	     != SLURM_SUCCESS, "connect to SlurmDBD that is down");
+	for (i = 0; i < MSG_CNT; i++) {
+		node_msg.cpu_count = i;
+		slurm_send_slurmdbd_msg(SLURMDBD_VERSION, &req);
+	}
+	xfree(pad);
+
+	/* The agent tries to connect again after 10 seconds */
+	note("Sending the messages with a failure after two batches");
+	listen(listen_fd, 5);
+	pthread_create(&tid, NULL, _server, NULL);
+	abs_time.tv_sec = time(NULL) + 60;
+	abs_time.tv_nsec = 0;
+	pthread_mutex_lock(&srv_lock);
+	while ((recv_cnt < MSG_CNT) &&
+	       (pthread_cond_timedwait(&srv_cond, &srv_lock, &abs_time) == 0))
+		;
+	pthread_mutex_unlock(&srv_lock);
+	version = slurmdbd_get_server_version();
+	slurm_close_slurmdbd_conn();
+
+	TEST(conn_cnt > 1, "reconnect after send failure");
+	TEST(recv_cnt == MSG_CNT, "every message received");
+	TEST(dup_cnt == 0, "no message received twice");
+	TEST(version == SLURMDBD_VERSION, "SlurmDBD version recorded");
+
+	unlink(conf_name);
+	xfree(conf_name);
+	xstrfmtcat(state_name, "%s/dbd.messages", dir);
+	unlink(state_name);
+	xfree(state_name);
+	rmdir(dir);
+
+	totals();
+	return failed;
+}
@@ -0,0 +1,154 @@
+/* Test of src/common/timer_wheel.c
+ */
+#include <stdlib.h>
+#include <src/common/timer_wheel.h>
+#include <src/common/xmalloc.h>
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define ENT_CNT 5000
+
+/* Advance the wheel one second at a time from start through end, checking
+ * that every pending entry expires in exactly the second it is due.
+ * RET count of entries which expired early, late or twice */
+static int _run(timer_wheel_t *tw, timer_ent_t *ents, time_t start,
+		time_t end)
+{
+	timer_ent_t *ent;
+	time_t now;
+	int errors = 0;
+
+	for (now = start; now <= end; now++) {
+		timer_wheel_expire(tw, now);
+		while ((ent = timer_wheel_next(tw))) {
+			if (ent->expires != now)
+				errors++;
+		}
+	}
+	for (ent = ents; ent < ents + ENT_CNT; ent++) {
+		if (timer_ent_pending(ent) && (ent->expires <= end))
+			errors++;
+	}
+	return errors;
+}
+
+int
+main(int argc, char *argv[])
+{
+	time_t base = 1000000000;
+
+	note("Testing basic operations");
+	{
+		timer_wheel_t *tw = timer_wheel_create(base);
+		timer_ent_t a, b, c;
+
+		timer_ent_init(&a, &a);
+		timer_ent_init(&b, &b);
+		timer_ent_init(&c, &c);
+		TEST(!timer_ent_pending(&a), "not pending after init");
+		timer_wheel_add(tw, &a, base + 10);
+		timer_wheel_add(tw, &b, base + 100);
+		timer_wheel_add(tw, &c, base - 5);
+		TEST(timer_ent_pending(&a), "pending after add");
+		TEST(timer_wheel_count(tw) == 3, "count");
+		TEST(timer_wheel_expire(tw, base) == 1, "past entry expires");
+		TEST(timer_wheel_next(tw) == &c, "next");
+		TEST(timer_wheel_next(tw) == NULL, "next when none");
+		TEST(timer_wheel_expire(tw, base + 9) == 0, "expire early");
+		TEST(timer_wheel_expire(tw, base + 10) == 1, "expire on time");
+		timer_wheel_add(tw, &a, base + 50);
+		TEST(timer_wheel_next(tw) == NULL, "re-add of collected entry");
+		timer_wheel_del(tw, &b);
+		TEST(!timer_ent_pending(&b), "not pending after del");
+		timer_wheel_del(tw, &b);
+		TEST(timer_wheel_count(tw) == 1, "count after del");
+		TEST(timer_wheel_expire(tw, base + 5) == 0, "clock going back");
+		TEST(timer_wheel_expire(tw, base + 200) == 1, "expire after move");
+		TEST(timer_wheel_next(tw) == &a, "next after move");
+		TEST(timer_wheel_count(tw) == 0, "count when empty");
+		timer_wheel_add(tw, &a, base + 300);
+		timer_wheel_destroy(tw);
+		TEST(!timer_ent_pending(&a), "not pending after destroy");
+	}
+
+	note("Testing expiration times across all levels");
+	{
+		timer_wheel_t *tw = timer_wheel_create(base + 1);
+		timer_ent_t *ents = xmalloc(sizeof(timer_ent_t) * ENT_CNT);
+		time_t delta, end = base + 300000;
+		int i;
+
+		srandom(1);
+		for (i = 0; i < ENT_CNT; i++) {
+			timer_ent_init(&ents[i], NULL);
+			/* Spread entries over ranges of each level */
+			delta = random() % ((time_t) 1 << (6 * (i % 4 + 1)));
+			timer_wheel_add(tw, &ents[i], base + 1 + delta);
+		}
+		TEST(_run(tw, ents, base + 1, end) == 0,
+		     "every entry expires in its second");
+
+		/* Move and remove entries while the wheel is running */
+		for (i = 0; i < ENT_CNT; i++) {
+			delta = random() % 100000;
+			timer_wheel_add(tw, &ents[i], end + 1 + delta);
+		}
+		for (i = 0; i < ENT_CNT; i += 3)
+			timer_wheel_del(tw, &ents[i]);
+		TEST(timer_wheel_count(tw) == (ENT_CNT - (ENT_CNT + 2) / 3),
+		     "count after moves and removals");
+		TEST(_run(tw, ents, end + 1, end + 100000) == 0,
+		     "moved entries expire in their second");
+		TEST(timer_wheel_count(tw) == 0, "count after expiring all");
+		timer_wheel_destroy(tw);
+		xfree(ents);
+	}
+
+	note("Testing catching up after a clock jump");
+	{
+		timer_wheel_t *tw = timer_wheel_create(base);
+		timer_ent_t a, b, c;
+
+		timer_ent_init(&a, NULL);
+		timer_ent_init(&b, NULL);
+		timer_ent_init(&c, NULL);
+		timer_wheel_add(tw, &a, base + 10);
+		timer_wheel_add(tw, &b, base + 86400);
+		timer_wheel_add(tw, &c, base + 86400 + 30);
+		TEST(timer_wheel_expire(tw, base + 86400) == 2,
+		     "expire after jump");
+		TEST(timer_wheel_expire(tw, base + 86400 + 29) == 0,
+		     "expire early after jump");
+		TEST(timer_wheel_expire(tw, base + 86400 + 30) == 1,
+		     "expire on time after jump");
+		timer_wheel_destroy(tw);
+	}
+
+	note("Testing entries beyond the range of the wheel");
+	{
+		timer_wheel_t *tw = timer_wheel_create(base);
+		timer_ent_t a;
+		time_t when = base + 400 * 24 * 60 * 60, now;
+		uint32_t cnt = 0;
+
+		timer_ent_init(&a, NULL);
+		timer_wheel_add(tw, &a, when);
+		/* Steps shorter than the catch up limit */
+		for (now = base; now < when; now += 3000)
+			cnt += timer_wheel_expire(tw, now);
+		TEST(cnt == 0, "no early expiration");
+		TEST(timer_wheel_expire(tw, when) == 1, "expire when due");
+		timer_wheel_destroy(tw);
+	}
+
+	totals();
+	return failed;
+}